@@ -500,7 +500,8 @@ UefiInitializeBootDevices(VOID)
 {
     ULONG i = 0;
 
-    DiskReadBufferSize = EFI_PAGE_SIZE;
+    /* Big enough for the disk cache to read several blocks at once */
+    DiskReadBufferSize = 16 * EFI_PAGE_SIZE;
     DiskReadBuffer = MmAllocateMemoryWithType(DiskReadBufferSize, LoaderFirmwareTemporary);
     UefiSetupBlockDevices();
     UefiSetBootpath();
@@ -588,9 +589,8 @@ UefiDiskGetDriveGeometry(UCHAR DriveNumber, PGEOMETRY Geometry)
 ULONG
 UefiDiskGetCacheableBlockCount(UCHAR DriveNumber)
 {
-    ULONG UefiDriveNumber = InternalUefiDisk[DriveNumber - FIRST_BIOS_DISK].UefiRootNumber;
-    TRACE("UefiDiskGetCacheableBlockCount: DriveNumber: %d\n", UefiDriveNumber);
+    TRACE("UefiDiskGetCacheableBlockCount: DriveNumber: %d\n", DriveNumber);
 
-    GlobalSystemTable->BootServices->HandleProtocol(handles[UefiDriveNumber], &bioGuid, (void**)&bio);
-    return bio->Media->LastBlock;
+    /* Like LBA BIOS disks, there are no track boundaries to follow */
+    return 64;
 }
@@ -23,20 +23,26 @@
 #define TAG_CACHE_DATA 'DcaC'
 #define TAG_CACHE_BLOCK 'BcaC'
 
+#define CACHE_HASH_BUCKETS      64          // Number of hash chains of cached blocks
+#define CACHE_MAX_BLOCK_SIZE    (8 * 1024)  // Largest cache block, in bytes
+#define CACHE_MAX_READ_AHEAD    8           // Most blocks read from the disk at once on a miss
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // This structure describes a cached block element. The disk is divided up into
-// cache blocks. For disks which LBA is not supported each block is the size of
-// one track. This will force the cache manager to make track sized reads, and
-// therefore maximizes throughput. For disks which support LBA the block size
-// is 64k because they have no cylinder, head, or sector boundaries.
+// cache blocks. For disks which LBA is not supported each block is at most the
+// size of one track. For disks which support LBA the block size is up to 8k
+// because they have no cylinder, head, or sector boundaries. On a miss, the
+// following blocks are read along with the missing one, as many as fit into
+// one disk read, so that sequential reads don't go to the disk every block.
 //
 ///////////////////////////////////////////////////////////////////////////////////////
 typedef struct
 {
-    LIST_ENTRY    ListEntry;                    // Doubly linked list synchronization member
+    LIST_ENTRY    ListEntry;                    // LRU list of the drive, most recently used first
+    LIST_ENTRY    HashListEntry;                // Hash chain of the drive, by block number
 
-    ULONG            BlockNumber;                // Track index for CHS, 64k block index for LBA
+    ULONG            BlockNumber;                // Block index (BlockSize sectors each)
     BOOLEAN        LockedInCache;                // Indicates that this block is locked in cache memory
     ULONG            AccessCount;                // Access count for this block
 
@@ -57,7 +63,9 @@ typedef struct
     ULONG            BytesPerSector;
 
     ULONG            BlockSize;            // Block size (in sectors)
+    ULONG            ReadAheadCount;            // Blocks read at once on a miss, 1 if there is no read-ahead
     LIST_ENTRY        CacheBlockHead;            // Contains CACHE_BLOCK structures
+    LIST_ENTRY        CacheBlockHash[CACHE_HASH_BUCKETS];    // Contains CACHE_BLOCK structures by block number
 
 } CACHE_DRIVE, *PCACHE_DRIVE;
 
@@ -73,6 +81,14 @@ extern    ULONG                CacheBlockCount;
 extern    SIZE_T                CacheSizeLimit;
 extern    SIZE_T                CacheSizeCurrent;
 
+#if DBG
+extern    ULONG                CacheHitCount;
+extern    ULONG                CacheMissCount;
+extern    ULONG                CacheDiskReadCount;
+extern    ULONGLONG            CacheDiskReadSectors;
+extern    ULONGLONG            CacheDiskReadTime;
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // Internal functions
@@ -92,3 +108,4 @@ VOID    CacheInvalidateCacheData(VOID);
 BOOLEAN    CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount, PVOID Buffer);
 BOOLEAN    CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount);
 BOOLEAN    CacheReleaseMemory(ULONG MinimumAmountToRelease);
+VOID    CacheDumpStatistics(VOID);
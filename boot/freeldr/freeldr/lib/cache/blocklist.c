@@ -22,6 +22,8 @@
 #include <debug.h>
 DBG_DEFAULT_CHANNEL(CACHE);
 
+#define CACHE_HASH(BlockNumber)    ((BlockNumber) % CACHE_HASH_BUCKETS)
+
 // Returns a pointer to a CACHE_BLOCK structure
 // Adds the block to the cache manager block list
 // in cache memory if it isn't already there
@@ -36,106 +38,160 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     if (CacheBlock != NULL)
     {
         TRACE("Cache hit! BlockNumber: %d CacheBlock->BlockNumber: %d\n", BlockNumber, CacheBlock->BlockNumber);
+#if DBG
+        CacheHitCount++;
+#endif
+
+        // Optimize the block list so it has a LRU structure
+        CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
 
         return CacheBlock;
     }
 
     TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
+#if DBG
+    CacheMissCount++;
+#endif
 
-    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
+    // The block is inserted at the head of the list, which
+    // already makes it the most recently used one
+    return CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
+}
 
-    // Optimize the block list so it has a LRU structure
-    CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
+static PCACHE_BLOCK CacheInternalLookupBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+{
+    PLIST_ENTRY        HashHead;
+    PLIST_ENTRY        Entry;
+    PCACHE_BLOCK    CacheBlock;
 
-    return CacheBlock;
+    // Only the blocks with the same hash have to be searched
+    HashHead = &CacheDrive->CacheBlockHash[CACHE_HASH(BlockNumber)];
+    for (Entry = HashHead->Flink; Entry != HashHead; Entry = Entry->Flink)
+    {
+        CacheBlock = CONTAINING_RECORD(Entry, CACHE_BLOCK, HashListEntry);
+        if (CacheBlock->BlockNumber == BlockNumber)
+        {
+            return CacheBlock;
+        }
+    }
+
+    return NULL;
 }
 
 PCACHE_BLOCK CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PCACHE_BLOCK    CacheBlock;
 
     TRACE("CacheInternalFindBlock() BlockNumber = %d\n", BlockNumber);
 
-    //
-    // Make sure the block list has entries before I start searching it.
-    //
-    if (!IsListEmpty(&CacheDrive->CacheBlockHead))
+    CacheBlock = CacheInternalLookupBlock(CacheDrive, BlockNumber);
+    if (CacheBlock != NULL)
     {
         //
-        // Search the list and find the BIOS drive number
+        // Increment the blocks access count
         //
-        CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
-
-        while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
-        {
-            //
-            // We found the block, so return it
-            //
-            if (CacheBlock->BlockNumber == BlockNumber)
-            {
-                //
-                // Increment the blocks access count
-                //
-                CacheBlock->AccessCount++;
-
-                return CacheBlock;
-            }
-
-            CacheBlock = CONTAINING_RECORD(CacheBlock->ListEntry.Flink, CACHE_BLOCK, ListEntry);
-        }
+        CacheBlock->AccessCount++;
     }
 
-    return NULL;
+    return CacheBlock;
 }
 
 PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
+    ULONG            BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
+    ULONG            BlockCount;
+    ULONG            Idx;
+    BOOLEAN            Success;
+#if DBG && !defined(_M_ARM)
+    ULONGLONG Time = __rdtsc();
+#endif
 
     TRACE("CacheInternalAddBlockToCache() BlockNumber = %d\n", BlockNumber);
 
-    // Check the size of the cache so we don't exceed our limits
-    CacheInternalCheckCacheSizeLimits(CacheDrive);
-
-    // We will need to add the block to the
-    // drive's list of cached blocks. So allocate
-    // the block memory.
-    CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
-    if (CacheBlock == NULL)
+    // Read ahead the blocks that follow this one, up to the
+    // first one that is already cached, so that a sequential
+    // reader costs one disk read every ReadAheadCount blocks
+    for (BlockCount = 1; BlockCount < CacheDrive->ReadAheadCount; BlockCount++)
     {
-        return NULL;
+        if (BlockNumber + BlockCount < BlockNumber ||
+            CacheInternalLookupBlock(CacheDrive, BlockNumber + BlockCount) != NULL)
+        {
+            break;
+        }
     }
 
-    // Now initialize the structure and
-    // allocate room for the block data
-    RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
-    CacheBlock->BlockNumber = BlockNumber;
-    CacheBlock->BlockData = FrLdrTempAlloc(CacheDrive->BlockSize * CacheDrive->BytesPerSector,
-                                           TAG_CACHE_DATA);
-    if (CacheBlock->BlockData ==NULL)
+    // Now try to read in the blocks, all in one go
+    Success = MachDiskReadLogicalSectors(CacheDrive->DriveNumber,
+                                         (ULONGLONG)BlockNumber * CacheDrive->BlockSize,
+                                         BlockCount * CacheDrive->BlockSize,
+                                         DiskReadBuffer);
+    if (!Success && BlockCount > 1)
     {
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        // The read may have gone past the end of the disk,
+        // so fall back to reading only the requested block
+        BlockCount = 1;
+        Success = MachDiskReadLogicalSectors(CacheDrive->DriveNumber,
+                                             (ULONGLONG)BlockNumber * CacheDrive->BlockSize,
+                                             CacheDrive->BlockSize,
+                                             DiskReadBuffer);
     }
-
-    // Now try to read in the block
-    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+    if (!Success)
     {
-        FrLdrTempFree(CacheBlock->BlockData, TAG_CACHE_DATA);
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
         return NULL;
     }
-    RtlCopyMemory(CacheBlock->BlockData, DiskReadBuffer, CacheDrive->BlockSize * CacheDrive->BytesPerSector);
 
-    // Add it to our list of blocks managed by the cache
-    InsertTailList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+#if DBG
+    CacheDiskReadCount++;
+    CacheDiskReadSectors += BlockCount * CacheDrive->BlockSize;
+#endif
 
-    // Update the cache data
-    CacheBlockCount++;
-    CacheSizeCurrent = CacheBlockCount * (CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+    // Add the blocks last one first, so that the requested
+    // block ends up at the head of the list
+    for (Idx = BlockCount; Idx-- > 0; )
+    {
+        // Check the size of the cache so we don't exceed our limits
+        CacheInternalCheckCacheSizeLimits(CacheDrive);
+
+        // We will need to add the block to the
+        // drive's list of cached blocks. So allocate
+        // the block memory.
+        CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
+        if (CacheBlock == NULL)
+        {
+            continue;
+        }
+
+        // Now initialize the structure and
+        // allocate room for the block data
+        RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
+        CacheBlock->BlockNumber = BlockNumber + Idx;
+        CacheBlock->BlockData = FrLdrTempAlloc(BlockBytes, TAG_CACHE_DATA);
+        if (CacheBlock->BlockData == NULL)
+        {
+            FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
+            CacheBlock = NULL;
+            continue;
+        }
+        RtlCopyMemory(CacheBlock->BlockData, (PUCHAR)DiskReadBuffer + Idx * BlockBytes, BlockBytes);
+
+        // Add it to our list of blocks managed by the cache
+        InsertHeadList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+        InsertHeadList(&CacheDrive->CacheBlockHash[CACHE_HASH(CacheBlock->BlockNumber)],
+                       &CacheBlock->HashListEntry);
+
+        // Update the cache data
+        CacheBlockCount++;
+        CacheSizeCurrent = CacheBlockCount * BlockBytes;
+    }
+
+#if DBG && !defined(_M_ARM)
+    CacheDiskReadTime += __rdtsc() - Time;
+#endif
 
     CacheInternalDumpBlockList(CacheDrive);
 
+    // This is NULL if the requested block could not be allocated
     return CacheBlock;
 }
 
@@ -156,12 +212,13 @@ BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
 
     // No blocks left in cache that can be freed
     // so just return
-    if (IsListEmpty(&CacheDrive->CacheBlockHead))
+    if (&CacheBlockToFree->ListEntry == &CacheDrive->CacheBlockHead)
     {
         return FALSE;
     }
 
     RemoveEntryList(&CacheBlockToFree->ListEntry);
+    RemoveEntryList(&CacheBlockToFree->HashListEntry);
 
     // Free the block memory and the block structure
     FrLdrTempFree(CacheBlockToFree->BlockData, TAG_CACHE_DATA);
@@ -198,6 +255,7 @@ VOID CacheInternalDumpBlockList(PCACHE_DRIVE CacheDrive)
     TRACE("Dumping block list for BIOS drive 0x%x.\n", CacheDrive->DriveNumber);
     TRACE("BytesPerSector: %d.\n", CacheDrive->BytesPerSector);
     TRACE("BlockSize: %d.\n", CacheDrive->BlockSize);
+    TRACE("ReadAheadCount: %d.\n", CacheDrive->ReadAheadCount);
     TRACE("CacheSizeLimit: %d.\n", CacheSizeLimit);
     TRACE("CacheSizeCurrent: %d.\n", CacheSizeCurrent);
     TRACE("CacheBlockCount: %d.\n", CacheBlockCount);
@@ -34,10 +34,20 @@ ULONG            CacheBlockCount = 0;
 SIZE_T            CacheSizeLimit = 0;
 SIZE_T            CacheSizeCurrent = 0;
 
+#if DBG
+ULONG            CacheHitCount = 0;
+ULONG            CacheMissCount = 0;
+ULONG            CacheDiskReadCount = 0;
+ULONGLONG        CacheDiskReadSectors = 0;
+ULONGLONG        CacheDiskReadTime = 0;
+#endif
+
 BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
 {
     PCACHE_BLOCK    NextCacheBlock;
     GEOMETRY    DriveGeometry;
+    ULONG        MaxReadSectors;
+    ULONG        Idx;
 
     // If we already have a cache for this drive then
     // by all means lets keep it, unless it is a removable
@@ -63,6 +73,7 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
         TRACE("CacheBlockCount: %d\n", CacheBlockCount);
         TRACE("CacheSizeLimit: %d\n", CacheSizeLimit);
         TRACE("CacheSizeCurrent: %d\n", CacheSizeCurrent);
+        CacheDumpStatistics();
         //
         // Loop through and free the cache blocks
         //
@@ -80,6 +91,10 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Initialize the structure
     RtlZeroMemory(&CacheManagerDrive, sizeof(CACHE_DRIVE));
     InitializeListHead(&CacheManagerDrive.CacheBlockHead);
+    for (Idx = 0; Idx < CACHE_HASH_BUCKETS; Idx++)
+    {
+        InitializeListHead(&CacheManagerDrive.CacheBlockHash[Idx]);
+    }
     CacheManagerDrive.DriveNumber = DriveNumber;
     if (!MachDiskGetDriveGeometry(DriveNumber, &DriveGeometry))
     {
@@ -87,24 +102,51 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     }
     CacheManagerDrive.BytesPerSector = DriveGeometry.BytesPerSector;
 
-    // Get the number of sectors in each cache block
+    // Get the number of sectors in each cache block. Blocks are
+    // read through the disk read buffer, so they must fit into it,
+    // and they are kept small so that a miss can read several of them
+    MaxReadSectors = (ULONG)(DiskReadBufferSize / CacheManagerDrive.BytesPerSector);
     CacheManagerDrive.BlockSize = MachDiskGetCacheableBlockCount(DriveNumber);
+    CacheManagerDrive.BlockSize = min(CacheManagerDrive.BlockSize, CACHE_MAX_BLOCK_SIZE / CacheManagerDrive.BytesPerSector);
+    CacheManagerDrive.BlockSize = min(CacheManagerDrive.BlockSize, MaxReadSectors);
+    CacheManagerDrive.BlockSize = max(CacheManagerDrive.BlockSize, 1);
 
     CacheBlockCount = 0;
     CacheSizeCurrent = 0;
     CacheSizeLimit = TotalPagesInLookupTable / 8 * MM_PAGE_SIZE;
     CacheSizeLimit = min(CacheSizeLimit, TEMP_HEAP_SIZE - (128 * 1024));
 
+    // Read as many blocks on a miss as fit into one disk read, but
+    // not so many that a single miss flushes a large part of the cache
+    CacheManagerDrive.ReadAheadCount = MaxReadSectors / CacheManagerDrive.BlockSize;
+    CacheManagerDrive.ReadAheadCount = min(CacheManagerDrive.ReadAheadCount, CACHE_MAX_READ_AHEAD);
+    CacheManagerDrive.ReadAheadCount = min(CacheManagerDrive.ReadAheadCount,
+                                           CacheSizeLimit / (CacheManagerDrive.BlockSize * CacheManagerDrive.BytesPerSector) / 4);
+    CacheManagerDrive.ReadAheadCount = max(CacheManagerDrive.ReadAheadCount, 1);
+
     CacheManagerInitialized = TRUE;
 
     TRACE("Initializing BIOS drive 0x%x.\n", DriveNumber);
     TRACE("BytesPerSector: %d.\n", CacheManagerDrive.BytesPerSector);
     TRACE("BlockSize: %d.\n", CacheManagerDrive.BlockSize);
+    TRACE("ReadAheadCount: %d.\n", CacheManagerDrive.ReadAheadCount);
     TRACE("CacheSizeLimit: %d.\n", CacheSizeLimit);
 
     return TRUE;
 }
 
+VOID CacheDumpStatistics(VOID)
+{
+#if DBG
+    TRACE("Cache hits: %lu, misses: %lu\n", CacheHitCount, CacheMissCount);
+    TRACE("Cache disk reads: %lu, %I64u sectors\n", CacheDiskReadCount, CacheDiskReadSectors);
+#if !defined(_M_ARM)
+    TRACE("Cache disk read time: %I64u cycles\n", CacheDiskReadTime);
+#endif
+    TRACE("CacheBlockCount: %d, CacheSizeCurrent: %d\n", CacheBlockCount, CacheSizeCurrent);
+#endif
+}
+
 VOID CacheInvalidateCacheData(VOID)
 {
     CacheManagerDataInvalid = TRUE;
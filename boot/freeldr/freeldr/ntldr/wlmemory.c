@@ -188,6 +188,7 @@ WinLdrSetupMemoryLayout(IN OUT PLOADER_PARAMETER_BLOCK LoaderBlock)
     BOOLEAN Status;
 
     /* Cleanup heap */
+    CacheDumpStatistics();
     FrLdrHeapCleanupAll();
 
     //
@@ -1776,7 +1776,7 @@ LdrpInitializeProcess(IN PCONTEXT Context,
     ULONG ConfigSize;
     UNICODE_STRING CurrentDirectory;
     HANDLE OptionsKey;
-    ULONG HeapFlags;
+    ULONG HeapFlags, HeapCompatibility;
     PIMAGE_NT_HEADERS NtHeader;
     LPWSTR NtDllName = NULL;
     NTSTATUS Status, ImportStatus;
@@ -2024,6 +2024,13 @@ LdrpInitializeProcess(IN PCONTEXT Context,
         return STATUS_NO_MEMORY;
     }
 
+    /* Put the low fragmentation heap in front of it, unless the heap is being debugged */
+    HeapCompatibility = 2;
+    RtlSetHeapInformation(Peb->ProcessHeap,
+                          HeapCompatibilityInformation,
+                          &HeapCompatibility,
+                          sizeof(HeapCompatibility));
+
     /* Allocate an Activation Context Stack */
     Status = RtlAllocateActivationContextStack(&Teb->ActivationContextStackPointer);
     if (!NT_SUCCESS(Status)) return Status;
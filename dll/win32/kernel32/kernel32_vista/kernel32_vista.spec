@@ -21,6 +21,40 @@
 
 @ stdcall InitializeCriticalSectionEx(ptr long long)
 
+@ stdcall CallbackMayRunLong(ptr)
+@ stdcall CancelThreadpoolIo(ptr) ntdll_vista.TpCancelAsyncIoOperation
+@ stdcall CloseThreadpool(ptr) ntdll_vista.TpReleasePool
+@ stdcall CloseThreadpoolCleanupGroup(ptr) ntdll_vista.TpReleaseCleanupGroup
+@ stdcall CloseThreadpoolCleanupGroupMembers(ptr long ptr) ntdll_vista.TpReleaseCleanupGroupMembers
+@ stdcall CloseThreadpoolIo(ptr) ntdll_vista.TpReleaseIoCompletion
+@ stdcall CloseThreadpoolTimer(ptr) ntdll_vista.TpReleaseTimer
+@ stdcall CloseThreadpoolWait(ptr) ntdll_vista.TpReleaseWait
+@ stdcall CloseThreadpoolWork(ptr) ntdll_vista.TpReleaseWork
+@ stdcall CreateThreadpool(ptr)
+@ stdcall CreateThreadpoolCleanupGroup()
+@ stdcall CreateThreadpoolIo(ptr ptr ptr ptr)
+@ stdcall CreateThreadpoolTimer(ptr ptr ptr)
+@ stdcall CreateThreadpoolWait(ptr ptr ptr)
+@ stdcall CreateThreadpoolWork(ptr ptr ptr)
+@ stdcall DisassociateCurrentThreadFromCallback(ptr) ntdll_vista.TpDisassociateCallback
+@ stdcall FreeLibraryWhenCallbackReturns(ptr ptr) ntdll_vista.TpCallbackUnloadDllOnCompletion
+@ stdcall IsThreadpoolTimerSet(ptr)
+@ stdcall LeaveCriticalSectionWhenCallbackReturns(ptr ptr) ntdll_vista.TpCallbackLeaveCriticalSectionOnCompletion
+@ stdcall ReleaseMutexWhenCallbackReturns(ptr ptr) ntdll_vista.TpCallbackReleaseMutexOnCompletion
+@ stdcall ReleaseSemaphoreWhenCallbackReturns(ptr ptr long) ntdll_vista.TpCallbackReleaseSemaphoreOnCompletion
+@ stdcall SetEventWhenCallbackReturns(ptr ptr) ntdll_vista.TpCallbackSetEventOnCompletion
+@ stdcall SetThreadpoolThreadMaximum(ptr long) ntdll_vista.TpSetPoolMaxThreads
+@ stdcall SetThreadpoolThreadMinimum(ptr long)
+@ stdcall SetThreadpoolTimer(ptr ptr long long) ntdll_vista.TpSetTimer
+@ stdcall SetThreadpoolWait(ptr long ptr) ntdll_vista.TpSetWait
+@ stdcall StartThreadpoolIo(ptr) ntdll_vista.TpStartAsyncIoOperation
+@ stdcall SubmitThreadpoolWork(ptr) ntdll_vista.TpPostWork
+@ stdcall TrySubmitThreadpoolCallback(ptr ptr ptr)
+@ stdcall WaitForThreadpoolIoCallbacks(ptr long) ntdll_vista.TpWaitForIoCompletion
+@ stdcall WaitForThreadpoolTimerCallbacks(ptr long) ntdll_vista.TpWaitForTimer
+@ stdcall WaitForThreadpoolWaitCallbacks(ptr long) ntdll_vista.TpWaitForWait
+@ stdcall WaitForThreadpoolWorkCallbacks(ptr long) ntdll_vista.TpWaitForWork
+
 @ stdcall GetFirmwareEnvironmentVariableExA(str str ptr long long)
 @ stdcall GetFirmwareEnvironmentVariableExW(wstr wstr ptr long long)
 @ stdcall GetFirmwareType(ptr)
@@ -0,0 +1,214 @@
+/*
+ * PROJECT:     ReactOS Win32 Base API
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Thread pool API
+ */
+
+#include "k32_vista.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* Most of the API is forwarded to the Tp* routines of ntdll, these are the
+   ones that need a Win32 error or a different callback. */
+
+static
+VOID
+NTAPI
+BasepTpIoCallback(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID Context,
+    _In_ PVOID ApcContext,
+    _In_ PIO_STATUS_BLOCK IoStatusBlock,
+    _In_ PTP_IO Io)
+{
+    /* CreateThreadpoolIo stored the Win32 callback in the first field of the object */
+    PTP_WIN32_IO_CALLBACK Callback = *(PTP_WIN32_IO_CALLBACK*)Io;
+
+    Callback(Instance,
+             Context,
+             ApcContext,
+             RtlNtStatusToDosError(IoStatusBlock->Status),
+             IoStatusBlock->Information,
+             Io);
+}
+
+BOOL
+WINAPI
+CallbackMayRunLong(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance)
+{
+    NTSTATUS Status;
+
+    Status = TpCallbackMayRunLong(Instance);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+PTP_POOL
+WINAPI
+CreateThreadpool(
+    _Reserved_ PVOID Reserved)
+{
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Status = TpAllocPool(&Pool, Reserved);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    return Pool;
+}
+
+PTP_CLEANUP_GROUP
+WINAPI
+CreateThreadpoolCleanupGroup(VOID)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    Status = TpAllocCleanupGroup(&CleanupGroup);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    return CleanupGroup;
+}
+
+PTP_IO
+WINAPI
+CreateThreadpoolIo(
+    _In_ HANDLE File,
+    _In_ PTP_WIN32_IO_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTP_IO Io;
+    NTSTATUS Status;
+
+    Status = TpAllocIoCompletion(&Io, File, BasepTpIoCallback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    /* No completion can come before the caller starts an operation */
+    *(PTP_WIN32_IO_CALLBACK*)Io = Callback;
+    return Io;
+}
+
+PTP_TIMER
+WINAPI
+CreateThreadpoolTimer(
+    _In_ PTP_TIMER_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTP_TIMER Timer;
+    NTSTATUS Status;
+
+    Status = TpAllocTimer(&Timer, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    return Timer;
+}
+
+PTP_WAIT
+WINAPI
+CreateThreadpoolWait(
+    _In_ PTP_WAIT_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTP_WAIT Wait;
+    NTSTATUS Status;
+
+    Status = TpAllocWait(&Wait, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    return Wait;
+}
+
+PTP_WORK
+WINAPI
+CreateThreadpoolWork(
+    _In_ PTP_WORK_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    PTP_WORK Work;
+    NTSTATUS Status;
+
+    Status = TpAllocWork(&Work, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return NULL;
+    }
+
+    return Work;
+}
+
+BOOL
+WINAPI
+IsThreadpoolTimerSet(
+    _Inout_ PTP_TIMER Timer)
+{
+    return TpIsTimerSet(Timer);
+}
+
+BOOL
+WINAPI
+SetThreadpoolThreadMinimum(
+    _Inout_ PTP_POOL Pool,
+    _In_ DWORD MinThreads)
+{
+    NTSTATUS Status;
+
+    Status = TpSetPoolMinThreads(Pool, MinThreads);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL
+WINAPI
+TrySubmitThreadpoolCallback(
+    _In_ PTP_SIMPLE_CALLBACK Callback,
+    _Inout_opt_ PVOID Context,
+    _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron)
+{
+    NTSTATUS Status;
+
+    Status = TpSimpleTryPost(Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        BaseSetLastNTError(Status);
+        return FALSE;
+    }
+
+    return TRUE;
+}
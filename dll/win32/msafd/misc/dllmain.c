@@ -2792,6 +2792,7 @@ WSPSetSockOpt(
 {
     PSOCKET_INFORMATION Socket;
     INT Errno;
+    ULONG Size;
 
     /* Get the Socket Structure associate to this Socket*/
     Socket = GetSocketStructure(s);
@@ -2890,7 +2891,8 @@ WSPSetSockOpt(
                                    NULL,
                                    NULL);
 
-              return NO_ERROR;
+              /* The helper passes the size on to the transport for its send buffer */
+              goto SendToHelper;
 
            case SO_RCVBUF:
               if (optlen < sizeof(ULONG))
@@ -2900,13 +2902,14 @@ WSPSetSockOpt(
               }
 
               /* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
-              if (*(PULONG)optval > 0x2000)
-                  *(PULONG)optval = 0x2000;
+              Size = *(PULONG)optval;
+              if (Size > 0x2000)
+                  Size = 0x2000;
 
               SetSocketInformation(Socket,
                                    AFD_INFO_RECEIVE_WINDOW_SIZE,
                                    NULL,
-                                   (PULONG)optval,
+                                   &Size,
                                    NULL,
                                    NULL,
                                    NULL);
@@ -2918,7 +2921,8 @@ WSPSetSockOpt(
                                    NULL,
                                    NULL);
 
-              return NO_ERROR;
+              /* The transport still gets the full size for its receive window */
+              goto SendToHelper;
 
            case SO_ERROR:
               if (optlen < sizeof(INT))
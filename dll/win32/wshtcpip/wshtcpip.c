@@ -174,6 +174,15 @@ GetTdiTypeId(
                 /* FIXME: Return proper option */
                 ASSERT(FALSE);
                 break;
+
+             case SO_RCVBUF:
+                *TdiId = AO_OPTION_WINDOW;
+                return;
+
+             case SO_SNDBUF:
+                *TdiId = AO_OPTION_SEND_WINDOW;
+                return;
+
              default:
                 break;
           }
@@ -689,6 +698,17 @@ WSHSetSocketInformation(
                     /* This is silently ignored on Windows */
                     return 0;
 
+                case SO_RCVBUF:
+                case SO_SNDBUF:
+                    if (OptionLength < sizeof(INT))
+                    {
+                        return WSAEFAULT;
+                    }
+                    /* AFD keeps its own copy, TCP also sizes its windows from these */
+                    if (Context->SocketType != SOCK_STREAM)
+                        return 0;
+                    break;
+
                 case SO_KEEPALIVE:
                     /* FIXME -- We'll send this to TCPIP */
                     DPRINT1("Set: SO_KEEPALIVE not yet supported\n");
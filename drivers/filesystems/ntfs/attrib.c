@@ -636,6 +636,9 @@ AddRun(PNTFS_VCB Vcb,
     }
     _SEH2_END;
 
+    // The decoded run list no longer matches the mcb
+    InvalidateRunCache(AttrContext);
+
     RunBuffer = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_NTFS);
     if (!RunBuffer)
     {
@@ -1148,6 +1151,9 @@ FreeClusters(PNTFS_VCB Vcb,
         ClustersLeftToFree--;
     }
 
+    // The decoded run list no longer matches the mcb
+    InvalidateRunCache(AttrContext);
+
     // update $BITMAP file on disk
     Status = WriteAttribute(Vcb, DataContext, 0, BitmapData, (ULONG)BitmapDataSize, &LengthWritten, FileRecord);
     if (!NT_SUCCESS(Status))
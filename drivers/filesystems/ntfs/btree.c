@@ -1438,6 +1438,10 @@ UpdateIndexNode(PDEVICE_EXTENSION DeviceExt,
 
         // Write the buffer to the index allocation
         Status = WriteAttribute(DeviceExt, IndexAllocationContext, NodeOffset, (const PUCHAR)IndexBuffer, IndexBufferSize, &LengthWritten, FileRecord);
+
+        // Lookups must not see the old copy of this node
+        InvalidateIndexBufferCache(DeviceExt, IndexAllocationContext->FileMFTIndex);
+
         if (!NT_SUCCESS(Status) || LengthWritten != IndexBufferSize)
         {
             DPRINT1("ERROR: Failed to update index allocation!\n");
@@ -60,10 +60,13 @@ NTAPI
 NtfsAcqReadAhead(PVOID Context,
                  BOOLEAN Wait)
 {
-    UNREFERENCED_PARAMETER(Context);
-    UNREFERENCED_PARAMETER(Wait);
-    UNIMPLEMENTED;
-    return FALSE;
+    PNTFS_FCB Fcb = (PNTFS_FCB)Context;
+
+    ASSERT(Fcb);
+    DPRINT("NtfsAcqReadAhead(): Fcb %p\n", Fcb);
+
+    // Read ahead only reads, keep writers away while it fills the cache
+    return ExAcquireResourceSharedLite(&Fcb->MainResource, Wait);
 }
 
 
@@ -71,8 +74,12 @@ VOID
 NTAPI
 NtfsRelReadAhead(PVOID Context)
 {
-    UNREFERENCED_PARAMETER(Context);
-    UNIMPLEMENTED;
+    PNTFS_FCB Fcb = (PNTFS_FCB)Context;
+
+    ASSERT(Fcb);
+    DPRINT("NtfsRelReadAhead(): Fcb %p\n", Fcb);
+
+    ExReleaseResourceLite(&Fcb->MainResource);
 }
 
 BOOLEAN
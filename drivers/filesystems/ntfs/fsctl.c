@@ -276,6 +276,8 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
 
     ExInitializeNPagedLookasideList(&DeviceExt->FileRecLookasideList,
                                     NULL, NULL, 0, NtfsInfo->BytesPerFileRecord, TAG_FILE_REC, 0);
+    InitializeFileRecordCache(DeviceExt);
+    InitializeIndexBufferCache(DeviceExt);
 
     DeviceExt->MasterFileTable = ExAllocateFromNPagedLookasideList(&DeviceExt->FileRecLookasideList);
     if (DeviceExt->MasterFileTable == NULL)
@@ -330,6 +332,8 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
     if (!NT_SUCCESS(Status))
     {
         DPRINT1("Failed reading volume file\n");
+        FreeFileRecordCache(DeviceExt);
+        FreeIndexBufferCache(DeviceExt);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, VolumeRecord);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, DeviceExt->MasterFileTable);
         ExDeleteNPagedLookasideList(&DeviceExt->FileRecLookasideList);
@@ -371,6 +375,8 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
     if (VolumeFcb == NULL)
     {
         DPRINT1("Failed allocating volume FCB\n");
+        FreeFileRecordCache(DeviceExt);
+        FreeIndexBufferCache(DeviceExt);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, VolumeRecord);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, DeviceExt->MasterFileTable);
         ExDeleteNPagedLookasideList(&DeviceExt->FileRecLookasideList);
@@ -565,7 +571,11 @@ ByeBye:
             ExFreePool(Ccb);
 
         if (Lookaside)
+        {
+            FreeFileRecordCache(Vcb);
+            FreeIndexBufferCache(Vcb);
             ExDeleteNPagedLookasideList(&Vcb->FileRecLookasideList);
+        }
 
         if (NewDeviceObject)
             IoDeleteDevice(NewDeviceObject);
@@ -61,6 +61,11 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord)
     // Copy the attribute
     RtlCopyMemory(Context->pRecord, AttrRecord, AttrRecord->Length);
 
+    // The decoded run list is built on first read
+    Context->RunCache = NULL;
+    KeInitializeSpinLock(&Context->RunCacheLock);
+    Context->RunCacheGeneration = 0;
+
     if (AttrRecord->IsNonResident)
     {
         LONGLONG DataRunOffset;
@@ -103,6 +108,8 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord)
 VOID
 ReleaseAttributeContext(PNTFS_ATTR_CONTEXT Context)
 {
+    InvalidateRunCache(Context);
+
     if (Context->pRecord)
     {
         if (Context->pRecord->IsNonResident)
@@ -995,6 +1002,7 @@ SetResidentAttributeDataLength(PDEVICE_EXTENSION Vcb,
                                  FILE_RECORD_END);
 
                 // Initialize the MCB, potentially catch an exception
+                InvalidateRunCache(AttrContext);
                 _SEH2_TRY
                 {
                     FsRtlInitializeLargeMcb(&AttrContext->DataRunsMCB, NonPagedPool);
@@ -1061,6 +1069,181 @@ SetResidentAttributeDataLength(PDEVICE_EXTENSION Vcb,
     return STATUS_SUCCESS;
 }
 
+static
+VOID
+ReleaseRunCache(PNTFS_RUN_CACHE Cache)
+{
+    if (InterlockedDecrement(&Cache->RefCount) == 0)
+    {
+        ExFreePoolWithTag(Cache, TAG_NTFS);
+    }
+}
+
+/**
+* @name InvalidateRunCache
+* @implemented
+*
+* Drops the decoded run list of an attribute context. Must be called whenever
+* DataRunsMCB changes, the list is rebuilt by the next ReadAttribute(). Reads
+* that are still using the old list keep it alive until they are done.
+*
+* @param Context
+* Pointer to the attribute context.
+*
+*/
+VOID
+InvalidateRunCache(PNTFS_ATTR_CONTEXT Context)
+{
+    PNTFS_RUN_CACHE Cache;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    Cache = Context->RunCache;
+    Context->RunCache = NULL;
+    Context->RunCacheGeneration++;
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    if (Cache)
+    {
+        ReleaseRunCache(Cache);
+    }
+}
+
+/**
+* @name ReferenceRunCache
+* @implemented
+*
+* Returns a referenced copy of the decoded run list of an attribute, decoding
+* the mappings of DataRunsMCB into an array sorted by VCN if there is none yet.
+* This lets reads find their run with a binary search instead of decoding the
+* run list from the start every time. Holes in the MCB become sparse runs.
+*
+* @param Context
+* Pointer to a non-resident attribute context.
+*
+* @param CacheOut
+* Receives the run list, to be released with ReleaseRunCache().
+*
+* @return
+* STATUS_SUCCESS on success, STATUS_INSUFFICIENT_RESOURCES if the array
+* couldn't be allocated.
+*
+*/
+static
+NTSTATUS
+ReferenceRunCache(PNTFS_ATTR_CONTEXT Context,
+                  PNTFS_RUN_CACHE *CacheOut)
+{
+    PNTFS_RUN_CACHE Cache;
+    PNTFS_DATA_RUN Runs;
+    LONGLONG Vbn, Lbn, Count;
+    ULONG i, j, RunCount, Generation;
+    KIRQL OldIrql;
+
+    ASSERT(Context->pRecord->IsNonResident);
+
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    Cache = Context->RunCache;
+    if (Cache)
+    {
+        InterlockedIncrement(&Cache->RefCount);
+    }
+    Generation = Context->RunCacheGeneration;
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    if (Cache)
+    {
+        *CacheOut = Cache;
+        return STATUS_SUCCESS;
+    }
+
+    // Count the mappings first
+    for (RunCount = 0; FsRtlGetNextLargeMcbEntry(&Context->DataRunsMCB, RunCount, &Vbn, &Lbn, &Count); RunCount++);
+
+    Cache = ExAllocatePoolWithTag(NonPagedPool,
+                                  FIELD_OFFSET(NTFS_RUN_CACHE, Runs) + RunCount * sizeof(NTFS_DATA_RUN),
+                                  TAG_NTFS);
+    if (Cache == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Runs = Cache->Runs;
+    for (i = 0, j = 0; i < RunCount; i++)
+    {
+        if (!FsRtlGetNextLargeMcbEntry(&Context->DataRunsMCB, i, &Vbn, &Lbn, &Count))
+            break;
+
+        // Merge runs that follow each other on disk too, so that ReadAttribute()
+        // reads a whole extent with a single request
+        if (j > 0 &&
+            Runs[j - 1].StartVCN + Runs[j - 1].Length == (ULONGLONG)Vbn &&
+            ((Runs[j - 1].StartLCN == -1 && Lbn == -1) ||
+             (Runs[j - 1].StartLCN != -1 && Runs[j - 1].StartLCN + (LONGLONG)Runs[j - 1].Length == Lbn)))
+        {
+            Runs[j - 1].Length += Count;
+            continue;
+        }
+
+        Runs[j].StartVCN = Vbn;
+        Runs[j].Length = Count;
+        Runs[j].StartLCN = Lbn;
+        j++;
+    }
+    Cache->RunCount = j;
+    Cache->RefCount = 1;
+
+    // The MFT context is shared, another reader may have beaten us to it. If the
+    // runs changed meanwhile, our copy may be stale and is only used for this read.
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    if (Context->RunCache == NULL && Context->RunCacheGeneration == Generation)
+    {
+        Cache->RefCount++;
+        Context->RunCache = Cache;
+    }
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    *CacheOut = Cache;
+    return STATUS_SUCCESS;
+}
+
+/**
+* @name FindRun
+* @implemented
+*
+* Looks up the decoded run that contains a given VCN.
+*
+* @return
+* Pointer to the run, or NULL if the VCN is past the last run.
+*
+*/
+static
+PNTFS_DATA_RUN
+FindRun(PNTFS_RUN_CACHE Cache,
+        ULONGLONG Vcn)
+{
+    ULONG Low = 0, High = Cache->RunCount, Middle;
+
+    while (Low < High)
+    {
+        Middle = Low + (High - Low) / 2;
+        if (Vcn < Cache->Runs[Middle].StartVCN)
+        {
+            High = Middle;
+        }
+        else if (Vcn >= Cache->Runs[Middle].StartVCN + Cache->Runs[Middle].Length)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            return &Cache->Runs[Middle];
+        }
+    }
+
+    return NULL;
+}
+
 ULONG
 ReadAttribute(PDEVICE_EXTENSION Vcb,
               PNTFS_ATTR_CONTEXT Context,
@@ -1068,19 +1251,13 @@ ReadAttribute(PDEVICE_EXTENSION Vcb,
               PCHAR Buffer,
               ULONG Length)
 {
-    ULONGLONG LastLCN;
-    PUCHAR DataRun;
-    LONGLONG DataRunOffset;
-    ULONGLONG DataRunLength;
-    LONGLONG DataRunStartLCN;
-    ULONGLONG CurrentOffset;
+    PNTFS_RUN_CACHE Cache;
+    PNTFS_DATA_RUN Run;
+    ULONGLONG RunOffset;
     ULONG ReadLength;
     ULONG AlreadyRead;
     NTSTATUS Status;
 
-    //TEMPTEMP
-    PUCHAR TempBuffer;
-
     if (!Context->pRecord->IsNonResident)
     {
         // We need to truncate Offset to a ULONG for pointer arithmetic
@@ -1101,171 +1278,49 @@ ReadAttribute(PDEVICE_EXTENSION Vcb,
      * Non-resident attribute
      */
 
-    /*
-     * I. Find the corresponding start data run.
-     */
-
     AlreadyRead = 0;
 
-    // FIXME: Cache seems to be non-working. Disable it for now
-    //if(Context->CacheRunOffset <= Offset && Offset < Context->CacheRunOffset + Context->CacheRunLength * Volume->ClusterSize)
-    if (0)
+    // Decode the run list once, later reads only have to search it
+    Status = ReferenceRunCache(Context, &Cache);
+    if (!NT_SUCCESS(Status))
     {
-        DataRun = Context->CacheRun;
-        LastLCN = Context->CacheRunLastLCN;
-        DataRunStartLCN = Context->CacheRunStartLCN;
-        DataRunLength = Context->CacheRunLength;
-        CurrentOffset = Context->CacheRunCurrentOffset;
+        DPRINT1("Unable to decode the data runs!\n");
+        return 0;
     }
-    else
+
+    while (Length > 0)
     {
-        //TEMPTEMP
-        ULONG UsedBufferSize;
-        TempBuffer = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_NTFS);
-        if (TempBuffer == NULL)
+        Run = FindRun(Cache, Offset / Vcb->NtfsInfo.BytesPerCluster);
+        if (Run == NULL)
+            break;
+
+        // Read up to the end of this run
+        RunOffset = Offset - Run->StartVCN * Vcb->NtfsInfo.BytesPerCluster;
+        ReadLength = (ULONG)min(Run->Length * Vcb->NtfsInfo.BytesPerCluster - RunOffset, Length);
+        if (Run->StartLCN == -1)
         {
-            return STATUS_INSUFFICIENT_RESOURCES;
+            // Sparse data run
+            RtlZeroMemory(Buffer, ReadLength);
         }
-
-        LastLCN = 0;
-        CurrentOffset = 0;
-
-        // This will be rewritten in the next iteration to just use the DataRuns MCB directly
-        ConvertLargeMCBToDataRuns(&Context->DataRunsMCB,
-                                  TempBuffer,
-                                  Vcb->NtfsInfo.BytesPerFileRecord,
-                                  &UsedBufferSize);
-
-        DataRun = TempBuffer;
-
-        while (1)
+        else
         {
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != -1)
-            {
-                /* Normal data run. */
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-            {
-                /* Sparse data run. */
-                DataRunStartLCN = -1;
-            }
-
-            if (Offset >= CurrentOffset &&
-                Offset < CurrentOffset + (DataRunLength * Vcb->NtfsInfo.BytesPerCluster))
-            {
+            Status = NtfsReadDisk(Vcb->StorageDevice,
+                                  Run->StartLCN * Vcb->NtfsInfo.BytesPerCluster + RunOffset,
+                                  ReadLength,
+                                  Vcb->NtfsInfo.BytesPerSector,
+                                  (PVOID)Buffer,
+                                  FALSE);
+            if (!NT_SUCCESS(Status))
                 break;
-            }
-
-            if (*DataRun == 0)
-            {
-                ExFreePoolWithTag(TempBuffer, TAG_NTFS);
-                return AlreadyRead;
-            }
-
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
         }
-    }
-
-    /*
-     * II. Go through the run list and read the data
-     */
 
-    ReadLength = (ULONG)min(DataRunLength * Vcb->NtfsInfo.BytesPerCluster - (Offset - CurrentOffset), Length);
-    if (DataRunStartLCN == -1)
-    {
-        RtlZeroMemory(Buffer, ReadLength);
-        Status = STATUS_SUCCESS;
-    }
-    else
-    {
-        Status = NtfsReadDisk(Vcb->StorageDevice,
-                              DataRunStartLCN * Vcb->NtfsInfo.BytesPerCluster + Offset - CurrentOffset,
-                              ReadLength,
-                              Vcb->NtfsInfo.BytesPerSector,
-                              (PVOID)Buffer,
-                              FALSE);
-    }
-    if (NT_SUCCESS(Status))
-    {
         Length -= ReadLength;
         Buffer += ReadLength;
+        Offset += ReadLength;
         AlreadyRead += ReadLength;
+    }
 
-        if (ReadLength == DataRunLength * Vcb->NtfsInfo.BytesPerCluster - (Offset - CurrentOffset))
-        {
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != (ULONGLONG)-1)
-            {
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-                DataRunStartLCN = -1;
-        }
-
-        while (Length > 0)
-        {
-            ReadLength = (ULONG)min(DataRunLength * Vcb->NtfsInfo.BytesPerCluster, Length);
-            if (DataRunStartLCN == -1)
-                RtlZeroMemory(Buffer, ReadLength);
-            else
-            {
-                Status = NtfsReadDisk(Vcb->StorageDevice,
-                                      DataRunStartLCN * Vcb->NtfsInfo.BytesPerCluster,
-                                      ReadLength,
-                                      Vcb->NtfsInfo.BytesPerSector,
-                                      (PVOID)Buffer,
-                                      FALSE);
-                if (!NT_SUCCESS(Status))
-                    break;
-            }
-
-            Length -= ReadLength;
-            Buffer += ReadLength;
-            AlreadyRead += ReadLength;
-
-            /* We finished this request, but there still data in this data run. */
-            if (Length == 0 && ReadLength != DataRunLength * Vcb->NtfsInfo.BytesPerCluster)
-                break;
-
-            /*
-             * Go to next run in the list.
-             */
-
-            if (*DataRun == 0)
-                break;
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != -1)
-            {
-                /* Normal data run. */
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-            {
-                /* Sparse data run. */
-                DataRunStartLCN = -1;
-            }
-        } /* while */
-
-    } /* if Disk */
-
-    // TEMPTEMP
-    if (Context->pRecord->IsNonResident)
-        ExFreePoolWithTag(TempBuffer, TAG_NTFS);
-
-    Context->CacheRun = DataRun;
-    Context->CacheRunOffset = Offset + AlreadyRead;
-    Context->CacheRunStartLCN = DataRunStartLCN;
-    Context->CacheRunLength = DataRunLength;
-    Context->CacheRunLastLCN = LastLCN;
-    Context->CacheRunCurrentOffset = CurrentOffset;
-
+    ReleaseRunCache(Cache);
     return AlreadyRead;
 }
 
@@ -1593,59 +1648,443 @@ WriteAttribute(PDEVICE_EXTENSION Vcb,
                 goto Cleanup;
             }
 
-            break;
-        }
+            break;
+        }
+
+        // Advance to the next data run
+        CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
+        DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
+        if (DataRunOffset != -1)
+        {
+            // Normal data run.
+            DataRunStartLCN = LastLCN + DataRunOffset;
+            LastLCN = DataRunStartLCN;
+        }
+        else
+        {
+            // Sparse data run.
+            DataRunStartLCN = -1;
+        }
+    } // end while (Length > 0) [more data to write]
+
+    Context->CacheRun = DataRun;
+    Context->CacheRunOffset = Offset + *RealLengthWritten;
+    Context->CacheRunStartLCN = DataRunStartLCN;
+    Context->CacheRunLength = DataRunLength;
+    Context->CacheRunLastLCN = LastLCN;
+    Context->CacheRunCurrentOffset = CurrentOffset;
+
+Cleanup:
+    // TEMPTEMP
+    if (Context->pRecord->IsNonResident)
+        ExFreePoolWithTag(TempBuffer, TAG_NTFS);
+
+    return Status;
+}
+
+/**
+* @name InitializeFileRecordCache
+* @implemented
+*
+* Sets up the per-volume cache of fixed-up file records. Path lookups and
+* directory listings read the same records over and over, this saves the
+* MFT I/O and the fixups for those. Buffers are allocated on first use.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume being mounted.
+*
+*/
+VOID
+InitializeFileRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG i;
+
+    ExInitializeFastMutex(&Vcb->FileRecordCacheLock);
+    Vcb->FileRecordCacheClock = 0;
+    Vcb->FileRecordCacheGeneration = 0;
+
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_SETS * NTFS_FILE_RECORD_CACHE_WAYS; i++)
+    {
+        Vcb->FileRecordCache[i].MftIndex = (ULONGLONG)-1;
+        Vcb->FileRecordCache[i].LastUse = 0;
+        Vcb->FileRecordCache[i].FileRecord = NULL;
+    }
+}
+
+/**
+* @name FreeFileRecordCache
+* @implemented
+*
+* Frees the buffers of the file record cache. The cache is left empty and
+* can still be used afterwards.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume.
+*
+*/
+VOID
+FreeFileRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG i;
+
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_SETS * NTFS_FILE_RECORD_CACHE_WAYS; i++)
+    {
+        if (Vcb->FileRecordCache[i].FileRecord != NULL)
+        {
+            ExFreePoolWithTag(Vcb->FileRecordCache[i].FileRecord, TAG_FILE_REC);
+            Vcb->FileRecordCache[i].FileRecord = NULL;
+        }
+
+        Vcb->FileRecordCache[i].MftIndex = (ULONGLONG)-1;
+    }
+}
+
+static
+PNTFS_FILE_RECORD_CACHE_ENTRY
+GetFileRecordCacheSet(PDEVICE_EXTENSION Vcb,
+                      ULONGLONG MftIndex)
+{
+    return &Vcb->FileRecordCache[(MftIndex % NTFS_FILE_RECORD_CACHE_SETS) * NTFS_FILE_RECORD_CACHE_WAYS];
+}
+
+static
+BOOLEAN
+LookupFileRecordCache(PDEVICE_EXTENSION Vcb,
+                      ULONGLONG MftIndex,
+                      PFILE_RECORD_HEADER FileRecord,
+                      PULONG Generation)
+{
+    PNTFS_FILE_RECORD_CACHE_ENTRY Set;
+    ULONG i;
+
+    Set = GetFileRecordCacheSet(Vcb, MftIndex);
+
+    ExAcquireFastMutex(&Vcb->FileRecordCacheLock);
+
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_WAYS; i++)
+    {
+        if (Set[i].MftIndex == MftIndex)
+        {
+            RtlCopyMemory(FileRecord, Set[i].FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+            Set[i].LastUse = ++Vcb->FileRecordCacheClock;
+            ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+            return TRUE;
+        }
+    }
+
+    // Remember which version of the MFT the caller is going to read
+    *Generation = Vcb->FileRecordCacheGeneration;
+
+    ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+    return FALSE;
+}
+
+static
+VOID
+InsertFileRecordCache(PDEVICE_EXTENSION Vcb,
+                      ULONGLONG MftIndex,
+                      PFILE_RECORD_HEADER FileRecord,
+                      ULONG Generation)
+{
+    PNTFS_FILE_RECORD_CACHE_ENTRY Set, Victim;
+    ULONG i;
+
+    Set = GetFileRecordCacheSet(Vcb, MftIndex);
+
+    ExAcquireFastMutex(&Vcb->FileRecordCacheLock);
+
+    // Don't cache what we read if the MFT was written meanwhile
+    if (Generation != Vcb->FileRecordCacheGeneration)
+    {
+        ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+        return;
+    }
+
+    // Replace the same record, or else the least recently used one
+    Victim = &Set[0];
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_WAYS; i++)
+    {
+        if (Set[i].MftIndex == MftIndex)
+        {
+            Victim = &Set[i];
+            break;
+        }
+
+        if (Set[i].LastUse < Victim->LastUse)
+            Victim = &Set[i];
+    }
+
+    if (Victim->FileRecord == NULL)
+    {
+        Victim->FileRecord = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_FILE_REC);
+        if (Victim->FileRecord == NULL)
+        {
+            ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+            return;
+        }
+    }
+
+    RtlCopyMemory(Victim->FileRecord, FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+    Victim->MftIndex = MftIndex;
+    Victim->LastUse = ++Vcb->FileRecordCacheClock;
+
+    ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+}
+
+static
+VOID
+InvalidateFileRecordCache(PDEVICE_EXTENSION Vcb,
+                          ULONGLONG MftIndex)
+{
+    PNTFS_FILE_RECORD_CACHE_ENTRY Set;
+    ULONG i;
+
+    Set = GetFileRecordCacheSet(Vcb, MftIndex);
+
+    ExAcquireFastMutex(&Vcb->FileRecordCacheLock);
+
+    // Reads that started before this write must not fill the cache
+    Vcb->FileRecordCacheGeneration++;
+
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_WAYS; i++)
+    {
+        if (Set[i].MftIndex == MftIndex)
+        {
+            Set[i].MftIndex = (ULONGLONG)-1;
+            Set[i].LastUse = 0;
+        }
+    }
+
+    ExReleaseFastMutex(&Vcb->FileRecordCacheLock);
+}
+
+NTSTATUS
+ReadFileRecord(PDEVICE_EXTENSION Vcb,
+               ULONGLONG index,
+               PFILE_RECORD_HEADER file)
+{
+    ULONGLONG BytesRead;
+    ULONG Generation;
+    NTSTATUS Status;
+
+    DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
+
+    if (LookupFileRecordCache(Vcb, index, file, &Generation))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
+    if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
+    {
+        DPRINT1("ReadFileRecord failed: %I64u read, %lu expected\n", BytesRead, Vcb->NtfsInfo.BytesPerFileRecord);
+        return STATUS_PARTIAL_COPY;
+    }
+
+    /* Apply update sequence array fixups. */
+    DPRINT("Sequence number: %u\n", file->SequenceNumber);
+    Status = FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    if (NT_SUCCESS(Status))
+    {
+        InsertFileRecordCache(Vcb, index, file, Generation);
+    }
+
+    return Status;
+}
+
+
+/**
+* @name InitializeIndexBufferCache
+* @implemented
+*
+* Sets up the per-volume cache of fixed-up $I30 index buffers. Name lookups
+* descend from the index root through the same upper nodes of a directory
+* every time, this saves the I/O and the fixups for those. Buffers are
+* allocated on first use.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume being mounted.
+*
+*/
+VOID
+InitializeIndexBufferCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG i;
+
+    ExInitializeFastMutex(&Vcb->IndexBufferCacheLock);
+    Vcb->IndexBufferCacheClock = 0;
+    Vcb->IndexBufferCacheGeneration = 0;
+
+    for (i = 0; i < NTFS_INDEX_BUFFER_CACHE_ENTRIES; i++)
+    {
+        Vcb->IndexBufferCache[i].MftIndex = (ULONGLONG)-1;
+        Vcb->IndexBufferCache[i].VCN = 0;
+        Vcb->IndexBufferCache[i].LastUse = 0;
+        Vcb->IndexBufferCache[i].Size = 0;
+        Vcb->IndexBufferCache[i].IndexBuffer = NULL;
+    }
+}
+
+/**
+* @name FreeIndexBufferCache
+* @implemented
+*
+* Frees the buffers of the index buffer cache. The cache is left empty and
+* can still be used afterwards.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume.
+*
+*/
+VOID
+FreeIndexBufferCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG i;
+
+    for (i = 0; i < NTFS_INDEX_BUFFER_CACHE_ENTRIES; i++)
+    {
+        if (Vcb->IndexBufferCache[i].IndexBuffer != NULL)
+        {
+            ExFreePoolWithTag(Vcb->IndexBufferCache[i].IndexBuffer, TAG_NTFS);
+            Vcb->IndexBufferCache[i].IndexBuffer = NULL;
+        }
+
+        Vcb->IndexBufferCache[i].MftIndex = (ULONGLONG)-1;
+        Vcb->IndexBufferCache[i].Size = 0;
+    }
+}
+
+static
+BOOLEAN
+LookupIndexBufferCache(PDEVICE_EXTENSION Vcb,
+                       ULONGLONG MftIndex,
+                       ULONGLONG VCN,
+                       PINDEX_BUFFER IndexBuffer,
+                       ULONG IndexBufferSize,
+                       PULONG Generation)
+{
+    PNTFS_INDEX_BUFFER_CACHE_ENTRY Entry;
+    ULONG i;
+
+    ExAcquireFastMutex(&Vcb->IndexBufferCacheLock);
+
+    for (i = 0; i < NTFS_INDEX_BUFFER_CACHE_ENTRIES; i++)
+    {
+        Entry = &Vcb->IndexBufferCache[i];
+        if (Entry->MftIndex == MftIndex && Entry->VCN == VCN && Entry->Size == IndexBufferSize)
+        {
+            RtlCopyMemory(IndexBuffer, Entry->IndexBuffer, IndexBufferSize);
+            Entry->LastUse = ++Vcb->IndexBufferCacheClock;
+            ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
+            return TRUE;
+        }
+    }
+
+    // Remember which version of the index the caller is going to read
+    *Generation = Vcb->IndexBufferCacheGeneration;
+
+    ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
+    return FALSE;
+}
+
+static
+VOID
+InsertIndexBufferCache(PDEVICE_EXTENSION Vcb,
+                       ULONGLONG MftIndex,
+                       ULONGLONG VCN,
+                       PINDEX_BUFFER IndexBuffer,
+                       ULONG IndexBufferSize,
+                       ULONG Generation)
+{
+    PNTFS_INDEX_BUFFER_CACHE_ENTRY Victim;
+    ULONG i;
+
+    ExAcquireFastMutex(&Vcb->IndexBufferCacheLock);
 
-        // Advance to the next data run
-        CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-        DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-        if (DataRunOffset != -1)
+    // Don't cache what we read if an index was written meanwhile
+    if (Generation != Vcb->IndexBufferCacheGeneration)
+    {
+        ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
+        return;
+    }
+
+    // Replace the same node, or else the least recently used one
+    Victim = &Vcb->IndexBufferCache[0];
+    for (i = 0; i < NTFS_INDEX_BUFFER_CACHE_ENTRIES; i++)
+    {
+        if (Vcb->IndexBufferCache[i].MftIndex == MftIndex && Vcb->IndexBufferCache[i].VCN == VCN)
         {
-            // Normal data run.
-            DataRunStartLCN = LastLCN + DataRunOffset;
-            LastLCN = DataRunStartLCN;
+            Victim = &Vcb->IndexBufferCache[i];
+            break;
         }
-        else
+
+        if (Vcb->IndexBufferCache[i].LastUse < Victim->LastUse)
+            Victim = &Vcb->IndexBufferCache[i];
+    }
+
+    // Directories with an unusual index block size get a buffer of their own
+    if (Victim->IndexBuffer != NULL && Victim->Size != IndexBufferSize)
+    {
+        ExFreePoolWithTag(Victim->IndexBuffer, TAG_NTFS);
+        Victim->IndexBuffer = NULL;
+    }
+
+    if (Victim->IndexBuffer == NULL)
+    {
+        Victim->MftIndex = (ULONGLONG)-1;
+        Victim->Size = 0;
+        Victim->IndexBuffer = ExAllocatePoolWithTag(NonPagedPool, IndexBufferSize, TAG_NTFS);
+        if (Victim->IndexBuffer == NULL)
         {
-            // Sparse data run.
-            DataRunStartLCN = -1;
+            ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
+            return;
         }
-    } // end while (Length > 0) [more data to write]
-
-    Context->CacheRun = DataRun;
-    Context->CacheRunOffset = Offset + *RealLengthWritten;
-    Context->CacheRunStartLCN = DataRunStartLCN;
-    Context->CacheRunLength = DataRunLength;
-    Context->CacheRunLastLCN = LastLCN;
-    Context->CacheRunCurrentOffset = CurrentOffset;
+    }
 
-Cleanup:
-    // TEMPTEMP
-    if (Context->pRecord->IsNonResident)
-        ExFreePoolWithTag(TempBuffer, TAG_NTFS);
+    RtlCopyMemory(Victim->IndexBuffer, IndexBuffer, IndexBufferSize);
+    Victim->MftIndex = MftIndex;
+    Victim->VCN = VCN;
+    Victim->Size = IndexBufferSize;
+    Victim->LastUse = ++Vcb->IndexBufferCacheClock;
 
-    return Status;
+    ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
 }
 
-NTSTATUS
-ReadFileRecord(PDEVICE_EXTENSION Vcb,
-               ULONGLONG index,
-               PFILE_RECORD_HEADER file)
+/**
+* @name InvalidateIndexBufferCache
+* @implemented
+*
+* Drops the cached index buffers of a directory. Must be called whenever
+* one of its index buffers, or its file record, is written.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume.
+*
+* @param MftIndex
+* Index of the directory in the master file table.
+*
+*/
+VOID
+InvalidateIndexBufferCache(PDEVICE_EXTENSION Vcb,
+                           ULONGLONG MftIndex)
 {
-    ULONGLONG BytesRead;
+    ULONG i;
 
-    DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
+    ExAcquireFastMutex(&Vcb->IndexBufferCacheLock);
 
-    BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
-    if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
+    // Reads that started before this write must not fill the cache
+    Vcb->IndexBufferCacheGeneration++;
+
+    for (i = 0; i < NTFS_INDEX_BUFFER_CACHE_ENTRIES; i++)
     {
-        DPRINT1("ReadFileRecord failed: %I64u read, %lu expected\n", BytesRead, Vcb->NtfsInfo.BytesPerFileRecord);
-        return STATUS_PARTIAL_COPY;
+        if (Vcb->IndexBufferCache[i].MftIndex == MftIndex)
+        {
+            Vcb->IndexBufferCache[i].MftIndex = (ULONGLONG)-1;
+            Vcb->IndexBufferCache[i].LastUse = 0;
+        }
     }
 
-    /* Apply update sequence array fixups. */
-    DPRINT("Sequence number: %u\n", file->SequenceNumber);
-    return FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    ExReleaseFastMutex(&Vcb->IndexBufferCacheLock);
 }
 
 
@@ -1889,6 +2328,7 @@ UpdateIndexEntryFileNameSize(PDEVICE_EXTENSION Vcb,
             }
 
             Status = WriteAttribute(Vcb, IndexAllocationCtx, RecordOffset, (const PUCHAR)IndexRecord, IndexBlockSize, &Written, MftRecord);
+            InvalidateIndexBufferCache(Vcb, IndexAllocationCtx->FileMFTIndex);
             if (!NT_SUCCESS(Status))
             {
                 DPRINT1("ERROR Performing write!\n");
@@ -1954,6 +2394,12 @@ UpdateFileRecord(PDEVICE_EXTENSION Vcb,
         DPRINT1("UpdateFileRecord failed: %lu written, %lu expected\n", BytesWritten, Vcb->NtfsInfo.BytesPerFileRecord);
     }
 
+    // Drop the cached copy, even if the write failed it may be stale now
+    InvalidateFileRecordCache(Vcb, MftIndex);
+
+    // The record may have been reused for another directory, forget its old index buffers too
+    InvalidateIndexBufferCache(Vcb, MftIndex);
+
     // remove the fixup array (so the file record pointer can still be used)
     FixupUpdateSequenceArray(Vcb, &FileRecord->Ntfs);
 
@@ -3142,6 +3588,362 @@ BrowseIndexEntries(PDEVICE_EXTENSION Vcb,
     return STATUS_OBJECT_PATH_NOT_FOUND;
 }
 
+/* Deeper than any real directory, only there to stop on looping child pointers */
+#define NTFS_INDEX_MAX_DEPTH 32
+
+static
+LONG
+CompareIndexName(PUNICODE_STRING FileName,
+                 PINDEX_ENTRY_ATTRIBUTE IndexEntry)
+{
+    ULONG i, NameLength;
+    WCHAR NameChar, EntryChar;
+
+    NameLength = FileName->Length / sizeof(WCHAR);
+
+    // $I30 is sorted by the upcased names, compared code unit per code unit
+    for (i = 0; i < NameLength && i < IndexEntry->FileName.NameLength; i++)
+    {
+        NameChar = RtlUpcaseUnicodeChar(FileName->Buffer[i]);
+        EntryChar = RtlUpcaseUnicodeChar(IndexEntry->FileName.Name[i]);
+        if (NameChar != EntryChar)
+            return (NameChar < EntryChar) ? -1 : 1;
+    }
+
+    return (LONG)NameLength - (LONG)IndexEntry->FileName.NameLength;
+}
+
+/**
+* @name SearchIndexNode
+* @implemented
+*
+* Binary searches the entries of an index node for a file name.
+*
+* @param Header
+* Pointer to the INDEX_HEADER_ATTRIBUTE of the index root or of the index buffer.
+*
+* @param Size
+* Number of valid bytes starting at Header.
+*
+* @param FileName
+* Name to search for.
+*
+* @param Entries
+* Scratch array, receives a pointer to every entry of the node.
+*
+* @param MaxEntries
+* Number of elements in Entries.
+*
+* @param Comparison
+* Receives the result of comparing FileName with the returned entry.
+*
+* @return
+* The first entry whose name doesn't sort before FileName, which is the end entry if
+* there is none. NULL if the node is corrupted.
+*/
+static
+PINDEX_ENTRY_ATTRIBUTE
+SearchIndexNode(PINDEX_HEADER_ATTRIBUTE Header,
+                ULONG Size,
+                PUNICODE_STRING FileName,
+                PINDEX_ENTRY_ATTRIBUTE *Entries,
+                ULONG MaxEntries,
+                PLONG Comparison)
+{
+    PINDEX_ENTRY_ATTRIBUTE IndexEntry;
+    ULONG Offset, Count, Low, High, Middle;
+
+    if (Header->TotalSizeOfEntries > Size)
+        return NULL;
+
+    // Entries have variable sizes, collect them first so that we can bisect
+    Count = 0;
+    Offset = Header->FirstEntryOffset;
+    for (;;)
+    {
+        if (Count == MaxEntries ||
+            Offset + FIELD_OFFSET(INDEX_ENTRY_ATTRIBUTE, FileName) > Header->TotalSizeOfEntries)
+        {
+            return NULL;
+        }
+
+        IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)Header + Offset);
+        if (IndexEntry->Length < FIELD_OFFSET(INDEX_ENTRY_ATTRIBUTE, FileName) ||
+            Offset + IndexEntry->Length > Header->TotalSizeOfEntries)
+        {
+            return NULL;
+        }
+
+        Entries[Count++] = IndexEntry;
+        if (IndexEntry->Flags & NTFS_INDEX_ENTRY_END)
+            break;
+
+        if (IndexEntry->Length < FIELD_OFFSET(INDEX_ENTRY_ATTRIBUTE, FileName.Name) +
+                                 IndexEntry->FileName.NameLength * sizeof(WCHAR))
+        {
+            return NULL;
+        }
+
+        Offset += IndexEntry->Length;
+    }
+
+    // The end entry is last and sorts after every name
+    Low = 0;
+    High = Count - 1;
+    while (Low < High)
+    {
+        Middle = (Low + High) / 2;
+        if (CompareIndexName(FileName, Entries[Middle]) <= 0)
+            High = Middle;
+        else
+            Low = Middle + 1;
+    }
+
+    *Comparison = (Low == Count - 1) ? -1 : CompareIndexName(FileName, Entries[Low]);
+    return Entries[Low];
+}
+
+static
+NTSTATUS
+ReadIndexNode(PDEVICE_EXTENSION Vcb,
+              ULONGLONG MftIndex,
+              PNTFS_ATTR_CONTEXT IndexAllocationContext,
+              ULONGLONG VCN,
+              PINDEX_BUFFER IndexBuffer,
+              ULONG IndexBufferSize)
+{
+    ULONGLONG Offset;
+    ULONG BytesRead;
+    ULONG Generation;
+    NTSTATUS Status;
+
+    if (LookupIndexBufferCache(Vcb, MftIndex, VCN, IndexBuffer, IndexBufferSize, &Generation))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    Offset = GetAllocationOffsetFromVCN(Vcb, IndexBufferSize, VCN);
+
+    BytesRead = ReadAttribute(Vcb, IndexAllocationContext, Offset, (PCHAR)IndexBuffer, IndexBufferSize);
+    if (BytesRead != IndexBufferSize)
+    {
+        DPRINT1("Unable to read index record!\n");
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if (IndexBuffer->Ntfs.Type != NRH_INDX_TYPE || IndexBuffer->VCN != VCN)
+    {
+        DPRINT1("File system corruption detected, node with VCN %I64u is not an index record.\n", VCN);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    Status = FixupUpdateSequenceArray(Vcb, &IndexBuffer->Ntfs);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to apply fixup array!\n");
+        return Status;
+    }
+
+    InsertIndexBufferCache(Vcb, MftIndex, VCN, IndexBuffer, IndexBufferSize, Generation);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+* @name LookupIndexEntry
+* @implemented
+*
+* Finds a file by its exact name in a directory, by descending the $I30 B+tree from the
+* index root into only the child node that can hold the name. Each node is binary
+* searched, so a lookup costs one index buffer read per level of the tree.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume.
+*
+* @param MftRecord
+* File record of the directory.
+*
+* @param MftIndex
+* Index of the directory in the master file table.
+*
+* @param IndexRoot
+* Contents of the $I30 index root attribute of the directory.
+*
+* @param IndexRootSize
+* Size of the contents of the index root, in bytes.
+*
+* @param FileName
+* Name of the file to look up, without wildcards.
+*
+* @param CaseSensitive
+* TRUE if the name must match exactly, FALSE to ignore the case.
+*
+* @param OutMFTIndex
+* Receives the index of the file in the master file table.
+*
+* @return
+* STATUS_SUCCESS if the file was found, STATUS_OBJECT_PATH_NOT_FOUND if it doesn't exist.
+* STATUS_MORE_PROCESSING_REQUIRED if the answer can't be trusted and the caller must walk all
+* the entries instead. STATUS_FILE_CORRUPT_ERROR if the index is damaged, or another error
+* from reading the index.
+*
+* @remarks
+* The index is sorted with the $UpCase table of the volume, we compare with the system
+* upcase table instead. Both agree on ASCII names, which is why a non-ASCII name that
+* isn't found is handed back to the caller.
+*/
+static
+NTSTATUS
+LookupIndexEntry(PDEVICE_EXTENSION Vcb,
+                 PFILE_RECORD_HEADER MftRecord,
+                 ULONGLONG MftIndex,
+                 PINDEX_ROOT_ATTRIBUTE IndexRoot,
+                 ULONG IndexRootSize,
+                 PUNICODE_STRING FileName,
+                 BOOLEAN CaseSensitive,
+                 ULONGLONG *OutMFTIndex)
+{
+    PNTFS_ATTR_CONTEXT IndexAllocationContext = NULL;
+    PINDEX_BUFFER IndexBuffer = NULL;
+    PINDEX_ENTRY_ATTRIBUTE *Entries;
+    PINDEX_ENTRY_ATTRIBUTE IndexEntry;
+    PINDEX_HEADER_ATTRIBUTE Header;
+    UNICODE_STRING EntryName;
+    ULONG IndexBlockSize, MaxEntries, Size, Depth, i;
+    BOOLEAN HasChildren;
+    LONG Comparison;
+    NTSTATUS Status;
+
+    DPRINT("LookupIndexEntry(%p, %p, %I64u, %p, %lu, %wZ, %s, %p)\n",
+           Vcb,
+           MftRecord,
+           MftIndex,
+           IndexRoot,
+           IndexRootSize,
+           FileName,
+           CaseSensitive ? "TRUE" : "FALSE",
+           OutMFTIndex);
+
+    if (IndexRootSize < sizeof(INDEX_ROOT_ATTRIBUTE))
+    {
+        DPRINT1("Filesystem corruption detected!\n");
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    IndexBlockSize = IndexRoot->SizeOfEntry;
+
+    // Enough room for a node made only of the smallest entries
+    MaxEntries = max(IndexBlockSize, IndexRootSize) / FIELD_OFFSET(INDEX_ENTRY_ATTRIBUTE, FileName) + 1;
+    Entries = ExAllocatePoolWithTag(NonPagedPool, MaxEntries * sizeof(PINDEX_ENTRY_ATTRIBUTE), TAG_NTFS);
+    if (!Entries)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Header = &IndexRoot->Header;
+    Size = IndexRootSize - FIELD_OFFSET(INDEX_ROOT_ATTRIBUTE, Header);
+    HasChildren = (IndexRoot->Header.Flags & INDEX_ROOT_LARGE) != 0;
+
+    for (Depth = 0; ; Depth++)
+    {
+        IndexEntry = SearchIndexNode(Header, Size, FileName, Entries, MaxEntries, &Comparison);
+        if (!IndexEntry)
+        {
+            DPRINT1("Filesystem corruption detected!\n");
+            Status = STATUS_FILE_CORRUPT_ERROR;
+            break;
+        }
+
+        if (Comparison == 0)
+        {
+            EntryName.Buffer = IndexEntry->FileName.Name;
+            EntryName.Length =
+            EntryName.MaximumLength = IndexEntry->FileName.NameLength * sizeof(WCHAR);
+
+            // Names that only differ by case sort together, let the caller find the right one
+            if (CaseSensitive && RtlCompareUnicodeString(FileName, &EntryName, FALSE) != 0)
+            {
+                Status = STATUS_MORE_PROCESSING_REQUIRED;
+                break;
+            }
+
+            // Same filter as BrowseIndexEntries()
+            if ((IndexEntry->Data.Directory.IndexedFile & NTFS_MFT_MASK) < NTFS_FILE_FIRST_USER_FILE ||
+                IndexEntry->FileName.NameType == NTFS_FILE_NAME_DOS)
+            {
+                Status = STATUS_OBJECT_PATH_NOT_FOUND;
+                break;
+            }
+
+            *OutMFTIndex = (IndexEntry->Data.Directory.IndexedFile & NTFS_MFT_MASK);
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        // Names sorting before this entry live in its sub-node, if it has one
+        if (!(IndexEntry->Flags & NTFS_INDEX_ENTRY_NODE))
+        {
+            Status = STATUS_OBJECT_PATH_NOT_FOUND;
+            break;
+        }
+
+        if (!HasChildren || Depth == NTFS_INDEX_MAX_DEPTH || IndexEntry->Length < FIELD_OFFSET(INDEX_ENTRY_ATTRIBUTE, FileName) + sizeof(ULONGLONG))
+        {
+            DPRINT1("Filesystem corruption detected!\n");
+            Status = STATUS_FILE_CORRUPT_ERROR;
+            break;
+        }
+
+        if (!IndexAllocationContext)
+        {
+            Status = FindAttribute(Vcb, MftRecord, AttributeIndexAllocation, L"$I30", 4, &IndexAllocationContext, NULL);
+            if (!NT_SUCCESS(Status))
+            {
+                DPRINT1("Filesystem corruption detected!\n");
+                IndexAllocationContext = NULL;
+                Status = STATUS_FILE_CORRUPT_ERROR;
+                break;
+            }
+
+            IndexBuffer = ExAllocatePoolWithTag(NonPagedPool, IndexBlockSize, TAG_NTFS);
+            if (!IndexBuffer)
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+        }
+
+        // The entry is in the buffer we're about to overwrite, only its VCN is needed
+        Status = ReadIndexNode(Vcb, MftIndex, IndexAllocationContext, GetIndexEntryVCN(IndexEntry), IndexBuffer, IndexBlockSize);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        Header = &IndexBuffer->Header;
+        Size = IndexBlockSize - FIELD_OFFSET(INDEX_BUFFER, Header);
+        HasChildren = (IndexBuffer->Header.Flags & INDEX_NODE_LARGE) != 0;
+    }
+
+    if (Status == STATUS_OBJECT_PATH_NOT_FOUND)
+    {
+        for (i = 0; i < FileName->Length / sizeof(WCHAR); i++)
+        {
+            if (FileName->Buffer[i] >= 0x80)
+            {
+                Status = STATUS_MORE_PROCESSING_REQUIRED;
+                break;
+            }
+        }
+    }
+
+    if (IndexBuffer)
+        ExFreePoolWithTag(IndexBuffer, TAG_NTFS);
+    if (IndexAllocationContext)
+        ReleaseAttributeContext(IndexAllocationContext);
+    ExFreePoolWithTag(Entries, TAG_NTFS);
+
+    return Status;
+}
+
 NTSTATUS
 NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
                   ULONGLONG MFTIndex,
@@ -3158,6 +3960,7 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
     PINDEX_ENTRY_ATTRIBUTE IndexEntry, IndexEntryEnd;
     NTSTATUS Status;
     ULONG CurrentEntry = 0;
+    ULONG IndexRootSize;
 
     DPRINT("NtfsFindMftRecord(%p, %I64d, %wZ, %lu, %s, %s, %p)\n",
            Vcb,
@@ -3197,7 +4000,7 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    ReadAttribute(Vcb, IndexRootCtx, 0, IndexRecord, Vcb->NtfsInfo.BytesPerIndexRecord);
+    IndexRootSize = ReadAttribute(Vcb, IndexRootCtx, 0, IndexRecord, Vcb->NtfsInfo.BytesPerIndexRecord);
     IndexRoot = (PINDEX_ROOT_ATTRIBUTE)IndexRecord;
     IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((PCHAR)&IndexRoot->Header + IndexRoot->Header.FirstEntryOffset);
     /* Index root is always resident. */
@@ -3206,6 +4009,25 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
 
     DPRINT("IndexRecordSize: %x IndexBlockSize: %x\n", Vcb->NtfsInfo.BytesPerIndexRecord, IndexRoot->SizeOfEntry);
 
+    // Exact names can follow the sort order of the index, only wildcards need to see every entry
+    if (!DirSearch)
+    {
+        Status = LookupIndexEntry(Vcb,
+                                  MftRecord,
+                                  MFTIndex,
+                                  IndexRoot,
+                                  IndexRootSize,
+                                  FileName,
+                                  CaseSensitive,
+                                  OutMFTIndex);
+        if (Status != STATUS_MORE_PROCESSING_REQUIRED)
+        {
+            ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+            ExFreeToNPagedLookasideList(&Vcb->FileRecLookasideList, MftRecord);
+            return Status;
+        }
+    }
+
     Status = BrowseIndexEntries(Vcb,
                                 MftRecord,
                                 (PINDEX_ROOT_ATTRIBUTE)IndexRecord,
@@ -96,6 +96,29 @@ typedef struct
     ULONG Size;
 } NTFSIDENTIFIER, *PNTFSIDENTIFIER;
 
+/* Fixed-up file records cached per volume, 4-way set associative */
+#define NTFS_FILE_RECORD_CACHE_SETS 16
+#define NTFS_FILE_RECORD_CACHE_WAYS 4
+
+typedef struct _NTFS_FILE_RECORD_CACHE_ENTRY
+{
+    ULONGLONG MftIndex;
+    ULONG LastUse;
+    struct _FILE_RECORD_HEADER* FileRecord;
+} NTFS_FILE_RECORD_CACHE_ENTRY, *PNTFS_FILE_RECORD_CACHE_ENTRY;
+
+/* Fixed-up $I30 index buffers cached per volume, fully associative */
+#define NTFS_INDEX_BUFFER_CACHE_ENTRIES 16
+
+typedef struct _NTFS_INDEX_BUFFER_CACHE_ENTRY
+{
+    ULONGLONG MftIndex;
+    ULONGLONG VCN;
+    ULONG LastUse;
+    ULONG Size;
+    PVOID IndexBuffer;
+} NTFS_INDEX_BUFFER_CACHE_ENTRY, *PNTFS_INDEX_BUFFER_CACHE_ENTRY;
+
 typedef struct
 {
     NTFSIDENTIFIER Identifier;
@@ -122,6 +145,16 @@ typedef struct
     ULONG Flags;
     ULONG OpenHandleCount;
 
+    FAST_MUTEX FileRecordCacheLock;
+    ULONG FileRecordCacheClock;
+    ULONG FileRecordCacheGeneration;
+    NTFS_FILE_RECORD_CACHE_ENTRY FileRecordCache[NTFS_FILE_RECORD_CACHE_SETS * NTFS_FILE_RECORD_CACHE_WAYS];
+
+    FAST_MUTEX IndexBufferCacheLock;
+    ULONG IndexBufferCacheClock;
+    ULONG IndexBufferCacheGeneration;
+    NTFS_INDEX_BUFFER_CACHE_ENTRY IndexBufferCache[NTFS_INDEX_BUFFER_CACHE_ENTRIES];
+
 } DEVICE_EXTENSION, *PDEVICE_EXTENSION, NTFS_VCB, *PNTFS_VCB;
 
 #define VCB_VOLUME_LOCKED       0x0001
@@ -491,6 +524,23 @@ typedef struct
     CCHAR PriorityBoost;
 } NTFS_IRP_CONTEXT, *PNTFS_IRP_CONTEXT;
 
+/* One decoded data run, StartLCN is -1 for sparse runs */
+typedef struct _NTFS_DATA_RUN
+{
+    ULONGLONG StartVCN;
+    ULONGLONG Length;
+    LONGLONG StartLCN;
+} NTFS_DATA_RUN, *PNTFS_DATA_RUN;
+
+/* Decoded run list of an attribute. Readers hold a reference while they use
+   it, so that it can be dropped at any time when the runs change */
+typedef struct _NTFS_RUN_CACHE
+{
+    LONG RefCount;
+    ULONG RunCount;
+    NTFS_DATA_RUN Runs[1];
+} NTFS_RUN_CACHE, *PNTFS_RUN_CACHE;
+
 typedef struct _NTFS_ATTR_CONTEXT
 {
     PUCHAR            CacheRun;
@@ -500,6 +550,9 @@ typedef struct _NTFS_ATTR_CONTEXT
     LONGLONG            CacheRunLastLCN;
     ULONGLONG            CacheRunCurrentOffset;
     LARGE_MCB           DataRunsMCB;
+    PNTFS_RUN_CACHE     RunCache;   /* Decoded from DataRunsMCB on first read */
+    KSPIN_LOCK          RunCacheLock;
+    ULONG               RunCacheGeneration;
     ULONGLONG           FileMFTIndex;
     ULONGLONG           FileOwnerMFTIndex; /* If attribute list attribute, reference the original file */
     PNTFS_ATTR_RECORD    pRecord;
@@ -1042,6 +1095,9 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord);
 VOID
 ReleaseAttributeContext(PNTFS_ATTR_CONTEXT Context);
 
+VOID
+InvalidateRunCache(PNTFS_ATTR_CONTEXT Context);
+
 ULONG
 ReadAttribute(PDEVICE_EXTENSION Vcb,
               PNTFS_ATTR_CONTEXT Context,
@@ -1118,6 +1174,22 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
                ULONGLONG index,
                PFILE_RECORD_HEADER file);
 
+VOID
+InitializeFileRecordCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+FreeFileRecordCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+InitializeIndexBufferCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+FreeIndexBufferCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+InvalidateIndexBufferCache(PDEVICE_EXTENSION Vcb,
+                           ULONGLONG MftIndex);
+
 NTSTATUS
 UpdateIndexEntryFileNameSize(PDEVICE_EXTENSION Vcb,
                              PFILE_RECORD_HEADER MftRecord,
@@ -149,7 +149,14 @@ NtfsReadFile(PDEVICE_EXTENSION DeviceExt,
     RealReadOffset = ReadOffset;
     RealLength = ToRead;
 
-    if ((ReadOffset % DeviceExt->NtfsInfo.BytesPerSector) != 0 || (ToRead % DeviceExt->NtfsInfo.BytesPerSector) != 0)
+    // The tail of the last sector of the stream can go straight to the caller's buffer if it fits,
+    // the bytes past the end of the stream are zeroed below. Paging I/O always takes this path.
+    if ((ReadOffset % DeviceExt->NtfsInfo.BytesPerSector) == 0 &&
+        ROUND_UP(ToRead, DeviceExt->NtfsInfo.BytesPerSector) <= Length)
+    {
+        RealLength = ROUND_UP(ToRead, DeviceExt->NtfsInfo.BytesPerSector);
+    }
+    else if ((ReadOffset % DeviceExt->NtfsInfo.BytesPerSector) != 0 || (ToRead % DeviceExt->NtfsInfo.BytesPerSector) != 0)
     {
         RealReadOffset = ROUND_DOWN(ReadOffset, DeviceExt->NtfsInfo.BytesPerSector);
         RealLength = ROUND_UP(ToRead, DeviceExt->NtfsInfo.BytesPerSector);
@@ -212,12 +219,115 @@ NtfsReadFile(PDEVICE_EXTENSION DeviceExt,
 }
 
 
+/*
+ * FUNCTION: Reads data from a file through the cache manager
+ */
+static
+NTSTATUS
+NtfsCachedRead(PNTFS_IRP_CONTEXT IrpContext,
+               PNTFS_FCB Fcb,
+               LARGE_INTEGER ReadOffset,
+               ULONG Length,
+               PULONG LengthRead)
+{
+    PIRP Irp = IrpContext->Irp;
+    PFILE_OBJECT FileObject = IrpContext->FileObject;
+    BOOLEAN CanWait = BooleanFlagOn(IrpContext->Flags, IRPCONTEXT_CANWAIT);
+    NTSTATUS Status;
+    PVOID Buffer;
+
+    DPRINT("NtfsCachedRead(%p, %p, %I64u, %lu, %p)\n", IrpContext, Fcb, ReadOffset.QuadPart, Length, LengthRead);
+
+    *LengthRead = 0;
+
+    if (Length == 0)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    // Same rules as NtfsReadFile()
+    if (ReadOffset.QuadPart >= Fcb->RFCB.FileSize.QuadPart)
+    {
+        DPRINT1("Reading beyond stream end!\n");
+        return STATUS_END_OF_FILE;
+    }
+
+    if (ReadOffset.QuadPart + Length > Fcb->RFCB.FileSize.QuadPart)
+        Length = (ULONG)(Fcb->RFCB.FileSize.QuadPart - ReadOffset.QuadPart);
+
+    // CcMdlRead() always blocks, and the user buffer must stay reachable from the worker thread
+    if (!CanWait && (IrpContext->MinorFunction & IRP_MN_MDL))
+    {
+        return NtfsMarkIrpContextForQueue(IrpContext);
+    }
+
+    Status = STATUS_SUCCESS;
+    _SEH2_TRY
+    {
+        // Only the first file object of a stream got a cache map when it was opened
+        if (FileObject->PrivateCacheMap == NULL)
+        {
+            CcInitializeCacheMap(FileObject,
+                                 (PCC_FILE_SIZES)(&Fcb->RFCB.AllocationSize),
+                                 FALSE,
+                                 &(NtfsGlobalData->CacheMgrCallbacks),
+                                 Fcb);
+        }
+
+        if (IrpContext->MinorFunction & IRP_MN_MDL)
+        {
+            // Hand out the cache pages themselves, they come back with IRP_MN_COMPLETE
+            CcMdlRead(FileObject, &ReadOffset, Length, &Irp->MdlAddress, &Irp->IoStatus);
+            Status = Irp->IoStatus.Status;
+        }
+        else
+        {
+            Buffer = NtfsGetUserBuffer(Irp, FALSE);
+            if (!CcCopyRead(FileObject, &ReadOffset, Length, CanWait, Buffer, &Irp->IoStatus))
+            {
+                ASSERT(!CanWait);
+                Status = STATUS_PENDING;
+            }
+            else
+            {
+                Status = Irp->IoStatus.Status;
+            }
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = _SEH2_GetExceptionCode();
+    }
+    _SEH2_END;
+
+    if (Status == STATUS_PENDING)
+    {
+        // The data isn't cached yet, retry from a worker thread that can wait for the disk
+        Status = NtfsLockUserBuffer(Irp, Length, IoWriteAccess);
+        if (!NT_SUCCESS(Status))
+        {
+            return Status;
+        }
+
+        return NtfsMarkIrpContextForQueue(IrpContext);
+    }
+
+    if (NT_SUCCESS(Status))
+    {
+        *LengthRead = (ULONG)Irp->IoStatus.Information;
+    }
+
+    return Status;
+}
+
+
 NTSTATUS
 NtfsRead(PNTFS_IRP_CONTEXT IrpContext)
 {
     PDEVICE_EXTENSION DeviceExt;
     PIO_STACK_LOCATION Stack;
     PFILE_OBJECT FileObject;
+    PNTFS_FCB Fcb;
     PVOID Buffer;
     ULONG ReadLength;
     LARGE_INTEGER ReadOffset;
@@ -232,19 +342,52 @@ NtfsRead(PNTFS_IRP_CONTEXT IrpContext)
     Irp = IrpContext->Irp;
     Stack = IrpContext->Stack;
     FileObject = IrpContext->FileObject;
+    Fcb = (PNTFS_FCB)FileObject->FsContext;
 
     DeviceExt = DeviceObject->DeviceExtension;
     ReadLength = Stack->Parameters.Read.Length;
     ReadOffset = Stack->Parameters.Read.ByteOffset;
-    Buffer = NtfsGetUserBuffer(Irp, BooleanFlagOn(Irp->Flags, IRP_PAGING_IO));
 
-    Status = NtfsReadFile(DeviceExt,
-                          FileObject,
-                          Buffer,
-                          ReadLength,
-                          ReadOffset.u.LowPart,
-                          Irp->Flags,
-                          &ReturnedReadLength);
+    // The caller is done with the pages of an MDL read
+    if (IrpContext->MinorFunction & IRP_MN_COMPLETE)
+    {
+        CcMdlReadComplete(FileObject, Irp->MdlAddress);
+        Irp->MdlAddress = NULL;
+        Irp->IoStatus.Information = 0;
+        return STATUS_SUCCESS;
+    }
+
+    // Cached reads are copied out of the cache, only the paging reads that fill it
+    // (and non-cached reads) get to the disk, straight into the caller's pages
+    if (!(Irp->Flags & (IRP_PAGING_IO | IRP_NOCACHE)) &&
+        !(Fcb->Flags & FCB_IS_VOLUME) &&
+        !NtfsFCBIsDirectory(Fcb) &&
+        !NtfsFCBIsCompressed(Fcb) &&
+        !NtfsFCBIsEncrypted(Fcb))
+    {
+        Status = NtfsCachedRead(IrpContext,
+                                Fcb,
+                                ReadOffset,
+                                ReadLength,
+                                &ReturnedReadLength);
+        if (Status == STATUS_PENDING)
+        {
+            return Status;
+        }
+    }
+    else
+    {
+        Buffer = NtfsGetUserBuffer(Irp, BooleanFlagOn(Irp->Flags, IRP_PAGING_IO));
+
+        Status = NtfsReadFile(DeviceExt,
+                              FileObject,
+                              Buffer,
+                              ReadLength,
+                              ReadOffset.u.LowPart,
+                              Irp->Flags,
+                              &ReturnedReadLength);
+    }
+
     if (NT_SUCCESS(Status))
     {
         if (FileObject->Flags & FO_SYNCHRONOUS_IO)
@@ -64,9 +64,18 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* Window scaling lets a single connection keep more than 64 KB in
+ * flight. These are only the defaults, AFD socket buffer sizes override
+ * them per connection (see LibTCPApplyWindows). */
+#define LWIP_WND_SCALE                  1
 
-#define TCP_SND_BUF                     TCP_WND
+#define TCP_RCV_SCALE                   3
+
+#define TCP_WND                         (256 * 1024)
+
+#define TCP_SND_BUF                     (256 * 1024)
+
+#define LWIP_TCP_SACK_OUT               1
 
 #define TCP_MAXRTX                      8
 
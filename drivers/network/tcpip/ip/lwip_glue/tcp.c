@@ -440,6 +440,25 @@ LibTCPBind(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const
     return ERR_MEM;
 }
 
+/* Sizes the windows of a PCB from the socket buffer options that AFD set on
+ * the address file. This is done before the connect or listen, so the SYN already
+ * carries them and accepted PCBs inherit the sizes of their listener. */
+static
+void
+LibTCPApplyWindows(PCONNECTION_ENDPOINT Connection, PTCP_PCB pcb)
+{
+    PADDRESS_FILE AddressFile = Connection->AddressFile;
+
+    if (!AddressFile)
+        return;
+
+    if (AddressFile->ReceiveWindow)
+        tcp_setrcvwnd(pcb, AddressFile->ReceiveWindow);
+
+    if (AddressFile->SendWindow)
+        tcp_setsndbuf(pcb, AddressFile->SendWindow);
+}
+
 static
 void
 LibTCPListenCallback(void *arg)
@@ -454,6 +473,8 @@ LibTCPListenCallback(void *arg)
         goto done;
     }
 
+    LibTCPApplyWindows(msg->Input.Listen.Connection, (PTCP_PCB)msg->Input.Listen.Connection->SocketContext);
+
     msg->Output.Listen.NewPcb = tcp_listen_with_backlog((PTCP_PCB)msg->Input.Listen.Connection->SocketContext, msg->Input.Listen.Backlog);
 
     if (msg->Output.Listen.NewPcb)
@@ -608,6 +629,8 @@ LibTCPConnectCallback(void *arg)
     tcp_recv((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalRecvEventHandler);
     tcp_sent((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalSendEventHandler);
 
+    LibTCPApplyWindows(msg->Input.Connect.Connection, (PTCP_PCB)msg->Input.Connect.Connection->SocketContext);
+
     Error = tcp_connect((PTCP_PCB)msg->Input.Connect.Connection->SocketContext,
                         msg->Input.Connect.IpAddress, ntohs(msg->Input.Connect.Port),
                         InternalConnectEventHandler);
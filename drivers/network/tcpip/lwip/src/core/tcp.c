@@ -172,7 +172,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
   err_t err;
 
   if (rst_on_unacked_data && ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT))) {
-    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND)) {
+    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != tcp_rcv_wnd_max(pcb))) {
       /* Not all data received by application, send RST to tell the remote
          side about this. */
       LWIP_ASSERT("pcb->flags & TF_RXCLOSED", pcb->flags & TF_RXCLOSED);
@@ -548,6 +548,8 @@ tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog)
   }
   lpcb->callback_arg = pcb->callback_arg;
   lpcb->local_port = pcb->local_port;
+  lpcb->rcv_wnd_max = pcb->rcv_wnd_max;
+  lpcb->snd_buf_max = pcb->snd_buf_max;
   lpcb->state = LISTEN;
   lpcb->prio = pcb->prio;
   lpcb->so_options = pcb->so_options;
@@ -580,7 +582,7 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 {
   u32_t new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
-  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
+  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((tcp_rcv_wnd_max(pcb) / 2), pcb->mss))) {
     /* we can advertise more window */
     pcb->rcv_ann_wnd = pcb->rcv_wnd;
     return new_right_edge - pcb->rcv_ann_right_edge;
@@ -592,8 +594,10 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
     } else {
       /* keep the right edge of window constant */
       u32_t new_rcv_ann_wnd = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+#if !LWIP_WND_SCALE
       LWIP_ASSERT("new_rcv_ann_wnd <= 0xffff", new_rcv_ann_wnd <= 0xffff);
-      pcb->rcv_ann_wnd = (u16_t)new_rcv_ann_wnd;
+#endif /* !LWIP_WND_SCALE */
+      pcb->rcv_ann_wnd = (tcpwnd_size_t)new_rcv_ann_wnd;
     }
     return 0;
   }
@@ -615,12 +619,12 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
   /* pcb->state LISTEN not allowed here */
   LWIP_ASSERT("don't call tcp_recved for listen-pcbs",
     pcb->state != LISTEN);
-  LWIP_ASSERT("tcp_recved: len would wrap rcv_wnd\n",
-              len <= 0xffff - pcb->rcv_wnd );
 
-  pcb->rcv_wnd += len;
-  if (pcb->rcv_wnd > TCP_WND) {
-    pcb->rcv_wnd = TCP_WND;
+  /* can never wrap: the window never grows beyond tcp_rcv_wnd_max() */
+  if (pcb->rcv_wnd + len > tcp_rcv_wnd_max(pcb)) {
+    pcb->rcv_wnd = tcp_rcv_wnd_max(pcb);
+  } else {
+    pcb->rcv_wnd += len;
   }
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
@@ -634,8 +638,8 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
     tcp_output(pcb);
   }
 
-  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U16_F" (%"U16_F").\n",
-         len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"TCPWNDSIZE_F" (%"TCPWNDSIZE_F").\n",
+         len, pcb->rcv_wnd, tcp_rcv_wnd_max(pcb) - pcb->rcv_wnd));
 }
 
 /**
@@ -743,8 +747,8 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
   pcb->snd_lbb = iss - 1;
-  pcb->rcv_wnd = TCP_WND;
-  pcb->rcv_ann_wnd = TCP_WND;
+  /* without window scaling (not negotiated yet) we can't use more than 64k */
+  pcb->rcv_wnd = pcb->rcv_ann_wnd = tcp_rcv_wnd_max(pcb);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -788,7 +792,7 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
-  u16_t eff_wnd;
+  tcpwnd_size_t eff_wnd;
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -867,8 +871,8 @@ tcp_slowtmr_start:
             pcb->ssthresh = (pcb->mss << 1);
           }
           pcb->cwnd = pcb->mss;
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"U16_F
-                                       " ssthresh %"U16_F"\n",
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
+                                       " ssthresh %"TCPWNDSIZE_F"\n",
                                        pcb->cwnd, pcb->ssthresh));
  
           /* The following needs to be called AFTER cwnd is set to one
@@ -1098,7 +1102,7 @@ tcp_process_refused_data(struct tcp_pcb *pcb)
     if (refused_flags & PBUF_FLAG_TCP_FIN) {
       /* correct rcv_wnd as the application won't call tcp_recved()
          for the FIN's seqno */
-      if (pcb->rcv_wnd != TCP_WND) {
+      if (pcb->rcv_wnd != tcp_rcv_wnd_max(pcb)) {
         pcb->rcv_wnd++;
       }
       TCP_EVENT_CLOSED(pcb, err);
@@ -1165,6 +1169,96 @@ tcp_setprio(struct tcp_pcb *pcb, u8_t prio)
   pcb->prio = prio;
 }
 
+#if LWIP_WND_SCALE
+#define TCP_RCV_WND_LIMIT (0xFFFFUL << TCP_RCV_SCALE)
+#define TCP_SND_BUF_LIMIT ((u32_t)(TCP_SND_QUEUELEN / 2) * TCP_MSS)
+#else /* LWIP_WND_SCALE */
+#define TCP_RCV_WND_LIMIT 0xFFFFUL
+#define TCP_SND_BUF_LIMIT LWIP_MIN((u32_t)(TCP_SND_QUEUELEN / 2) * TCP_MSS, 0xFFFFUL)
+#endif /* LWIP_WND_SCALE */
+
+/**
+ * Sets the receive window of a connection, e.g. from the receive buffer
+ * size of a socket. Connections accepted on a listen pcb inherit its size.
+ * Without window scaling, at most 64k of it can be announced.
+ *
+ * A bigger window is announced at once, a smaller one only takes effect
+ * as data is received (the announced right edge is never moved back).
+ *
+ * @param pcb the tcp_pcb (or listen pcb) to manipulate
+ * @param wnd new receive window size in bytes
+ */
+void
+tcp_setrcvwnd(struct tcp_pcb *pcb, u32_t wnd)
+{
+  tcpwnd_size_t old_max;
+  tcpwnd_size_t new_max;
+
+  wnd = LWIP_MAX(wnd, 2 * TCP_MSS);
+  wnd = LWIP_MIN(wnd, TCP_RCV_WND_LIMIT);
+
+  if (pcb->state == LISTEN) {
+    pcb->rcv_wnd_max = (tcpwnd_size_t)wnd;
+    return;
+  }
+
+  old_max = tcp_rcv_wnd_max(pcb);
+  pcb->rcv_wnd_max = (tcpwnd_size_t)wnd;
+  new_max = tcp_rcv_wnd_max(pcb);
+
+  if (new_max > old_max) {
+    pcb->rcv_wnd += new_max - old_max;
+  } else if (pcb->rcv_wnd > old_max - new_max) {
+    pcb->rcv_wnd -= old_max - new_max;
+  } else {
+    pcb->rcv_wnd = 0;
+  }
+
+  if (pcb->state < ESTABLISHED) {
+    /* nothing announced with window scaling yet */
+    pcb->rcv_ann_wnd = pcb->rcv_wnd;
+  } else if (tcp_update_rcv_ann_wnd(pcb) >= TCP_WND_UPDATE_THRESHOLD) {
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+  }
+
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_setrcvwnd: wnd %"TCPWNDSIZE_F" (max %"TCPWNDSIZE_F").\n",
+         pcb->rcv_wnd, new_max));
+}
+
+/**
+ * Sets the send buffer size of a connection, e.g. from the send buffer
+ * size of a socket. Connections accepted on a listen pcb inherit its size.
+ *
+ * The buffer never shrinks below the data that is already queued.
+ *
+ * @param pcb the tcp_pcb (or listen pcb) to manipulate
+ * @param size new send buffer size in bytes
+ */
+void
+tcp_setsndbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  tcpwnd_size_t queued;
+
+  size = LWIP_MAX(size, 2 * TCP_MSS);
+  size = LWIP_MIN(size, TCP_SND_BUF_LIMIT);
+
+  if (pcb->state == LISTEN) {
+    pcb->snd_buf_max = (tcpwnd_size_t)size;
+    return;
+  }
+
+  queued = pcb->snd_buf_max - pcb->snd_buf;
+  if (size < queued) {
+    size = queued;
+  }
+  pcb->snd_buf_max = (tcpwnd_size_t)size;
+  pcb->snd_buf = pcb->snd_buf_max - queued;
+
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_setsndbuf: buf %"TCPWNDSIZE_F" (max %"TCPWNDSIZE_F").\n",
+         pcb->snd_buf, pcb->snd_buf_max));
+}
+
 #if TCP_QUEUE_OOSEQ
 /**
  * Returns a copy of the given TCP segment.
@@ -1306,10 +1400,10 @@ tcp_alloc(u8_t prio)
   if (pcb != NULL) {
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
-    pcb->snd_buf = TCP_SND_BUF;
+    pcb->snd_buf_max = pcb->snd_buf = TCP_SND_BUF;
     pcb->snd_queuelen = 0;
-    pcb->rcv_wnd = TCP_WND;
-    pcb->rcv_ann_wnd = TCP_WND;
+    pcb->rcv_wnd_max = TCP_WND;
+    pcb->rcv_wnd = pcb->rcv_ann_wnd = tcp_rcv_wnd_max(pcb);
     pcb->tos = 0;
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -105,7 +105,7 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
-    tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+    tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
 
@@ -306,7 +306,7 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
 
   /* fail on too much data */
   if (len > pcb->snd_buf) {
-    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"U16_F")\n",
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"TCPWNDSIZE_F")\n",
       len, pcb->snd_buf));
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -370,7 +370,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   /* don't allocate segments bigger than half the maximum window we ever received */
-  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+  u16_t mss_local = (u16_t)LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
 
 #if LWIP_NETIF_TX_SINGLE_PBUF
   /* Always copy to try to create single pbufs for TX */
@@ -742,6 +742,19 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 
   if (flags & TCP_SYN) {
     optflags = TF_SEG_OPTS_MSS;
+#if LWIP_WND_SCALE
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_WND_SCALE)) {
+      /* In a <SYN,ACK> (sent in state SYN_RCVD), the window scale option may
+         only be sent if we received a window scale option from the remote host. */
+      optflags |= TF_SEG_OPTS_WND_SCALE;
+    }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_SACK)) {
+      /* Same for the SACK permitted option */
+      optflags |= TF_SEG_OPTS_SACK_PERM;
+    }
+#endif /* LWIP_TCP_SACK_OUT */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP)) {
@@ -834,6 +847,114 @@ tcp_build_timestamp_option(struct tcp_pcb *pcb, u32_t *opts)
 }
 #endif
 
+#if LWIP_WND_SCALE
+/** Build a window scale option (3 bytes long) at the specified options pointer,
+ * preceded by a NOP option to keep the alignment.
+ *
+ * @param opts option pointer where to store the window scale option
+ */
+static void
+tcp_build_wnd_scale_option(u32_t *opts)
+{
+  opts[0] = PP_HTONL(0x01030300 | TCP_RCV_SCALE);
+}
+#endif /* LWIP_WND_SCALE */
+
+#if LWIP_TCP_SACK_OUT
+/** Build a SACK permitted option (2 bytes long) at the specified options
+ * pointer, preceded by two NOP options to keep the alignment.
+ *
+ * @param opts option pointer where to store the SACK permitted option
+ */
+static void
+tcp_build_sack_perm_option(u32_t *opts)
+{
+  opts[0] = PP_HTONL(0x01010402);
+}
+
+/** Collect the SACK blocks (RFC 2018) describing the out of sequence queue.
+ * Adjacent segments are merged into one block. The block holding the most
+ * recently received segment comes first, the others follow in sequence order.
+ *
+ * @param pcb tcp_pcb
+ * @param blocks array receiving left and right edge of each block
+ * @param max_blocks the maximum number of blocks to return
+ * @return the number of blocks stored in blocks
+ */
+static u8_t
+tcp_get_sack_blocks(struct tcp_pcb *pcb, u32_t *blocks, u8_t max_blocks)
+{
+  struct tcp_seg *seg;
+  u32_t left = 0, right = 0;
+  u8_t num = 1, have_recent = 0, i;
+
+  if (!(pcb->flags & TF_SACK) || (max_blocks == 0) || (pcb->ooseq == NULL)) {
+    return 0;
+  }
+
+  /* slot 0 is kept for the block of the most recent segment */
+  seg = pcb->ooseq;
+  for (;;) {
+    if ((seg != NULL) && (TCP_TCPLEN(seg) == 0)) {
+      seg = seg->next;
+      continue;
+    }
+    if ((seg != NULL) && (left != right) && (seg->tcphdr->seqno == right)) {
+      /* contiguous to the current block */
+      right += TCP_TCPLEN(seg);
+      seg = seg->next;
+      continue;
+    }
+    /* the current block is complete */
+    if (left != right) {
+      if (!have_recent && TCP_SEQ_BETWEEN(pcb->rcv_sack_recent, left, right - 1)) {
+        blocks[0] = left;
+        blocks[1] = right;
+        have_recent = 1;
+      } else if (num < max_blocks) {
+        blocks[num * 2] = left;
+        blocks[num * 2 + 1] = right;
+        num++;
+      }
+    }
+    if (seg == NULL) {
+      break;
+    }
+    left = seg->tcphdr->seqno;
+    right = left + TCP_TCPLEN(seg);
+    seg = seg->next;
+  }
+
+  if (!have_recent) {
+    /* the most recent segment is gone (e.g. trimmed), close the gap */
+    for (i = 1; i < num; i++) {
+      blocks[(i - 1) * 2] = blocks[i * 2];
+      blocks[(i - 1) * 2 + 1] = blocks[i * 2 + 1];
+    }
+    num--;
+  }
+  return num;
+}
+
+/** Build a SACK option (2 + 8 * num_blocks bytes long) at the specified
+ * options pointer, preceded by two NOP options to keep the alignment.
+ *
+ * @param opts option pointer where to store the SACK option
+ * @param blocks left and right edge of each block
+ * @param num_blocks the number of SACK blocks
+ */
+static void
+tcp_build_sack_option(u32_t *opts, const u32_t *blocks, u8_t num_blocks)
+{
+  u8_t i;
+
+  opts[0] = htonl(0x01010500 | (2 + num_blocks * 8));
+  for (i = 0; i < num_blocks * 2; i++) {
+    opts[1 + i] = htonl(blocks[i]);
+  }
+}
+#endif /* LWIP_TCP_SACK_OUT */
+
 /** Send an ACK without data.
  *
  * @param pcb Protocol control block for the TCP connection to send the ACK
@@ -843,13 +964,26 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
 {
   struct pbuf *p;
   struct tcp_hdr *tcphdr;
+  u32_t *opts;
   u8_t optlen = 0;
+#if LWIP_TCP_SACK_OUT
+  u32_t sack_blocks[LWIP_TCP_MAX_SACK_NUM * 2];
+  u8_t num_sacks;
+#endif /* LWIP_TCP_SACK_OUT */
 
 #if LWIP_TCP_TIMESTAMPS
   if (pcb->flags & TF_TIMESTAMP) {
     optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
   }
 #endif
+#if LWIP_TCP_SACK_OUT
+  /* as many blocks as fit next to the other options */
+  num_sacks = tcp_get_sack_blocks(pcb, sack_blocks,
+    (u8_t)LWIP_MIN(LWIP_TCP_MAX_SACK_NUM, (TCP_MAX_OPTION_BYTES - optlen - 4) / 8));
+  if (num_sacks > 0) {
+    optlen += 4 + num_sacks * 8;
+  }
+#endif /* LWIP_TCP_SACK_OUT */
 
   p = tcp_output_alloc_header(pcb, optlen, 0, htonl(pcb->snd_nxt));
   if (p == NULL) {
@@ -863,13 +997,21 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   pcb->flags &= ~(TF_ACK_DELAY | TF_ACK_NOW);
 
   /* NB. MSS option is only sent on SYNs, so ignore it here */
+  opts = (u32_t *)(void *)(tcphdr + 1);
 #if LWIP_TCP_TIMESTAMPS
   pcb->ts_lastacksent = pcb->rcv_nxt;
 
   if (pcb->flags & TF_TIMESTAMP) {
-    tcp_build_timestamp_option(pcb, (u32_t *)(tcphdr + 1));
+    tcp_build_timestamp_option(pcb, opts);
+    opts += 3;
   }
 #endif 
+#if LWIP_TCP_SACK_OUT
+  if (num_sacks > 0) {
+    tcp_build_sack_option(opts, sack_blocks, num_sacks);
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+  LWIP_UNUSED_ARG(opts);
 
 #if CHECKSUM_GEN_TCP
   tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
@@ -945,13 +1087,13 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_OUTPUT_DEBUG */
 #if TCP_CWND_DEBUG
   if (seg == NULL) {
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F
-                                 ", cwnd %"U16_F", wnd %"U32_F
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F
+                                 ", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                                  ", seg == NULL, ack %"U32_F"\n",
                                  pcb->snd_wnd, pcb->cwnd, wnd, pcb->lastack));
   } else {
     LWIP_DEBUGF(TCP_CWND_DEBUG, 
-                ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F
+                ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                  ", effwnd %"U32_F", seq %"U32_F", ack %"U32_F"\n",
                  pcb->snd_wnd, pcb->cwnd, wnd,
                  ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len,
@@ -975,7 +1117,7 @@ tcp_output(struct tcp_pcb *pcb)
       break;
     }
 #if TCP_CWND_DEBUG
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
                             pcb->snd_wnd, pcb->cwnd, wnd,
                             ntohl(seg->tcphdr->seqno) + seg->len -
                             pcb->lastack,
@@ -1060,7 +1202,16 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   seg->tcphdr->ackno = htonl(pcb->rcv_nxt);
 
   /* advertise our receive window size in this TCP segment */
-  seg->tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    /* The Window field in a SYN segment itself (the only type where we send
+       the window scale option) is never scaled. */
+    seg->tcphdr->wnd = htons(TCPWND16(pcb->rcv_ann_wnd));
+  } else
+#endif /* LWIP_WND_SCALE */
+  {
+    seg->tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
+  }
 
   pcb->rcv_ann_right_edge = pcb->rcv_nxt + pcb->rcv_ann_wnd;
 
@@ -1077,6 +1228,18 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     *opts = TCP_BUILD_MSS_OPTION(mss);
     opts += 1;
   }
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    tcp_build_wnd_scale_option(opts);
+    opts += 1;
+  }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+  if (seg->flags & TF_SEG_OPTS_SACK_PERM) {
+    tcp_build_sack_perm_option(opts);
+    opts += 1;
+  }
+#endif /* LWIP_TCP_SACK_OUT */
 #if LWIP_TCP_TIMESTAMPS
   pcb->ts_lastacksent = pcb->rcv_nxt;
 
@@ -1212,7 +1375,7 @@ tcp_rst(u32_t seqno, u32_t ackno,
   tcphdr->seqno = htonl(seqno);
   tcphdr->ackno = htonl(ackno);
   TCPH_HDRLEN_FLAGS_SET(tcphdr, TCP_HLEN/4, TCP_RST | TCP_ACK);
-  tcphdr->wnd = PP_HTONS(TCP_WND);
+  tcphdr->wnd = PP_HTONS(TCPWND16(TCP_WND));
   tcphdr->chksum = 0;
   tcphdr->urgp = 0;
 
@@ -1340,7 +1503,7 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
     /* The minimum value for ssthresh should be 2 MSS */
     if (pcb->ssthresh < 2*pcb->mss) {
       LWIP_DEBUGF(TCP_FR_DEBUG, 
-                  ("tcp_receive: The minimum value for ssthresh %"U16_F
+                  ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
                    " should be min 2 mss %"U16_F"...\n",
                    pcb->ssthresh, 2*pcb->mss));
       pcb->ssthresh = 2*pcb->mss;
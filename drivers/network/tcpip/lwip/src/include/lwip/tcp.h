@@ -48,6 +48,14 @@ extern "C" {
 
 struct tcp_pcb;
 
+#if LWIP_WND_SCALE
+typedef u32_t tcpwnd_size_t;
+#define TCPWNDSIZE_F U32_F
+#else
+typedef u16_t tcpwnd_size_t;
+#define TCPWNDSIZE_F U16_F
+#endif
+
 /** Function prototype for tcp accept callback functions. Called when a new
  * connection can be accepted on a listening pcb.
  *
@@ -161,7 +169,10 @@ enum tcp_state {
   enum tcp_state state; /* TCP state */ \
   u8_t prio; \
   /* ports are in host byte order */ \
-  u16_t local_port
+  u16_t local_port; \
+  /* receive window and send buffer sizes, inherited by accepted pcbs */ \
+  tcpwnd_size_t rcv_wnd_max; \
+  tcpwnd_size_t snd_buf_max
 
 
 /* the TCP protocol control block */
@@ -174,15 +185,17 @@ struct tcp_pcb {
   /* ports are in host byte order */
   u16_t remote_port;
   
-  u8_t flags;
-#define TF_ACK_DELAY   ((u8_t)0x01U)   /* Delayed ACK. */
-#define TF_ACK_NOW     ((u8_t)0x02U)   /* Immediate ACK. */
-#define TF_INFR        ((u8_t)0x04U)   /* In fast recovery. */
-#define TF_TIMESTAMP   ((u8_t)0x08U)   /* Timestamp option enabled */
-#define TF_RXCLOSED    ((u8_t)0x10U)   /* rx closed by tcp_shutdown */
-#define TF_FIN         ((u8_t)0x20U)   /* Connection was closed locally (FIN segment enqueued). */
-#define TF_NODELAY     ((u8_t)0x40U)   /* Disable Nagle algorithm */
-#define TF_NAGLEMEMERR ((u8_t)0x80U)   /* nagle enabled, memerr, try to output to prevent delayed ACK to happen */
+  u16_t flags;
+#define TF_ACK_DELAY   ((u16_t)0x01U)   /* Delayed ACK. */
+#define TF_ACK_NOW     ((u16_t)0x02U)   /* Immediate ACK. */
+#define TF_INFR        ((u16_t)0x04U)   /* In fast recovery. */
+#define TF_TIMESTAMP   ((u16_t)0x08U)   /* Timestamp option enabled */
+#define TF_RXCLOSED    ((u16_t)0x10U)   /* rx closed by tcp_shutdown */
+#define TF_FIN         ((u16_t)0x20U)   /* Connection was closed locally (FIN segment enqueued). */
+#define TF_NODELAY     ((u16_t)0x40U)   /* Disable Nagle algorithm */
+#define TF_NAGLEMEMERR ((u16_t)0x80U)   /* nagle enabled, memerr, try to output to prevent delayed ACK to happen */
+#define TF_WND_SCALE   ((u16_t)0x0100U) /* Window Scale option enabled */
+#define TF_SACK        ((u16_t)0x0200U) /* Peer permits selective acknowledgements */
 
   /* the rest of the fields are in host byte order
      as we have to do some math with them */
@@ -194,9 +207,12 @@ struct tcp_pcb {
 
   /* receiver variables */
   u32_t rcv_nxt;   /* next seqno expected */
-  u16_t rcv_wnd;   /* receiver window available */
-  u16_t rcv_ann_wnd; /* receiver window to announce */
+  tcpwnd_size_t rcv_wnd;   /* receiver window available */
+  tcpwnd_size_t rcv_ann_wnd; /* receiver window to announce */
   u32_t rcv_ann_right_edge; /* announced right edge of window */
+#if LWIP_TCP_SACK_OUT
+  u32_t rcv_sack_recent; /* seqno of the most recent out of sequence segment */
+#endif /* LWIP_TCP_SACK_OUT */
 
   /* Retransmission timer. */
   s16_t rtime;
@@ -216,20 +232,20 @@ struct tcp_pcb {
   u32_t lastack; /* Highest acknowledged seqno. */
 
   /* congestion avoidance/control variables */
-  u16_t cwnd;
-  u16_t ssthresh;
+  tcpwnd_size_t cwnd;
+  tcpwnd_size_t ssthresh;
 
   /* sender variables */
   u32_t snd_nxt;   /* next new seqno to be sent */
   u32_t snd_wl1, snd_wl2; /* Sequence and acknowledgement numbers of last
                              window update. */
   u32_t snd_lbb;       /* Sequence number of next byte to be buffered. */
-  u16_t snd_wnd;   /* sender window */
-  u16_t snd_wnd_max; /* the maximum sender window announced by the remote host */
+  tcpwnd_size_t snd_wnd;   /* sender window */
+  tcpwnd_size_t snd_wnd_max; /* the maximum sender window announced by the remote host */
 
-  u16_t acked;
+  tcpwnd_size_t acked;
 
-  u16_t snd_buf;   /* Available buffer space for sending (in bytes). */
+  tcpwnd_size_t snd_buf;   /* Available buffer space for sending (in bytes). */
 #define TCP_SNDQUEUELEN_OVERFLOW (0xffffU-3)
   u16_t snd_queuelen; /* Available buffer space for sending (in tcp_segs). */
 
@@ -279,6 +295,11 @@ struct tcp_pcb {
 
   /* KEEPALIVE counter */
   u8_t keep_cnt_sent;
+
+#if LWIP_WND_SCALE
+  u8_t snd_scale;
+  u8_t rcv_scale;
+#endif /* LWIP_WND_SCALE */
 };
 
 struct tcp_pcb_listen {  
@@ -329,6 +350,13 @@ void             tcp_err     (struct tcp_pcb *pcb, tcp_err_fn err);
 #define          tcp_nagle_enable(pcb)    ((pcb)->flags &= ~TF_NODELAY)
 #define          tcp_nagle_disabled(pcb)  (((pcb)->flags & TF_NODELAY) != 0)
 
+#if LWIP_WND_SCALE
+#define          tcp_rcv_wnd_max(pcb)     (((pcb)->flags & TF_WND_SCALE) ? (pcb)->rcv_wnd_max : \
+                                           (tcpwnd_size_t)LWIP_MIN((pcb)->rcv_wnd_max, 0xFFFF))
+#else
+#define          tcp_rcv_wnd_max(pcb)     ((pcb)->rcv_wnd_max)
+#endif /* LWIP_WND_SCALE */
+
 #if TCP_LISTEN_BACKLOG
 #define          tcp_accepted(pcb) do { \
   LWIP_ASSERT("pcb->state == LISTEN (called for wrong pcb?)", pcb->state == LISTEN); \
@@ -359,6 +387,8 @@ err_t            tcp_write   (struct tcp_pcb *pcb, const void *dataptr, u16_t le
                               u8_t apiflags);
 
 void             tcp_setprio (struct tcp_pcb *pcb, u8_t prio);
+void             tcp_setrcvwnd(struct tcp_pcb *pcb, u32_t wnd);
+void             tcp_setsndbuf(struct tcp_pcb *pcb, u32_t size);
 
 #define TCP_PRIO_MIN    1
 #define TCP_PRIO_NORMAL 64
@@ -292,16 +292,45 @@ struct tcp_seg {
 #define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
 #define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
+#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include WND SCALE option */
+#define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK Permitted option */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
-#define LWIP_TCP_OPT_LENGTH(flags)              \
-  (flags & TF_SEG_OPTS_MSS ? 4  : 0) +          \
-  (flags & TF_SEG_OPTS_TS  ? 12 : 0)
+#define LWIP_TCP_OPT_LENGTH(flags)                  \
+  (((flags) & TF_SEG_OPTS_MSS       ? 4  : 0) +     \
+   ((flags) & TF_SEG_OPTS_TS        ? 12 : 0) +     \
+   ((flags) & TF_SEG_OPTS_WND_SCALE ? 4  : 0) +     \
+   ((flags) & TF_SEG_OPTS_SACK_PERM ? 4  : 0))
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) htonl(0x02040000 | ((mss) & 0xFFFF))
 
+/** Maximum length of all TCP header options */
+#define TCP_MAX_OPTION_BYTES 40
+
+#if LWIP_WND_SCALE
+#define RCV_WND_SCALE(pcb, wnd) (((wnd) >> (pcb)->rcv_scale))
+#define SND_WND_SCALE(pcb, wnd) (((tcpwnd_size_t)(wnd) << (pcb)->snd_scale))
+#else
+#define RCV_WND_SCALE(pcb, wnd) (wnd)
+#define SND_WND_SCALE(pcb, wnd) ((tcpwnd_size_t)(wnd))
+#endif /* LWIP_WND_SCALE */
+
+/** Clamp a window to what fits into the 16 bit header field */
+#define TCPWND16(x)             ((u16_t)LWIP_MIN((x), 0xFFFF))
+
+/** Event callbacks report acknowledged data in u16_t chunks */
+#define TCP_EVENT_SENT_CHUNKED(pcb,acked,ret) do {                  \
+    tcpwnd_size_t sent_left_ = (acked);                             \
+    (ret) = ERR_OK;                                                 \
+    while ((sent_left_ > 0) && ((ret) == ERR_OK)) {                 \
+      u16_t sent_now_ = TCPWND16(sent_left_);                       \
+      sent_left_ -= sent_now_;                                      \
+      TCP_EVENT_SENT(pcb, sent_now_, ret);                          \
+    }                                                               \
+  } while (0)
+
 /* Global variables: */
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
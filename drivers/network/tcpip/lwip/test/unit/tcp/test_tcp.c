@@ -649,6 +649,189 @@ START_TEST(test_tcp_tx_full_window_lost_from_unacked)
   test_tcp_tx_full_window_lost(0);
 }
 END_TEST
+#if LWIP_WND_SCALE
+/** Copy the headers of the (single) packet that was sent last and forget it
+ *
+ * @param txcounters the counters of the netif the packet was sent over
+ * @param hdr buffer receiving the IP and TCP headers
+ * @param len number of bytes to copy
+ * @return the TCP header inside hdr
+ */
+static struct tcp_hdr*
+test_tcp_get_tx_header(struct test_tcp_txcounters *txcounters, u8_t *hdr, u16_t len)
+{
+  EXPECT_RETNULL(txcounters->num_tx_calls == 1);
+  EXPECT_RETNULL(txcounters->tx_packets != NULL);
+  EXPECT_RETNULL(pbuf_copy_partial(txcounters->tx_packets, hdr, len, 0) == len);
+  pbuf_free(txcounters->tx_packets);
+  txcounters->tx_packets = NULL;
+  txcounters->num_tx_calls = 0;
+  txcounters->num_tx_bytes = 0;
+  return (struct tcp_hdr*)(hdr + 20);
+}
+
+/** Actively open a connection asking for a receive window bigger than 64k,
+ * the remote side answers with a window scale option (shift count 3) */
+static struct tcp_pcb*
+test_tcp_wnd_scale_connect(struct test_tcp_counters *counters, struct test_tcp_txcounters *txcounters,
+                           struct netif *netif, u32_t rcv_wnd)
+{
+  struct tcp_pcb* pcb;
+  struct tcp_hdr* tcphdr;
+  struct pbuf* p;
+  ip_addr_t remote_ip, local_ip, netmask;
+  u8_t hdr[20 + 20 + 12];
+  /* MSS, NOP, window scale 3 */
+  const u8_t synack_opts[] = {0x02, 0x04, TCP_MSS >> 8, TCP_MSS & 0xFF, 0x01, 0x03, 0x03, 0x03};
+  /* MSS, NOP, window scale, NOP, NOP, SACK permitted */
+  const u8_t syn_opts[] = {0x02, 0x04, TCP_MSS >> 8, TCP_MSS & 0xFF, 0x01, 0x03, 0x03, TCP_RCV_SCALE,
+                           0x01, 0x01, 0x04, 0x02};
+  err_t err;
+
+  IP4_ADDR(&local_ip, 192, 168, 1, 1);
+  IP4_ADDR(&remote_ip, 192, 168, 1, 2);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  test_tcp_init_netif(netif, txcounters, &local_ip, &netmask);
+  txcounters->copy_tx_packets = 1;
+
+  pcb = test_tcp_new_counters_pcb(counters);
+  EXPECT_RETNULL(pcb != NULL);
+  tcp_setrcvwnd(pcb, rcv_wnd);
+
+  /* the SYN offers window scaling, its own window is never scaled */
+  err = tcp_connect(pcb, &remote_ip, 0x100, NULL);
+  EXPECT_RETNULL(err == ERR_OK);
+  tcphdr = test_tcp_get_tx_header(txcounters, hdr, sizeof(hdr));
+  EXPECT_RETNULL(tcphdr != NULL);
+  EXPECT(TCPH_FLAGS(tcphdr) == TCP_SYN);
+  EXPECT(TCPH_HDRLEN(tcphdr) == 8);
+  EXPECT(ntohs(tcphdr->wnd) == 0xFFFF);
+  EXPECT(memcmp(tcphdr + 1, syn_opts, sizeof(syn_opts)) == 0);
+
+  /* the SYN|ACK accepts it: window scaling is used from now on */
+  p = tcp_create_rx_segment_wnd_opts(pcb, NULL, 0, 0, 1, TCP_SYN | TCP_ACK, 0x2000,
+    synack_opts, sizeof(synack_opts));
+  EXPECT_RETNULL(p != NULL);
+  test_tcp_input(p, netif);
+  EXPECT_RETNULL(pcb->state == ESTABLISHED);
+  EXPECT(pcb->flags & TF_WND_SCALE);
+  EXPECT(pcb->snd_scale == 3);
+  EXPECT(pcb->rcv_scale == TCP_RCV_SCALE);
+  /* the window in the SYN|ACK isn't scaled either */
+  EXPECT(pcb->snd_wnd == 0x2000);
+  EXPECT(pcb->rcv_wnd == rcv_wnd);
+
+  /* the ACK announces the whole (scaled) window */
+  tcphdr = test_tcp_get_tx_header(txcounters, hdr, 40);
+  EXPECT_RETNULL(tcphdr != NULL);
+  EXPECT(TCPH_FLAGS(tcphdr) == TCP_ACK);
+  EXPECT(ntohs(tcphdr->wnd) == (rcv_wnd >> TCP_RCV_SCALE));
+  return pcb;
+}
+
+/** Negotiate window scaling and check that windows and buffers can grow
+ * beyond 64k */
+START_TEST(test_tcp_wnd_scale)
+{
+  struct test_tcp_counters counters;
+  struct test_tcp_txcounters txcounters;
+  struct netif netif;
+  struct tcp_pcb* pcb;
+  struct pbuf* p;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&counters, 0, sizeof(counters));
+  pcb = test_tcp_wnd_scale_connect(&counters, &txcounters, &netif, 0x20000);
+  EXPECT_RET(pcb != NULL);
+  txcounters.copy_tx_packets = 0;
+
+  /* the window of the remote side is scaled now */
+  p = tcp_create_rx_segment_wnd(pcb, NULL, 0, 0, 0, TCP_ACK, 0x4000);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(pcb->snd_wnd == (0x4000 << 3));
+  EXPECT(pcb->snd_wnd_max == (0x4000 << 3));
+
+  /* the send buffer can grow as far as the send queue allows */
+  tcp_setsndbuf(pcb, 0x100000);
+  EXPECT(tcp_sndbuf(pcb) == (TCP_SND_QUEUELEN / 2) * TCP_MSS);
+  tcp_setsndbuf(pcb, 4 * TCP_MSS);
+  EXPECT(tcp_sndbuf(pcb) == 4 * TCP_MSS);
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+}
+END_TEST
+
+/** Simulate a link with a big bandwidth-delay product: the remote side sends
+ * more than 64k before it sees any window update, all of it must be accepted
+ * and the window must reopen once the data is consumed */
+START_TEST(test_tcp_wnd_scale_rx_beyond_64k)
+{
+  struct test_tcp_counters counters;
+  struct test_tcp_txcounters txcounters;
+  struct netif netif;
+  struct tcp_pcb* pcb;
+  struct tcp_hdr* tcphdr;
+  struct pbuf* p;
+  u8_t hdr[40];
+  u32_t rcv_wnd = 0x20000, received = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&counters, 0, sizeof(counters));
+  pcb = test_tcp_wnd_scale_connect(&counters, &txcounters, &netif, rcv_wnd);
+  EXPECT_RET(pcb != NULL);
+  txcounters.copy_tx_packets = 0;
+
+  /* the data is not consumed (no tcp_recved) while it is in flight */
+  while (received + TCP_MSS <= 0x18000) {
+    p = tcp_create_rx_segment(pcb, tx_data, TCP_MSS, 0, 0, TCP_ACK);
+    EXPECT_RET(p != NULL);
+    test_tcp_input(p, &netif);
+    received += TCP_MSS;
+    EXPECT_RET(counters.recved_bytes == received);
+  }
+  EXPECT(received > 0xFFFF);
+  EXPECT(pcb->rcv_wnd == rcv_wnd - received);
+  EXPECT(pcb->ooseq == NULL);
+
+  /* an ACK now keeps the right edge of the window where it was */
+  txcounters.num_tx_calls = 0;
+  txcounters.copy_tx_packets = 1;
+  tcp_ack_now(pcb);
+  tcp_output(pcb);
+  tcphdr = test_tcp_get_tx_header(&txcounters, hdr, sizeof(hdr));
+  EXPECT_RET(tcphdr != NULL);
+  EXPECT(ntohs(tcphdr->wnd) == ((rcv_wnd - received) >> TCP_RCV_SCALE));
+
+  /* the application consumes the data: window updates are sent and the
+     whole window is open again */
+  txcounters.copy_tx_packets = 0;
+  while (received > 0) {
+    u16_t len = (u16_t)LWIP_MIN(received, 0xFFFF);
+    tcp_recved(pcb, len);
+    received -= len;
+  }
+  EXPECT(pcb->rcv_wnd == rcv_wnd);
+  EXPECT(txcounters.num_tx_calls > 0);
+  txcounters.num_tx_calls = 0;
+  txcounters.copy_tx_packets = 1;
+  tcp_ack_now(pcb);
+  tcp_output(pcb);
+  tcphdr = test_tcp_get_tx_header(&txcounters, hdr, sizeof(hdr));
+  EXPECT_RET(tcphdr != NULL);
+  EXPECT(ntohs(tcphdr->wnd) == (rcv_wnd >> TCP_RCV_SCALE));
+
+  /* make sure the pcb is freed */
+  txcounters.copy_tx_packets = 0;
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+}
+END_TEST
+#endif /* LWIP_WND_SCALE */
 
 /** Create the suite including all tests for this module */
 Suite *
@@ -661,7 +844,11 @@ tcp_suite(void)
     test_tcp_fast_rexmit_wraparound,
     test_tcp_rto_rexmit_wraparound,
     test_tcp_tx_full_window_lost_from_unacked,
-    test_tcp_tx_full_window_lost_from_unsent
+    test_tcp_tx_full_window_lost_from_unsent,
+#if LWIP_WND_SCALE
+    test_tcp_wnd_scale,
+    test_tcp_wnd_scale_rx_beyond_64k,
+#endif /* LWIP_WND_SCALE */
   };
   return create_suite("TCP", tests, sizeof(tests)/sizeof(TFun), tcp_setup, tcp_teardown);
 }
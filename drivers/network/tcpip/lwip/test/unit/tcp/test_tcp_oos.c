@@ -912,6 +912,129 @@ FIN_TEST(test_tcp_recv_ooseq_double_FIN_13, 13)
 FIN_TEST(test_tcp_recv_ooseq_double_FIN_14, 14)
 FIN_TEST(test_tcp_recv_ooseq_double_FIN_15, 15)
 
+#if LWIP_TCP_SACK_OUT
+/** Check the SACK blocks in the (single) ACK that was sent last
+ *
+ * @param txcounters the counters of the netif the ACK was sent over
+ * @param blocks expected left and right edges of the blocks
+ * @param num_blocks expected number of SACK blocks
+ */
+static void
+check_sack_blocks(struct test_tcp_txcounters *txcounters, const u32_t *blocks, int num_blocks)
+{
+  u8_t hdr[20 + 20 + 40];
+  u16_t hdr_len = (u16_t)(20 + 20 + (num_blocks ? 4 + num_blocks * 8 : 0));
+  u32_t edge;
+  int i;
+
+  EXPECT_RET(txcounters->num_tx_calls == 1);
+  EXPECT_RET(txcounters->tx_packets != NULL);
+  EXPECT(txcounters->tx_packets->tot_len == hdr_len);
+  EXPECT_RET(pbuf_copy_partial(txcounters->tx_packets, hdr, hdr_len, 0) == hdr_len);
+  /* TCP header length */
+  EXPECT((hdr[20 + 12] >> 4) == (hdr_len - 20) / 4);
+  if (num_blocks > 0) {
+    /* NOP, NOP, SACK, length */
+    EXPECT(hdr[40] == 0x01 && hdr[41] == 0x01 && hdr[42] == 0x05);
+    EXPECT(hdr[43] == 2 + num_blocks * 8);
+    for (i = 0; i < num_blocks * 2; i++) {
+      memcpy(&edge, &hdr[44 + i * 4], sizeof(edge));
+      EXPECT(ntohl(edge) == blocks[i]);
+    }
+  }
+
+  pbuf_free(txcounters->tx_packets);
+  txcounters->tx_packets = NULL;
+  txcounters->num_tx_calls = 0;
+  txcounters->num_tx_bytes = 0;
+}
+
+/** Send segments out of order and check that the duplicate ACKs carry
+ * SACK blocks: the most recent block first, adjacent segments merged */
+START_TEST(test_tcp_recv_ooseq_sack)
+{
+  struct test_tcp_counters counters;
+  struct test_tcp_txcounters txcounters;
+  struct tcp_pcb* pcb;
+  struct pbuf *p;
+  ip_addr_t remote_ip, local_ip, netmask;
+  u16_t remote_port = 0x100, local_port = 0x101;
+  struct netif netif;
+  u32_t rcv_nxt = 0x8000;
+  u32_t blocks[4];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for(i = 0; i < 4 * TCP_MSS; i++) {
+    data_full_wnd[i] = (char)i;
+  }
+
+  /* initialize local vars */
+  IP4_ADDR(&local_ip, 192, 168, 1, 1);
+  IP4_ADDR(&remote_ip, 192, 168, 1, 2);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  test_tcp_init_netif(&netif, &txcounters, &local_ip, &netmask);
+  txcounters.copy_tx_packets = 1;
+  /* initialize counter struct */
+  memset(&counters, 0, sizeof(counters));
+  counters.expected_data_len = 4 * TCP_MSS;
+  counters.expected_data = data_full_wnd;
+
+  /* create and initialize the pcb */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &local_ip, &remote_ip, local_port, remote_port);
+  pcb->rcv_nxt = rcv_nxt;
+  /* as if the peer sent the SACK permitted option in its SYN */
+  pcb->flags |= TF_SACK;
+
+  /* segment 1 of 0..3: one block */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[TCP_MSS], TCP_MSS, TCP_MSS, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  blocks[0] = rcv_nxt + TCP_MSS;
+  blocks[1] = rcv_nxt + 2 * TCP_MSS;
+  check_sack_blocks(&txcounters, blocks, 1);
+
+  /* segment 3: its block goes first */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[3 * TCP_MSS], TCP_MSS, 3 * TCP_MSS, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  blocks[0] = rcv_nxt + 3 * TCP_MSS;
+  blocks[1] = rcv_nxt + 4 * TCP_MSS;
+  blocks[2] = rcv_nxt + TCP_MSS;
+  blocks[3] = rcv_nxt + 2 * TCP_MSS;
+  check_sack_blocks(&txcounters, blocks, 2);
+
+  /* segment 2: fills the gap between both blocks, which are merged */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[2 * TCP_MSS], TCP_MSS, 2 * TCP_MSS, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  blocks[0] = rcv_nxt + TCP_MSS;
+  blocks[1] = rcv_nxt + 4 * TCP_MSS;
+  check_sack_blocks(&txcounters, blocks, 1);
+  EXPECT(counters.recv_calls == 0);
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == 3);
+
+  /* segment 0: everything is in sequence, ACKed without SACK blocks */
+  p = tcp_create_rx_segment(pcb, &data_full_wnd[0], TCP_MSS, 0, 0, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(counters.recv_calls == 1);
+  EXPECT(counters.recved_bytes == 4 * TCP_MSS);
+  EXPECT_OOSEQ(tcp_oos_count(pcb) == 0);
+  check_sack_blocks(&txcounters, NULL, 0);
+
+  /* make sure the pcb is freed */
+  txcounters.copy_tx_packets = 0;
+  EXPECT(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+  netif_list = NULL;
+}
+END_TEST
+#endif /* LWIP_TCP_SACK_OUT */
+
 
 /** Create the suite including all tests for this module */
 Suite *
@@ -938,7 +1061,10 @@ tcp_oos_suite(void)
     test_tcp_recv_ooseq_double_FIN_12,
     test_tcp_recv_ooseq_double_FIN_13,
     test_tcp_recv_ooseq_double_FIN_14,
-    test_tcp_recv_ooseq_double_FIN_15
+    test_tcp_recv_ooseq_double_FIN_15,
+#if LWIP_TCP_SACK_OUT
+    test_tcp_recv_ooseq_sack,
+#endif /* LWIP_TCP_SACK_OUT */
   };
   return create_suite("TCP_OOS", tests, sizeof(tests)/sizeof(TFun), tcp_oos_setup, tcp_oos_teardown);
 }
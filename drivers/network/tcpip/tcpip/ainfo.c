@@ -55,6 +55,26 @@ TDI_STATUS SetAddressFileInfo(TDIObjectID *ID,
 
          return TDI_SUCCESS;
 
+      case AO_OPTION_WINDOW:
+         if (BufferSize < sizeof(UINT))
+             return TDI_INVALID_PARAMETER;
+
+         LockObject(AddrFile);
+         AddrFile->ReceiveWindow = *((PUINT)Buffer);
+         UnlockObject(AddrFile);
+
+         return TDI_SUCCESS;
+
+      case AO_OPTION_SEND_WINDOW:
+         if (BufferSize < sizeof(UINT))
+             return TDI_INVALID_PARAMETER;
+
+         LockObject(AddrFile);
+         AddrFile->SendWindow = *((PUINT)Buffer);
+         UnlockObject(AddrFile);
+
+         return TDI_SUCCESS;
+
       default:
          DbgPrint("Unimplemented option %x\n", ID->toi_id);
 
@@ -0,0 +1,179 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Round-trip and throughput test for RtlCompressBuffer
+ */
+
+#include "precomp.h"
+
+#define TEST_ITERATIONS 8
+
+typedef struct _COMPRESS_ENGINE
+{
+    USHORT FormatAndEngine;
+    PCSTR Name;
+} COMPRESS_ENGINE;
+
+static const COMPRESS_ENGINE Engines[] =
+{
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD, "LZNT1 standard" },
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_MAXIMUM,  "LZNT1 maximum" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_STANDARD, "Xpress standard" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_MAXIMUM,  "Xpress maximum" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_STANDARD, "Xpress Huffman standard" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_MAXIMUM,  "Xpress Huffman maximum" },
+};
+
+static
+double
+ElapsedSeconds(
+    _In_ PLARGE_INTEGER Start,
+    _In_ PLARGE_INTEGER End,
+    _In_ PLARGE_INTEGER Frequency)
+{
+    return (double)(End->QuadPart - Start->QuadPart) / (double)Frequency->QuadPart;
+}
+
+static
+ULONG
+MaxCompressedSize(
+    _In_ const COMPRESS_ENGINE *Engine,
+    _In_ ULONG DataSize)
+{
+    switch (Engine->FormatAndEngine & 0xFF)
+    {
+        case COMPRESSION_FORMAT_LZNT1:
+            /* One stored chunk per 4 KB plus its header, and the terminator */
+            return DataSize + DataSize / 0x800 + 2;
+
+        case COMPRESSION_FORMAT_XPRESS:
+            /* Matches never take more bytes than they cover, plus one flag word per 32 literals */
+            return DataSize + DataSize / 8 + 4;
+
+        default:
+            /* No more than 9 bits per byte, as a flat code would give, plus the table
+               and bit stream padding of each 64 KB block */
+            return DataSize + DataSize / 8 + (DataSize / 0x10000 + 1) * (256 + 8);
+    }
+}
+
+static
+VOID
+TestRoundTrip(
+    _In_ const COMPRESS_ENGINE *Engine,
+    _In_ PCSTR DataName,
+    _In_ PUCHAR Data,
+    _In_ ULONG DataSize)
+{
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize;
+    ULONG CompressedSize, FinalSize, MaxSize;
+    PUCHAR WorkSpace, Compressed, Decompressed;
+    LARGE_INTEGER Frequency, Start, End;
+    double CompressTime, DecompressTime;
+    NTSTATUS Status;
+    ULONG i;
+
+    Status = RtlGetCompressionWorkSpaceSize(Engine->FormatAndEngine,
+                                            &WorkSpaceSize,
+                                            &FragmentWorkSpaceSize);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    MaxSize = MaxCompressedSize(Engine, DataSize);
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, WorkSpaceSize);
+    Compressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, MaxSize + 16);
+    Decompressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, DataSize);
+    if (!WorkSpace || !Compressed || !Decompressed)
+    {
+        skip("Out of memory\n");
+        goto Cleanup;
+    }
+
+    NtQueryPerformanceCounter(&Start, &Frequency);
+    for (i = 0; i < TEST_ITERATIONS; i++)
+    {
+        Status = RtlCompressBuffer(Engine->FormatAndEngine,
+                                   Data,
+                                   DataSize,
+                                   Compressed,
+                                   MaxSize + 16,
+                                   0x1000,
+                                   &CompressedSize,
+                                   WorkSpace);
+    }
+    NtQueryPerformanceCounter(&End, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        goto Cleanup;
+    ok(CompressedSize <= MaxSize,
+       "%s: compressed size %lu is larger than expected for %lu bytes\n",
+       Engine->Name, CompressedSize, DataSize);
+    CompressTime = ElapsedSeconds(&Start, &End, &Frequency);
+
+    NtQueryPerformanceCounter(&Start, NULL);
+    for (i = 0; i < TEST_ITERATIONS; i++)
+    {
+        RtlFillMemory(Decompressed, DataSize, 0x55);
+        Status = RtlDecompressBuffer(Engine->FormatAndEngine & 0xFF,
+                                     Decompressed,
+                                     DataSize,
+                                     Compressed,
+                                     CompressedSize,
+                                     &FinalSize);
+    }
+    NtQueryPerformanceCounter(&End, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_eq_ulong(FinalSize, DataSize);
+    ok(RtlCompareMemory(Decompressed, Data, DataSize) == DataSize,
+       "%s: round-trip mismatch for %s\n", Engine->Name, DataName);
+    DecompressTime = ElapsedSeconds(&Start, &End, &Frequency);
+
+    trace("%s, %s: %lu -> %lu bytes (%lu%%), compress %.1f MB/s, decompress %.1f MB/s\n",
+          Engine->Name, DataName, DataSize, CompressedSize,
+          (ULONG)((ULONGLONG)CompressedSize * 100 / DataSize),
+          CompressTime ? (double)DataSize * TEST_ITERATIONS / CompressTime / (1024 * 1024) : 0.0,
+          DecompressTime ? (double)DataSize * TEST_ITERATIONS / DecompressTime / (1024 * 1024) : 0.0);
+
+Cleanup:
+    if (Decompressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Decompressed);
+    if (Compressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Compressed);
+    if (WorkSpace) RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+START_TEST(RtlCompressBuffer)
+{
+    static const CHAR Text[] = "The quick brown fox jumps over the lazy dog. ";
+    PIMAGE_NT_HEADERS NtHeaders;
+    PUCHAR ImageBase, Buffer;
+    ULONG BufferSize, i, Seed = 0x12345678;
+
+    /* A loaded image is a good approximation of real file data */
+    ImageBase = (PUCHAR)GetModuleHandleW(L"ntdll.dll");
+    NtHeaders = RtlImageNtHeader(ImageBase);
+    ok(NtHeaders != NULL, "RtlImageNtHeader failed\n");
+    if (!NtHeaders)
+        return;
+
+    /* Text, random bytes and zeroes, one third each */
+    BufferSize = 3 * 0x10000;
+    Buffer = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (!Buffer)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+    for (i = 0; i < 0x10000; i++)
+        Buffer[i] = Text[i % (sizeof(Text) - 1)];
+    for (; i < 2 * 0x10000; i++)
+        Buffer[i] = (UCHAR)RtlRandom(&Seed);
+    RtlZeroMemory(Buffer + 2 * 0x10000, 0x10000);
+
+    for (i = 0; i < RTL_NUMBER_OF(Engines); i++)
+    {
+        TestRoundTrip(&Engines[i], "ntdll image", ImageBase, NtHeaders->OptionalHeader.SizeOfImage);
+        TestRoundTrip(&Engines[i], "mixed data", Buffer, BufferSize);
+    }
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
+}
@@ -267,6 +267,47 @@ MultiHeapFreeTest()
     TEST_FREE(3, -1, 0, HeapHandle, 0, 3, Array);
 }
 
+static void
+MultiHeapExactFitTest()
+{
+    HANDLE HeapHandle;
+    PVOID Before, After, Guard;
+    PVOID First[3] = {NULL, NULL, NULL};
+    PVOID Second[3] = {NULL, NULL, NULL};
+    INT ret;
+
+    HeapHandle = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(HeapHandle != NULL, "RtlCreateHeap failed\n");
+    if (!HeapHandle)
+        return;
+
+    // Leave a free block in the middle of the heap, just big enough for three
+    Before = RtlAllocateHeap(HeapHandle, 0, 24);
+    ret = g_alloc(HeapHandle, 0, 24, 3, First);
+    INT_EXPECTED(ret, 3);
+    After = RtlAllocateHeap(HeapHandle, 0, 24);
+    Guard = RtlAllocateHeap(HeapHandle, 0, 24);
+    ok(Before && After && Guard, "RtlAllocateHeap failed\n");
+    ret = g_free(HeapHandle, 0, 3, First);
+    INT_EXPECTED(ret, 3);
+
+    // The same three take it all, without anything left to split off
+    ret = g_alloc(HeapHandle, 0, 24, 3, Second);
+    INT_EXPECTED(ret, 3);
+    ok(Second[0] == First[0], "Second[0] is expected as %p, but %p\n", First[0], Second[0]);
+    ok(Second[2] == First[2], "Second[2] is expected as %p, but %p\n", First[2], Second[2]);
+
+    // Freeing the block after them must find the right one before it
+    ok(RtlFreeHeap(HeapHandle, 0, After), "RtlFreeHeap failed\n");
+    ok(RtlValidateHeap(HeapHandle, 0, NULL), "RtlValidateHeap failed\n");
+
+    ret = g_free(HeapHandle, 0, 3, Second);
+    INT_EXPECTED(ret, 3);
+    ok(RtlValidateHeap(HeapHandle, 0, NULL), "RtlValidateHeap failed\n");
+
+    RtlDestroyHeap(HeapHandle);
+}
+
 START_TEST(RtlMultipleAllocateHeap)
 {
     HINSTANCE ntdll = LoadLibraryA("ntdll");
@@ -282,6 +323,7 @@ START_TEST(RtlMultipleAllocateHeap)
     {
         MultiHeapAllocTest();
         MultiHeapFreeTest();
+        MultiHeapExactFitTest();
     }
 
     FreeLibrary(ntdll);
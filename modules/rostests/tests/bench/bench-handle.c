@@ -0,0 +1,82 @@
+/*
+ * Multi-threaded handle table benchmark.
+ *
+ * All threads duplicate the same event handle and close the copies again,
+ * which are plain NtDuplicateObject and NtClose calls, so they all allocate,
+ * look up and free entries of the process handle table. Each thread keeps a
+ * few copies open at once so that the table does not stay at a single entry.
+ * Reports the duplicate / close pairs per second for 1 thread up to the given
+ * count.
+ *
+ * Usage: bench-handle [max threads] [operations per thread]
+ */
+
+#include "bench.h"
+
+#define BATCH_SIZE  16
+
+static HANDLE SourceEvent;
+static DWORD Operations;
+
+static DWORD WINAPI BenchThread(LPVOID Param)
+{
+    HANDLE Handles[BATCH_SIZE];
+    DWORD i, j;
+
+    for (i = 0; i < Operations; i += BATCH_SIZE)
+    {
+        for (j = 0; j < BATCH_SIZE; j++)
+        {
+            if (!DuplicateHandle(GetCurrentProcess(), SourceEvent,
+                                 GetCurrentProcess(), &Handles[j],
+                                 0, FALSE, DUPLICATE_SAME_ACCESS))
+                Handles[j] = NULL;
+        }
+
+        for (j = 0; j < BATCH_SIZE; j++)
+        {
+            if (Handles[j])
+                CloseHandle(Handles[j]);
+        }
+    }
+
+    return 0;
+}
+
+static void Run(DWORD Count)
+{
+    double Seconds;
+
+    Seconds = BenchRunThreads(Count, BenchThread, NULL);
+    printf("%2lu threads: %.3f s, %.0f duplicate/close pairs/s\n",
+           Count, Seconds,
+           Seconds > 0 ? (double)Count * Operations / Seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD MaxThreads, Count;
+    SYSTEM_INFO SystemInfo;
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors * 2;
+    Operations = 1000000;
+
+    if (argc > 1) MaxThreads = strtoul(argv[1], NULL, 0);
+    if (argc > 2) Operations = strtoul(argv[2], NULL, 0);
+    if (!MaxThreads || MaxThreads > BENCH_MAX_THREADS || !Operations)
+    {
+        printf("Usage: %s [max threads (1 - %d)] [operations per thread]\n",
+               argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    printf("%lu processors\n", SystemInfo.dwNumberOfProcessors);
+
+    SourceEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    for (Count = 1; Count <= MaxThreads; Count *= 2)
+        Run(Count);
+
+    CloseHandle(SourceEvent);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Multi-threaded malloc / free benchmark.
+ *
+ * Each thread keeps a table of small blocks allocated with malloc (so through
+ * msvcrt and the process heap) and keeps replacing random entries of it,
+ * with random sizes. Some blocks are handed over to the next thread, which
+ * frees them, as producer / consumer code does. A handover only happens when
+ * the previous one was taken, so that the consumer really frees the blocks.
+ * Reports the operations per second for 1 thread up to the given count.
+ *
+ * Usage: bench-heap [max threads] [operations per thread]
+ */
+
+#include "bench.h"
+
+#define TABLE_SIZE  1024
+#define MAX_BLOCK   1024
+
+typedef struct _BENCH_THREAD
+{
+    DWORD Operations;
+    DWORD Seed;
+    void *volatile Handover;
+    struct _BENCH_THREAD *Next;
+    void *Table[TABLE_SIZE];
+} BENCH_THREAD;
+
+static BENCH_THREAD Threads[BENCH_MAX_THREADS];
+
+static DWORD Random(DWORD *Seed)
+{
+    *Seed = *Seed * 1103515245 + 12345;
+    return *Seed >> 8;
+}
+
+static DWORD WINAPI BenchThread(LPVOID Param)
+{
+    BENCH_THREAD *Thread = Param;
+    DWORD i, Slot;
+
+    for (i = 0; i < Thread->Operations; i++)
+    {
+        /* Free what the previous thread handed over to us */
+        if (Thread->Handover)
+            free(InterlockedExchangePointer((void **)&Thread->Handover, NULL));
+
+        Slot = Random(&Thread->Seed) % TABLE_SIZE;
+
+        /* Hand one block in 16 over, if the next thread took the last one */
+        if ((i & 15) != 0 || !Thread->Table[Slot] ||
+            InterlockedCompareExchangePointer((void **)&Thread->Next->Handover,
+                                              Thread->Table[Slot],
+                                              NULL) != NULL)
+        {
+            free(Thread->Table[Slot]);
+        }
+
+        Thread->Table[Slot] = malloc(Random(&Thread->Seed) % MAX_BLOCK + 1);
+        if (Thread->Table[Slot])
+            *(volatile char *)Thread->Table[Slot] = 0;
+    }
+
+    for (Slot = 0; Slot < TABLE_SIZE; Slot++)
+    {
+        free(Thread->Table[Slot]);
+        Thread->Table[Slot] = NULL;
+    }
+
+    return 0;
+}
+
+static void Run(DWORD Count, DWORD Operations)
+{
+    LPVOID Parameters[BENCH_MAX_THREADS];
+    double Seconds;
+    DWORD i;
+
+    for (i = 0; i < Count; i++)
+    {
+        Threads[i].Operations = Operations;
+        Threads[i].Seed = i + 1;
+        Threads[i].Next = &Threads[(i + 1) % Count];
+        Parameters[i] = &Threads[i];
+    }
+
+    Seconds = BenchRunThreads(Count, BenchThread, Parameters);
+
+    /* The last handovers come after their consumer was done */
+    for (i = 0; i < Count; i++)
+    {
+        free(Threads[i].Handover);
+        Threads[i].Handover = NULL;
+    }
+
+    printf("%2lu threads: %.3f s, %.0f operations/s\n", Count, Seconds,
+           Seconds > 0 ? (double)Count * Operations / Seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD MaxThreads, Operations = 1000000;
+    ULONG HeapType = 0;
+    SYSTEM_INFO SystemInfo;
+    DWORD Count;
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors * 2;
+
+    if (argc > 1) MaxThreads = strtoul(argv[1], NULL, 0);
+    if (argc > 2) Operations = strtoul(argv[2], NULL, 0);
+    if (!MaxThreads || MaxThreads > BENCH_MAX_THREADS || !Operations)
+    {
+        printf("Usage: %s [max threads (1 - %d)] [operations per thread]\n",
+               argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    HeapQueryInformation(GetProcessHeap(), HeapCompatibilityInformation,
+                         &HeapType, sizeof(HeapType), NULL);
+    printf("%lu processors, process heap front end %lu%s\n",
+           SystemInfo.dwNumberOfProcessors, HeapType,
+           HeapType == 2 ? " (LFH)" : "");
+
+    for (Count = 1; Count <= MaxThreads; Count *= 2)
+        Run(Count, Operations);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * File system path lookup and directory listing benchmark.
+ *
+ * Walks the given directory tree like "dir /s" does, remembering the
+ * deepest path that was found, then opens that path over and over so that
+ * every path component gets looked up again. Meant to be run on an NTFS
+ * volume to measure the file record and run list caches of the driver, the
+ * first pass is cold, the next ones are warm.
+ *
+ * Usage: bench-path <directory> [passes] [lookups]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+static WCHAR DeepestPath[MAX_PATH];
+static ULONG DeepestLevel;
+
+static double Elapsed(LARGE_INTEGER *Start)
+{
+    LARGE_INTEGER End, Frequency;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(End.QuadPart - Start->QuadPart) / (double)Frequency.QuadPart;
+}
+
+static ULONG Walk(WCHAR *Path, ULONG Level)
+{
+    WIN32_FIND_DATAW FindData;
+    HANDLE Find;
+    size_t Length = wcslen(Path);
+    ULONG Count = 0;
+
+    if (Length + 3 >= MAX_PATH)
+        return 0;
+
+    wcscpy(Path + Length, L"\\*");
+    Find = FindFirstFileW(Path, &FindData);
+    Path[Length] = 0;
+    if (Find == INVALID_HANDLE_VALUE)
+        return 0;
+
+    do
+    {
+        if (!wcscmp(FindData.cFileName, L".") || !wcscmp(FindData.cFileName, L".."))
+            continue;
+
+        Count++;
+        if (Length + 1 + wcslen(FindData.cFileName) >= MAX_PATH)
+            continue;
+
+        Path[Length] = L'\\';
+        wcscpy(Path + Length + 1, FindData.cFileName);
+
+        if (Level + 1 > DeepestLevel)
+        {
+            DeepestLevel = Level + 1;
+            wcscpy(DeepestPath, Path);
+        }
+
+        if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+            !(FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+        {
+            Count += Walk(Path, Level + 1);
+        }
+
+        Path[Length] = 0;
+    } while (FindNextFileW(Find, &FindData));
+
+    FindClose(Find);
+    return Count;
+}
+
+int wmain(int argc, WCHAR **argv)
+{
+    WCHAR Path[MAX_PATH];
+    LARGE_INTEGER Start;
+    ULONG Passes = 3, Lookups = 100000, Count, i;
+    double Seconds;
+    HANDLE File;
+
+    if (argc < 2 || wcslen(argv[1]) >= MAX_PATH)
+    {
+        printf("Usage: %S <directory> [passes] [lookups]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2) Passes = wcstoul(argv[2], NULL, 0);
+    if (argc > 3) Lookups = wcstoul(argv[3], NULL, 0);
+
+    for (i = 0; i < Passes; i++)
+    {
+        wcscpy(Path, argv[1]);
+        QueryPerformanceCounter(&Start);
+        Count = Walk(Path, 0);
+        Seconds = Elapsed(&Start);
+        printf("Listing pass %lu: %lu entries in %.3f s, %.0f entries/s\n", i + 1, Count, Seconds,
+               Seconds > 0 ? Count / Seconds : 0.0);
+    }
+
+    if (!DeepestLevel)
+    {
+        printf("Nothing found under %S\n", argv[1]);
+        return 1;
+    }
+
+    printf("Deepest path (%lu levels): %S\n", DeepestLevel, DeepestPath);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Lookups; i++)
+    {
+        File = CreateFileW(DeepestPath, FILE_READ_ATTRIBUTES,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (File == INVALID_HANDLE_VALUE)
+        {
+            printf("Failed to open %S: %lu\n", DeepestPath, GetLastError());
+            return 1;
+        }
+        CloseHandle(File);
+    }
+    Seconds = Elapsed(&Start);
+    printf("Path lookups: %lu in %.3f s, %.0f lookups/s\n", Lookups, Seconds,
+           Seconds > 0 ? Lookups / Seconds : 0.0);
+
+    return 0;
+}
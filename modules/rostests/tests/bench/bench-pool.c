@@ -0,0 +1,120 @@
+/*
+ * Multi-threaded kernel pool benchmark.
+ *
+ * Each thread keeps creating and closing unnamed event objects. Every object
+ * body is a small non-paged pool block, so this mostly measures the pool
+ * lookaside lists. The handle table entries come from pages that the handle
+ * table keeps, so they are not counted. With a non zero big size, each batch
+ * also reads a registry value of that size, which needs a big pool
+ * allocation in the kernel. Reports the allocations per second for 1 thread
+ * up to the given count.
+ *
+ * Usage: bench-pool [max threads] [iterations per thread] [big size]
+ */
+
+#include "bench.h"
+
+#define BATCH_SIZE  32
+
+static DWORD Iterations;
+static DWORD BigSize;
+static HKEY BigKey;
+
+static DWORD WINAPI BenchThread(LPVOID Param)
+{
+    HANDLE Events[BATCH_SIZE];
+    BYTE *Buffer = NULL;
+    DWORD i, j, Size;
+
+    if (BigSize)
+        Buffer = malloc(BigSize);
+
+    for (i = 0; i < Iterations; i += BATCH_SIZE)
+    {
+        /* Keep a few objects alive so that the lists are really used */
+        for (j = 0; j < BATCH_SIZE; j++)
+            Events[j] = CreateEventW(NULL, FALSE, FALSE, NULL);
+        for (j = 0; j < BATCH_SIZE; j++)
+        {
+            if (Events[j])
+                CloseHandle(Events[j]);
+        }
+
+        if (Buffer)
+        {
+            Size = BigSize;
+            RegQueryValueExW(BigKey, L"Data", NULL, NULL, Buffer, &Size);
+        }
+    }
+
+    free(Buffer);
+    return 0;
+}
+
+static void Run(DWORD Count)
+{
+    double Seconds, Allocations;
+
+    Seconds = BenchRunThreads(Count, BenchThread, NULL);
+
+    /* One allocation for each object body, and one more per batch for the
+       big block */
+    Allocations = (double)Count * Iterations;
+    if (BigSize)
+        Allocations += (double)Count * Iterations / BATCH_SIZE;
+
+    printf("%2lu threads: %.3f s, %.0f allocations/s, %.0f per thread\n", Count, Seconds,
+           Seconds > 0 ? Allocations / Seconds : 0.0,
+           Seconds > 0 ? Allocations / Seconds / Count : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD MaxThreads, Count;
+    SYSTEM_INFO SystemInfo;
+    BYTE *Data;
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors * 2;
+    Iterations = 1000000;
+
+    if (argc > 1) MaxThreads = strtoul(argv[1], NULL, 0);
+    if (argc > 2) Iterations = strtoul(argv[2], NULL, 0);
+    if (argc > 3) BigSize = strtoul(argv[3], NULL, 0);
+    if (!MaxThreads || MaxThreads > BENCH_MAX_THREADS || !Iterations)
+    {
+        printf("Usage: %s [max threads (1 - %d)] [iterations per thread] [big size]\n", argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    if (BigSize)
+    {
+        /* Keep the value in a volatile key, it goes away on reboot anyway */
+        if (RegCreateKeyExW(HKEY_CURRENT_USER, L"Software\\ReactOS\\bench-pool", 0, NULL,
+                            REG_OPTION_VOLATILE, KEY_ALL_ACCESS, NULL, &BigKey, NULL))
+        {
+            printf("Failed to create the registry key\n");
+            return 1;
+        }
+
+        Data = calloc(1, BigSize);
+        if (!Data || RegSetValueExW(BigKey, L"Data", 0, REG_BINARY, Data, BigSize))
+        {
+            printf("Failed to set the registry value\n");
+            return 1;
+        }
+        free(Data);
+    }
+
+    printf("%lu processors, big size %lu\n", SystemInfo.dwNumberOfProcessors, BigSize);
+
+    for (Count = 1; Count <= MaxThreads; Count *= 2)
+        Run(Count);
+
+    if (BigKey)
+    {
+        RegCloseKey(BigKey);
+        RegDeleteKeyW(HKEY_CURRENT_USER, L"Software\\ReactOS\\bench-pool");
+    }
+    return 0;
+}
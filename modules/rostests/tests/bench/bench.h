@@ -0,0 +1,67 @@
+/*
+ * Helpers shared by the multi-threaded benchmarks.
+ *
+ * BenchRunThreads() starts the given number of threads, releases them all
+ * at once and returns how long it took until the last one was done, so that
+ * thread creation is not part of the measurement.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#define BENCH_MAX_THREADS 64
+
+typedef struct _BENCH_START
+{
+    LPTHREAD_START_ROUTINE Routine;
+    LPVOID Parameter;
+} BENCH_START;
+
+static HANDLE BenchStartEvent;
+static BENCH_START BenchStart[BENCH_MAX_THREADS];
+
+static DWORD WINAPI BenchThreadStart(LPVOID Param)
+{
+    BENCH_START *Start = Param;
+
+    WaitForSingleObject(BenchStartEvent, INFINITE);
+    return Start->Routine(Start->Parameter);
+}
+
+/* Parameters is either NULL or holds one parameter per thread */
+static double BenchRunThreads(DWORD Count, LPTHREAD_START_ROUTINE Routine, LPVOID *Parameters)
+{
+    HANDLE Handles[BENCH_MAX_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    DWORD i;
+
+    if (!BenchStartEvent)
+        BenchStartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    ResetEvent(BenchStartEvent);
+    for (i = 0; i < Count; i++)
+    {
+        BenchStart[i].Routine = Routine;
+        BenchStart[i].Parameter = Parameters ? Parameters[i] : NULL;
+        Handles[i] = CreateThread(NULL, 0, BenchThreadStart, &BenchStart[i], 0, NULL);
+        if (!Handles[i])
+        {
+            printf("Failed to create thread %lu: %lu\n", i, GetLastError());
+            exit(1);
+        }
+    }
+
+    QueryPerformanceCounter(&Start);
+    SetEvent(BenchStartEvent);
+    WaitForMultipleObjects(Count, Handles, TRUE, INFINITE);
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+
+    for (i = 0; i < Count; i++)
+        CloseHandle(Handles[i]);
+
+    return (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+}
@@ -150,7 +150,7 @@ CcRemapBcb (
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
@@ -161,7 +161,10 @@ CcScheduleReadAhead (
 	)
 {
     KIRQL OldIrql;
-    LARGE_INTEGER NewOffset;
+    LONGLONG ReadEnd, Prefetched, NewEnd;
+    LONGLONG Granularity;
+    ULONG Window;
+    BOOLEAN Sequential;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
 
@@ -175,47 +178,80 @@ CcScheduleReadAhead (
         return;
     }
 
-    /* Round read length with read ahead mask */
-    Length = ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1);
-    /* Compute the offset we'll reach */
-    NewOffset.QuadPart = FileOffset->QuadPart + Length;
+    Granularity = (LONGLONG)PrivateCacheMap->ReadAheadMask + 1;
+    ReadEnd = FileOffset->QuadPart + Length;
 
     /* Lock read ahead spin lock */
     KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-    /* Easy case: the file is sequentially read */
-    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+
+    /* Keep track of the last two reads */
+    PrivateCacheMap->FileOffset1.QuadPart = PrivateCacheMap->FileOffset2.QuadPart;
+    PrivateCacheMap->BeyondLastByte1.QuadPart = PrivateCacheMap->BeyondLastByte2.QuadPart;
+    PrivateCacheMap->FileOffset2.QuadPart = FileOffset->QuadPart;
+    PrivateCacheMap->BeyondLastByte2.QuadPart = ReadEnd;
+
+    /* The stream is sequential if this read starts, within the read ahead
+     * granularity, where the previous one ended */
+    Sequential = BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY) ||
+                 (FileOffset->QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
+                  FileOffset->QuadPart <= ROUND_UP(PrivateCacheMap->BeyondLastByte1.QuadPart, Granularity));
+
+    Window = max(PrivateCacheMap->ReadAheadLength[0], CC_READ_AHEAD_MIN_WINDOW);
+
+    if (!Sequential)
+    {
+        /* Lost the stream: shrink the window, and forget what was read ahead */
+        PrivateCacheMap->ReadAheadLength[0] = max(Window / 2, CC_READ_AHEAD_MIN_WINDOW);
+        PrivateCacheMap->ReadAheadOffset[0].QuadPart = 0;
+        InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ENABLED);
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
+    }
+
+    InterlockedOr((volatile long *)&PrivateCacheMap->UlongFlags, PRIVATE_CACHE_MAP_READ_AHEAD_ENABLED);
+
+    /* ReadAheadOffset[0] is where the data already requested ends */
+    Prefetched = PrivateCacheMap->ReadAheadOffset[0].QuadPart;
+    if (ReadEnd > Prefetched)
     {
-        /* If we went backward, this is no go! */
-        if (NewOffset.QuadPart < PrivateCacheMap->ReadAheadOffset[1].QuadPart)
+        /* The reader caught up with read ahead, it needs a larger window */
+        if (Prefetched != 0)
         {
-            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            return;
+            Window = min(Window * 2, CC_READ_AHEAD_MAX_WINDOW);
         }
+        Prefetched = ROUND_UP(ReadEnd, Granularity);
+    }
+    else if (Prefetched - ReadEnd > Window / 2)
+    {
+        /* Read ahead hit, and there is enough data ahead of the reader yet */
+        PrivateCacheMap->ReadAheadLength[0] = Window;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
+    }
 
-        /* FIXME: hackish, but will do the job for now */
-        PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-        PrivateCacheMap->ReadAheadLength[1] = Length;
+    /* Keep a whole window ahead of the reader */
+    NewEnd = ROUND_UP(ReadEnd + Window, Granularity);
+    if (NewEnd <= Prefetched)
+    {
+        PrivateCacheMap->ReadAheadLength[0] = Window;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
+    }
+
+    PrivateCacheMap->ReadAheadLength[0] = Window;
+    PrivateCacheMap->ReadAheadOffset[0].QuadPart = NewEnd;
+
+    /* ReadAheadOffset[1] is the range pending for the worker. Extend it
+     * if it is contiguous, otherwise replace it */
+    if (PrivateCacheMap->ReadAheadLength[1] != 0 &&
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart + PrivateCacheMap->ReadAheadLength[1] == Prefetched)
+    {
+        PrivateCacheMap->ReadAheadLength[1] = (ULONG)(NewEnd - PrivateCacheMap->ReadAheadOffset[1].QuadPart);
     }
-    /* Other cases: try to find some logic in that mess... */
     else
     {
-        /* Let's check if we always read the same way (like going down in the file)
-         * and pretend it's enough for now
-         */
-        if (PrivateCacheMap->FileOffset2.QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
-            FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart)
-        {
-            /* FIXME: hackish, but will do the job for now */
-            PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-            PrivateCacheMap->ReadAheadLength[1] = Length;
-        }
-        else
-        {
-            /* FIXME: handle the other cases */
-            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            UNIMPLEMENTED_ONCE;
-            return;
-        }
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart = Prefetched;
+        PrivateCacheMap->ReadAheadLength[1] = (ULONG)(NewEnd - Prefetched);
     }
 
     /* If read ahead isn't active yet */
@@ -251,7 +287,7 @@ CcScheduleReadAhead (
         InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
     }
 
-    /* Done (fail) */
+    /* Done: either read ahead is already running and will pick up the new range, or we failed */
     KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
 }
 
@@ -140,6 +140,7 @@ CcPerformReadAhead(
     PPRIVATE_CACHE_MAP PrivateCacheMap;
     BOOLEAN Locked;
     BOOLEAN Success;
+    BOOLEAN Completed = FALSE;
 
     SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
 
@@ -164,6 +165,8 @@ CcPerformReadAhead(
         KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
         CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
         Length = PrivateCacheMap->ReadAheadLength[1];
+        /* We own that range now */
+        PrivateCacheMap->ReadAheadLength[1] = 0;
         KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
     }
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
@@ -180,6 +183,7 @@ CcPerformReadAhead(
     /* Remember it's locked */
     Locked = TRUE;
 
+Next:
     /* Don't read past the end of the file */
     if (CurrentOffset >= SharedCacheMap->FileSize.QuadPart)
     {
@@ -267,14 +271,31 @@ CcPerformReadAhead(
         CurrentOffset += PartialLength;
     }
 
+    /* The whole range was read, the reader may have asked for more meanwhile */
+    Completed = TRUE;
+
 Clear:
     /* See previous comment about private cache map */
     OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
     PrivateCacheMap = FileObject->PrivateCacheMap;
     if (PrivateCacheMap != NULL)
     {
-        /* Mark read ahead as unactive */
         KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+
+        /* Go on with the next range while we hold the file */
+        if (Completed && PrivateCacheMap->ReadAheadLength[1] != 0)
+        {
+            CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
+            Length = PrivateCacheMap->ReadAheadLength[1];
+            PrivateCacheMap->ReadAheadLength[1] = 0;
+            KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+
+            Completed = FALSE;
+            goto Next;
+        }
+
+        /* Mark read ahead as unactive */
         InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
         KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
     }
@@ -559,28 +580,12 @@ CcCopyRead (
     IoStatus->Status = STATUS_SUCCESS;
     IoStatus->Information = ReadLength;
 
-#if 0
-    /* If that was a successful sync read operation, let's handle read ahead */
-    if (Length == 0 && Wait)
+    /* Unless the caller told us otherwise, feed the read ahead engine with
+     * this read, it will detect sequential streams and prefetch ahead of them */
+    if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
     {
-        PPRIVATE_CACHE_MAP PrivateCacheMap = FileObject->PrivateCacheMap;
-
-        /* If file isn't random access and next read may get us cross VACB boundary,
-         * schedule next read
-         */
-        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS) &&
-            (CurrentOffset - 1) / VACB_MAPPING_GRANULARITY != (CurrentOffset + ReadLength - 1) / VACB_MAPPING_GRANULARITY)
-        {
-            CcScheduleReadAhead(FileObject, FileOffset, ReadLength);
-        }
-
-        /* And update read history in private cache map */
-        PrivateCacheMap->FileOffset1.QuadPart = PrivateCacheMap->FileOffset2.QuadPart;
-        PrivateCacheMap->BeyondLastByte1.QuadPart = PrivateCacheMap->BeyondLastByte2.QuadPart;
-        PrivateCacheMap->FileOffset2.QuadPart = FileOffset->QuadPart;
-        PrivateCacheMap->BeyondLastByte2.QuadPart = FileOffset->QuadPart + ReadLength;
+        CcScheduleReadAhead(FileObject, FileOffset, ReadLength);
     }
-#endif
 
     return TRUE;
 }
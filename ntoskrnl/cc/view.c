@@ -112,6 +112,97 @@ ULONG CcRosVacbGetRefCount_(PROS_VACB vacb, PCSTR file, INT line)
 
 /* FUNCTIONS *****************************************************************/
 
+/*
+ * Returns the slot of the VACB index holding the VACB for the given
+ * VACB_MAPPING_GRANULARITY index, or NULL if it doesn't exist (or couldn't be
+ * allocated). Must be called with the CacheMapLock held.
+ */
+static
+PVOID *
+CcRosVacbIndexSlot(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    ULONGLONG Index,
+    BOOLEAN Allocate)
+{
+    PVOID *Table;
+    PVOID *Slot;
+    ULONG Level;
+
+    /* Grow the index on top until it covers this entry */
+    while (SharedCacheMap->VacbIndexDepth == 0 ||
+           (Index >> (VACB_INDEX_LEVEL_SHIFT * SharedCacheMap->VacbIndexDepth)) != 0)
+    {
+        if (!Allocate)
+            return NULL;
+
+        Table = ExAllocatePoolZero(NonPagedPool, VACB_INDEX_LEVEL_SIZE * sizeof(PVOID), TAG_VACB_INDEX);
+        if (Table == NULL)
+            return NULL;
+
+        Table[0] = SharedCacheMap->VacbIndex;
+        SharedCacheMap->VacbIndex = Table;
+        SharedCacheMap->VacbIndexDepth++;
+    }
+
+    Table = SharedCacheMap->VacbIndex;
+    for (Level = SharedCacheMap->VacbIndexDepth - 1; Level > 0; Level--)
+    {
+        Slot = &Table[(Index >> (VACB_INDEX_LEVEL_SHIFT * Level)) & (VACB_INDEX_LEVEL_SIZE - 1)];
+        if (*Slot == NULL)
+        {
+            if (!Allocate)
+                return NULL;
+
+            *Slot = ExAllocatePoolZero(NonPagedPool, VACB_INDEX_LEVEL_SIZE * sizeof(PVOID), TAG_VACB_INDEX);
+            if (*Slot == NULL)
+                return NULL;
+        }
+        Table = *Slot;
+    }
+
+    return &Table[Index & (VACB_INDEX_LEVEL_SIZE - 1)];
+}
+
+VOID
+CcRosVacbIndexRemove(
+    PROS_VACB Vacb)
+/*
+ * FUNCTION: Unlinks a VACB from the index of its shared cache map.
+ * The CacheMapLock must be held.
+ */
+{
+    PVOID *Slot;
+
+    Slot = CcRosVacbIndexSlot(Vacb->SharedCacheMap,
+                              Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY,
+                              FALSE);
+    ASSERT(Slot != NULL && *Slot == Vacb);
+    if (Slot != NULL)
+        *Slot = NULL;
+}
+
+static
+VOID
+CcRosFreeVacbIndex(
+    PVOID *Table,
+    ULONG Level)
+{
+    ULONG i;
+
+    if (Table == NULL)
+        return;
+
+    if (Level > 0)
+    {
+        for (i = 0; i < VACB_INDEX_LEVEL_SIZE; i++)
+        {
+            CcRosFreeVacbIndex(Table[i], Level - 1);
+        }
+    }
+
+    ExFreePoolWithTag(Table, TAG_VACB_INDEX);
+}
+
 VOID
 CcRosTraceCacheMap (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
@@ -247,6 +338,10 @@ CcRosDeleteFileCache (
     KeReleaseQueuedSpinLock(LockQueueMasterLock, *OldIrql);
 
     /* Now that we're out of the locks, free everything for real */
+    CcRosFreeVacbIndex(SharedCacheMap->VacbIndex, SharedCacheMap->VacbIndexDepth - 1);
+    SharedCacheMap->VacbIndex = NULL;
+    SharedCacheMap->VacbIndexDepth = 0;
+
     while (!IsListEmpty(&SharedCacheMap->CacheMapVacbListHead))
     {
         PROS_VACB Vacb = CONTAINING_RECORD(RemoveHeadList(&SharedCacheMap->CacheMapVacbListHead), ROS_VACB, CacheMapVacbListEntry);
@@ -519,6 +614,7 @@ retry:
             ASSERT(!current->MappedCount);
             ASSERT(Refs == 1);
 
+            CcRosVacbIndexRemove(current);
             RemoveEntryList(&current->CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
@@ -601,48 +697,41 @@ CcRosReleaseVacb (
     return STATUS_SUCCESS;
 }
 
-/* Returns with VACB Lock Held! */
+/* Returns a referenced VACB, or NULL if the offset is not mapped yet */
 PROS_VACB
 CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
-    PROS_VACB current;
+    PVOID *Slot;
+    PROS_VACB current = NULL;
     KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
+    ASSERT(FileOffset >= 0);
 
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    /* VACBs only enter and leave the index with the CacheMapLock held,
+     * so there is no need for the master lock here */
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    SharedCacheMap->VacbIndexLookups++;
+    Slot = CcRosVacbIndexSlot(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY, FALSE);
+    if (Slot != NULL && *Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        current = *Slot;
+        ASSERT(IsPointInRange(current->FileOffset.QuadPart,
+                              VACB_MAPPING_GRANULARITY,
+                              FileOffset));
+        CcRosVacbIncRefCount(current);
+        SharedCacheMap->VacbIndexHits++;
     }
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-    return NULL;
+    return current;
 }
 
 VOID
@@ -748,6 +837,7 @@ CcRosFreeOneUnusedVacb(
             ASSERT(Refs == 1);
 
             /* Reset it, this is the one we want to free */
+            CcRosVacbIndexRemove(current);
             RemoveEntryList(&current->CacheMapVacbListEntry);
             InitializeListHead(&current->CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
@@ -785,6 +875,7 @@ CcRosCreateVacb (
     PROS_VACB current;
     PROS_VACB previous;
     PLIST_ENTRY current_entry;
+    PVOID *Slot;
     NTSTATUS Status;
     KIRQL oldIrql;
     ULONG Refs;
@@ -845,56 +936,57 @@ CcRosCreateVacb (
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosVacbIndexSlot(SharedCacheMap, FileOffset / VACB_MAPPING_GRANULARITY, TRUE);
+    if (Slot == NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-#if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
-#endif
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-            Refs = CcRosVacbDecRefCount(*Vacb);
-            ASSERT(Refs == 0);
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
 
-            *Vacb = current;
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
+        *Vacb = NULL;
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    if (*Slot != NULL)
+    {
+        current = *Slot;
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+#if DBG
+        if (SharedCacheMap->Trace)
         {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
         }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+#endif
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
+
+        *Vacb = current;
+        return STATUS_SUCCESS;
     }
-    /* There was no existing VACB. */
+
+    /* There was no existing VACB. Keep the list sorted by offset, walking
+     * it backwards since files are mostly mapped sequentially */
     current = *Vacb;
-    if (previous)
-    {
-        InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
-    }
-    else
+    *Slot = current;
+    current_entry = SharedCacheMap->CacheMapVacbListHead.Blink;
+    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
     {
-        InsertHeadList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
+        previous = CONTAINING_RECORD(current_entry,
+                                     ROS_VACB,
+                                     CacheMapVacbListEntry);
+        if (previous->FileOffset.QuadPart < current->FileOffset.QuadPart)
+            break;
+        current_entry = current_entry->Blink;
     }
+    InsertHeadList(current_entry, &current->CacheMapVacbListEntry);
     KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
     InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
 
@@ -1492,14 +1584,14 @@ ExpKdbgExtFileCache(ULONG Argc, PCHAR Argv[])
     UNICODE_STRING NoName = RTL_CONSTANT_STRING(L"No name for File");
 
     KdbpPrint("  Usage Summary (in kb)\n");
-    KdbpPrint("Shared\t\tMapped\tDirty\tName\n");
+    KdbpPrint("Shared\t\tMapped\tDirty\tDepth\tHits\tName\n");
     /* No need to lock the spin lock here, we're in DBG */
     for (ListEntry = CcCleanSharedCacheMapList.Flink;
          ListEntry != &CcCleanSharedCacheMapList;
          ListEntry = ListEntry->Flink)
     {
         PLIST_ENTRY Vacbs;
-        ULONG Mapped = 0, Dirty = 0;
+        ULONG Mapped = 0, Dirty = 0, HitRate = 0;
         PROS_SHARED_CACHE_MAP SharedCacheMap;
         PUNICODE_STRING FileName;
         PWSTR Extra = L"";
@@ -1517,6 +1609,13 @@ ExpKdbgExtFileCache(ULONG Argc, PCHAR Argv[])
             Mapped += VACB_MAPPING_GRANULARITY / 1024;
         }
 
+        /* Index lookups hit rate */
+        if (SharedCacheMap->VacbIndexLookups != 0)
+        {
+            HitRate = (ULONG)(((ULONGLONG)SharedCacheMap->VacbIndexHits * 100) /
+                              SharedCacheMap->VacbIndexLookups);
+        }
+
         /* Setup name */
         if (SharedCacheMap->FileObject != NULL &&
             SharedCacheMap->FileObject->FileName.Length != 0)
@@ -1538,7 +1637,8 @@ ExpKdbgExtFileCache(ULONG Argc, PCHAR Argv[])
         }
 
         /* And print */
-        KdbpPrint("%p\t%d\t%d\t%wZ%S\n", SharedCacheMap, Mapped, Dirty, FileName, Extra);
+        KdbpPrint("%p\t%d\t%d\t%lu\t%lu%%\t%wZ%S\n", SharedCacheMap, Mapped, Dirty,
+                  SharedCacheMap->VacbIndexDepth, HitRate, FileName, Extra);
     }
 
     return TRUE;
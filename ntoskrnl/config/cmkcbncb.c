@@ -492,6 +492,9 @@ CmpCleanUpKcbCacheWithLock(IN PCM_KEY_CONTROL_BLOCK Kcb,
     /* Check if we have an index hint block and free it */
     if (Kcb->ExtFlags & CM_KCB_SUBKEY_HINT) CmpFree(Kcb->IndexHint, 0);
 
+    /* Same for the subkey hash cache */
+    if (Kcb->SubKeyCache) CmpFree(Kcb->SubKeyCache, 0);
+
     /* Check if we were already deleted */
     Parent = Kcb->ParentKcb;
     if (!Kcb->Delete) CmpRemoveKeyControlBlock(Kcb);
@@ -535,6 +538,13 @@ CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
         Kcb->ExtFlags &= ~(CM_KCB_NO_SUBKEY | CM_KCB_SUBKEY_ONE | CM_KCB_SUBKEY_HINT);
     }
 
+    /* The subkeys changed, so the hash cache has to be rebuilt */
+    if (Kcb->SubKeyCache)
+    {
+        CmpFree(Kcb->SubKeyCache, 0);
+        Kcb->SubKeyCache = NULL;
+    }
+
     /* Check if there's no linked cell */
     if (Kcb->KeyCell == HCELL_NIL)
     {
@@ -566,6 +576,205 @@ CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
     }
 }
 
+static
+ULONG
+CmpComputeNodeHashKey(IN PCM_KEY_NODE Node)
+{
+    UNICODE_STRING KeyName;
+    ULONG Hash = 0, i;
+
+    /* Uncompressed names can be hashed as they are */
+    if (!(Node->Flags & KEY_COMP_NAME))
+    {
+        KeyName.Buffer = Node->Name;
+        KeyName.Length = Node->NameLength;
+        KeyName.MaximumLength = KeyName.Length;
+        return CmpComputeHashKey(0, &KeyName, FALSE);
+    }
+
+    /* Same as CmpComputeHashKey, one byte per character */
+    for (i = 0; i < Node->NameLength; i++)
+    {
+        Hash = 37 * Hash + RtlUpcaseUnicodeChar(((PUCHAR)Node->Name)[i]);
+    }
+
+    return Hash;
+}
+
+static
+BOOLEAN
+CmpAddLeafToSubKeyCache(IN PHHIVE Hive,
+                        IN PCM_SUBKEY_HASH_CACHE Cache,
+                        IN PCM_KEY_INDEX Leaf)
+{
+    PCM_KEY_FAST_INDEX FastIndex = (PCM_KEY_FAST_INDEX)Leaf;
+    PCM_KEY_NODE Node;
+    HCELL_INDEX Cell;
+    ULONG HashKey, i, j;
+
+    for (i = 0; i < Leaf->Count; i++)
+    {
+        if (Leaf->Signature == CM_KEY_HASH_LEAF)
+        {
+            /* Hash leaves already have what we need */
+            Cell = FastIndex->List[i].Cell;
+            HashKey = FastIndex->List[i].HashKey;
+        }
+        else
+        {
+            /* Otherwise hash the name of the subkey */
+            Cell = (Leaf->Signature == CM_KEY_FAST_LEAF) ?
+                   FastIndex->List[i].Cell : Leaf->List[i];
+
+            Node = (PCM_KEY_NODE)HvGetCell(Hive, Cell);
+            if (!Node) return FALSE;
+            HashKey = CmpComputeNodeHashKey(Node);
+            HvReleaseCell(Hive, Cell);
+        }
+
+        /* Insert it in the first free slot */
+        for (j = HashKey & Cache->Mask;
+             Cache->Table[j].Cell != HCELL_NIL;
+             j = (j + 1) & Cache->Mask);
+
+        Cache->Table[j].HashKey = HashKey;
+        Cache->Table[j].Cell = Cell;
+    }
+
+    return TRUE;
+}
+
+static
+PCM_SUBKEY_HASH_CACHE
+CmpBuildSubKeyCache(IN PHHIVE Hive,
+                    IN PCM_KEY_NODE Node)
+{
+    PCM_SUBKEY_HASH_CACHE Cache;
+    PCM_KEY_INDEX Index, Leaf;
+    ULONG Size, Type, i;
+    BOOLEAN Success = TRUE;
+
+    /* Keep the table at most half full */
+    for (Size = 16;
+         Size < 2 * (Node->SubKeyCounts[Stable] + Node->SubKeyCounts[Volatile]);
+         Size *= 2);
+
+    Cache = CmpAllocate(FIELD_OFFSET(CM_SUBKEY_HASH_CACHE, Table) +
+                        Size * sizeof(CM_SUBKEY_HASH_ENTRY),
+                        TRUE,
+                        TAG_CM);
+    if (!Cache) return NULL;
+
+    Cache->Mask = Size - 1;
+    for (i = 0; i < Size; i++) Cache->Table[i].Cell = HCELL_NIL;
+
+    for (Type = 0; Type < HTYPE_COUNT; Type++)
+    {
+        /* Remember which index this was built from */
+        Cache->SubKeyLists[Type] = Node->SubKeyLists[Type];
+        Cache->SubKeyCounts[Type] = Node->SubKeyCounts[Type];
+
+        if ((Type >= Hive->StorageTypeCount) || !Node->SubKeyCounts[Type]) continue;
+
+        Index = (PCM_KEY_INDEX)HvGetCell(Hive, Node->SubKeyLists[Type]);
+        if (!Index)
+        {
+            Success = FALSE;
+            break;
+        }
+
+        if (Index->Signature == CM_KEY_INDEX_ROOT)
+        {
+            /* Add every leaf of the root */
+            for (i = 0; Success && (i < Index->Count); i++)
+            {
+                Leaf = (PCM_KEY_INDEX)HvGetCell(Hive, Index->List[i]);
+                if (!Leaf)
+                {
+                    Success = FALSE;
+                    break;
+                }
+
+                Success = CmpAddLeafToSubKeyCache(Hive, Cache, Leaf);
+                HvReleaseCell(Hive, Index->List[i]);
+            }
+        }
+        else
+        {
+            Success = CmpAddLeafToSubKeyCache(Hive, Cache, Index);
+        }
+
+        HvReleaseCell(Hive, Node->SubKeyLists[Type]);
+        if (!Success) break;
+    }
+
+    if (!Success)
+    {
+        CmpFree(Cache, 0);
+        return NULL;
+    }
+
+    return Cache;
+}
+
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithCache(IN PCM_KEY_CONTROL_BLOCK Kcb,
+                             IN PCM_KEY_NODE Node,
+                             IN PCUNICODE_STRING SearchName)
+{
+    PCM_SUBKEY_HASH_CACHE Cache, OldCache;
+    PHHIVE Hive = Kcb->KeyHive;
+    ULONG HashKey, Type, i;
+
+    /* Small keys aren't worth it, their index is searched quickly enough */
+    if ((Node->SubKeyCounts[Stable] + Node->SubKeyCounts[Volatile]) < CMP_SUBKEY_CACHE_MIN_COUNT)
+    {
+        return CmpFindSubKeyByName(Hive, Node, SearchName);
+    }
+
+    Cache = Kcb->SubKeyCache;
+    if (!Cache)
+    {
+        /* Build it from the index, we might only hold the KCB lock shared */
+        Cache = CmpBuildSubKeyCache(Hive, Node);
+        if (!Cache) return CmpFindSubKeyByName(Hive, Node, SearchName);
+
+        /* Somebody else might have been faster, use theirs then */
+        OldCache = InterlockedCompareExchangePointer((PVOID*)&Kcb->SubKeyCache, Cache, NULL);
+        if (OldCache)
+        {
+            CmpFree(Cache, 0);
+            Cache = OldCache;
+        }
+    }
+
+    /* Don't trust it if the index changed behind our back */
+    for (Type = 0; Type < HTYPE_COUNT; Type++)
+    {
+        if ((Cache->SubKeyLists[Type] != Node->SubKeyLists[Type]) ||
+            (Cache->SubKeyCounts[Type] != Node->SubKeyCounts[Type]))
+        {
+            return CmpFindSubKeyByName(Hive, Node, SearchName);
+        }
+    }
+
+    /* Walk the chain of this hash until an empty slot */
+    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
+    for (i = HashKey & Cache->Mask;
+         Cache->Table[i].Cell != HCELL_NIL;
+         i = (i + 1) & Cache->Mask)
+    {
+        if ((Cache->Table[i].HashKey == HashKey) &&
+            !CmpDoCompareKeyName(Hive, SearchName, Cache->Table[i].Cell))
+        {
+            return Cache->Table[i].Cell;
+        }
+    }
+
+    return HCELL_NIL;
+}
+
 VOID
 NTAPI
 CmpDereferenceKeyControlBlock(IN PCM_KEY_CONTROL_BLOCK Kcb)
@@ -724,6 +933,7 @@ CmpCreateKeyControlBlock(IN PHHIVE Hive,
     Kcb->ConvKey = ConvKey;
     Kcb->DelayedCloseIndex = CmpDelayedCloseSize;
     Kcb->InDelayClose = 0;
+    Kcb->SubKeyCache = NULL;
     ASSERT_KCB_VALID(Kcb);
 
     /* Check if we have two hash entires */
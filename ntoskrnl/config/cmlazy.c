@@ -26,6 +26,14 @@ static ULONG CmpLazyFlushHiveCount = 7;
 ULONG CmpLazyFlushCount = 1;
 LONG CmpFlushStarveWriters;
 
+/* Dirty blocks after which the lazy flusher is triggered early (1 MB) */
+ULONG CmpLazyFlushDirtyThreshold = 256;
+static ULONG CmpLazyFlushVolumeIntervalInSeconds = 1;
+static LONG CmpLazyFlushDirtyBlocks;
+
+/* 0: timer idle, 1: armed with the regular interval, 2: armed early because of the dirty volume */
+static LONG CmpLazyFlushTimerState;
+
 /* FUNCTIONS ******************************************************************/
 
 BOOLEAN
@@ -34,7 +42,6 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                    _Out_ PBOOLEAN Error,
                    _Out_ PULONG DirtyCount)
 {
-    NTSTATUS Status;
     PLIST_ENTRY NextEntry;
     PCMHIVE CmHive;
     BOOLEAN Result;
@@ -79,12 +86,11 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                 /* Do the sync */
                 DPRINT("Flushing: %wZ\n", &CmHive->FileFullPath);
                 DPRINT("Handle: %p\n", CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
-                Status = HvSyncHive(&CmHive->Hive);
-                if(!NT_SUCCESS(Status))
+                if (!HvSyncHive(&CmHive->Hive))
                 {
                     /* Let them know we failed */
-                    DPRINT1("Failed to flush %wZ on handle %p (status 0x%08lx)\n",
-                        &CmHive->FileFullPath,  CmHive->FileHandles[HFILE_TYPE_PRIMARY], Status);
+                    DPRINT1("Failed to flush %wZ on handle %p\n",
+                        &CmHive->FileFullPath, CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
                     *Error = TRUE;
                     Result = FALSE;
                     break;
@@ -143,6 +149,9 @@ CmpLazyFlushDpcRoutine(IN PKDPC Dpc,
                        IN PVOID SystemArgument1,
                        IN PVOID SystemArgument2)
 {
+    /* The timer has expired, the next dirty cell arms it again */
+    InterlockedExchange(&CmpLazyFlushTimerState, 0);
+
     /* Check if we should queue the lazy flush worker */
     DPRINT("Flush pending: %s, Holding lazy flush: %s.\n", CmpLazyFlushPending ? "yes" : "no", CmpHoldLazyFlush ? "yes" : "no");
     if (!CmpLazyFlushPending && !CmpHoldLazyFlush)
@@ -162,13 +171,43 @@ CmpLazyFlush(VOID)
     /* Check if we should set the lazy flush timer */
     if (!CmpNoWrite && !CmpHoldLazyFlush)
     {
-        /* Do it */
-        DueTime.QuadPart = Int32x32To64(CmpLazyFlushIntervalInSeconds,
-                                        -10 * 1000 * 1000);
-        KeSetTimer(&CmpLazyFlushTimer, DueTime, &CmpLazyFlushDpc);
+        /*
+         * Don't push back an armed timer: with a steady stream of
+         * registry writes the flush would otherwise never happen.
+         * If a lot of data became dirty, bring the flush closer.
+         */
+        if ((ULONG)CmpLazyFlushDirtyBlocks >= CmpLazyFlushDirtyThreshold)
+        {
+            if (InterlockedExchange(&CmpLazyFlushTimerState, 2) != 2)
+            {
+                InterlockedIncrement((PLONG)&CmpFlushStatistics.VolumeTriggeredFlushes);
+                DueTime.QuadPart = Int32x32To64(CmpLazyFlushVolumeIntervalInSeconds,
+                                                -10 * 1000 * 1000);
+                KeSetTimer(&CmpLazyFlushTimer, DueTime, &CmpLazyFlushDpc);
+            }
+        }
+        else if (InterlockedCompareExchange(&CmpLazyFlushTimerState, 1, 0) == 0)
+        {
+            /* Do it */
+            DueTime.QuadPart = Int32x32To64(CmpLazyFlushIntervalInSeconds,
+                                            -10 * 1000 * 1000);
+            KeSetTimer(&CmpLazyFlushTimer, DueTime, &CmpLazyFlushDpc);
+        }
     }
 }
 
+VOID
+NTAPI
+CmpLazyFlushDirty(IN ULONG DirtyBlocks)
+{
+    PAGED_CODE();
+
+    /* Account for the newly dirtied blocks and set the lazy flush timer */
+    if (DirtyBlocks)
+        InterlockedExchangeAdd(&CmpLazyFlushDirtyBlocks, DirtyBlocks);
+    CmpLazyFlush();
+}
+
 _Function_class_(WORKER_THREAD_ROUTINE)
 VOID
 NTAPI
@@ -176,6 +215,8 @@ CmpLazyFlushWorker(IN PVOID Parameter)
 {
     BOOLEAN ForceFlush, Result, MoreWork = FALSE;
     ULONG DirtyCount = 0;
+    LARGE_INTEGER Start;
+    ULONG Time;
     PAGED_CODE();
 
     /* Don't do anything if lazy flushing isn't enabled yet */
@@ -202,7 +243,11 @@ CmpLazyFlushWorker(IN PVOID Parameter)
         CmpLockRegistry();
     }
 
+    /* Whatever is dirty by now is going to be written */
+    InterlockedExchange(&CmpLazyFlushDirtyBlocks, 0);
+
     /* Flush the next hive */
+    Start = KeQueryPerformanceCounter(NULL);
     MoreWork = CmpDoFlushNextHive(ForceFlush, &Result, &DirtyCount);
     if (!MoreWork)
     {
@@ -218,6 +263,12 @@ CmpLazyFlushWorker(IN PVOID Parameter)
     CmpLazyFlushPending = FALSE;
     CmpUnlockRegistry();
 
+    /* Update the statistics with how long the registry was held */
+    Time = CmpElapsedMicroseconds(Start);
+    InterlockedIncrement((PLONG)&CmpFlushStatistics.LazyFlushes);
+    InterlockedExchangeAdd64((PLONG64)&CmpFlushStatistics.LazyFlushTime, Time);
+    CmpUpdateMaxTime(&CmpFlushStatistics.MaxLazyFlushTime, Time);
+
     DPRINT("Lazy flush done. More work to be done: %s. Entries still dirty: %u.\n",
         MoreWork ? "Yes" : "No", DirtyCount);
 
@@ -449,4 +500,45 @@ CmSetLazyFlushState(IN BOOLEAN Enable)
     CmpHoldLazyFlush = !Enable;
 }
 
+#if DBG && defined(KDBG)
+
+#include <kdbg/kdb.h>
+
+BOOLEAN
+ExpKdbgExtRegFlush(ULONG Argc, PCHAR Argv[])
+{
+    PCM_FLUSH_STATISTICS Stats = &CmpFlushStatistics;
+    PLIST_ENTRY NextEntry;
+    PCMHIVE CmHive;
+
+    KdbpPrint("Writes:\t\t\t%lu (%I64u Kb)\n", Stats->Writes, Stats->BytesWritten / 1024);
+    KdbpPrint("Flushes:\t\t%lu, average %I64u us, max %lu us\n", Stats->Flushes,
+              Stats->Flushes ? Stats->FlushTime / Stats->Flushes : 0, Stats->MaxFlushTime);
+    KdbpPrint("Lazy flushes:\t\t%lu, average %I64u us, max %lu us held\n", Stats->LazyFlushes,
+              Stats->LazyFlushes ? Stats->LazyFlushTime / Stats->LazyFlushes : 0,
+              Stats->MaxLazyFlushTime);
+    KdbpPrint("Volume triggered:\t%lu\n", Stats->VolumeTriggeredFlushes);
+    KdbpPrint("Lazy flush interval:\t%lu s (%lu s above %lu dirty blocks)\n",
+              CmpLazyFlushIntervalInSeconds, CmpLazyFlushVolumeIntervalInSeconds,
+              CmpLazyFlushDirtyThreshold);
+    KdbpPrint("Pending dirty blocks:\t%ld, timer state %ld%s\n", CmpLazyFlushDirtyBlocks,
+              CmpLazyFlushTimerState, CmpHoldLazyFlush ? ", held" : "");
+
+    KdbpPrint("\nHive\t\tDirty\tBlocks\tFile\n");
+    for (NextEntry = CmpHiveListHead.Flink;
+         NextEntry != &CmpHiveListHead;
+         NextEntry = NextEntry->Flink)
+    {
+        CmHive = CONTAINING_RECORD(NextEntry, CMHIVE, HiveList);
+        KdbpPrint("%p\t%lu\t%lu\t%wZ\n", CmHive, CmHive->Hive.DirtyCount,
+                  CmHive->Hive.DirtyVector.Buffer ?
+                  RtlNumberOfSetBits(&CmHive->Hive.DirtyVector) : 0,
+                  &CmHive->FileFullPath);
+    }
+
+    return TRUE;
+}
+
+#endif // DBG && defined(KDBG)
+
 /* EOF */
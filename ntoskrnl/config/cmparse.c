@@ -2049,7 +2049,7 @@ CmpParseKey(IN PVOID ParseObject,
             if (!(Kcb->Flags & KEY_SYM_LINK))
             {
                 /* Find the subkey */
-                NextCell = CmpFindSubKeyByName(Hive, Node, &NextName);
+                NextCell = CmpFindSubKeyByNameWithCache(ParentKcb, Node, &NextName);
                 if (NextCell != HCELL_NIL)
                 {
                     /* Get the new node */
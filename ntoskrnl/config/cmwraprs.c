@@ -12,8 +12,37 @@
 #define NDEBUG
 #include "debug.h"
 
+/* GLOBALS *******************************************************************/
+
+CM_FLUSH_STATISTICS CmpFlushStatistics;
+
 /* FUNCTIONS *****************************************************************/
 
+ULONG
+NTAPI
+CmpElapsedMicroseconds(IN LARGE_INTEGER Start)
+{
+    LARGE_INTEGER End, Frequency;
+
+    End = KeQueryPerformanceCounter(&Frequency);
+    return (ULONG)(((End.QuadPart - Start.QuadPart) * 1000000) / Frequency.QuadPart);
+}
+
+VOID
+NTAPI
+CmpUpdateMaxTime(IN PULONG MaxTime,
+                 IN ULONG Time)
+{
+    ULONG OldTime;
+
+    /* Only keep the biggest value, no matter who else updates it */
+    OldTime = *MaxTime;
+    while (Time > OldTime)
+    {
+        OldTime = InterlockedCompareExchange((PLONG)MaxTime, Time, OldTime);
+    }
+}
+
 NTSTATUS
 NTAPI
 CmpCreateEvent(IN EVENT_TYPE EventType,
@@ -121,10 +150,17 @@ CmpFileWrite(IN PHHIVE RegistryHive,
                          Buffer, (ULONG)BufferLength, &_FileOffset, NULL);
     /* We do synchronous I/O for simplicity - see CmpOpenHiveFiles.
      * Windows optimizes here by starting an async write for each 64k chunk,
-     * then waiting for all writes to complete at once.
+     * then waiting for all writes to complete at once. cmlib already gathers
+     * adjacent dirty blocks into writes of up to 64k, see hivewrt.c.
      */
     ASSERT(Status != STATUS_PENDING);
-    return NT_SUCCESS(Status) ? TRUE : FALSE;
+    if (!NT_SUCCESS(Status))
+        return FALSE;
+
+    /* Update the statistics */
+    InterlockedIncrement((PLONG)&CmpFlushStatistics.Writes);
+    InterlockedExchangeAdd64((PLONG64)&CmpFlushStatistics.BytesWritten, BufferLength);
+    return TRUE;
 }
 
 BOOLEAN
@@ -197,6 +233,8 @@ CmpFileFlush(IN PHHIVE RegistryHive,
     PCMHIVE CmHive = (PCMHIVE)RegistryHive;
     HANDLE HiveHandle = CmHive->FileHandles[FileType];
     IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Start;
+    ULONG Time;
     NTSTATUS Status;
 
     /* Just return success if no file is associated with this hive */
@@ -207,11 +245,18 @@ CmpFileFlush(IN PHHIVE RegistryHive,
     if (CmpNoWrite)
         return TRUE;
 
+    Start = KeQueryPerformanceCounter(NULL);
     Status = ZwFlushBuffersFile(HiveHandle, &IoStatusBlock);
 
     /* This operation is always synchronous */
     ASSERT(Status != STATUS_PENDING);
     ASSERT(Status == IoStatusBlock.Status);
 
+    /* Update the statistics */
+    Time = CmpElapsedMicroseconds(Start);
+    InterlockedIncrement((PLONG)&CmpFlushStatistics.Flushes);
+    InterlockedExchangeAdd64((PLONG64)&CmpFlushStatistics.FlushTime, Time);
+    CmpUpdateMaxTime(&CmpFlushStatistics.MaxFlushTime, Time);
+
     return NT_SUCCESS(Status) ? TRUE : FALSE;
 }
@@ -20,6 +20,31 @@ EX_PUSH_LOCK HandleTableListLock;
 #define SizeOfHandle(x) (sizeof(HANDLE) * (x))
 #define INDEX_TO_HANDLE_VALUE(x) ((x) << HANDLE_TAG_BITS)
 
+/*
+ * Free handles are cached per processor, in cache lines that follow the
+ * handle table in the same allocation. Closing and reopening handles then
+ * mostly stays on the local line instead of fighting over FirstFree.
+ */
+#define HANDLE_CACHE_LINES      8
+#define HANDLE_CACHE_ENTRIES    (SYSTEM_CACHE_ALIGNMENT_SIZE / sizeof(ULONG))
+
+typedef struct _HANDLE_TABLE_CACHE
+{
+    ULONG Handles[HANDLE_CACHE_ENTRIES];
+} HANDLE_TABLE_CACHE, *PHANDLE_TABLE_CACHE;
+
+#define HANDLE_TABLE_ALLOCATION_SIZE                                \
+    (sizeof(HANDLE_TABLE) + SYSTEM_CACHE_ALIGNMENT_SIZE +           \
+     HANDLE_CACHE_LINES * sizeof(HANDLE_TABLE_CACHE))
+
+#define ExpGetHandleTableCache(t)                                   \
+    ((PHANDLE_TABLE_CACHE)ALIGN_UP_POINTER_BY((t) + 1,              \
+                                              SYSTEM_CACHE_ALIGNMENT_SIZE))
+
+/* Tables past this many pages grow by several pages at once */
+#define HANDLE_TABLE_GROWTH_THRESHOLD   8
+#define HANDLE_TABLE_GROWTH_BATCH       4
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 #ifdef _WIN64
@@ -270,29 +295,18 @@ ExpFreeHandleTable(IN PHANDLE_TABLE HandleTable)
     if (Process)
     {
         /* Release the quota it was taking up */
-        PsReturnProcessPagedPoolQuota(Process, sizeof(HANDLE_TABLE));
+        PsReturnProcessPagedPoolQuota(Process, HANDLE_TABLE_ALLOCATION_SIZE);
     }
 }
 
+static
 VOID
-NTAPI
-ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
-                        IN EXHANDLE Handle,
-                        IN PHANDLE_TABLE_ENTRY HandleTableEntry)
+ExpInsertFreeHandle(IN PHANDLE_TABLE HandleTable,
+                    IN EXHANDLE Handle,
+                    IN PHANDLE_TABLE_ENTRY HandleTableEntry)
 {
     ULONG OldValue, *Free;
     ULONG LockIndex;
-    PAGED_CODE();
-
-    /* Sanity checks */
-    ASSERT(HandleTableEntry->Object == NULL);
-    ASSERT(HandleTableEntry == ExpLookupHandleTableEntry(HandleTable, Handle));
-
-    /* Decrement the handle count */
-    InterlockedDecrement(&HandleTable->HandleCount);
-
-    /* Mark the handle as free */
-    Handle.TagBits = 0;
 
     /* Check if we're FIFO */
     if (!HandleTable->StrictFIFO)
@@ -326,6 +340,112 @@ ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     }
 }
 
+static
+BOOLEAN
+ExpPushCachedHandle(IN PHANDLE_TABLE HandleTable,
+                    IN ULONG Handle)
+{
+    PHANDLE_TABLE_CACHE Cache;
+    ULONG i;
+
+    /* Get the cache line of this processor */
+    Cache = &ExpGetHandleTableCache(HandleTable)[KeGetCurrentProcessorNumber() %
+                                                 HANDLE_CACHE_LINES];
+
+    /* Take the first empty slot, slots are owned by whoever swaps them */
+    for (i = 0; i < HANDLE_CACHE_ENTRIES; i++)
+    {
+        if (!(*(volatile ULONG*)&Cache->Handles[i]) &&
+            !(InterlockedCompareExchange((PLONG)&Cache->Handles[i], Handle, 0)))
+        {
+            return TRUE;
+        }
+    }
+
+    /* The cache is full */
+    return FALSE;
+}
+
+static
+ULONG
+ExpPopCachedHandle(IN PHANDLE_TABLE HandleTable)
+{
+    PHANDLE_TABLE_CACHE Cache;
+    ULONG i, Handle;
+
+    /* Get the cache line of this processor */
+    Cache = &ExpGetHandleTableCache(HandleTable)[KeGetCurrentProcessorNumber() %
+                                                 HANDLE_CACHE_LINES];
+
+    /* Take the first handle we find, 0 is never a valid one */
+    for (i = HANDLE_CACHE_ENTRIES; i > 0; i--)
+    {
+        if (*(volatile ULONG*)&Cache->Handles[i - 1])
+        {
+            Handle = InterlockedExchange((PLONG)&Cache->Handles[i - 1], 0);
+            if (Handle) return Handle;
+        }
+    }
+
+    /* Nothing cached */
+    return 0;
+}
+
+static
+VOID
+ExpFlushHandleCaches(IN PHANDLE_TABLE HandleTable)
+{
+    PHANDLE_TABLE_CACHE Cache;
+    EXHANDLE Handle;
+    ULONG i, j;
+
+    /* Give back the handles that all processors are holding */
+    Cache = ExpGetHandleTableCache(HandleTable);
+    for (i = 0; i < HANDLE_CACHE_LINES; i++)
+    {
+        for (j = 0; j < HANDLE_CACHE_ENTRIES; j++)
+        {
+            if (!(*(volatile ULONG*)&Cache[i].Handles[j])) continue;
+
+            Handle.Value = InterlockedExchange((PLONG)&Cache[i].Handles[j], 0);
+            if (!Handle.Value) continue;
+
+            ExpInsertFreeHandle(HandleTable,
+                                Handle,
+                                ExpLookupHandleTableEntry(HandleTable, Handle));
+        }
+    }
+}
+
+VOID
+NTAPI
+ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
+                        IN EXHANDLE Handle,
+                        IN PHANDLE_TABLE_ENTRY HandleTableEntry)
+{
+    PAGED_CODE();
+
+    /* Sanity checks */
+    ASSERT(HandleTableEntry->Object == NULL);
+    ASSERT(HandleTableEntry == ExpLookupHandleTableEntry(HandleTable, Handle));
+
+    /* Decrement the handle count */
+    InterlockedDecrement(&HandleTable->HandleCount);
+
+    /* Mark the handle as free */
+    Handle.TagBits = 0;
+
+    /* Keep it on this processor if there is room, unless order matters */
+    if (!(HandleTable->StrictFIFO) &&
+        (ExpPushCachedHandle(HandleTable, Handle.AsULONG)))
+    {
+        return;
+    }
+
+    /* Put it back on the free list */
+    ExpInsertFreeHandle(HandleTable, Handle, HandleTableEntry);
+}
+
 PHANDLE_TABLE
 NTAPI
 ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
@@ -339,7 +459,7 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
 
     /* Allocate the table */
     HandleTable = ExAllocatePoolWithTag(PagedPool,
-                                        sizeof(HANDLE_TABLE),
+                                        HANDLE_TABLE_ALLOCATION_SIZE,
                                         TAG_OBJECT_TABLE);
     if (!HandleTable) return NULL;
 
@@ -347,7 +467,7 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
     if (Process)
     {
         /* Charge quota */
-        Status = PsChargeProcessPagedPoolQuota(Process, sizeof(HANDLE_TABLE));
+        Status = PsChargeProcessPagedPoolQuota(Process, HANDLE_TABLE_ALLOCATION_SIZE);
         if (!NT_SUCCESS(Status))
         {
             ExFreePoolWithTag(HandleTable, TAG_OBJECT_TABLE);
@@ -355,8 +475,8 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
         }
     }
 
-    /* Clear the table */
-    RtlZeroMemory(HandleTable, sizeof(HANDLE_TABLE));
+    /* Clear the table and the free handle caches */
+    RtlZeroMemory(HandleTable, HANDLE_TABLE_ALLOCATION_SIZE);
 
     /* Now allocate the first level structures */
     HandleTableTable = ExpAllocateTablePagedPoolNoZero(Process, PAGE_SIZE);
@@ -368,7 +488,7 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
         /* Return the quota it was taking up */
         if (Process)
         {
-            PsReturnProcessPagedPoolQuota(Process, sizeof(HANDLE_TABLE));
+            PsReturnProcessPagedPoolQuota(Process, HANDLE_TABLE_ALLOCATION_SIZE);
         }
 
         return NULL;
@@ -689,6 +809,21 @@ ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     BOOLEAN Result;
     ULONG i;
 
+    /* Try the free handles cached for this processor first */
+    Handle.Value = ExpPopCachedHandle(HandleTable);
+    if (Handle.Value)
+    {
+        /* Lookup the entry for this handle, it can't have gone away */
+        Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+        ASSERT(Entry != NULL);
+        ASSERT(Entry->Object == NULL);
+
+        /* Increase the number of handles and return it */
+        InterlockedIncrement(&HandleTable->HandleCount);
+        *NewHandle = Handle;
+        return Entry;
+    }
+
     /* Start allocation loop */
     for (;;)
     {
@@ -710,6 +845,17 @@ ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
                 break;
             }
 
+            /* Take back the handles cached by other processors */
+            ExpFlushHandleCaches(HandleTable);
+            OldValue = HandleTable->FirstFree;
+            if (OldValue)
+            {
+                /* Some were left, no need to grow the table */
+                ExReleasePushLockExclusive(&HandleTable->HandleTableLock[0]);
+                KeLeaveCriticalRegion();
+                break;
+            }
+
             /* Now move any free handles */
             OldValue = ExpMoveFreeHandles(HandleTable);
             if (OldValue)
@@ -723,6 +869,18 @@ ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
             /* We're the first one through, so do the actual allocation */
             Result = ExpAllocateHandleTableEntrySlow(HandleTable, TRUE);
 
+            /* Large tables grow by a few pages at a time, so that threads
+               creating many handles don't keep coming back here */
+            if ((Result) &&
+                (HandleTable->NextHandleNeedingPool >=
+                 INDEX_TO_HANDLE_VALUE(LOW_LEVEL_ENTRIES * HANDLE_TABLE_GROWTH_THRESHOLD)))
+            {
+                for (i = 1; i < HANDLE_TABLE_GROWTH_BATCH; i++)
+                {
+                    if (!ExpAllocateHandleTableEntrySlow(HandleTable, TRUE)) break;
+                }
+            }
+
             /* Unlock the table and get the value now */
             ExReleasePushLockExclusive(&HandleTable->HandleTableLock[0]);
             KeLeaveCriticalRegion();
@@ -911,6 +1069,23 @@ ExpLockHandleTableEntry(IN PHANDLE_TABLE HandleTable,
         {
             /* We couldn't lock it, bail out if it's been freed */
             if (!OldValue) return FALSE;
+
+#ifdef CONFIG_SMP
+            /* Entries are only held for a short while, spin a bit first */
+            if (ExPushLockSpinCount)
+            {
+                ULONG i = ExPushLockSpinCount;
+
+                do
+                {
+                    YieldProcessor();
+                    OldValue = *(volatile LONG_PTR *)&HandleTableEntry->Object;
+                } while ((--i) && (OldValue) && !(OldValue & EXHANDLE_TABLE_ENTRY_LOCK_BIT));
+
+                /* Try again if it got unlocked or freed meanwhile */
+                if (!(OldValue) || (OldValue & EXHANDLE_TABLE_ENTRY_LOCK_BIT)) continue;
+            }
+#endif
         }
 
         /* It's locked, wait for it to be unlocked */
@@ -935,8 +1110,16 @@ ExUnlockHandleTableEntry(IN PHANDLE_TABLE HandleTable,
                              EXHANDLE_TABLE_ENTRY_LOCK_BIT);
     ASSERT((OldValue & EXHANDLE_TABLE_ENTRY_LOCK_BIT) == 0);
 
-    /* Unblock any waiters */
-    ExfUnblockPushLock(&HandleTable->HandleContentionEvent, NULL);
+    /*
+     * Unblock any waiters. Waiters queue themselves before checking the entry
+     * again, and the interlocked operation above is a full barrier, so an
+     * empty contention lock really means nobody is waiting. This keeps the
+     * common case from writing to the table-wide lock.
+     */
+    if (*(volatile PVOID*)&HandleTable->HandleContentionEvent.Ptr)
+    {
+        ExfUnblockPushLock(&HandleTable->HandleContentionEvent, NULL);
+    }
 }
 
 VOID
@@ -1030,8 +1213,11 @@ ExDestroyHandle(IN PHANDLE_TABLE HandleTable,
     ASSERT(Object != NULL);
     ASSERT((((ULONG_PTR)Object) & EXHANDLE_TABLE_ENTRY_LOCK_BIT) == 0);
 
-    /* Unblock the pushlock */
-    ExfUnblockPushLock(&HandleTable->HandleContentionEvent, NULL);
+    /* Unblock the pushlock if anybody is waiting on it */
+    if (*(volatile PVOID*)&HandleTable->HandleContentionEvent.Ptr)
+    {
+        ExfUnblockPushLock(&HandleTable->HandleContentionEvent, NULL);
+    }
 
     /* Free the actual entry */
     ExpFreeHandleTableEntry(HandleTable, ExHandle, HandleTableEntry);
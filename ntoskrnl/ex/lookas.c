@@ -23,6 +23,14 @@ LIST_ENTRY ExPoolLookasideListHead;
 GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
 GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
 
+/* The boot processor gets its per-processor lists before pool is available */
+GENERAL_LOOKASIDE ExpBootNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+GENERAL_LOOKASIDE ExpBootPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+
+/* Depth tuning, done once per second by the balance set manager */
+#define MINIMUM_LOOKASIDE_DEPTH         4
+#define MINIMUM_ALLOCATION_THRESHOLD    25
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 CODE_SEG("INIT")
@@ -53,6 +61,170 @@ ExInitializeSystemLookasideList(IN PGENERAL_LOOKASIDE List,
     List->LastAllocateHits = 0;
 }
 
+static
+USHORT
+ExpComputeLookasideDepth(IN ULONG Allocates,
+                         IN ULONG Misses,
+                         IN USHORT MaximumDepth,
+                         IN USHORT Depth)
+{
+    ULONG Ratio, Target;
+
+    /* A list that is barely used gives its entries back quickly */
+    if (Allocates < MINIMUM_ALLOCATION_THRESHOLD)
+    {
+        Depth = (Depth > MINIMUM_LOOKASIDE_DEPTH + 10) ?
+                Depth - 10 : MINIMUM_LOOKASIDE_DEPTH;
+        return min(Depth, MaximumDepth);
+    }
+
+    /* Miss ratio in tenths of a percent */
+    Ratio = (ULONG)(((ULONGLONG)Misses * 1000) / Allocates);
+    if (Ratio < 5)
+    {
+        /* Almost everything hits, try with one entry less */
+        if (Depth > MINIMUM_LOOKASIDE_DEPTH) Depth--;
+        return min(Depth, MaximumDepth);
+    }
+
+    /* Grow in proportion to the misses, and to the room that is left */
+    Target = ((Ratio * (MaximumDepth - Depth)) / (1000 * 2)) + 5;
+    Target += Depth;
+    return (USHORT)min(Target, MaximumDepth);
+}
+
+static
+VOID
+ExpAdjustLookasideList(IN PGENERAL_LOOKASIDE List,
+                       IN BOOLEAN ListUsesMisses)
+{
+    ULONG Allocates, Misses;
+
+    /* Compute what happened since the last scan */
+    Allocates = List->TotalAllocates - List->LastTotalAllocates;
+    if (ListUsesMisses)
+    {
+        Misses = List->AllocateMisses - List->LastAllocateMisses;
+        List->LastAllocateMisses = List->AllocateMisses;
+    }
+    else
+    {
+        /* Pool lists count hits, get the misses out of them */
+        Misses = Allocates - (List->AllocateHits - List->LastAllocateHits);
+        List->LastAllocateHits = List->AllocateHits;
+    }
+    List->LastTotalAllocates = List->TotalAllocates;
+
+    /* Set the new depth, entries beyond it are freed as they come back */
+    List->Depth = ExpComputeLookasideDepth(Allocates,
+                                           Misses,
+                                           List->MaximumDepth,
+                                           List->Depth);
+}
+
+static
+VOID
+ExpScanLookasideListHead(IN PLIST_ENTRY ListHead,
+                         IN BOOLEAN ListUsesMisses)
+{
+    PLIST_ENTRY ListEntry;
+
+    for (ListEntry = ListHead->Flink;
+         ListEntry != ListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        ExpAdjustLookasideList(CONTAINING_RECORD(ListEntry,
+                                                 GENERAL_LOOKASIDE,
+                                                 ListEntry),
+                               ListUsesMisses);
+    }
+}
+
+CODE_SEG("INIT")
+static
+VOID
+ExpBindPoolLookasideLists(IN PKPRCB Prcb,
+                          IN PGENERAL_LOOKASIDE NPagedLists,
+                          IN PGENERAL_LOOKASIDE PagedLists)
+{
+    ULONG i;
+
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+    {
+        /* The per-processor list is tried first, the system-wide one next */
+        Prcb->PPNPagedLookasideList[i].P = &NPagedLists[i];
+        Prcb->PPNPagedLookasideList[i].L = &ExpSmallNPagedPoolLookasideLists[i];
+        Prcb->PPPagedLookasideList[i].P = &PagedLists[i];
+        Prcb->PPPagedLookasideList[i].L = &ExpSmallPagedPoolLookasideLists[i];
+    }
+}
+
+CODE_SEG("INIT")
+BOOLEAN
+NTAPI
+ExAllocateProcessorLookasideLists(IN PKPRCB Prcb)
+{
+    ULONG i;
+    KIRQL OldIrql;
+    PGENERAL_LOOKASIDE Lists;
+
+    /* Called by the boot processor before it starts another one, as the
+       new processor initializes itself at HIGH_LEVEL and cannot allocate */
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    Lists = ExAllocatePoolWithTag(NonPagedPool,
+                                  2 * NUMBER_POOL_LOOKASIDE_LISTS *
+                                  sizeof(GENERAL_LOOKASIDE),
+                                  'looP');
+    if (!Lists) return FALSE;
+
+    /* Initialize them, the balance set manager may be scanning already */
+    KeAcquireSpinLock(&ExpNonPagedLookasideListLock, &OldIrql);
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+    {
+        ExInitializeSystemLookasideList(&Lists[i],
+                                        NonPagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
+        ExInitializeSystemLookasideList(&Lists[NUMBER_POOL_LOOKASIDE_LISTS + i],
+                                        PagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
+    }
+    KeReleaseSpinLock(&ExpNonPagedLookasideListLock, OldIrql);
+
+    ExpBindPoolLookasideLists(Prcb,
+                              Lists,
+                              &Lists[NUMBER_POOL_LOOKASIDE_LISTS]);
+    return TRUE;
+}
+
+CODE_SEG("INIT")
+VOID
+NTAPI
+ExFreeProcessorLookasideLists(IN PKPRCB Prcb)
+{
+    ULONG i;
+    KIRQL OldIrql;
+    PGENERAL_LOOKASIDE Lists = Prcb->PPNPagedLookasideList[0].P;
+
+    /* The processor never started, so its lists were never used */
+    KeAcquireSpinLock(&ExpNonPagedLookasideListLock, &OldIrql);
+    for (i = 0; i < 2 * NUMBER_POOL_LOOKASIDE_LISTS; i++)
+    {
+        RemoveEntryList(&Lists[i].ListEntry);
+    }
+    KeReleaseSpinLock(&ExpNonPagedLookasideListLock, OldIrql);
+
+    ExFreePoolWithTag(Lists, 'looP');
+    RtlZeroMemory(Prcb->PPNPagedLookasideList, sizeof(Prcb->PPNPagedLookasideList));
+    RtlZeroMemory(Prcb->PPPagedLookasideList, sizeof(Prcb->PPPagedLookasideList));
+}
+
 CODE_SEG("INIT")
 VOID
 NTAPI
@@ -62,22 +234,38 @@ ExInitPoolLookasidePointers(VOID)
     PKPRCB Prcb = KeGetCurrentPrcb();
     PGENERAL_LOOKASIDE Entry;
 
-    /* Loop for all pool lists */
+    /* Nothing to do if the boot processor gave us our own lists already */
+    if (Prcb->PPNPagedLookasideList[0].P)
+    {
+        return;
+    }
+
+    /* The boot processor uses static lists, ExpInitLookasideLists sets them up */
+    if (Prcb->Number == 0)
+    {
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            InitializeSListHead(&ExpSmallNPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpSmallPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpBootNPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpBootPagedPoolLookasideLists[i].ListHead);
+        }
+
+        ExpBindPoolLookasideLists(Prcb,
+                                  ExpBootNPagedPoolLookasideLists,
+                                  ExpBootPagedPoolLookasideLists);
+        return;
+    }
+
+    /* This runs at HIGH_LEVEL on the other processors, so when no lists
+       could be allocated for us we just share the system-wide ones */
     for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
-        /* Initialize the non-paged list */
         Entry = &ExpSmallNPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
-
-        /* Bind to PRCB */
         Prcb->PPNPagedLookasideList[i].P = Entry;
         Prcb->PPNPagedLookasideList[i].L = Entry;
 
-        /* Initialize the paged list */
         Entry = &ExpSmallPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
-
-        /* Bind to PRCB */
         Prcb->PPPagedLookasideList[i].P = Entry;
         Prcb->PPPagedLookasideList[i].L = Entry;
     }
@@ -116,9 +304,43 @@ ExpInitLookasideLists(VOID)
                                         'looP',
                                         256,
                                         &ExPoolLookasideListHead);
+
+        /* And the per-processor lists of the boot processor */
+        ExInitializeSystemLookasideList(&ExpBootNPagedPoolLookasideLists[i],
+                                        NonPagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
+        ExInitializeSystemLookasideList(&ExpBootPagedPoolLookasideLists[i],
+                                        PagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
     }
 }
 
+VOID
+NTAPI
+ExAdjustLookasideDepth(VOID)
+{
+    KIRQL OldIrql;
+
+    /* Pool and system lists only grow at boot, under the non-paged lock */
+    KeAcquireSpinLock(&ExpNonPagedLookasideListLock, &OldIrql);
+    ExpScanLookasideListHead(&ExPoolLookasideListHead, FALSE);
+    ExpScanLookasideListHead(&ExSystemLookasideListHead, TRUE);
+
+    /* Lists of drivers and components */
+    ExpScanLookasideListHead(&ExpNonPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpNonPagedLookasideListLock, OldIrql);
+
+    KeAcquireSpinLock(&ExpPagedLookasideListLock, &OldIrql);
+    ExpScanLookasideListHead(&ExpPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpPagedLookasideListLock, OldIrql);
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -1845,41 +1845,56 @@ QSI_DEF(SystemKernelDebuggerInformation)
 /* Class 36 - Context Switch Information */
 QSI_DEF(SystemContextSwitchInformation)
 {
-    PSYSTEM_CONTEXT_SWITCH_INFORMATION ContextSwitchInformation =
-        (PSYSTEM_CONTEXT_SWITCH_INFORMATION)Buffer;
-    ULONG ContextSwitches;
+    PSYSTEM_CONTEXT_SWITCH_INFORMATION_EX ContextSwitchInformation =
+        (PSYSTEM_CONTEXT_SWITCH_INFORMATION_EX)Buffer;
+    PKI_SCHEDULER_COUNTERS Counters;
+    ULONG MaxReadyLatency = 0;
     PKPRCB Prcb;
     CHAR i;
 
-    /* Check size of a buffer, it must match our expectations */
-    if (sizeof(SYSTEM_CONTEXT_SWITCH_INFORMATION) != Size)
+    /*
+     * Check size of a buffer, it must match our expectations. Callers
+     * that know about it can also get the ready queue statistics.
+     */
+    if ((sizeof(SYSTEM_CONTEXT_SWITCH_INFORMATION) != Size) &&
+        (sizeof(SYSTEM_CONTEXT_SWITCH_INFORMATION_EX) != Size))
+    {
         return STATUS_INFO_LENGTH_MISMATCH;
+    }
 
-    /* Calculate total value of context switches across all processors */
-    ContextSwitches = 0;
+    RtlZeroMemory(ContextSwitchInformation, Size);
+
+    /* Calculate the totals across all processors */
     for (i = 0; i < KeNumberProcessors; i ++)
     {
         Prcb = KiProcessorBlock[i];
-        if (Prcb)
+        if (!Prcb) continue;
+
+        Counters = &KiSchedulerCounters[i];
+        ContextSwitchInformation->Info.ContextSwitches += KeGetContextSwitches(Prcb);
+        ContextSwitchInformation->Info.FindAny += Counters->FindAny;
+        ContextSwitchInformation->Info.FindLast += Counters->FindLast;
+        ContextSwitchInformation->Info.FindIdeal += Counters->FindIdeal;
+        ContextSwitchInformation->Info.IdleAny += Counters->IdleAny;
+        ContextSwitchInformation->Info.IdleCurrent += Counters->IdleCurrent;
+        ContextSwitchInformation->Info.IdleLast += Counters->IdleLast;
+        ContextSwitchInformation->Info.IdleIdeal += Counters->IdleIdeal;
+        ContextSwitchInformation->Info.PreemptAny += Counters->PreemptAny;
+        ContextSwitchInformation->Info.PreemptCurrent += Counters->PreemptCurrent;
+        ContextSwitchInformation->Info.PreemptLast += Counters->PreemptLast;
+        ContextSwitchInformation->Info.SwitchToIdle += Counters->SwitchToIdle;
+
+        if (Size == sizeof(SYSTEM_CONTEXT_SWITCH_INFORMATION_EX))
         {
-            ContextSwitches += KeGetContextSwitches(Prcb);
+            ContextSwitchInformation->IdleSteal += Counters->IdleSteal;
+            ContextSwitchInformation->ReadyCount += Counters->ReadyCount;
+            ContextSwitchInformation->ReadyLatency += Counters->ReadyLatency;
+            MaxReadyLatency = max(MaxReadyLatency, Counters->MaxReadyLatency);
         }
     }
 
-    ContextSwitchInformation->ContextSwitches = ContextSwitches;
-
-    /* FIXME */
-    ContextSwitchInformation->FindAny = 0;
-    ContextSwitchInformation->FindLast = 0;
-    ContextSwitchInformation->FindIdeal = 0;
-    ContextSwitchInformation->IdleAny = 0;
-    ContextSwitchInformation->IdleCurrent = 0;
-    ContextSwitchInformation->IdleLast = 0;
-    ContextSwitchInformation->IdleIdeal = 0;
-    ContextSwitchInformation->PreemptAny = 0;
-    ContextSwitchInformation->PreemptCurrent = 0;
-    ContextSwitchInformation->PreemptLast = 0;
-    ContextSwitchInformation->SwitchToIdle = 0;
+    if (Size == sizeof(SYSTEM_CONTEXT_SWITCH_INFORMATION_EX))
+        ContextSwitchInformation->MaxReadyLatency = MaxReadyLatency;
 
     return STATUS_SUCCESS;
 }
@@ -193,11 +193,22 @@ typedef struct _ROS_SHARED_CACHE_MAP
     LIST_ENTRY CacheMapVacbListHead;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
+    /* Sparse index of the VACBs, by FileOffset / VACB_MAPPING_GRANULARITY.
+     * Protected by CacheMapLock, see CcRosVacbIndexSlot */
+    PVOID *VacbIndex;
+    ULONG VacbIndexDepth;
+    ULONG VacbIndexLookups;
+    ULONG VacbIndexHits;
 #if DBG
     BOOLEAN Trace; /* enable extra trace output for this cache map and it's VACBs */
 #endif
 } ROS_SHARED_CACHE_MAP, *PROS_SHARED_CACHE_MAP;
 
+/* Each level of the VACB index covers VACB_INDEX_LEVEL_SIZE slots: the
+ * leaf level holds PROS_VACB, the upper ones point to the next level */
+#define VACB_INDEX_LEVEL_SHIFT 7
+#define VACB_INDEX_LEVEL_SIZE (1 << VACB_INDEX_LEVEL_SHIFT)
+
 #define READAHEAD_DISABLED 0x1
 #define WRITEBEHIND_DISABLED 0x2
 #define SHARED_CACHE_MAP_IN_CREATION 0x4
@@ -283,6 +294,12 @@ typedef enum _WORK_QUEUE_FUNCTIONS
 
 extern LAZY_WRITER LazyWriter;
 
+/* Read ahead window bounds. The window, kept in ReadAheadLength[0] of the
+ * private cache map, doubles each time a sequential reader catches up with
+ * read ahead and is halved when the read pattern stops being sequential */
+#define CC_READ_AHEAD_MIN_WINDOW VACB_MAPPING_GRANULARITY
+#define CC_READ_AHEAD_MAX_WINDOW (8 * VACB_MAPPING_GRANULARITY)
+
 #define NODE_TYPE_DEFERRED_WRITE 0x02FC
 #define NODE_TYPE_PRIVATE_MAP    0x02FE
 #define NODE_TYPE_SHARED_MAP     0x02FF
@@ -363,6 +380,10 @@ CcRosUnmarkDirtyVacb(
     PROS_VACB Vacb,
     BOOLEAN LockViews);
 
+VOID
+CcRosVacbIndexRemove(
+    PROS_VACB Vacb);
+
 NTSTATUS
 CcRosFlushDirtyPages(
     ULONG Target,
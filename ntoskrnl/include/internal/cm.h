@@ -71,6 +71,11 @@
 #endif
 #define CMP_MAX_CALLBACKS                               100
 
+//
+// Keys with fewer subkeys than this are searched through their index directly
+//
+#define CMP_SUBKEY_CACHE_MIN_COUNT                      64
+
 //
 // Hashing Constants
 //
@@ -225,6 +230,23 @@ typedef struct _CM_INDEX_HINT_BLOCK
     ULONG HashKey[ANYSIZE_ARRAY];
 } CM_INDEX_HINT_BLOCK, *PCM_INDEX_HINT_BLOCK;
 
+//
+// Subkey Hash Cache
+//
+typedef struct _CM_SUBKEY_HASH_ENTRY
+{
+    ULONG HashKey;
+    HCELL_INDEX Cell;
+} CM_SUBKEY_HASH_ENTRY, *PCM_SUBKEY_HASH_ENTRY;
+
+typedef struct _CM_SUBKEY_HASH_CACHE
+{
+    HCELL_INDEX SubKeyLists[HTYPE_COUNT];
+    ULONG SubKeyCounts[HTYPE_COUNT];
+    ULONG Mask;
+    CM_SUBKEY_HASH_ENTRY Table[ANYSIZE_ARRAY];
+} CM_SUBKEY_HASH_CACHE, *PCM_SUBKEY_HASH_CACHE;
+
 //
 // Key Body
 //
@@ -315,6 +337,7 @@ typedef struct _CM_KEY_CONTROL_BLOCK
          ULONG Flags : 16;
     };
     ULONG InDelayClose;
+    PCM_SUBKEY_HASH_CACHE SubKeyCache;
 } CM_KEY_CONTROL_BLOCK, *PCM_KEY_CONTROL_BLOCK;
 
 //
@@ -464,6 +487,22 @@ typedef struct _CM_SYSTEM_CONTROL_VECTOR
     PULONG Type;
 } CM_SYSTEM_CONTROL_VECTOR, *PCM_SYSTEM_CONTROL_VECTOR;
 
+//
+// Hive write and flush statistics, for the !regflush debugger extension
+//
+typedef struct _CM_FLUSH_STATISTICS
+{
+    ULONG Writes;
+    ULONGLONG BytesWritten;
+    ULONG Flushes;
+    ULONGLONG FlushTime;
+    ULONG MaxFlushTime;
+    ULONG LazyFlushes;
+    ULONGLONG LazyFlushTime;
+    ULONG MaxLazyFlushTime;
+    ULONG VolumeTriggeredFlushes;
+} CM_FLUSH_STATISTICS, *PCM_FLUSH_STATISTICS;
+
 //
 // Structure for CmpQueryValueDataFromCache
 //
@@ -978,6 +1017,14 @@ CmpCleanUpSubKeyInfo(
     IN PCM_KEY_CONTROL_BLOCK Kcb
 );
 
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithCache(
+    IN PCM_KEY_CONTROL_BLOCK Kcb,
+    IN PCM_KEY_NODE Node,
+    IN PCUNICODE_STRING SearchName
+);
+
 PUNICODE_STRING
 NTAPI
 CmpConstructName(
@@ -1102,6 +1149,12 @@ CmpLazyFlush(
     VOID
 );
 
+VOID
+NTAPI
+CmpLazyFlushDirty(
+    IN ULONG DirtyBlocks
+);
+
 //
 // Open/Create Routines
 //
@@ -1242,6 +1295,19 @@ CmpFileFlush(
    IN ULONG Length
 );
 
+ULONG
+NTAPI
+CmpElapsedMicroseconds(
+    IN LARGE_INTEGER Start
+);
+
+VOID
+NTAPI
+CmpUpdateMaxTime(
+    IN PULONG MaxTime,
+    IN ULONG Time
+);
+
 //
 // Configuration Manager side of Registry System Calls
 //
@@ -1423,6 +1489,9 @@ extern BOOLEAN CmpMiniNTBoot;
 extern BOOLEAN CmpNoVolatileCreates;
 extern EX_PUSH_LOCK CmpHiveListHeadLock, CmpLoadHiveLock;
 extern LIST_ENTRY CmpHiveListHead;
+extern CM_FLUSH_STATISTICS CmpFlushStatistics;
+extern ULONG CmpLazyFlushIntervalInSeconds;
+extern ULONG CmpLazyFlushDirtyThreshold;
 extern POBJECT_TYPE CmpKeyObjectType;
 extern ERESOURCE CmpRegistryLock;
 extern PCM_KEY_HASH_TABLE_ENTRY CmpCacheTable;
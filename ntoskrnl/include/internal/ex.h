@@ -37,6 +37,7 @@ extern KSPIN_LOCK ExpNonPagedLookasideListLock;
 extern KSPIN_LOCK ExpPagedLookasideListLock;
 extern ULONG ExCriticalWorkerThreads;
 extern ULONG ExDelayedWorkerThreads;
+extern ULONG ExPushLockSpinCount;
 
 extern PVOID ExpDefaultErrorPort;
 extern PEPROCESS ExpDefaultErrorPortProcess;
@@ -316,6 +317,20 @@ VOID
 NTAPI
 ExInitPoolLookasidePointers(VOID);
 
+CODE_SEG("INIT")
+BOOLEAN
+NTAPI
+ExAllocateProcessorLookasideLists(IN PKPRCB Prcb);
+
+CODE_SEG("INIT")
+VOID
+NTAPI
+ExFreeProcessorLookasideLists(IN PKPRCB Prcb);
+
+VOID
+NTAPI
+ExAdjustLookasideDepth(VOID);
+
 /* Callback Functions ********************************************************/
 
 VOID
@@ -75,6 +75,31 @@ typedef struct _DPC_QUEUE_ENTRY
     PVOID Context;
 } DPC_QUEUE_ENTRY, *PDPC_QUEUE_ENTRY;
 
+//
+// Per-processor dispatcher counters, reported through
+// SystemContextSwitchInformation. Each processor only updates
+// its own entry, except for the ready counters which are
+// protected by the PRCB lock of the processor.
+//
+typedef struct DECLSPEC_CACHEALIGN _KI_SCHEDULER_COUNTERS
+{
+    ULONG FindAny;
+    ULONG FindLast;
+    ULONG FindIdeal;
+    ULONG IdleAny;
+    ULONG IdleCurrent;
+    ULONG IdleLast;
+    ULONG IdleIdeal;
+    ULONG PreemptAny;
+    ULONG PreemptCurrent;
+    ULONG PreemptLast;
+    ULONG SwitchToIdle;
+    ULONG IdleSteal;
+    ULONG ReadyCount;
+    ULONG MaxReadyLatency;
+    ULONGLONG ReadyLatency;
+} KI_SCHEDULER_COUNTERS, *PKI_SCHEDULER_COUNTERS;
+
 typedef struct _KNMI_HANDLER_CALLBACK
 {
     struct _KNMI_HANDLER_CALLBACK* Next;
@@ -138,6 +163,8 @@ extern LIST_ENTRY KiStackInSwapListHead;
 extern KEVENT KiSwapEvent;
 extern PKPRCB KiProcessorBlock[];
 extern KAFFINITY KiIdleSummary;
+extern KAFFINITY KiIdleSMTSummary;
+extern KI_SCHEDULER_COUNTERS KiSchedulerCounters[MAXIMUM_PROCESSORS];
 extern PVOID KeUserApcDispatcher;
 extern PVOID KeUserCallbackDispatcher;
 extern PVOID KeUserExceptionDispatcher;
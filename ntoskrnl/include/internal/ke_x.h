@@ -1413,6 +1413,23 @@ KxQueueReadyThread(IN PKTHREAD Thread,
     }
 }
 
+//
+// This routine accounts for the time a thread spent on a ready queue
+// before being selected to run. The PRCB lock must be held.
+//
+FORCEINLINE
+VOID
+KiUpdateReadyLatency(IN PKTHREAD Thread,
+                     IN PKPRCB Prcb)
+{
+    PKI_SCHEDULER_COUNTERS Counters = &KiSchedulerCounters[Prcb->Number];
+    ULONG Latency = KeTickCount.LowPart - Thread->WaitTime;
+
+    Counters->ReadyCount++;
+    Counters->ReadyLatency += Latency;
+    if (Latency > Counters->MaxReadyLatency) Counters->MaxReadyLatency = Latency;
+}
+
 //
 // This routine scans for an appropriate ready thread to select at the
 // given priority and for the given CPU.
@@ -1455,6 +1472,9 @@ KiSelectReadyThread(IN KPRIORITY Priority,
         Prcb->ReadySummary ^= PRIORITY_MASK(HighPriority);
     }
 
+    /* Update the ready latency counters */
+    KiUpdateReadyLatency(Thread, Prcb);
+
     /* Sanity check and return the thread */
 Quickie:
     ASSERT((Thread == NULL) ||
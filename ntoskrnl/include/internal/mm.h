@@ -507,9 +507,48 @@ typedef struct _MMPAGING_FILE
     UNICODE_STRING PageFileName;
     PRTL_BITMAP Bitmap;
     HANDLE FileHandle;
+    ULONG AllocationHint;
+    /* I/O statistics, times are in microseconds */
+    ULONGLONG PagesWritten;
+    ULONGLONG PagesRead;
+    ULONG WriteIos;
+    ULONG ReadIos;
+    ULONGLONG WriteTime;
+    ULONG MaxWriteTime;
 }
 MMPAGING_FILE, *PMMPAGING_FILE;
 
+/* Maximum number of pages per page file write and per clustered read */
+#define MM_PAGEFILE_WRITE_CLUSTER   16
+#define MM_PAGEFILE_READ_CLUSTER    8
+
+/* A page file write in progress */
+typedef struct _MM_PAGEFILE_WRITE
+{
+    SWAPENTRY SwapEntry;
+    ULONG PageCount;
+    LARGE_INTEGER StartTime;
+    KEVENT Event;
+    IO_STATUS_BLOCK Iosb;
+    NTSTATUS Status;
+    MDL Mdl;
+    /* The page array of the MDL, must follow it */
+    PFN_NUMBER MdlPages[MM_PAGEFILE_WRITE_CLUSTER];
+}
+MM_PAGEFILE_WRITE, *PMM_PAGEFILE_WRITE;
+
+/* Dirty private pages collected by the balancer to be written out together */
+typedef struct _MM_PAGEOUT_CLUSTER
+{
+    ULONG Count;
+    BOOLEAN WriteInProgress;
+    PEPROCESS Process[MM_PAGEFILE_WRITE_CLUSTER];
+    PVOID Address[MM_PAGEFILE_WRITE_CLUSTER];
+    PFN_NUMBER Page[MM_PAGEFILE_WRITE_CLUSTER];
+    MM_PAGEFILE_WRITE Write;
+}
+MM_PAGEOUT_CLUSTER, *PMM_PAGEOUT_CLUSTER;
+
 extern PMMPAGING_FILE MmPagingFile[MAX_PAGING_FILES];
 
 typedef VOID
@@ -704,10 +743,25 @@ SWAPENTRY
 NTAPI
 MmAllocSwapPage(VOID);
 
+SWAPENTRY
+NTAPI
+MmAllocSwapPages(ULONG Count);
+
+SWAPENTRY
+NTAPI
+MmGetNextSwapEntry(SWAPENTRY SwapEntry);
+
 VOID
 NTAPI
 MmFreeSwapPage(SWAPENTRY Entry);
 
+VOID
+NTAPI
+MmFreeSwapPages(
+    SWAPENTRY Entry,
+    ULONG Count
+);
+
 CODE_SEG("INIT")
 VOID
 NTAPI
@@ -724,6 +778,14 @@ MmReadFromSwapPage(
     PFN_NUMBER Page
 );
 
+NTSTATUS
+NTAPI
+MmReadFromSwapPages(
+    SWAPENTRY SwapEntry,
+    PPFN_NUMBER Pages,
+    ULONG PageCount
+);
+
 NTSTATUS
 NTAPI
 MmWriteToSwapPage(
@@ -731,6 +793,19 @@ MmWriteToSwapPage(
     PFN_NUMBER Page
 );
 
+VOID
+NTAPI
+MmStartSwapWrite(
+    PMM_PAGEFILE_WRITE Write,
+    SWAPENTRY SwapEntry,
+    PPFN_NUMBER Pages,
+    ULONG PageCount
+);
+
+NTSTATUS
+NTAPI
+MmWaitForSwapWrite(PMM_PAGEFILE_WRITE Write);
+
 VOID
 NTAPI
 MmShowOutOfSpaceMessagePagingFile(VOID);
@@ -742,6 +817,14 @@ MiReadPageFile(
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset);
 
+NTSTATUS
+NTAPI
+MiReadPageFileCluster(
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount,
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset);
+
 /* process.c ****************************************************************/
 
 NTSTATUS
@@ -983,6 +1066,24 @@ NTSTATUS
 NTAPI
 MmPageOutPhysicalAddress(PFN_NUMBER Page);
 
+NTSTATUS
+NTAPI
+MmPageOutPhysicalAddressEx(
+    PFN_NUMBER Page,
+    PMM_PAGEOUT_CLUSTER Cluster
+);
+
+VOID
+NTAPI
+MmStartPageOutCluster(PMM_PAGEOUT_CLUSTER Cluster);
+
+VOID
+NTAPI
+MmCompletePageOutCluster(
+    PMM_PAGEOUT_CLUSTER Cluster,
+    PULONG NrFreedPages
+);
+
 PMM_SECTION_SEGMENT
 NTAPI
 MmGetSectionAssociation(PFN_NUMBER Page,
@@ -1107,7 +1208,8 @@ MiUnmapPageInHyperSpace(IN PEPROCESS Process,
 
 PVOID
 NTAPI
-MiMapPagesInZeroSpace(IN PMMPFN Pfn1,
+MiMapPagesInZeroSpace(IN PMMPTE ZeroingPte,
+                      IN PMMPFN Pfn1,
                       IN PFN_NUMBER NumberOfPages);
 
 VOID
@@ -126,10 +126,17 @@ KeStartAllProcessors(VOID)
         KeLoaderBlock->Prcb = (ULONG_PTR)&APInfo->Pcr.Prcb;
         KeLoaderBlock->Thread = (ULONG_PTR)&APInfo->Pcr.Prcb->IdleThread;
 
+        // The new CPU can't allocate pool while it initializes at HIGH_LEVEL,
+        // so give it its pool lookaside lists now. Without them it shares the
+        // system-wide ones.
+        ExAllocateProcessorLookasideLists(APInfo->Pcr.Prcb);
+
         // Start the CPU
         DPRINT("Attempting to Start a CPU with number: %u\n", ProcessorCount);
         if (!HalStartNextProcessor(KeLoaderBlock, ProcessorState))
         {
+            if (APInfo->Pcr.Prcb->PPNPagedLookasideList[0].P)
+                ExFreeProcessorLookasideLists(APInfo->Pcr.Prcb);
             break;
         }
 
@@ -15,15 +15,152 @@
 #ifdef _WIN64
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr64((PLONG64)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd64((PLONG64)Destination, SetMember);
 #else
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr((PLONG)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd((PLONG)Destination, SetMember);
 #endif
 
 /* GLOBALS *******************************************************************/
 
 KAFFINITY KiIdleSummary;
 KAFFINITY KiIdleSMTSummary;
+KI_SCHEDULER_COUNTERS KiSchedulerCounters[MAXIMUM_PROCESSORS];
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+VOID
+KiSetIdleSummary(IN PKPRCB Prcb)
+{
+    /* Mark the processor idle */
+    InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+
+    /* Mark the whole core idle if all of its logical processors are */
+    if ((KiIdleSummary & Prcb->MultiThreadProcessorSet) == Prcb->MultiThreadProcessorSet)
+    {
+        InterlockedOrSetMember(&KiIdleSMTSummary, Prcb->MultiThreadProcessorSet);
+    }
+}
+
+static
+VOID
+KiClearIdleSMTSummary(IN PKPRCB Prcb)
+{
+    /* The core isn't completely idle anymore */
+    if (KiIdleSMTSummary & Prcb->SetMember)
+    {
+        InterlockedAndSetMember(&KiIdleSMTSummary, ~Prcb->MultiThreadProcessorSet);
+    }
+}
+
+static
+ULONG
+KiSelectIdleProcessor(IN PKTHREAD Thread,
+                      IN KAFFINITY IdleSet)
+{
+    ULONG Processor;
+    KAFFINITY IdleCores;
+
+    /* Prefer the processors whose caches most likely hold the thread's data */
+    if (IdleSet & AFFINITY_MASK(Thread->IdealProcessor)) return Thread->IdealProcessor;
+    if (IdleSet & AFFINITY_MASK(Thread->NextProcessor)) return Thread->NextProcessor;
+    if (IdleSet & KeGetCurrentPrcb()->SetMember) return KeGetCurrentProcessorNumber();
+
+    /* Otherwise prefer a completely idle core over a busy core's sibling */
+    IdleCores = IdleSet & KiIdleSMTSummary;
+    if (IdleCores) IdleSet = IdleCores;
+
+    BitScanForwardAffinity(&Processor, IdleSet);
+    return Processor;
+}
+
+static
+PKTHREAD
+KiStealReadyThread(IN PKPRCB Prcb)
+{
+    PKPRCB Neighbor, Busiest = NULL;
+    ULONG Index, Summary, HighPriority, BusiestPriority = 0;
+    PLIST_ENTRY ListHead, ListEntry;
+    PKTHREAD Thread;
+
+    /*
+     * Look for the processor with the most urgent ready thread, starting
+     * after this one so that idle processors don't all pick the same one.
+     */
+    for (Index = 1; Index < (ULONG)KeNumberProcessors; Index++)
+    {
+        Neighbor = KiProcessorBlock[(Prcb->Number + Index) % KeNumberProcessors];
+        if (!Neighbor) continue;
+
+        Summary = Neighbor->ReadySummary;
+        if (!Summary) continue;
+
+        BitScanReverse(&HighPriority, Summary);
+        if (!(Busiest) || (HighPriority > BusiestPriority))
+        {
+            Busiest = Neighbor;
+            BusiestPriority = HighPriority;
+        }
+    }
+
+    /* Nothing to do anywhere */
+    if (!Busiest) return NULL;
+
+    /* Lock it and take its highest priority thread that may run here */
+    KiAcquirePrcbLock(Busiest);
+    Summary = Busiest->ReadySummary;
+    while (Summary)
+    {
+        BitScanReverse(&HighPriority, Summary);
+        Summary ^= PRIORITY_MASK(HighPriority);
+
+        ListHead = &Busiest->DispatcherReadyListHead[HighPriority];
+        for (ListEntry = ListHead->Flink;
+             ListEntry != ListHead;
+             ListEntry = ListEntry->Flink)
+        {
+            Thread = CONTAINING_RECORD(ListEntry, KTHREAD, WaitListEntry);
+            if (!(Thread->Affinity & Prcb->SetMember)) continue;
+
+            /* Remove it from the list */
+            ASSERT(Thread->State == Ready);
+            if (RemoveEntryList(&Thread->WaitListEntry))
+            {
+                /* The list is empty now, reset the ready summary */
+                Busiest->ReadySummary ^= PRIORITY_MASK(HighPriority);
+            }
+
+            /* It's going to run here */
+            Thread->NextProcessor = Prcb->Number;
+            Thread->State = Standby;
+            KiReleasePrcbLock(Busiest);
+            return Thread;
+        }
+    }
+
+    /* None of them can run on this processor */
+    KiReleasePrcbLock(Busiest);
+    return NULL;
+}
+
+static
+VOID
+KiCountPreemption(IN PKI_SCHEDULER_COUNTERS Counters,
+                  IN ULONG Processor,
+                  IN ULONG CurrentProcessor,
+                  IN ULONG LastProcessor)
+{
+    if (Processor == CurrentProcessor)
+        Counters->PreemptCurrent++;
+    else if (Processor == LastProcessor)
+        Counters->PreemptLast++;
+    else
+        Counters->PreemptAny++;
+}
 
 /* FUNCTIONS *****************************************************************/
 
@@ -31,8 +168,37 @@ PKTHREAD
 FASTCALL
 KiIdleSchedule(IN PKPRCB Prcb)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("SMP: Not yet implemented\n", FALSE);
+    PKTHREAD Thread;
+
+    /* Only look once each time the processor goes idle */
+    Prcb->IdleSchedule = FALSE;
+    if (Prcb->NextThread) return NULL;
+
+    /* Try to take some work from the busiest processor */
+    Thread = KiStealReadyThread(Prcb);
+    if (!Thread) return NULL;
+
+    /* Make sure nobody gave us a thread in the meantime */
+    KiAcquirePrcbLock(Prcb);
+    if (!Prcb->NextThread)
+    {
+        /* We're not idle anymore */
+        InterlockedBitTestAndResetAffinity(&KiIdleSummary, Prcb->Number);
+        KiClearIdleSMTSummary(Prcb);
+
+        /* Update the counters and schedule the thread */
+        KiUpdateReadyLatency(Thread, Prcb);
+        KiSchedulerCounters[Prcb->Number].IdleSteal++;
+        Prcb->NextThread = Thread;
+        KiReleasePrcbLock(Prcb);
+        return Thread;
+    }
+
+    /* Somebody did, so send the thread through the dispatcher again */
+    KiReleasePrcbLock(Prcb);
+    Thread->State = DeferredReady;
+    Thread->DeferredProcessor = Prcb->Number;
+    KiDeferredReadyThread(Thread);
     return NULL;
 }
 
@@ -80,9 +246,11 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
 {
     PKPRCB Prcb;
     BOOLEAN Preempted;
-    ULONG Processor = 0;
+    ULONG Processor, LastProcessor, CurrentProcessor;
+    KAFFINITY Affinity, IdleSet;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+    PKI_SCHEDULER_COUNTERS Counters;
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,26 +396,79 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
-    /* Queue the thread on CPU 0 and get the PRCB and lock it */
-    Thread->NextProcessor = 0;
-    Prcb = KiProcessorBlock[0];
-    KiAcquirePrcbLock(Prcb);
+    /* Get the processors the thread may run on */
+    Affinity = Thread->Affinity & KeActiveProcessors;
+    if (!Affinity)
+    {
+        /* Its processors aren't started yet, use the boot processor meanwhile */
+        Affinity = AFFINITY_MASK(0);
+    }
+    LastProcessor = Thread->NextProcessor;
+    CurrentProcessor = KeGetCurrentProcessorNumber();
+    Counters = &KiSchedulerCounters[CurrentProcessor];
 
-    /* Check if we have an idle summary */
-    if (KiIdleSummary)
+    /* Check if we have an idle processor for it */
+    IdleSet = Affinity & KiIdleSummary;
+    while (IdleSet)
     {
-        /* Clear it and set this thread as the next one */
-        KiIdleSummary = 0;
+        /* Pick one and try to claim it, another processor may be quicker */
+        Processor = KiSelectIdleProcessor(Thread, IdleSet);
+        IdleSet &= ~AFFINITY_MASK(Processor);
+        if (!InterlockedBitTestAndResetAffinity(&KiIdleSummary, Processor)) continue;
+
+        /* Lock its PRCB and make sure it didn't get a thread meanwhile */
+        Prcb = KiProcessorBlock[Processor];
+        KiClearIdleSMTSummary(Prcb);
+        KiAcquirePrcbLock(Prcb);
+        if (Prcb->NextThread)
+        {
+            KiReleasePrcbLock(Prcb);
+            continue;
+        }
+
+        /* Update the counters */
+        if (Processor == Thread->IdealProcessor)
+            Counters->IdleIdeal++;
+        else if (Processor == LastProcessor)
+            Counters->IdleLast++;
+        else if (Processor == CurrentProcessor)
+            Counters->IdleCurrent++;
+        else
+            Counters->IdleAny++;
+
+        /* Set this thread as the next one */
+        Thread->NextProcessor = (UCHAR)Processor;
         Thread->State = Standby;
         Prcb->NextThread = Thread;
+        Prcb->IdleSchedule = FALSE;
 
-        /* Unlock the PRCB and return */
+        /* Unlock the PRCB and wake the processor up if it isn't this one */
         KiReleasePrcbLock(Prcb);
+        if (Processor != CurrentProcessor) KiIpiSend(AFFINITY_MASK(Processor), IPI_DPC);
         return;
     }
 
-    /* Set the CPU number */
+    /* Otherwise queue it on its ideal processor, or the last one it ran on */
+    if (Affinity & AFFINITY_MASK(Thread->IdealProcessor))
+    {
+        Processor = Thread->IdealProcessor;
+        Counters->FindIdeal++;
+    }
+    else if (Affinity & AFFINITY_MASK(LastProcessor))
+    {
+        Processor = LastProcessor;
+        Counters->FindLast++;
+    }
+    else
+    {
+        BitScanForwardAffinity(&Processor, Affinity);
+        Counters->FindAny++;
+    }
+
+    /* Set the CPU number and get the PRCB and lock it */
     Thread->NextProcessor = (UCHAR)Processor;
+    Prcb = KiProcessorBlock[Processor];
+    KiAcquirePrcbLock(Prcb);
 
     /* Get the next scheduled thread */
     NextThread = Prcb->NextThread;
@@ -261,6 +482,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         {
             /* Preempt the thread */
             NextThread->Preempted = TRUE;
+            KiCountPreemption(Counters, Processor, CurrentProcessor, LastProcessor);
 
             /* Put this one as the next one */
             Thread->State = Standby;
@@ -282,6 +504,14 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         {
             /* Preempt it if it's already running */
             if (NextThread->State == Running) NextThread->Preempted = TRUE;
+            KiCountPreemption(Counters, Processor, CurrentProcessor, LastProcessor);
+
+            /* The processor isn't idle anymore */
+            if (NextThread == Prcb->IdleThread)
+            {
+                InterlockedBitTestAndResetAffinity(&KiIdleSummary, Processor);
+                KiClearIdleSMTSummary(Prcb);
+            }
 
             /* Set the thread on standby and as the next thread */
             Thread->State = Standby;
@@ -291,7 +521,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
             KiReleasePrcbLock(Prcb);
 
             /* Check if we're running on another CPU */
-            if (KeGetCurrentProcessorNumber() != Thread->NextProcessor)
+            if (CurrentProcessor != Thread->NextProcessor)
             {
                 /* We are, send an IPI */
                 KiIpiSend(AFFINITY_MASK(Thread->NextProcessor), IPI_DPC);
@@ -336,12 +566,10 @@ KiSelectNextThread(IN PKPRCB Prcb)
         /* Didn't find any, get the current idle thread */
         Thread = Prcb->IdleThread;
 
-        /* Enable idle scheduling */
-        InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+        /* Enable idle scheduling, the idle loop looks for work elsewhere */
+        KiSetIdleSummary(Prcb);
         Prcb->IdleSchedule = TRUE;
-
-        /* FIXME: SMT support */
-        ASSERTMSG("SMP: Not yet implemented\n", FALSE);
+        KiSchedulerCounters[Prcb->Number].SwitchToIdle++;
     }
 
     /* Sanity checks and return the thread */
@@ -385,8 +613,10 @@ KiSwapThread(IN PKTHREAD CurrentThread,
         }
         else
         {
-            /* Set the idle summary */
-            InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+            /* Set the idle summary and enable idle scheduling */
+            KiSetIdleSummary(Prcb);
+            Prcb->IdleSchedule = TRUE;
+            KiSchedulerCounters[Prcb->Number].SwitchToIdle++;
 
             /* Schedule the idle thread */
             NextThread = Prcb->IdleThread;
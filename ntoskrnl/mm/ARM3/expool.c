@@ -51,7 +51,7 @@ PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
 KSPIN_LOCK ExpTaggedPoolLock;
 ULONG PoolHitTag;
 BOOLEAN ExStopBadTags;
-KSPIN_LOCK ExpLargePoolTableLock;
+volatile LONG ExpLargePoolTableLock;
 ULONG ExpPoolBigEntriesInUse;
 ULONG ExpPoolFlags;
 ULONG ExPoolFailures;
@@ -64,6 +64,82 @@ ULONGLONG MiLastPoolDumpTime;
 #define POOL_NEXT_BLOCK(x)  POOL_BLOCK((x), (x)->BlockSize)
 #define POOL_PREV_BLOCK(x)  POOL_BLOCK((x), -((x)->PreviousSize))
 
+/*
+ * The big page table is protected by a reader/writer spinlock. Adding and
+ * removing entries only takes it shared, since entries are claimed with an
+ * interlocked operation on their address, so that big allocations on several
+ * processors don't serialize. Only the expansion and the shrinking of the
+ * table take it exclusive.
+ */
+#define POOL_BIG_TABLE_LOCK_EXCLUSIVE ((LONG)0x80000000)
+
+_IRQL_raises_(DISPATCH_LEVEL)
+FORCEINLINE
+KIRQL
+ExpAcquireBigPageTableShared(VOID)
+{
+    KIRQL OldIrql;
+    LONG Value;
+
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    for (;;)
+    {
+        Value = ExpLargePoolTableLock;
+        if (!(Value & POOL_BIG_TABLE_LOCK_EXCLUSIVE) &&
+            (InterlockedCompareExchange(&ExpLargePoolTableLock, Value + 1, Value) == Value))
+        {
+            return OldIrql;
+        }
+        YieldProcessor();
+    }
+}
+
+FORCEINLINE
+VOID
+ExpReleaseBigPageTableShared(
+    _In_ _IRQL_restores_ KIRQL OldIrql)
+{
+    InterlockedDecrement(&ExpLargePoolTableLock);
+    KeLowerIrql(OldIrql);
+}
+
+_IRQL_raises_(DISPATCH_LEVEL)
+FORCEINLINE
+KIRQL
+ExpAcquireBigPageTableExclusive(VOID)
+{
+    KIRQL OldIrql;
+
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
+    /* Keep new readers out, then wait for the current ones to leave */
+    while (InterlockedOr(&ExpLargePoolTableLock, POOL_BIG_TABLE_LOCK_EXCLUSIVE) & POOL_BIG_TABLE_LOCK_EXCLUSIVE)
+    {
+        YieldProcessor();
+    }
+    while (ExpLargePoolTableLock != POOL_BIG_TABLE_LOCK_EXCLUSIVE)
+    {
+        YieldProcessor();
+    }
+
+    return OldIrql;
+}
+
+FORCEINLINE
+VOID
+ExpReleaseBigPageTableExclusive(
+    _In_ _IRQL_restores_ KIRQL OldIrql)
+{
+    InterlockedExchange(&ExpLargePoolTableLock, 0);
+    KeLowerIrql(OldIrql);
+}
+
+static
+BOOLEAN
+ExpCheckTagForBigPages(
+    _In_ PVOID Va,
+    _Out_ PULONG Key);
+
 /*
  * Pool list access debug macros, similar to Arthur's pfnlist.c work.
  * Microsoft actually implements similar checks in the Windows Server 2003 SP1
@@ -299,8 +375,7 @@ ExpCheckPoolAllocation(
     ULONG Tag)
 {
     PPOOL_HEADER Entry;
-    ULONG i;
-    KIRQL OldIrql;
+    ULONG Key;
     POOL_TYPE RealPoolType;
 
     /* Get the pool header */
@@ -309,32 +384,10 @@ ExpCheckPoolAllocation(
     /* Check if this is a large allocation */
     if (PAGE_ALIGN(P) == P)
     {
-        /* Lock the pool table */
-        KeAcquireSpinLock(&ExpLargePoolTableLock, &OldIrql);
-
-        /* Find the pool tag */
-        for (i = 0; i < PoolBigPageTableSize; i++)
-        {
-            /* Check if this is our allocation */
-            if (PoolBigPageTable[i].Va == P)
-            {
-                /* Make sure the tag is ok */
-                if (PoolBigPageTable[i].Key != Tag)
-                {
-                    KeBugCheckEx(BAD_POOL_CALLER, 0x0A, (ULONG_PTR)P, PoolBigPageTable[i].Key, Tag);
-                }
-
-                break;
-            }
-        }
-
-        /* Release the lock */
-        KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
-
-        if (i == PoolBigPageTableSize)
+        /* Find the pool tag, and make sure it is ok */
+        if (ExpCheckTagForBigPages(P, &Key) && (Key != Tag))
         {
-            /* Did not find the allocation */
-            //ASSERT(FALSE);
+            KeBugCheckEx(BAD_POOL_CALLER, 0x0A, (ULONG_PTR)P, Key, Tag);
         }
 
         /* Get Pool type by address */
@@ -1456,14 +1509,12 @@ ExGetPoolTagInfo(IN PSYSTEM_POOLTAG_INFORMATION SystemInformation,
     return Status;
 }
 
-_IRQL_requires_(DISPATCH_LEVEL)
 static
 BOOLEAN
 ExpReallocateBigPageTable(
-    _In_ _IRQL_restores_ KIRQL OldIrql,
+    _In_ SIZE_T OldSize,
     _In_ BOOLEAN Shrink)
 {
-    SIZE_T OldSize = PoolBigPageTableSize;
     SIZE_T NewSize, NewSizeInBytes;
     PPOOL_TRACKER_BIG_PAGES NewTable;
     PPOOL_TRACKER_BIG_PAGES OldTable;
@@ -1471,9 +1522,17 @@ ExpReallocateBigPageTable(
     ULONG PagesFreed;
     ULONG Hash;
     ULONG HashMask;
+    KIRQL OldIrql;
 
-    /* Must be holding ExpLargePoolTableLock */
-    ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+    OldIrql = ExpAcquireBigPageTableExclusive();
+
+    /* Somebody else may have resized the table while we were waiting for the lock */
+    if ((PoolBigPageTableSize != OldSize) ||
+        (Shrink && (ExpPoolBigEntriesInUse >= (OldSize / (POOL_BIG_TABLE_USE_RATE * 2)))))
+    {
+        ExpReleaseBigPageTableExclusive(OldIrql);
+        return TRUE;
+    }
 
     /* Make sure we don't overflow */
     if (Shrink)
@@ -1490,7 +1549,7 @@ ExpReallocateBigPageTable(
         if (NewSize == OldSize)
         {
             ASSERT(NewSize == (PAGE_SIZE / sizeof(POOL_TRACKER_BIG_PAGES)));
-            KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+            ExpReleaseBigPageTableExclusive(OldIrql);
             return TRUE;
         }
     }
@@ -1499,7 +1558,7 @@ ExpReallocateBigPageTable(
         if (!NT_SUCCESS(RtlSIZETMult(2, OldSize, &NewSize)))
         {
             DPRINT1("Overflow expanding big page table. Size=%lu\n", OldSize);
-            KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+            ExpReleaseBigPageTableExclusive(OldIrql);
             return FALSE;
         }
 
@@ -1511,7 +1570,7 @@ ExpReallocateBigPageTable(
     if (!NT_SUCCESS(RtlSIZETMult(sizeof(POOL_TRACKER_BIG_PAGES), NewSize, &NewSizeInBytes)))
     {
         DPRINT1("Overflow while calculating big page table size. Size=%lu\n", OldSize);
-        KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+        ExpReleaseBigPageTableExclusive(OldIrql);
         return FALSE;
     }
 
@@ -1519,7 +1578,7 @@ ExpReallocateBigPageTable(
     if (NewTable == NULL)
     {
         DPRINT("Could not allocate %lu bytes for new big page table\n", NewSizeInBytes);
-        KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+        ExpReleaseBigPageTableExclusive(OldIrql);
         return FALSE;
     }
 
@@ -1543,8 +1602,8 @@ ExpReallocateBigPageTable(
             continue;
         }
 
-        /* Recalculate the hash due to the new table size */
-        Hash = ExpComputePartialHashForAddress(OldTable[i].Va) % HashMask;
+        /* Recalculate the hash due to the new table size, the same way lookups do */
+        Hash = ExpComputePartialHashForAddress(OldTable[i].Va) & HashMask;
 
         /* Find the location in the new table */
         while (!((ULONG_PTR)NewTable[Hash].Va & POOL_BIG_TABLE_ENTRY_FREE))
@@ -1566,7 +1625,7 @@ ExpReallocateBigPageTable(
     PoolBigPageTableHash = PoolBigPageTableSize - 1;
 
     /* Release the lock, we're done changing global state */
-    KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+    ExpReleaseBigPageTableExclusive(OldIrql);
 
     /* Free the old table and update our tracker */
     PagesFreed = MiFreePoolPages(OldTable);
@@ -1576,6 +1635,59 @@ ExpReallocateBigPageTable(
     return TRUE;
 }
 
+_IRQL_requires_(DISPATCH_LEVEL)
+static
+PPOOL_TRACKER_BIG_PAGES
+ExpFindBigPageEntry(
+    _In_ PVOID Va)
+{
+    SIZE_T Hash, Start, TableSize;
+
+    /* Must be holding ExpLargePoolTableLock, shared at least */
+    ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+    //
+    // Probe from the hash bucket of the address, the way ExpAddTagForBigPages
+    // inserted it, wrapping around once at the end of the table
+    //
+    TableSize = PoolBigPageTableSize;
+    Start = Hash = ExpComputePartialHashForAddress(Va) & PoolBigPageTableHash;
+    do
+    {
+        if (PoolBigPageTable[Hash].Va == Va)
+        {
+            return &PoolBigPageTable[Hash];
+        }
+
+        if (++Hash >= TableSize) Hash = 0;
+    } while (Hash != Start);
+
+    //
+    // This means it was never inserted into the pool table
+    //
+    return NULL;
+}
+
+static
+BOOLEAN
+ExpCheckTagForBigPages(
+    _In_ PVOID Va,
+    _Out_ PULONG Key)
+{
+    PPOOL_TRACKER_BIG_PAGES Entry;
+    KIRQL OldIrql;
+
+    OldIrql = ExpAcquireBigPageTableShared();
+    Entry = ExpFindBigPageEntry(Va);
+    if (Entry)
+    {
+        *Key = Entry->Key;
+    }
+    ExpReleaseBigPageTableShared(OldIrql);
+
+    return (Entry != NULL);
+}
+
 BOOLEAN
 NTAPI
 ExpAddTagForBigPages(IN PVOID Va,
@@ -1593,13 +1705,13 @@ ExpAddTagForBigPages(IN PVOID Va,
 
     //
     // As the table is expandable, these values must only be read after acquiring
-    // the lock to avoid a teared access during an expansion
-    // NOTE: Windows uses a special reader/writer SpinLock to improve
-    // performance in the common case (add/remove a tracker entry)
+    // the lock to avoid a teared access during an expansion. The lock is only
+    // taken shared: entries are claimed with an interlocked operation, so that
+    // concurrent insertions only collide when they want the same entry.
     //
 Retry:
     Hash = ExpComputePartialHashForAddress(Va);
-    KeAcquireSpinLock(&ExpLargePoolTableLock, &OldIrql);
+    OldIrql = ExpAcquireBigPageTableShared();
     Hash &= PoolBigPageTableHash;
     TableSize = PoolBigPageTableSize;
 
@@ -1615,11 +1727,10 @@ Retry:
         //
         // Make sure that this is a free entry and attempt to atomically make the
         // entry busy now
-        // NOTE: the Interlocked operation cannot fail with an exclusive SpinLock
         //
         OldVa = Entry->Va;
         if (((ULONG_PTR)OldVa & POOL_BIG_TABLE_ENTRY_FREE) &&
-            (NT_VERIFY(InterlockedCompareExchangePointer(&Entry->Va, Va, OldVa) == OldVa)))
+            (InterlockedCompareExchangePointer(&Entry->Va, Va, OldVa) == OldVa))
         {
             //
             // We now own this entry, write down the size and the pool tag
@@ -1636,20 +1747,20 @@ Retry:
             // keep losing the race or that we are not finding a free entry anymore,
             // which implies a massive number of concurrent big pool allocations.
             //
-            ExpPoolBigEntriesInUse++;
-            if ((i >= 16) && (ExpPoolBigEntriesInUse > (TableSize * (POOL_BIG_TABLE_USE_RATE - 1) / POOL_BIG_TABLE_USE_RATE)))
+            if ((InterlockedIncrement((PLONG)&ExpPoolBigEntriesInUse) > (TableSize * (POOL_BIG_TABLE_USE_RATE - 1) / POOL_BIG_TABLE_USE_RATE)) &&
+                (i >= 16))
             {
                 DPRINT("Attempting expansion since we now have %lu entries\n",
                         ExpPoolBigEntriesInUse);
-                ASSERT(TableSize == PoolBigPageTableSize);
-                ExpReallocateBigPageTable(OldIrql, FALSE);
+                ExpReleaseBigPageTableShared(OldIrql);
+                ExpReallocateBigPageTable(TableSize, FALSE);
                 return TRUE;
             }
 
             //
             // We have our entry, return
             //
-            KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+            ExpReleaseBigPageTableShared(OldIrql);
             return TRUE;
         }
 
@@ -1667,8 +1778,8 @@ Retry:
     // This means there's no free hash buckets whatsoever, so we now have
     // to attempt expanding the table
     //
-    ASSERT(TableSize == PoolBigPageTableSize);
-    if (ExpReallocateBigPageTable(OldIrql, FALSE))
+    ExpReleaseBigPageTableShared(OldIrql);
+    if (ExpReallocateBigPageTable(TableSize, FALSE))
     {
         goto Retry;
     }
@@ -1683,61 +1794,36 @@ ExpFindAndRemoveTagBigPages(IN PVOID Va,
                             OUT PULONG_PTR BigPages,
                             IN POOL_TYPE PoolType)
 {
-    BOOLEAN FirstTry = TRUE;
     SIZE_T TableSize;
     KIRQL OldIrql;
-    ULONG PoolTag, Hash;
+    ULONG PoolTag;
     PPOOL_TRACKER_BIG_PAGES Entry;
     ASSERT(((ULONG_PTR)Va & POOL_BIG_TABLE_ENTRY_FREE) == 0);
     ASSERT(!(PoolType & SESSION_POOL_MASK));
 
     //
-    // As the table is expandable, these values must only be read after acquiring
-    // the lock to avoid a teared access during an expansion
+    // As the table is expandable, it must only be looked at while holding the
+    // lock, to avoid a teared access during an expansion
     //
-    Hash = ExpComputePartialHashForAddress(Va);
-    KeAcquireSpinLock(&ExpLargePoolTableLock, &OldIrql);
-    Hash &= PoolBigPageTableHash;
+    OldIrql = ExpAcquireBigPageTableShared();
     TableSize = PoolBigPageTableSize;
-
-    //
-    // Loop while trying to find this big page allocation
-    //
-    while (PoolBigPageTable[Hash].Va != Va)
+    Entry = ExpFindBigPageEntry(Va);
+    if (!Entry)
     {
         //
-        // Increment the size until we go past the end of the table
+        // This means it was never inserted into the pool table and it
+        // received the special "BIG" tag -- return that and return 0
+        // so that the code can ask Mm for the page count instead
         //
-        if (++Hash >= TableSize)
-        {
-            //
-            // Is this the second time we've tried?
-            //
-            if (!FirstTry)
-            {
-                //
-                // This means it was never inserted into the pool table and it
-                // received the special "BIG" tag -- return that and return 0
-                // so that the code can ask Mm for the page count instead
-                //
-                KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
-                *BigPages = 0;
-                return ' GIB';
-            }
-
-            //
-            // The first time this happens, reset the hash index and try again
-            //
-            Hash = 0;
-            FirstTry = FALSE;
-        }
+        ExpReleaseBigPageTableShared(OldIrql);
+        *BigPages = 0;
+        return ' GIB';
     }
 
     //
     // Now capture all the information we need from the entry, since after we
-    // release the lock, the data can change
+    // set the free bit, the data can change
     //
-    Entry = &PoolBigPageTable[Hash];
     *BigPages = Entry->NumberOfPages;
     PoolTag = Entry->Key;
 
@@ -1745,20 +1831,15 @@ ExpFindAndRemoveTagBigPages(IN PVOID Va,
     // Set the free bit, and decrement the number of allocations. Finally, release
     // the lock and return the tag that was located
     //
-    Entry->Va = (PVOID)((ULONG_PTR)Entry->Va | POOL_BIG_TABLE_ENTRY_FREE);
-
-    ExpPoolBigEntriesInUse--;
+    InterlockedExchangePointer(&Entry->Va, (PVOID)((ULONG_PTR)Va | POOL_BIG_TABLE_ENTRY_FREE));
+    ExpReleaseBigPageTableShared(OldIrql);
 
     /* If reaching 12.5% of the size (or whatever integer rounding gets us to),
      * halve the allocation size, which will get us to 25% of space used. */
-    if (ExpPoolBigEntriesInUse < (PoolBigPageTableSize / (POOL_BIG_TABLE_USE_RATE * 2)))
+    if (InterlockedDecrement((PLONG)&ExpPoolBigEntriesInUse) < (TableSize / (POOL_BIG_TABLE_USE_RATE * 2)))
     {
         /* Shrink the table. */
-        ExpReallocateBigPageTable(OldIrql, TRUE);
-    }
-    else
-    {
-        KeReleaseSpinLock(&ExpLargePoolTableLock, OldIrql);
+        ExpReallocateBigPageTable(TableSize, TRUE);
     }
     return PoolTag;
 }
@@ -439,6 +439,17 @@ typedef struct _MI_LARGE_PAGE_RANGES
     PFN_NUMBER LastFrame;
 } MI_LARGE_PAGE_RANGES, *PMI_LARGE_PAGE_RANGES;
 
+//
+// TB entries to flush after a batch of PTE changes, so that they are all
+// flushed at once. Past FLUSH_MULTIPLE_MAXIMUM entries, the whole TB is.
+//
+typedef struct _MMPTE_FLUSH_LIST
+{
+    ULONG Count;
+    PEPROCESS Process;
+    PVOID FlushVa[FLUSH_MULTIPLE_MAXIMUM];
+} MMPTE_FLUSH_LIST, *PMMPTE_FLUSH_LIST;
+
 typedef struct _MMVIEW
 {
     ULONG_PTR Entry;
@@ -632,6 +643,8 @@ extern PFN_NUMBER MmSystemPageDirectory[PPE_PER_PAGE];
 extern PMMPTE MmSharedUserDataPte;
 extern LIST_ENTRY MmProcessList;
 extern KEVENT MmZeroingPageEvent;
+extern PFN_NUMBER MiPagesZeroedByThreads;
+extern PFN_NUMBER MiPagesZeroedInline;
 extern ULONG MmSystemPageColor;
 extern ULONG MmProcessColorSeed;
 extern PMMWSL MmWorkingSetList;
@@ -2093,6 +2106,37 @@ MiDecrementShareCount(
     IN PFN_NUMBER PageFrameIndex
 );
 
+VOID
+NTAPI
+MiFlushPteList(
+    IN PMMPTE_FLUSH_LIST FlushList
+);
+
+//
+// Starts a TB flush batch for the given process' addresses, or system addresses if NULL
+//
+FORCEINLINE
+VOID
+MiInitializePteFlushList(IN PMMPTE_FLUSH_LIST FlushList,
+                         IN PEPROCESS Process)
+{
+    FlushList->Count = 0;
+    FlushList->Process = Process;
+}
+
+FORCEINLINE
+VOID
+MiInsertPteFlushList(IN PMMPTE_FLUSH_LIST FlushList,
+                     IN PVOID VirtualAddress)
+{
+    /* Once the list overflows, we only need to know that */
+    if (FlushList->Count < FLUSH_MULTIPLE_MAXIMUM)
+    {
+        FlushList->FlushVa[FlushList->Count] = VirtualAddress;
+    }
+    FlushList->Count++;
+}
+
 PFN_NUMBER
 NTAPI
 MiRemoveAnyPage(
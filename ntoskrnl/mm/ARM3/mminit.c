@@ -1575,6 +1575,10 @@ MmDumpArmPfnDatabase(IN BOOLEAN StatusOnly)
     DbgPrint("Free:                 %5d pages\t[%6d KB]\n", FreePages,    (FreePages      << PAGE_SHIFT) / 1024);
     DbgPrint("Other:                %5d pages\t[%6d KB]\n", OtherPages,   (OtherPages     << PAGE_SHIFT) / 1024);
     DbgPrint("-----------------------------------------\n");
+    DbgPrint("Zeroed list:          %5d pages\t[%6d KB]\n", MmZeroedPageListHead.Total, (MmZeroedPageListHead.Total << PAGE_SHIFT) / 1024);
+    DbgPrint("Zeroed by threads:    %5d pages\n", MiPagesZeroedByThreads);
+    DbgPrint("Zeroed on demand:     %5d pages\n", MiPagesZeroedInline);
+    DbgPrint("-----------------------------------------\n");
 #if MI_TRACE_PFNS
     OtherPages = UsageBucket[MI_USAGE_BOOT_DRIVER];
     DbgPrint("Boot Images:          %5d pages\t[%6d KB]\n", OtherPages,   (OtherPages     << PAGE_SHIFT) / 1024);
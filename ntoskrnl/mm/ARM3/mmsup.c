@@ -21,6 +21,82 @@ SIZE_T MmMinimumWorkingSetSize;
 SIZE_T MmMaximumWorkingSetSize;
 SIZE_T MmPagesAboveWsMinimum;
 
+/* PRIVATE FUNCTIONS **********************************************************/
+
+static
+VOID
+MiFlushCurrentTbList(IN PMMPTE_FLUSH_LIST FlushList)
+{
+    ULONG i;
+
+    /* Flush everything if there were too many entries to keep track of */
+    if (FlushList->Count > FLUSH_MULTIPLE_MAXIMUM)
+    {
+        KeFlushCurrentTb();
+        return;
+    }
+
+    for (i = 0; i < FlushList->Count; i++)
+    {
+        KeInvalidateTlbEntry(FlushList->FlushVa[i]);
+    }
+}
+
+#ifdef CONFIG_SMP
+static
+ULONG_PTR
+NTAPI
+MiFlushTbListTarget(IN ULONG_PTR Context)
+{
+    PMMPTE_FLUSH_LIST FlushList = (PMMPTE_FLUSH_LIST)Context;
+
+    /* A processor which isn't running the process doesn't have its entries */
+    if ((FlushList->Process == NULL) ||
+        (FlushList->Process->Pcb.ActiveProcessors & KeGetCurrentPrcb()->SetMember))
+    {
+        MiFlushCurrentTbList(FlushList);
+    }
+
+    return 0;
+}
+#endif
+
+VOID
+NTAPI
+MiFlushPteList(IN PMMPTE_FLUSH_LIST FlushList)
+{
+    KIRQL OldIrql;
+#ifdef CONFIG_SMP
+    KAFFINITY TargetAffinity;
+#endif
+
+    if (FlushList->Count == 0)
+        return;
+
+    /* Don't move to another processor in the middle */
+    OldIrql = KeRaiseIrqlToDpcLevel();
+
+#ifdef CONFIG_SMP
+    /* Only interrupt the others if some of them may have these entries */
+    TargetAffinity = FlushList->Process ?
+                     FlushList->Process->Pcb.ActiveProcessors : KeActiveProcessors;
+    TargetAffinity &= ~KeGetCurrentPrcb()->SetMember;
+    if (TargetAffinity)
+    {
+        /* One IPI for the whole batch */
+        KeIpiGenericCall(MiFlushTbListTarget, (ULONG_PTR)FlushList);
+    }
+    else
+#endif
+    {
+        MiFlushCurrentTbList(FlushList);
+    }
+
+    KeLowerIrql(OldIrql);
+
+    FlushList->Count = 0;
+}
+
 /* PUBLIC FUNCTIONS ***********************************************************/
 
 /*
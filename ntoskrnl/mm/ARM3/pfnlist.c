@@ -38,6 +38,9 @@ ULONG MmSystemPageColor;
 ULONG MmTransitionSharedPages;
 ULONG MmTotalPagesForPagingFile;
 
+/* Pages MiRemoveZeroPage had to zero itself because the zeroed list was empty */
+PFN_NUMBER MiPagesZeroedInline;
+
 MMPFNLIST MmZeroedPageListHead = {0, ZeroedPageList, LIST_HEAD, LIST_HEAD};
 MMPFNLIST MmFreePageListHead = {0, FreePageList, LIST_HEAD, LIST_HEAD};
 MMPFNLIST MmStandbyPageListHead = {0, StandbyPageList, LIST_HEAD, LIST_HEAD};
@@ -594,7 +597,11 @@ MiRemoveZeroPage(IN ULONG Color)
     ASSERT(Pfn1 == MI_PFN_ELEMENT(PageIndex));
 
     /* Zero it, if needed */
-    if (Zero) MiZeroPhysicalPage(PageIndex);
+    if (Zero)
+    {
+        MiZeroPhysicalPage(PageIndex);
+        MiPagesZeroedInline++;
+    }
 
     /* Sanity checks */
     ASSERT(Pfn1->u3.e2.ReferenceCount == 0);
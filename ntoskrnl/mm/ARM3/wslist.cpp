@@ -215,14 +215,40 @@ RemoveFromWsList(PMMWSL WsList, PVOID Address)
     FreeWsleIndex(WsList, Pfn1->u1.WsIndex);
 }
 
+/*
+ * The PTEs of the trimmed pages are flushed from the TB by batches, and a page
+ * can only be let go once no processor has its translation anymore.
+ */
+static
+VOID
+FlushTrimmedPages(PMMPTE_FLUSH_LIST FlushList, PPFN_NUMBER Pages, ULONG& PageCount)
+{
+    MiFlushPteList(FlushList);
+
+    if (PageCount == 0)
+        return;
+
+    ntoskrnl::MiPfnLockGuard PfnLock;
+
+    for (ULONG i = 0; i < PageCount; i++)
+    {
+        /* Drop the share count. This will take care of putting it in the standby or modified list. */
+        MiDecrementShareCount(MiGetPfnEntry(Pages[i]), Pages[i]);
+    }
+
+    PageCount = 0;
+}
+
 static
 ULONG
-TrimWsList(PMMWSL WsList)
+TrimWsList(PMMWSL WsList, PMMPTE_FLUSH_LIST FlushList)
 {
     /* This should be done under WS lock */
     ASSERT(MM_ANY_WS_LOCK_HELD(PsGetCurrentThread()));
 
     ULONG Ret = 0;
+    PFN_NUMBER TrimmedPages[FLUSH_MULTIPLE_MAXIMUM];
+    ULONG TrimmedCount = 0;
 
     /* Walk the array */
     for (ULONG i = WsList->FirstDynamic; i < WsList->LastEntry; i++)
@@ -245,7 +271,7 @@ TrimWsList(PMMWSL WsList)
         {
             Entry.u1.e1.Age = 0;
             PointerPte->u.Hard.Accessed = 0;
-            KeInvalidateTlbEntry(Entry.u1.VirtualAddress);
+            MiInsertPteFlushList(FlushList, Entry.u1.VirtualAddress);
             continue;
         }
 
@@ -283,24 +309,30 @@ TrimWsList(PMMWSL WsList)
                 continue;
             }
 
-            /* We can remove it from the list. Save Protection first */
+            /* We can remove it from the list. Save Protection and address first */
             ULONG Protection = Entry.u1.e1.Protection;
-            RemoveFromWsList(WsList, Entry.u1.VirtualAddress);
+            PVOID Address = Entry.u1.VirtualAddress;
+            RemoveFromWsList(WsList, Address);
 
             /* Dirtify the page, if needed */
             if (PointerPte->u.Hard.Dirty)
                 Pfn->u3.e1.Modified = 1;
 
-            /* Make this a transition PTE */
+            /* Make this a transition PTE. The page is released with the rest of the batch */
             MI_MAKE_TRANSITION_PTE(PointerPte, Page, Protection);
-            KeInvalidateTlbEntry(MiAddressToPte(PointerPte));
-
-            /* Drop the share count. This will take care of putting it in the standby or modified list. */
-            MiDecrementShareCount(Pfn, Page);
+            MiInsertPteFlushList(FlushList, Address);
+            TrimmedPages[TrimmedCount++] = Page;
         }
 
         Ret++;
+
+        if (TrimmedCount == FLUSH_MULTIPLE_MAXIMUM)
+            FlushTrimmedPages(FlushList, TrimmedPages, TrimmedCount);
     }
+
+    /* The WS lock is about to be released, nothing can be left behind */
+    FlushTrimmedPages(FlushList, TrimmedPages, TrimmedCount);
+
     return Ret;
 }
 
@@ -458,10 +490,14 @@ MmWorkingSetManager(VOID)
             (TrimHard && (Vm->WorkingSetSize > Vm->MinimumWorkingSetSize))) &&
             MiConvertSharedWorkingSetLockToExclusive(PsGetCurrentThread(), Vm))
         {
+            MMPTE_FLUSH_LIST FlushList;
+
             /* We're done */
             Vm->Flags.BeingTrimmed = 1;
 
-            ULONG Trimmed = TrimWsList(Vm->VmWorkingSetList);
+            /* TB entries are flushed by batches, not one IPI per page */
+            MiInitializePteFlushList(&FlushList, Process);
+            ULONG Trimmed = TrimWsList(Vm->VmWorkingSetList, &FlushList);
 
             /* We're done */
             Vm->WorkingSetSize -= Trimmed * PAGE_SIZE;
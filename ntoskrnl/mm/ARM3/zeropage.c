@@ -19,6 +19,12 @@
 
 KEVENT MmZeroingPageEvent;
 
+/* Pages zeroed ahead of time by the zero page threads, under the PFN lock */
+PFN_NUMBER MiPagesZeroedByThreads;
+
+/* Number of zero page threads, one per processor (but not more than colors) */
+static ULONG MiZeroPageThreads;
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
 VOID
@@ -31,18 +37,52 @@ NTAPI
 MiFreeInitializationCode(IN PVOID StartVa,
 IN PVOID EndVa);
 
+static
+PFN_NUMBER
+MiFindPageToZero(IN ULONG Index,
+                 IN OUT PULONG Color)
+{
+    PFN_NUMBER PageIndex;
+    ULONG i;
+
+    MI_ASSERT_PFN_LOCK_HELD();
+
+    /* Look at our own colors first, starting where we left off */
+    for (i = Index; i < MmSecondaryColors; i += MiZeroPageThreads)
+    {
+        PageIndex = MmFreePagesByColor[FreePageList][*Color].Flink;
+        if (PageIndex != LIST_HEAD) return PageIndex;
+
+        *Color += MiZeroPageThreads;
+        if (*Color >= MmSecondaryColors) *Color = Index;
+    }
+
+    /* They are all done, so help with the colors of the other threads */
+    PageIndex = MmFreePageListHead.Flink;
+    if (PageIndex != LIST_HEAD)
+    {
+        /* Take the page at the head of its color list, that's what MiRemoveAnyPage will pick */
+        PageIndex = MmFreePagesByColor[FreePageList][MI_GET_PAGE_COLOR(PageIndex)].Flink;
+        ASSERT(PageIndex != LIST_HEAD);
+    }
+
+    return PageIndex;
+}
+
+static
 VOID
-NTAPI
-MmZeroPageThread(VOID)
+MiZeroPageLoop(IN ULONG Index,
+               IN PMMPTE ZeroingPte)
 {
     PKTHREAD Thread = KeGetCurrentThread();
-    PVOID StartAddress, EndAddress;
     PVOID WaitObjects[2];
+    ULONG Color = Index;
 
-    /* Get the discardable sections to free them */
-    MiFindInitializationCode(&StartAddress, &EndAddress);
-    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
-    DPRINT("Free pages: %lx\n", MmAvailablePages);
+    /*
+     * Stay on our processor: the zeroing PTEs are only ever used there, so
+     * flushing its TB is enough when they get recycled.
+     */
+    KeSetSystemAffinityThread(AFFINITY_MASK(Index));
 
     /* Set our priority to 0 */
     Thread->BasePriority = 0;
@@ -77,16 +117,15 @@ MmZeroPageThread(VOID)
             {
                 PMMPFN Pfn2;
 
-                if (!MmFreePageListHead.Total)
+                PageIndex = MiFindPageToZero(Index, &Color);
+                if (PageIndex == LIST_HEAD)
                     break;
 
-                PageIndex = MmFreePageListHead.Flink;
-                ASSERT(PageIndex != LIST_HEAD);
                 MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
                 MI_SET_PROCESS2("Kernel 0 Loop");
                 FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
 
-                /* The first global free page should also be the first on its own list */
+                /* The first free page of a color should also be the one we get */
                 if (FreePage != PageIndex)
                 {
                     KeBugCheckEx(PFN_LIST_CORRUPT,
@@ -101,15 +140,17 @@ MmZeroPageThread(VOID)
                 Pfn1 = Pfn2;
                 PageCount++;
             }
-            MiReleasePfnLock(OldIrql);
 
             if (PageCount == 0)
             {
+                /* There is nothing left for anyone, so everybody can go back to sleep */
                 KeClearEvent(&MmZeroingPageEvent);
+                MiReleasePfnLock(OldIrql);
                 break;
             }
+            MiReleasePfnLock(OldIrql);
 
-            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, PageCount);
+            ZeroAddress = MiMapPagesInZeroSpace(ZeroingPte, Pfn1, PageCount);
             ASSERT(ZeroAddress);
             KeZeroPages(ZeroAddress, PageCount * PAGE_SIZE);
             MiUnmapPagesInZeroSpace(ZeroAddress, PageCount);
@@ -122,8 +163,70 @@ MmZeroPageThread(VOID)
                 Pfn1 = (PMMPFN)Pfn1->u1.Flink;
                 MiInsertPageInList(&MmZeroedPageListHead, PageIndex);
             }
+            MiPagesZeroedByThreads += PageCount;
+        }
+    }
+}
+
+static
+VOID
+NTAPI
+MiZeroPageWorkerThread(IN PVOID Context)
+{
+    ULONG Index = PtrToUlong(Context);
+    PMMPTE ZeroingPte;
+
+    /* Get our own zeroing PTEs, laid out like MiFirstReservedZeroingPte */
+    ZeroingPte = MiReserveSystemPtes(MI_ZERO_PTES + 1, SystemPteSpace);
+    if (!ZeroingPte)
+    {
+        /* The other threads will take care of our colors */
+        DPRINT1("No zeroing PTEs for zero page thread %lu\n", Index);
+        PsTerminateSystemThread(STATUS_INSUFFICIENT_RESOURCES);
+    }
+    RtlZeroMemory(ZeroingPte, (MI_ZERO_PTES + 1) * sizeof(MMPTE));
+    ZeroingPte->u.Hard.PageFrameNumber = MI_ZERO_PTES;
+
+    MiZeroPageLoop(Index, ZeroingPte);
+}
+
+VOID
+NTAPI
+MmZeroPageThread(VOID)
+{
+    PVOID StartAddress, EndAddress;
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+    ULONG i;
+
+    /* Get the discardable sections to free them */
+    MiFindInitializationCode(&StartAddress, &EndAddress);
+    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
+    DPRINT("Free pages: %lx\n", MmAvailablePages);
+
+    /*
+     * Zero pages on every processor, each thread taking care of its own share
+     * of the colors. We are the first one and use the boot zeroing PTEs.
+     */
+    MiZeroPageThreads = min((ULONG)KeNumberProcessors, MmSecondaryColors);
+    for (i = 1; i < MiZeroPageThreads; i++)
+    {
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      NULL,
+                                      NULL,
+                                      NULL,
+                                      MiZeroPageWorkerThread,
+                                      UlongToPtr(i));
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to create zero page thread %lu: 0x%lx\n", i, Status);
+            continue;
         }
+        ZwClose(ThreadHandle);
     }
+
+    MiZeroPageLoop(0, MiFirstReservedZeroingPte);
 }
 
 /* EOF */
@@ -139,19 +139,39 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
 {
     PFN_NUMBER FirstPage, CurrentPage;
     NTSTATUS Status;
+    MM_PAGEOUT_CLUSTER Clusters[2];
+    PMM_PAGEOUT_CLUSTER Cluster, WritingCluster;
 
     (*NrFreedPages) = 0;
 
     DPRINT("MM BALANCER: %s\n", Priority ? "Paging out!" : "Removing access bit!");
 
+    /*
+     * Dirty private pages are gathered in a cluster, and written together in one I/O.
+     * While one cluster is being written, we fill the other one.
+     */
+    Clusters[0].Count = Clusters[1].Count = 0;
+    Clusters[0].WriteInProgress = Clusters[1].WriteInProgress = FALSE;
+    Cluster = &Clusters[0];
+    WritingCluster = &Clusters[1];
+
     FirstPage = MmGetLRUFirstUserPage();
     CurrentPage = FirstPage;
     while (CurrentPage != 0 && Target > 0)
     {
         if (Priority)
         {
-            Status = MmPageOutPhysicalAddress(CurrentPage);
-            if (NT_SUCCESS(Status))
+            Status = MmPageOutPhysicalAddressEx(CurrentPage, Cluster);
+            if (Status == STATUS_PENDING)
+            {
+                /* It will be counted as freed once written */
+                Target--;
+                if (CurrentPage == FirstPage)
+                {
+                    FirstPage = 0;
+                }
+            }
+            else if (NT_SUCCESS(Status))
             {
                 DPRINT("Succeeded\n");
                 Target--;
@@ -248,7 +268,7 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
             {
                 /* Nobody accessed this page since the last time we check. Time to clean up */
 
-                Status = MmPageOutPhysicalAddress(CurrentPage);
+                Status = MmPageOutPhysicalAddressEx(CurrentPage, Cluster);
                 if (NT_SUCCESS(Status))
                 {
                     if (CurrentPage == FirstPage)
@@ -263,6 +283,17 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
             Target--;
         }
 
+        if (Cluster->Count == MM_PAGEFILE_WRITE_CLUSTER)
+        {
+            PMM_PAGEOUT_CLUSTER FullCluster = Cluster;
+
+            /* Reap the previous write, and send this one */
+            MmCompletePageOutCluster(WritingCluster, NrFreedPages);
+            MmStartPageOutCluster(FullCluster);
+            Cluster = WritingCluster;
+            WritingCluster = FullCluster;
+        }
+
         CurrentPage = MmGetLRUNextUserPage(CurrentPage, TRUE);
         if (FirstPage == 0)
         {
@@ -271,7 +302,7 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         else if (CurrentPage == FirstPage)
         {
             DPRINT1("We are back at the start, abort!\n");
-            return STATUS_SUCCESS;
+            break;
         }
     }
 
@@ -282,6 +313,11 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         MiReleasePfnLock(OldIrql);
     }
 
+    /* Write what is left */
+    MmStartPageOutCluster(Cluster);
+    MmCompletePageOutCluster(WritingCluster, NrFreedPages);
+    MmCompletePageOutCluster(Cluster, NrFreedPages);
+
     return STATUS_SUCCESS;
 }
 
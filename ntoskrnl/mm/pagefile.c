@@ -100,6 +100,38 @@ static PFN_COUNT MiReservedSwapPages;
 /* Make sure there can be only 16 paging files */
 C_ASSERT(FILE_FROM_ENTRY(0xffffffff) < MAX_PAGING_FILES);
 
+/* MmStartSwapWrite builds the page array of the MDL in place */
+C_ASSERT(FIELD_OFFSET(MM_PAGEFILE_WRITE, MdlPages) == FIELD_OFFSET(MM_PAGEFILE_WRITE, Mdl) + sizeof(MDL));
+
+/*
+ * Single page allocations are served from a run of free slots which each
+ * processor takes from a paging file at once, so that they don't all go
+ * through MmPageFileCreationLock and the bitmap search.
+ */
+#define MI_SWAP_CACHE_RUN       16
+
+typedef struct DECLSPEC_CACHEALIGN _MI_SWAP_CACHE
+{
+    KSPIN_LOCK Lock;
+    SWAPENTRY Entry;
+    ULONG Count;
+    ULONG Hits;
+} MI_SWAP_CACHE, *PMI_SWAP_CACHE;
+
+static MI_SWAP_CACHE MiSwapCache[MAXIMUM_PROCESSORS];
+
+/* Swap slot allocator statistics, updated with MmPageFileCreationLock held */
+typedef struct _MI_SWAP_STATISTICS
+{
+    ULONG Allocations;
+    ULONG LockAcquisitions;
+    ULONGLONG LockHoldTicks;
+    ULONG MaxLockHoldTicks;
+    LARGE_INTEGER Frequency;
+} MI_SWAP_STATISTICS, *PMI_SWAP_STATISTICS;
+
+static MI_SWAP_STATISTICS MiSwapStatistics;
+
 static BOOLEAN MmSwapSpaceMessage = FALSE;
 
 static BOOLEAN MmSystemPageFileLocated = FALSE;
@@ -142,60 +174,110 @@ MmShowOutOfSpaceMessagePagingFile(VOID)
     }
 }
 
-NTSTATUS
+static
+VOID
+MiUpdateMaxWriteTime(PMMPAGING_FILE PagingFile, ULONG Time)
+{
+    ULONG OldTime;
+
+    /* Only keep the biggest value, no matter who else updates it */
+    OldTime = PagingFile->MaxWriteTime;
+    while (Time > OldTime)
+    {
+        OldTime = InterlockedCompareExchange((PLONG)&PagingFile->MaxWriteTime, Time, OldTime);
+    }
+}
+
+VOID
 NTAPI
-MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+MmStartSwapWrite(PMM_PAGEFILE_WRITE Write, SWAPENTRY SwapEntry, PPFN_NUMBER Pages, ULONG PageCount)
 {
     ULONG i;
     ULONG_PTR offset;
     LARGE_INTEGER file_offset;
-    IO_STATUS_BLOCK Iosb;
-    NTSTATUS Status;
-    KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(PFN_NUMBER)];
-    PMDL Mdl = (PMDL)MdlBase;
+    PMMPAGING_FILE PagingFile;
 
-    DPRINT("MmWriteToSwapPage\n");
+    DPRINT("MmStartSwapWrite(%p, %lu)\n", SwapEntry, PageCount);
 
-    if (SwapEntry == 0)
+    if (SwapEntry == 0 || PageCount == 0 || PageCount > MM_PAGEFILE_WRITE_CLUSTER)
     {
         KeBugCheck(MEMORY_MANAGEMENT);
-        return(STATUS_UNSUCCESSFUL);
+        return;
     }
 
     i = FILE_FROM_ENTRY(SwapEntry);
     offset = OFFSET_FROM_ENTRY(SwapEntry) - 1;
 
-    if (MmPagingFile[i]->FileObject == NULL ||
-            MmPagingFile[i]->FileObject->DeviceObject == NULL)
+    PagingFile = MmPagingFile[i];
+    if (PagingFile->FileObject == NULL ||
+            PagingFile->FileObject->DeviceObject == NULL)
     {
         DPRINT1("Bad paging file 0x%.8X\n", SwapEntry);
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
-    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
+    Write->SwapEntry = SwapEntry;
+    Write->PageCount = PageCount;
+
+    /* The whole run goes out in a single I/O */
+    MmInitializeMdl(&Write->Mdl, NULL, PageCount << PAGE_SHIFT);
+    MmBuildMdlFromPages(&Write->Mdl, Pages);
+    Write->Mdl.MdlFlags |= MDL_PAGES_LOCKED;
 
     file_offset.QuadPart = offset * PAGE_SIZE;
 
-    KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoSynchronousPageWrite(MmPagingFile[i]->FileObject,
-                                    Mdl,
-                                    &file_offset,
-                                    &Event,
-                                    &Iosb);
-    if (Status == STATUS_PENDING)
+    /* Don't wait for it, MmWaitForSwapWrite will */
+    KeInitializeEvent(&Write->Event, NotificationEvent, FALSE);
+    Write->StartTime = KeQueryPerformanceCounter(NULL);
+    Write->Status = IoSynchronousPageWrite(PagingFile->FileObject,
+                                           &Write->Mdl,
+                                           &file_offset,
+                                           &Write->Event,
+                                           &Write->Iosb);
+}
+
+NTSTATUS
+NTAPI
+MmWaitForSwapWrite(PMM_PAGEFILE_WRITE Write)
+{
+    PMMPAGING_FILE PagingFile;
+    LARGE_INTEGER EndTime, Frequency;
+    ULONG Time;
+
+    if (Write->Status == STATUS_PENDING)
     {
-        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
-        Status = Iosb.Status;
+        KeWaitForSingleObject(&Write->Event, Executive, KernelMode, FALSE, NULL);
+        Write->Status = Write->Iosb.Status;
     }
 
-    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    if (Write->Mdl.MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
     {
-        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        MmUnmapLockedPages(Write->Mdl.MappedSystemVa, &Write->Mdl);
     }
-    return(Status);
+
+    /* This is the latency seen by the writer, not only the one of the device */
+    EndTime = KeQueryPerformanceCounter(&Frequency);
+    Time = (ULONG)(((EndTime.QuadPart - Write->StartTime.QuadPart) * 1000000) / Frequency.QuadPart);
+
+    PagingFile = MmPagingFile[FILE_FROM_ENTRY(Write->SwapEntry)];
+    InterlockedIncrement((PLONG)&PagingFile->WriteIos);
+    InterlockedExchangeAdd64((PLONG64)&PagingFile->PagesWritten, Write->PageCount);
+    InterlockedExchangeAdd64((PLONG64)&PagingFile->WriteTime, Time);
+    MiUpdateMaxWriteTime(PagingFile, Time);
+
+    return Write->Status;
+}
+
+NTSTATUS
+NTAPI
+MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+{
+    MM_PAGEFILE_WRITE Write;
+
+    DPRINT("MmWriteToSwapPage\n");
+
+    MmStartSwapWrite(&Write, SwapEntry, &Page, 1);
+    return MmWaitForSwapWrite(&Write);
 }
 
 
@@ -206,24 +288,50 @@ MmReadFromSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
     return MiReadPageFile(Page, FILE_FROM_ENTRY(SwapEntry), OFFSET_FROM_ENTRY(SwapEntry));
 }
 
+NTSTATUS
+NTAPI
+MmReadFromSwapPages(SWAPENTRY SwapEntry, PPFN_NUMBER Pages, ULONG PageCount)
+{
+    return MiReadPageFileCluster(Pages, PageCount, FILE_FROM_ENTRY(SwapEntry), OFFSET_FROM_ENTRY(SwapEntry));
+}
+
+SWAPENTRY
+NTAPI
+MmGetNextSwapEntry(SWAPENTRY SwapEntry)
+{
+    /* The entry of the page which follows this one in the same paging file */
+    return ENTRY_FROM_FILE_OFFSET(FILE_FROM_ENTRY(SwapEntry), OFFSET_FROM_ENTRY(SwapEntry) + 1);
+}
+
 NTSTATUS
 NTAPI
 MiReadPageFile(
     _In_ PFN_NUMBER Page,
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset)
+{
+    return MiReadPageFileCluster(&Page, 1, PageFileIndex, PageFileOffset);
+}
+
+NTSTATUS
+NTAPI
+MiReadPageFileCluster(
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount,
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
 {
     LARGE_INTEGER file_offset;
     IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(PFN_NUMBER)];
+    UCHAR MdlBase[sizeof(MDL) + MM_PAGEFILE_READ_CLUSTER * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
     PMMPAGING_FILE PagingFile;
 
     DPRINT("MiReadSwapFile\n");
 
-    if (PageFileOffset == 0)
+    if (PageFileOffset == 0 || PageCount == 0 || PageCount > MM_PAGEFILE_READ_CLUSTER)
     {
         KeBugCheck(MEMORY_MANAGEMENT);
         return(STATUS_UNSUCCESSFUL);
@@ -242,8 +350,8 @@ MiReadPageFile(
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
+    MmInitializeMdl(Mdl, NULL, PageCount << PAGE_SHIFT);
+    MmBuildMdlFromPages(Mdl, Pages);
     Mdl->MdlFlags |= MDL_PAGES_LOCKED | MDL_IO_PAGE_READ;
 
     file_offset.QuadPart = PageFileOffset * PAGE_SIZE;
@@ -263,6 +371,10 @@ MiReadPageFile(
     {
         MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
     }
+
+    InterlockedIncrement((PLONG)&PagingFile->ReadIos);
+    InterlockedExchangeAdd64((PLONG64)&PagingFile->PagesRead, PageCount);
+
     return(Status);
 }
 
@@ -283,82 +395,262 @@ MmInitPagingFile(VOID)
     {
         MmPagingFile[i] = NULL;
     }
+
+    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    {
+        KeInitializeSpinLock(&MiSwapCache[i].Lock);
+        MiSwapCache[i].Count = 0;
+    }
+
     MmNumberOfPagingFiles = 0;
 }
 
+static
 VOID
-NTAPI
-MmFreeSwapPage(SWAPENTRY Entry)
+MiAcquireSwapLock(PLARGE_INTEGER StartTime)
+{
+    KeAcquireGuardedMutex(&MmPageFileCreationLock);
+    *StartTime = KeQueryPerformanceCounter(NULL);
+}
+
+static
+VOID
+MiReleaseSwapLock(PLARGE_INTEGER StartTime)
+{
+    LARGE_INTEGER EndTime;
+    ULONG Ticks;
+
+    /* Account for how long we held it, while we still do */
+    EndTime = KeQueryPerformanceCounter(&MiSwapStatistics.Frequency);
+    Ticks = (ULONG)(EndTime.QuadPart - StartTime->QuadPart);
+    MiSwapStatistics.LockAcquisitions++;
+    MiSwapStatistics.LockHoldTicks += Ticks;
+    if (Ticks > MiSwapStatistics.MaxLockHoldTicks)
+    {
+        MiSwapStatistics.MaxLockHoldTicks = Ticks;
+    }
+
+    KeReleaseGuardedMutex(&MmPageFileCreationLock);
+}
+
+/*
+ * MiFreeSwapPages counts the slots sitting in the processor caches as free,
+ * so it is only updated when slots are handed out or given back, which the
+ * cached path does without the lock.
+ */
+static
+VOID
+MiChargeSwapPages(LONG Count)
+{
+    InterlockedExchangeAdd((PLONG)&MiFreeSwapPages, -Count);
+    InterlockedExchangeAdd((PLONG)&MiUsedSwapPages, Count);
+    UpdateTotalCommittedPages(Count);
+}
+
+static
+SWAPENTRY
+MiAllocSwapRun(ULONG Count)
 {
     ULONG i;
+    ULONG off;
+    PMMPAGING_FILE PagingFile;
+
+    ASSERT(KeAreAllApcsDisabled());
+
+    for (i = 0; i < MAX_PAGING_FILES; i++)
+    {
+        PagingFile = MmPagingFile[i];
+        if (PagingFile == NULL || PagingFile->FreeSpace < Count)
+            continue;
+
+        /*
+         * Start where the previous allocation stopped rather than scanning the
+         * used beginning of the bitmap again. The run has to be contiguous, so
+         * that it can be written at once.
+         */
+        off = RtlFindClearBitsAndSet(PagingFile->Bitmap, Count, PagingFile->AllocationHint);
+        if (off == 0xFFFFFFFF)
+            continue;
+
+        PagingFile->AllocationHint = off + Count;
+        PagingFile->FreeSpace -= Count;
+        PagingFile->CurrentUsage += Count;
+
+        return ENTRY_FROM_FILE_OFFSET(i, off + 1);
+    }
+
+    /* Fragmented, or the free slots belong to several paging files */
+    return 0;
+}
+
+static
+VOID
+MiReleaseSwapRun(SWAPENTRY Entry, ULONG Count)
+{
     ULONG_PTR off;
     PMMPAGING_FILE PagingFile;
 
-    i = FILE_FROM_ENTRY(Entry);
-    off = OFFSET_FROM_ENTRY(Entry) - 1;
+    ASSERT(KeAreAllApcsDisabled());
 
-    KeAcquireGuardedMutex(&MmPageFileCreationLock);
+    off = OFFSET_FROM_ENTRY(Entry) - 1;
 
-    PagingFile = MmPagingFile[i];
+    PagingFile = MmPagingFile[FILE_FROM_ENTRY(Entry)];
     if (PagingFile == NULL)
     {
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    RtlClearBit(PagingFile->Bitmap, off >> 5);
+    ASSERT(RtlAreBitsSet(PagingFile->Bitmap, (ULONG)off, Count));
+    RtlClearBits(PagingFile->Bitmap, (ULONG)off, Count);
+
+    PagingFile->FreeSpace += Count;
+    PagingFile->CurrentUsage -= Count;
+}
 
-    PagingFile->FreeSpace++;
-    PagingFile->CurrentUsage--;
+static
+SWAPENTRY
+MiTakeCachedSwapPage(PMI_SWAP_CACHE Cache)
+{
+    SWAPENTRY Entry = 0;
+    KIRQL OldIrql;
 
-    MiFreeSwapPages++;
-    MiUsedSwapPages--;
-    UpdateTotalCommittedPages(-1);
+    if (Cache->Count == 0)
+        return 0;
 
-    KeReleaseGuardedMutex(&MmPageFileCreationLock);
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+    if (Cache->Count != 0)
+    {
+        Entry = Cache->Entry;
+        Cache->Entry = MmGetNextSwapEntry(Entry);
+        Cache->Count--;
+        Cache->Hits++;
+    }
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+
+    return Entry;
+}
+
+VOID
+NTAPI
+MmFreeSwapPages(SWAPENTRY Entry, ULONG Count)
+{
+    LARGE_INTEGER LockTime;
+
+    ASSERT(Count != 0);
+
+    MiAcquireSwapLock(&LockTime);
+    MiReleaseSwapRun(Entry, Count);
+    MiReleaseSwapLock(&LockTime);
+
+    MiChargeSwapPages(-(LONG)Count);
+}
+
+VOID
+NTAPI
+MmFreeSwapPage(SWAPENTRY Entry)
+{
+    MmFreeSwapPages(Entry, 1);
+}
+
+SWAPENTRY
+NTAPI
+MmAllocSwapPages(ULONG Count)
+{
+    LARGE_INTEGER LockTime;
+    SWAPENTRY Entry;
+
+    ASSERT(Count != 0);
+
+    if (MiFreeSwapPages < Count)
+    {
+        return(0);
+    }
+
+    MiAcquireSwapLock(&LockTime);
+    Entry = MiAllocSwapRun(Count);
+    if (Entry)
+    {
+        MiSwapStatistics.Allocations++;
+    }
+    MiReleaseSwapLock(&LockTime);
+
+    if (Entry)
+    {
+        MiChargeSwapPages(Count);
+    }
+
+    return(Entry);
 }
 
 SWAPENTRY
 NTAPI
 MmAllocSwapPage(VOID)
 {
+    PMI_SWAP_CACHE Cache;
+    LARGE_INTEGER LockTime;
+    SWAPENTRY Entry, Run;
+    KIRQL OldIrql;
     ULONG i;
-    ULONG off;
-    SWAPENTRY entry;
-
-    KeAcquireGuardedMutex(&MmPageFileCreationLock);
 
     if (MiFreeSwapPages == 0)
     {
-        KeReleaseGuardedMutex(&MmPageFileCreationLock);
         return(0);
     }
 
-    for (i = 0; i < MAX_PAGING_FILES; i++)
+    /* Most of the time, this processor still has a slot for us */
+    Cache = &MiSwapCache[KeGetCurrentProcessorNumber()];
+    Entry = MiTakeCachedSwapPage(Cache);
+    if (Entry == 0)
     {
-        if (MmPagingFile[i] != NULL &&
-                MmPagingFile[i]->FreeSpace >= 1)
+        /* Get a new run for the cache, or at least a slot for us */
+        MiAcquireSwapLock(&LockTime);
+        Run = MiAllocSwapRun(MI_SWAP_CACHE_RUN);
+        if (Run == 0)
         {
-            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, 0);
-            if (off == 0xFFFFFFFF)
+            Entry = MiAllocSwapRun(1);
+        }
+        if (Run || Entry)
+        {
+            MiSwapStatistics.Allocations++;
+        }
+        MiReleaseSwapLock(&LockTime);
+
+        if (Run)
+        {
+            Entry = Run;
+            Run = MmGetNextSwapEntry(Run);
+
+            KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+            if (Cache->Count == 0)
             {
-                KeBugCheck(MEMORY_MANAGEMENT);
-                KeReleaseGuardedMutex(&MmPageFileCreationLock);
-                return(STATUS_UNSUCCESSFUL);
+                Cache->Entry = Run;
+                Cache->Count = MI_SWAP_CACHE_RUN - 1;
+                Run = 0;
             }
-            MiUsedSwapPages++;
-            MiFreeSwapPages--;
-            UpdateTotalCommittedPages(1);
-
-            KeReleaseGuardedMutex(&MmPageFileCreationLock);
+            KeReleaseSpinLock(&Cache->Lock, OldIrql);
 
-            entry = ENTRY_FROM_FILE_OFFSET(i, off + 1);
-            return(entry);
+            if (Run)
+            {
+                /* Someone refilled it in the meantime, give ours back */
+                MiAcquireSwapLock(&LockTime);
+                MiReleaseSwapRun(Run, MI_SWAP_CACHE_RUN - 1);
+                MiReleaseSwapLock(&LockTime);
+            }
         }
     }
 
-    KeReleaseGuardedMutex(&MmPageFileCreationLock);
-    KeBugCheck(MEMORY_MANAGEMENT);
-    return(0);
+    /* The last free slots may be cached by other processors, take one of theirs */
+    for (i = 0; (Entry == 0) && (i < (ULONG)KeNumberProcessors); i++)
+    {
+        Entry = MiTakeCachedSwapPage(&MiSwapCache[i]);
+    }
+
+    if (Entry)
+    {
+        MiChargeSwapPages(1);
+    }
+
+    return(Entry);
 }
 
 NTSTATUS
@@ -792,13 +1084,22 @@ EarlyQuit:
                         (ULONG)(PagingFile->MaximumSize));
     RtlClearAllBits(PagingFile->Bitmap);
 
+    /* Never hand out the header, nor what lies past the end of the file */
+    RtlSetBit(PagingFile->Bitmap, 0);
+    if (PagingFile->MaximumSize > PagingFile->Size)
+    {
+        RtlSetBits(PagingFile->Bitmap,
+                   (ULONG)PagingFile->Size,
+                   (ULONG)(PagingFile->MaximumSize - PagingFile->Size));
+    }
+
     /* Insert the new paging file information into the list */
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
     /* Ensure the corresponding slot is empty yet */
     ASSERT(MmPagingFile[MmNumberOfPagingFiles] == NULL);
     MmPagingFile[MmNumberOfPagingFiles] = PagingFile;
     MmNumberOfPagingFiles++;
-    MiFreeSwapPages = MiFreeSwapPages + PagingFile->FreeSpace;
+    InterlockedExchangeAdd((PLONG)&MiFreeSwapPages, (LONG)PagingFile->FreeSpace);
     KeReleaseGuardedMutex(&MmPageFileCreationLock);
 
     MmSwapSpaceMessage = FALSE;
@@ -811,4 +1112,57 @@ EarlyQuit:
     return STATUS_SUCCESS;
 }
 
+#if DBG && defined(KDBG)
+
+#include <kdbg/kdb.h>
+
+BOOLEAN
+ExpKdbgExtPageFile(ULONG Argc, PCHAR Argv[])
+{
+    PMMPAGING_FILE PagingFile;
+    PMI_SWAP_STATISTICS Stats = &MiSwapStatistics;
+    ULONGLONG Frequency = Stats->Frequency.QuadPart ? Stats->Frequency.QuadPart : 1;
+    ULONG i, Cached = 0, Hits = 0;
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        Cached += MiSwapCache[i].Count;
+        Hits += MiSwapCache[i].Hits;
+    }
+
+    KdbpPrint("Swap pages:\t%lu used, %lu free, %lu of them cached\n",
+              MiUsedSwapPages, MiFreeSwapPages, Cached);
+    KdbpPrint("Allocations:\t%lu from the bitmap, %lu from the processor caches\n",
+              Stats->Allocations, Hits);
+    KdbpPrint("Lock:\t\t%lu acquisitions, average %I64u us, max %I64u us held\n",
+              Stats->LockAcquisitions,
+              Stats->LockAcquisitions ?
+              Stats->LockHoldTicks * 1000000 / Frequency / Stats->LockAcquisitions : 0,
+              (ULONGLONG)Stats->MaxLockHoldTicks * 1000000 / Frequency);
+
+    for (i = 0; i < MAX_PAGING_FILES; i++)
+    {
+        PagingFile = MmPagingFile[i];
+        if (PagingFile == NULL)
+            continue;
+
+        KdbpPrint("\n%lu: %wZ\n", i, &PagingFile->PageFileName);
+        KdbpPrint("  Size:\t\t%Iu pages, %Iu used, %Iu free\n",
+                  PagingFile->Size, PagingFile->CurrentUsage, PagingFile->FreeSpace);
+        KdbpPrint("  Writes:\t%lu for %I64u pages (%I64u per I/O)\n",
+                  PagingFile->WriteIos, PagingFile->PagesWritten,
+                  PagingFile->WriteIos ? PagingFile->PagesWritten / PagingFile->WriteIos : 0);
+        KdbpPrint("  Write time:\taverage %I64u us, max %lu us\n",
+                  PagingFile->WriteIos ? PagingFile->WriteTime / PagingFile->WriteIos : 0,
+                  PagingFile->MaxWriteTime);
+        KdbpPrint("  Reads:\t%lu for %I64u pages (%I64u per I/O)\n",
+                  PagingFile->ReadIos, PagingFile->PagesRead,
+                  PagingFile->ReadIos ? PagingFile->PagesRead / PagingFile->ReadIos : 0);
+    }
+
+    return TRUE;
+}
+
+#endif // DBG && defined(KDBG)
+
 /* EOF */
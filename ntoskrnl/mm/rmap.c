@@ -49,6 +49,19 @@ MmInitializeRmapList(VOID)
 NTSTATUS
 NTAPI
 MmPageOutPhysicalAddress(PFN_NUMBER Page)
+{
+    return MmPageOutPhysicalAddressEx(Page, NULL);
+}
+
+/*
+ * Same as MmPageOutPhysicalAddress, but when a cluster is given, a dirty
+ * private page is only unmapped and added to it, and STATUS_PENDING is
+ * returned. The page is written and released with the rest of the cluster
+ * by MmStartPageOutCluster and MmCompletePageOutCluster.
+ */
+NTSTATUS
+NTAPI
+MmPageOutPhysicalAddressEx(PFN_NUMBER Page, PMM_PAGEOUT_CLUSTER Cluster)
 {
     PMM_RMAP_ENTRY entry;
     PMEMORY_AREA MemoryArea;
@@ -183,6 +196,30 @@ GetEntry:
             /* Check if we should write it back to the page file */
             SwapEntry = MmGetSavedSwapEntryPage(Page);
 
+            if (Dirty && Cluster && (Cluster->Count < MM_PAGEFILE_WRITE_CLUSTER))
+            {
+                /* The old copy is stale, the page gets a new one along with the rest of the cluster */
+                if (SwapEntry)
+                {
+                    MmSetSavedSwapEntryPage(Page, 0);
+                    MmFreeSwapPage(SwapEntry);
+                }
+
+                /* Put a wait entry into the process until the cluster is written */
+                MmCreatePageFileMapping(Process, Address, MM_WAIT_ENTRY);
+                MmUnlockAddressSpace(AddressSpace);
+                if (Process != PsInitialSystemProcess)
+                    KeDetachProcess();
+
+                /* The cluster keeps our rundown protection and reference on the process */
+                Cluster->Process[Cluster->Count] = Process;
+                Cluster->Address[Cluster->Count] = Address;
+                Cluster->Page[Cluster->Count] = Page;
+                Cluster->Count++;
+
+                return STATUS_PENDING;
+            }
+
             if ((SwapEntry == 0) && Dirty)
             {
                 /* We don't have a Swap entry, yet the page is dirty. Get one */
@@ -322,6 +359,143 @@ WriteSegment:
     return STATUS_UNSUCCESSFUL;
 }
 
+VOID
+NTAPI
+MmStartPageOutCluster(PMM_PAGEOUT_CLUSTER Cluster)
+{
+    SWAPENTRY SwapEntry;
+
+    ASSERT(!Cluster->WriteInProgress);
+
+    if (Cluster->Count == 0)
+        return;
+
+    /* Get a contiguous run for the whole cluster, so that it goes out in one I/O */
+    SwapEntry = MmAllocSwapPages(Cluster->Count);
+    if (SwapEntry == 0)
+    {
+        /* MmCompletePageOutCluster will write the pages one by one */
+        return;
+    }
+
+    MmStartSwapWrite(&Cluster->Write, SwapEntry, Cluster->Page, Cluster->Count);
+    Cluster->WriteInProgress = TRUE;
+}
+
+static
+BOOLEAN
+MiCompletePageOut(PEPROCESS Process, PVOID Address, PFN_NUMBER Page, SWAPENTRY SwapEntry)
+{
+    PMMSUPPORT AddressSpace = &Process->Vm;
+    PMEMORY_AREA MemoryArea;
+    PMM_REGION Region;
+    SWAPENTRY Dummy;
+
+    MmLockAddressSpace(AddressSpace);
+    if (Process != PsInitialSystemProcess)
+        KeAttachProcess(&Process->Pcb);
+
+    MmDeletePageFileMapping(Process, Address, &Dummy);
+    ASSERT(Dummy == MM_WAIT_ENTRY);
+
+    if (SwapEntry)
+    {
+        /* Keep this in the process VM */
+        MmCreatePageFileMapping(Process, Address, SwapEntry);
+    }
+    else
+    {
+        /* We failed at saving the content of this page. Keep it in */
+        MemoryArea = MmLocateMemoryAreaByAddress(AddressSpace, Address);
+        ASSERT(MemoryArea != NULL);
+        Region = MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
+                              &MemoryArea->SectionData.RegionListHead,
+                              Address, NULL);
+
+        MmCreateVirtualMapping(Process, Address, Region->Protect, Page);
+        MmInsertRmap(Page, Process, Address);
+        MmSetDirtyPage(Process, Address);
+    }
+
+    MmUnlockAddressSpace(AddressSpace);
+    if (Process != PsInitialSystemProcess)
+        KeDetachProcess();
+
+    /* We can finally let this page go */
+    if (SwapEntry)
+        MmReleasePageMemoryConsumer(MC_USER, Page);
+
+    ExReleaseRundownProtection(&Process->RundownProtect);
+    ObDereferenceObject(Process);
+
+    return (SwapEntry != 0);
+}
+
+VOID
+NTAPI
+MmCompletePageOutCluster(PMM_PAGEOUT_CLUSTER Cluster, PULONG NrFreedPages)
+{
+    NTSTATUS Status;
+    SWAPENTRY SwapEntry;
+    ULONG i;
+
+    if (Cluster->Count == 0)
+        return;
+
+    if (Cluster->WriteInProgress)
+    {
+        Status = MmWaitForSwapWrite(&Cluster->Write);
+        Cluster->WriteInProgress = FALSE;
+
+        SwapEntry = Cluster->Write.SwapEntry;
+        if (!NT_SUCCESS(Status))
+        {
+            /* This run is useless to us */
+            MmFreeSwapPages(SwapEntry, Cluster->Count);
+        }
+
+        for (i = 0; i < Cluster->Count; i++)
+        {
+            if (MiCompletePageOut(Cluster->Process[i],
+                                  Cluster->Address[i],
+                                  Cluster->Page[i],
+                                  NT_SUCCESS(Status) ? SwapEntry : 0))
+            {
+                (*NrFreedPages)++;
+            }
+
+            SwapEntry = MmGetNextSwapEntry(SwapEntry);
+        }
+    }
+    else
+    {
+        /* There was no run long enough for all of them, write them one by one */
+        for (i = 0; i < Cluster->Count; i++)
+        {
+            SwapEntry = MmAllocSwapPage();
+            if (SwapEntry)
+            {
+                Status = MmWriteToSwapPage(SwapEntry, Cluster->Page[i]);
+                if (!NT_SUCCESS(Status))
+                {
+                    MmFreeSwapPage(SwapEntry);
+                    SwapEntry = 0;
+                }
+            }
+
+            if (MiCompletePageOut(Cluster->Process[i],
+                                  Cluster->Address[i],
+                                  Cluster->Page[i],
+                                  SwapEntry))
+            {
+                (*NrFreedPages)++;
+            }
+        }
+    }
+
+    Cluster->Count = 0;
+}
+
 VOID
 NTAPI
 MmInsertRmap(PFN_NUMBER Page, PEPROCESS Process,
@@ -1527,6 +1527,62 @@ MmAlterViewAttributes(PMMSUPPORT AddressSpace,
     MmUnlockSectionSegment(Segment);
 }
 
+/*
+ * Pick the private pages following a page being swapped in whose copies also
+ * follow its own in the paging file, so that they are all read in one I/O.
+ * Pages[0] is the faulting page, the others are allocated here and get a wait
+ * entry like it. Returns the number of pages to read.
+ */
+static
+ULONG
+MiGatherSwapInCluster(PEPROCESS Process,
+                      PMEMORY_AREA MemoryArea,
+                      PMM_REGION Region,
+                      PVOID Address,
+                      SWAPENTRY SwapEntry,
+                      PPFN_NUMBER Pages)
+{
+    ULONG Count = 1;
+    PVOID NextAddress = (PVOID)((ULONG_PTR)Address + PAGE_SIZE);
+    SWAPENTRY NextEntry = SwapEntry;
+    SWAPENTRY Entry;
+
+    /* Don't make things worse when memory is short */
+    if (!Process || MmAvailablePages < MmPlentyFreePages)
+        return 1;
+
+    while ((Count < MM_PAGEFILE_READ_CLUSTER) &&
+           ((ULONG_PTR)NextAddress < MA_GetEndingAddress(MemoryArea)))
+    {
+        NextEntry = MmGetNextSwapEntry(NextEntry);
+
+        if (MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
+                         &MemoryArea->SectionData.RegionListHead,
+                         NextAddress, NULL) != Region)
+        {
+            break;
+        }
+
+        if (!MmIsPageSwapEntry(Process, NextAddress))
+            break;
+
+        MmGetPageFileMapping(Process, NextAddress, &Entry);
+        if (Entry != NextEntry)
+            break;
+
+        if (!NT_SUCCESS(MmRequestPageMemoryConsumer(MC_USER, FALSE, &Pages[Count])))
+            break;
+
+        MmDeletePageFileMapping(Process, NextAddress, &Entry);
+        MmCreatePageFileMapping(Process, NextAddress, MM_WAIT_ENTRY);
+
+        Count++;
+        NextAddress = (PVOID)((ULONG_PTR)NextAddress + PAGE_SIZE);
+    }
+
+    return Count;
+}
+
 NTSTATUS
 NTAPI
 MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
@@ -1610,6 +1666,8 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
     if (HasSwapEntry)
     {
         SWAPENTRY DummyEntry;
+        PFN_NUMBER Pages[MM_PAGEFILE_READ_CLUSTER];
+        ULONG PageCount, i;
 
         MmGetPageFileMapping(Process, Address, &SwapEntry);
         if (SwapEntry == MM_WAIT_ENTRY)
@@ -1642,12 +1700,16 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
         /* Tell everyone else we are serving the fault. */
         MmCreatePageFileMapping(Process, Address, MM_WAIT_ENTRY);
 
+        /* Bring in along with it the pages which follow it in the paging file */
+        Pages[0] = Page;
+        PageCount = MiGatherSwapInCluster(Process, MemoryArea, Region, PAddress, SwapEntry, Pages);
+
         MmUnlockAddressSpace(AddressSpace);
 
-        Status = MmReadFromSwapPage(SwapEntry, Page);
+        Status = MmReadFromSwapPages(SwapEntry, Pages, PageCount);
         if (!NT_SUCCESS(Status))
         {
-            DPRINT1("MmReadFromSwapPage failed, status = %x\n", Status);
+            DPRINT1("MmReadFromSwapPages failed, status = %x\n", Status);
             KeBugCheck(MEMORY_MANAGEMENT);
         }
 
@@ -1675,6 +1737,28 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
          * Add the page to the process's working set
          */
         if (Process) MmInsertRmap(Page, Process, Address);
+
+        /* Map the pages which came along */
+        for (i = 1; i < PageCount; i++)
+        {
+            PVOID NextAddress = (PVOID)((ULONG_PTR)PAddress + i * PAGE_SIZE);
+
+            SwapEntry = MmGetNextSwapEntry(SwapEntry);
+
+            MmDeletePageFileMapping(Process, NextAddress, &DummyEntry);
+            ASSERT(DummyEntry == MM_WAIT_ENTRY);
+
+            Status = MmCreateVirtualMapping(Process, NextAddress, Region->Protect, Pages[i]);
+            if (!NT_SUCCESS(Status))
+            {
+                KeBugCheck(MEMORY_MANAGEMENT);
+                return Status;
+            }
+
+            MmSetSavedSwapEntryPage(Pages[i], SwapEntry);
+            MmInsertRmap(Pages[i], Process, NextAddress);
+        }
+
         /*
          * Finish the operation
          */
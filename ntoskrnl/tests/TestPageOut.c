@@ -0,0 +1,96 @@
+/*
+ * Paging stress test.
+ *
+ * Allocates a working set a few times larger than the physical memory (or
+ * as much of it as the address space allows), then writes and checks every
+ * page of it a number of times, so that most of it has to go through the
+ * paging file on each pass. Reports the time each pass takes.
+ *
+ * The swap slot allocator and paging file I/O statistics, including how
+ * long MmPageFileCreationLock was held, are shown by !pagefile in kdbg.
+ *
+ * Usage: TestPageOut [size in RAM multiples] [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#define PAGE_SIZE 4096
+
+static double Elapsed(LARGE_INTEGER *Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(End.QuadPart - Start->QuadPart) / (double)Frequency.QuadPart;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD Multiple = 3, Passes = 4;
+    DWORD Pass, Errors = 0;
+    MEMORYSTATUSEX Status;
+    ULONGLONG Size, Pages, i;
+    LARGE_INTEGER Start;
+    double Seconds;
+    PULONG Buffer;
+
+    if (argc > 1) Multiple = strtoul(argv[1], NULL, 0);
+    if (argc > 2) Passes = strtoul(argv[2], NULL, 0);
+    if (!Multiple || !Passes)
+    {
+        printf("Usage: %s [size in RAM multiples] [passes]\n", argv[0]);
+        return 1;
+    }
+
+    Status.dwLength = sizeof(Status);
+    GlobalMemoryStatusEx(&Status);
+
+    /* Leave some room in the address space for everything else */
+    Size = Status.ullTotalPhys * Multiple;
+    if (Size > Status.ullAvailVirtual - 64 * 1024 * 1024)
+        Size = Status.ullAvailVirtual - 64 * 1024 * 1024;
+    if (Size > Status.ullAvailPageFile)
+        Size = Status.ullAvailPageFile;
+    Size &= ~(ULONGLONG)(PAGE_SIZE - 1);
+    Pages = Size / PAGE_SIZE;
+
+    printf("Physical memory %I64u MB, working set %I64u MB\n",
+           Status.ullTotalPhys / (1024 * 1024), Size / (1024 * 1024));
+    if (Size <= Status.ullTotalPhys)
+        printf("The working set fits in memory, there won't be much paging!\n");
+
+    Buffer = VirtualAlloc(NULL, (SIZE_T)Size, MEM_COMMIT, PAGE_READWRITE);
+    if (!Buffer)
+    {
+        printf("Failed to allocate the working set: %lu\n", GetLastError());
+        return 1;
+    }
+
+    for (Pass = 0; Pass < Passes; Pass++)
+    {
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Pages; i++)
+        {
+            PULONG Page = (PULONG)((PUCHAR)Buffer + i * PAGE_SIZE);
+
+            /* Check what the previous pass left, then dirty the page again */
+            if (Pass && (Page[0] != (ULONG)i + Pass - 1 || Page[PAGE_SIZE / sizeof(ULONG) - 1] != Pass - 1))
+                Errors++;
+            Page[0] = (ULONG)i + Pass;
+            Page[PAGE_SIZE / sizeof(ULONG) - 1] = Pass;
+        }
+        Seconds = Elapsed(&Start);
+
+        printf("Pass %lu: %.3f s, %.2f MB/s\n", Pass, Seconds,
+               Seconds > 0 ? (double)Size / (1024.0 * 1024.0) / Seconds : 0.0);
+    }
+
+    if (Errors)
+        printf("%lu pages didn't have the expected content!\n", Errors);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    return Errors ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Registry open benchmark for wide keys.
+ *
+ * Creates a temporary key with a large number of subkeys under
+ * HKEY_CURRENT_USER\Software, then opens random subkeys of it (and looks up
+ * names that don't exist) and reports the lookups per second. Keys with many
+ * children, like HKCR\CLSID, are where the subkey hash cache of the KCB pays
+ * off.
+ *
+ * Usage: TestRegOpen [subkey count] [lookup count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+#define BENCH_KEY L"Software\\ReactOS Registry Open Benchmark"
+
+static double Elapsed(LARGE_INTEGER *Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(End.QuadPart - Start->QuadPart) / (double)Frequency.QuadPart;
+}
+
+static void Report(const char *What, DWORD Count, double Seconds)
+{
+    printf("%-16s %lu in %.3f s, %.0f lookups/s\n",
+           What, Count, Seconds, Seconds > 0 ? Count / Seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD SubKeys = 20000, Lookups = 200000;
+    DWORD i, Found = 0;
+    WCHAR Name[32];
+    HKEY hParent, hKey;
+    LARGE_INTEGER Start;
+    LONG Error;
+
+    if (argc > 1) SubKeys = strtoul(argv[1], NULL, 0);
+    if (argc > 2) Lookups = strtoul(argv[2], NULL, 0);
+    if (!SubKeys || !Lookups)
+    {
+        printf("Usage: %s [subkey count] [lookup count]\n", argv[0]);
+        return 1;
+    }
+
+    Error = RegCreateKeyExW(HKEY_CURRENT_USER, BENCH_KEY, 0, NULL, REG_OPTION_VOLATILE,
+                            KEY_ALL_ACCESS, NULL, &hParent, NULL);
+    if (Error != ERROR_SUCCESS)
+    {
+        printf("Failed to create the benchmark key: %ld\n", Error);
+        return 1;
+    }
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < SubKeys; i++)
+    {
+        swprintf(Name, L"Subkey %08lu", i);
+        Error = RegCreateKeyExW(hParent, Name, 0, NULL, REG_OPTION_VOLATILE,
+                                KEY_READ, NULL, &hKey, NULL);
+        if (Error != ERROR_SUCCESS)
+        {
+            printf("Failed to create subkey %lu: %ld\n", i, Error);
+            SubKeys = i;
+            break;
+        }
+        RegCloseKey(hKey);
+    }
+    Report("create", SubKeys, Elapsed(&Start));
+
+    /* Existing siblings, in random order so the KCB cache doesn't help much */
+    srand(1);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Lookups; i++)
+    {
+        swprintf(Name, L"Subkey %08lu", ((DWORD)rand() * (RAND_MAX + 1) + rand()) % SubKeys);
+        if (RegOpenKeyExW(hParent, Name, 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+        {
+            Found++;
+            RegCloseKey(hKey);
+        }
+    }
+    Report("open existing", Lookups, Elapsed(&Start));
+    if (Found != Lookups) printf("Only %lu of %lu subkeys were found!\n", Found, Lookups);
+
+    /* Missing names always have to go through the subkey lookup */
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Lookups; i++)
+    {
+        swprintf(Name, L"Missing %08lu", i);
+        if (RegOpenKeyExW(hParent, Name, 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+        {
+            printf("Opened %S, which doesn't exist!\n", Name);
+            RegCloseKey(hKey);
+        }
+    }
+    Report("open missing", Lookups, Elapsed(&Start));
+
+    /* Clean up */
+    for (i = 0; i < SubKeys; i++)
+    {
+        swprintf(Name, L"Subkey %08lu", i);
+        RegDeleteKeyW(hParent, Name);
+    }
+    RegCloseKey(hParent);
+    RegDeleteKeyW(HKEY_CURRENT_USER, BENCH_KEY);
+
+    return 0;
+}
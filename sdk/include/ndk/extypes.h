@@ -1272,6 +1272,18 @@ typedef struct _SYSTEM_CONTEXT_SWITCH_INFORMATION
     ULONG SwitchToIdle;
 } SYSTEM_CONTEXT_SWITCH_INFORMATION, *PSYSTEM_CONTEXT_SWITCH_INFORMATION;
 
+#ifdef __REACTOS__
+// Class 36, with the ready queue statistics of the dispatcher appended
+typedef struct _SYSTEM_CONTEXT_SWITCH_INFORMATION_EX
+{
+    SYSTEM_CONTEXT_SWITCH_INFORMATION Info;
+    ULONG IdleSteal;
+    ULONG ReadyCount;
+    ULONG MaxReadyLatency;      // In clock ticks
+    ULONGLONG ReadyLatency;     // In clock ticks, for all ReadyCount threads
+} SYSTEM_CONTEXT_SWITCH_INFORMATION_EX, *PSYSTEM_CONTEXT_SWITCH_INFORMATION_EX;
+#endif
+
 // Class 37
 typedef struct _SYSTEM_REGISTRY_QUOTA_INFORMATION
 {
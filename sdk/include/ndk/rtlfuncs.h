@@ -4995,6 +4995,50 @@ RtlRunOnceComplete(
     _In_ ULONG Flags,
     _In_opt_ PVOID Context);
 
+//
+// Thread Pool Functions
+//
+NTSYSAPI NTSTATUS NTAPI TpAllocPool(_Out_ PTP_POOL *PoolReturn, _Reserved_ PVOID Reserved);
+NTSYSAPI VOID NTAPI TpReleasePool(_Inout_ PTP_POOL Pool);
+NTSYSAPI VOID NTAPI TpSetPoolMaxThreads(_Inout_ PTP_POOL Pool, _In_ ULONG MaxThreads);
+NTSYSAPI NTSTATUS NTAPI TpSetPoolMinThreads(_Inout_ PTP_POOL Pool, _In_ ULONG MinThreads);
+
+NTSYSAPI NTSTATUS NTAPI TpAllocCleanupGroup(_Out_ PTP_CLEANUP_GROUP *CleanupGroupReturn);
+NTSYSAPI VOID NTAPI TpReleaseCleanupGroup(_Inout_ PTP_CLEANUP_GROUP CleanupGroup);
+NTSYSAPI VOID NTAPI TpReleaseCleanupGroupMembers(_Inout_ PTP_CLEANUP_GROUP CleanupGroup, _In_ BOOLEAN CancelPendingCallbacks, _Inout_opt_ PVOID CleanupParameter);
+
+NTSYSAPI NTSTATUS NTAPI TpSimpleTryPost(_In_ PTP_SIMPLE_CALLBACK Callback, _Inout_opt_ PVOID Context, _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron);
+
+NTSYSAPI NTSTATUS NTAPI TpAllocWork(_Out_ PTP_WORK *WorkReturn, _In_ PTP_WORK_CALLBACK Callback, _Inout_opt_ PVOID Context, _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron);
+NTSYSAPI VOID NTAPI TpReleaseWork(_Inout_ PTP_WORK Work);
+NTSYSAPI VOID NTAPI TpPostWork(_Inout_ PTP_WORK Work);
+NTSYSAPI VOID NTAPI TpWaitForWork(_Inout_ PTP_WORK Work, _In_ BOOLEAN CancelPendingCallbacks);
+
+NTSYSAPI NTSTATUS NTAPI TpAllocTimer(_Out_ PTP_TIMER *Timer, _In_ PTP_TIMER_CALLBACK Callback, _Inout_opt_ PVOID Context, _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron);
+NTSYSAPI VOID NTAPI TpReleaseTimer(_Inout_ PTP_TIMER Timer);
+NTSYSAPI VOID NTAPI TpSetTimer(_Inout_ PTP_TIMER Timer, _In_opt_ PLARGE_INTEGER DueTime, _In_ LONG Period, _In_opt_ LONG WindowLength);
+NTSYSAPI BOOLEAN NTAPI TpIsTimerSet(_In_ PTP_TIMER Timer);
+NTSYSAPI VOID NTAPI TpWaitForTimer(_Inout_ PTP_TIMER Timer, _In_ BOOLEAN CancelPendingCallbacks);
+
+NTSYSAPI NTSTATUS NTAPI TpAllocWait(_Out_ PTP_WAIT *WaitReturn, _In_ PTP_WAIT_CALLBACK Callback, _Inout_opt_ PVOID Context, _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron);
+NTSYSAPI VOID NTAPI TpReleaseWait(_Inout_ PTP_WAIT Wait);
+NTSYSAPI VOID NTAPI TpSetWait(_Inout_ PTP_WAIT Wait, _In_opt_ HANDLE Handle, _In_opt_ PLARGE_INTEGER Timeout);
+NTSYSAPI VOID NTAPI TpWaitForWait(_Inout_ PTP_WAIT Wait, _In_ BOOLEAN CancelPendingCallbacks);
+
+NTSYSAPI NTSTATUS NTAPI TpAllocIoCompletion(_Out_ PTP_IO *IoReturn, _In_ HANDLE File, _In_ PTP_IO_CALLBACK Callback, _Inout_opt_ PVOID Context, _In_opt_ PTP_CALLBACK_ENVIRON CallbackEnviron);
+NTSYSAPI VOID NTAPI TpReleaseIoCompletion(_Inout_ PTP_IO Io);
+NTSYSAPI VOID NTAPI TpStartAsyncIoOperation(_Inout_ PTP_IO Io);
+NTSYSAPI VOID NTAPI TpCancelAsyncIoOperation(_Inout_ PTP_IO Io);
+NTSYSAPI VOID NTAPI TpWaitForIoCompletion(_Inout_ PTP_IO Io, _In_ BOOLEAN CancelPendingCallbacks);
+
+NTSYSAPI NTSTATUS NTAPI TpCallbackMayRunLong(_Inout_ PTP_CALLBACK_INSTANCE Instance);
+NTSYSAPI VOID NTAPI TpDisassociateCallback(_Inout_ PTP_CALLBACK_INSTANCE Instance);
+NTSYSAPI VOID NTAPI TpCallbackLeaveCriticalSectionOnCompletion(_Inout_ PTP_CALLBACK_INSTANCE Instance, _Inout_ PRTL_CRITICAL_SECTION CriticalSection);
+NTSYSAPI VOID NTAPI TpCallbackReleaseMutexOnCompletion(_Inout_ PTP_CALLBACK_INSTANCE Instance, _In_ HANDLE Mutex);
+NTSYSAPI VOID NTAPI TpCallbackReleaseSemaphoreOnCompletion(_Inout_ PTP_CALLBACK_INSTANCE Instance, _In_ HANDLE Semaphore, _In_ ULONG ReleaseCount);
+NTSYSAPI VOID NTAPI TpCallbackSetEventOnCompletion(_Inout_ PTP_CALLBACK_INSTANCE Instance, _In_ HANDLE Event);
+NTSYSAPI VOID NTAPI TpCallbackUnloadDllOnCompletion(_Inout_ PTP_CALLBACK_INSTANCE Instance, _In_ PVOID DllHandle);
+
 #endif
 
 #if (_WIN32_WINNT >= _WIN32_WINNT_VISTA) || (defined(__REACTOS__) && defined(_NTDLLBUILD_))
@@ -99,6 +99,10 @@
 #define AO_OPTION_RCV_HOPLIMIT      36
 #define AO_OPTION_UNBIND            37
 #define AO_OPTION_PROTECT           38
+/* Non public option used to pass SO_SNDBUF down to TCP */
+#ifdef __REACTOS__
+#define AO_OPTION_SEND_WINDOW       0x100
+#endif
 
 /* TCP connection options */
 #define TCP_SOCKET_NODELAY 1
@@ -4087,6 +4087,50 @@ InitOnceComplete(
     _In_ DWORD dwFlags,
     _In_opt_ LPVOID lpContext);
 
+
+typedef VOID
+(WINAPI *PTP_WIN32_IO_CALLBACK)(
+  _Inout_ PTP_CALLBACK_INSTANCE Instance,
+  _Inout_opt_ PVOID Context,
+  _Inout_opt_ PVOID Overlapped,
+  _In_ ULONG IoResult,
+  _In_ ULONG_PTR NumberOfBytesTransferred,
+  _Inout_ PTP_IO Io);
+
+WINBASEAPI BOOL WINAPI CallbackMayRunLong(_Inout_ PTP_CALLBACK_INSTANCE);
+WINBASEAPI VOID WINAPI CancelThreadpoolIo(_Inout_ PTP_IO);
+WINBASEAPI VOID WINAPI CloseThreadpool(_Inout_ PTP_POOL);
+WINBASEAPI VOID WINAPI CloseThreadpoolCleanupGroup(_Inout_ PTP_CLEANUP_GROUP);
+WINBASEAPI VOID WINAPI CloseThreadpoolCleanupGroupMembers(_Inout_ PTP_CLEANUP_GROUP, _In_ BOOL, _Inout_opt_ PVOID);
+WINBASEAPI VOID WINAPI CloseThreadpoolIo(_Inout_ PTP_IO);
+WINBASEAPI VOID WINAPI CloseThreadpoolTimer(_Inout_ PTP_TIMER);
+WINBASEAPI VOID WINAPI CloseThreadpoolWait(_Inout_ PTP_WAIT);
+WINBASEAPI VOID WINAPI CloseThreadpoolWork(_Inout_ PTP_WORK);
+WINBASEAPI PTP_POOL WINAPI CreateThreadpool(_Reserved_ PVOID);
+WINBASEAPI PTP_CLEANUP_GROUP WINAPI CreateThreadpoolCleanupGroup(VOID);
+WINBASEAPI PTP_IO WINAPI CreateThreadpoolIo(_In_ HANDLE, _In_ PTP_WIN32_IO_CALLBACK, _Inout_opt_ PVOID, _In_opt_ PTP_CALLBACK_ENVIRON);
+WINBASEAPI PTP_TIMER WINAPI CreateThreadpoolTimer(_In_ PTP_TIMER_CALLBACK, _Inout_opt_ PVOID, _In_opt_ PTP_CALLBACK_ENVIRON);
+WINBASEAPI PTP_WAIT WINAPI CreateThreadpoolWait(_In_ PTP_WAIT_CALLBACK, _Inout_opt_ PVOID, _In_opt_ PTP_CALLBACK_ENVIRON);
+WINBASEAPI PTP_WORK WINAPI CreateThreadpoolWork(_In_ PTP_WORK_CALLBACK, _Inout_opt_ PVOID, _In_opt_ PTP_CALLBACK_ENVIRON);
+WINBASEAPI VOID WINAPI DisassociateCurrentThreadFromCallback(_Inout_ PTP_CALLBACK_INSTANCE);
+WINBASEAPI VOID WINAPI FreeLibraryWhenCallbackReturns(_Inout_ PTP_CALLBACK_INSTANCE, _In_ HMODULE);
+WINBASEAPI BOOL WINAPI IsThreadpoolTimerSet(_Inout_ PTP_TIMER);
+WINBASEAPI VOID WINAPI LeaveCriticalSectionWhenCallbackReturns(_Inout_ PTP_CALLBACK_INSTANCE, _Inout_ PCRITICAL_SECTION);
+WINBASEAPI VOID WINAPI ReleaseMutexWhenCallbackReturns(_Inout_ PTP_CALLBACK_INSTANCE, _In_ HANDLE);
+WINBASEAPI VOID WINAPI ReleaseSemaphoreWhenCallbackReturns(_Inout_ PTP_CALLBACK_INSTANCE, _In_ HANDLE, _In_ DWORD);
+WINBASEAPI VOID WINAPI SetEventWhenCallbackReturns(_Inout_ PTP_CALLBACK_INSTANCE, _In_ HANDLE);
+WINBASEAPI VOID WINAPI SetThreadpoolThreadMaximum(_Inout_ PTP_POOL, _In_ DWORD);
+WINBASEAPI BOOL WINAPI SetThreadpoolThreadMinimum(_Inout_ PTP_POOL, _In_ DWORD);
+WINBASEAPI VOID WINAPI SetThreadpoolTimer(_Inout_ PTP_TIMER, _In_opt_ PFILETIME, _In_ DWORD, _In_opt_ DWORD);
+WINBASEAPI VOID WINAPI SetThreadpoolWait(_Inout_ PTP_WAIT, _In_opt_ HANDLE, _In_opt_ PFILETIME);
+WINBASEAPI VOID WINAPI StartThreadpoolIo(_Inout_ PTP_IO);
+WINBASEAPI VOID WINAPI SubmitThreadpoolWork(_Inout_ PTP_WORK);
+WINBASEAPI BOOL WINAPI TrySubmitThreadpoolCallback(_In_ PTP_SIMPLE_CALLBACK, _Inout_opt_ PVOID, _In_opt_ PTP_CALLBACK_ENVIRON);
+WINBASEAPI VOID WINAPI WaitForThreadpoolIoCallbacks(_Inout_ PTP_IO, _In_ BOOL);
+WINBASEAPI VOID WINAPI WaitForThreadpoolTimerCallbacks(_Inout_ PTP_TIMER, _In_ BOOL);
+WINBASEAPI VOID WINAPI WaitForThreadpoolWaitCallbacks(_Inout_ PTP_WAIT, _In_ BOOL);
+WINBASEAPI VOID WINAPI WaitForThreadpoolWorkCallbacks(_Inout_ PTP_WORK, _In_ BOOL);
+
 #endif /* (_WIN32_WINNT >= _WIN32_WINNT_VISTA) || (DLL_EXPORT_VERSION >= _WIN32_WINNT_VISTA) */
 
 WINBASEAPI
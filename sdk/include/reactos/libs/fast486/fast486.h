@@ -26,6 +26,34 @@
 
 /* DEFINES ********************************************************************/
 
+#ifdef FAST486_HOST
+    /* Building for the host, for the tests and benchmarks */
+    #include <typedefs.h>
+    #include <string.h>
+    #include <stdio.h>
+
+    #define FASTCALL
+    #ifndef FORCEINLINE
+    #define FORCEINLINE static inline
+    #endif
+    #ifndef C_ASSERT
+    #define C_ASSERT(e) typedef char __C_ASSERT__[(e) ? 1 : -1]
+    #endif
+    #ifndef min
+    #define min(a, b)  (((a) < (b)) ? (a) : (b))
+    #endif
+    #ifndef max
+    #define max(a, b)  (((a) > (b)) ? (a) : (b))
+    #endif
+    #define UNREFERENCED_PARAMETER(P) ((void)(P))
+    #define UlongToPtr(ul) ((PVOID)(ULONG_PTR)(ul))
+    #define RtlFillMemory(Destination, Length, Fill) memset(Destination, Fill, Length)
+    #define DbgPrint printf
+
+    typedef LONGLONG *PLONGLONG;
+    typedef ULONGLONG *PULONGLONG;
+#endif
+
 #ifndef FASTCALL
 #define FASTCALL __fastcall
 #endif
@@ -676,6 +676,14 @@ CmCheckRegistry(
 //
 // Cell Index Routines
 //
+LONG
+NTAPI
+CmpDoCompareKeyName(
+    IN PHHIVE Hive,
+    IN PCUNICODE_STRING SearchName,
+    IN HCELL_INDEX Cell
+);
+
 HCELL_INDEX
 NTAPI
 CmpFindSubKeyByName(
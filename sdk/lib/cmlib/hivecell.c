@@ -14,7 +14,7 @@
 #if !defined(CMLIB_HOST) && !defined(_BLDR_)
 VOID
 NTAPI
-CmpLazyFlush(VOID);
+CmpLazyFlushDirty(IN ULONG DirtyBlocks);
 #endif
 
 /* FUNCTIONS *****************************************************************/
@@ -113,6 +113,9 @@ HvMarkCellDirty(
 {
     ULONG CellBlock;
     ULONG CellLastBlock;
+#if !defined(CMLIB_HOST) && !defined(_BLDR_)
+    ULONG Block, NewDirtyBlocks = 0;
+#endif
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
@@ -125,6 +128,15 @@ HvMarkCellDirty(
     CellBlock     = HvGetCellBlock(CellIndex);
     CellLastBlock = HvGetCellBlock(CellIndex + HBLOCK_SIZE - 1);
 
+#if !defined(CMLIB_HOST) && !defined(_BLDR_)
+    /* Count the blocks that weren't dirty yet, the lazy flusher watches their volume */
+    for (Block = CellBlock; Block < CellLastBlock; Block++)
+    {
+        if (!RtlCheckBit(&RegistryHive->DirtyVector, Block))
+            NewDirtyBlocks++;
+    }
+#endif
+
     RtlSetBits(&RegistryHive->DirtyVector,
                CellBlock, CellLastBlock - CellBlock);
     RegistryHive->DirtyCount++;
@@ -143,7 +155,7 @@ HvMarkCellDirty(
 #if !defined(CMLIB_HOST) && !defined(_BLDR_)
     if (!(RegistryHive->HiveFlags & HIVE_NOLAZYFLUSH))
     {
-        CmpLazyFlush();
+        CmpLazyFlushDirty(NewDirtyBlocks);
     }
 #endif
     return TRUE;
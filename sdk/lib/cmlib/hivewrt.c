@@ -23,8 +23,152 @@ IoSetThreadHardErrorMode(
 
 /* GLOBALS ******************************************************************/
 
+/* Dirty blocks following each other in a file are gathered into writes of up to this size */
+#define HV_WRITE_CLUSTER_SIZE   (64 * 1024)
+
+typedef struct _HV_WRITE_CLUSTER
+{
+    PHHIVE RegistryHive;
+    ULONG FileType;
+    ULONG FileOffset;
+    ULONG Length;
+    PUCHAR Buffer;
+} HV_WRITE_CLUSTER, *PHV_WRITE_CLUSTER;
+
 /* PRIVATE FUNCTIONS ********************************************************/
 
+/**
+ * @brief
+ * Prepares a write cluster, used to coalesce
+ * the writes of adjacent data to a hive file.
+ *
+ * @param[out] Cluster
+ * A pointer to the cluster to initialize.
+ *
+ * @param[in] RegistryHive
+ * A pointer to a hive descriptor the data
+ * belongs to.
+ *
+ * @param[in] FileType
+ * The type of the file the data goes to.
+ *
+ * @remarks
+ * If the cluster buffer can't be allocated, the
+ * data is simply written as it comes.
+ */
+static
+VOID
+HvpInitWriteCluster(
+    _Out_ PHV_WRITE_CLUSTER Cluster,
+    _In_ PHHIVE RegistryHive,
+    _In_ ULONG FileType)
+{
+    Cluster->RegistryHive = RegistryHive;
+    Cluster->FileType = FileType;
+    Cluster->FileOffset = 0;
+    Cluster->Length = 0;
+    Cluster->Buffer = RegistryHive->Allocate(HV_WRITE_CLUSTER_SIZE, TRUE, TAG_CM);
+}
+
+/**
+ * @brief
+ * Writes the data gathered in a write
+ * cluster to its file.
+ *
+ * @param[in] Cluster
+ * A pointer to the cluster to write.
+ *
+ * @return
+ * Returns TRUE if the write has succeeded
+ * (or there was nothing to write), FALSE otherwise.
+ */
+static
+BOOLEAN
+HvpFlushWriteCluster(
+    _In_ PHV_WRITE_CLUSTER Cluster)
+{
+    ULONG FileOffset = Cluster->FileOffset;
+    ULONG Length = Cluster->Length;
+
+    if (!Length)
+        return TRUE;
+
+    Cluster->Length = 0;
+    return Cluster->RegistryHive->FileWrite(Cluster->RegistryHive, Cluster->FileType,
+                                            &FileOffset, Cluster->Buffer, Length);
+}
+
+/**
+ * @brief
+ * Queues data to be written to the file of
+ * a write cluster. The pending data is written
+ * first if the new data doesn't directly follow
+ * it or doesn't fit in the cluster.
+ *
+ * @param[in] Cluster
+ * A pointer to the cluster to use.
+ *
+ * @param[in] FileOffset
+ * The offset in the file the data goes to.
+ *
+ * @param[in] Buffer
+ * A pointer to the data to write.
+ *
+ * @param[in] Length
+ * The size of the data, in bytes.
+ *
+ * @return
+ * Returns TRUE if the data has been queued or
+ * written, FALSE if a write failed.
+ */
+static
+BOOLEAN
+HvpWriteToCluster(
+    _In_ PHV_WRITE_CLUSTER Cluster,
+    _In_ ULONG FileOffset,
+    _In_ PVOID Buffer,
+    _In_ ULONG Length)
+{
+    if (Cluster->Length &&
+        ((FileOffset != Cluster->FileOffset + Cluster->Length) ||
+         (Length > HV_WRITE_CLUSTER_SIZE - Cluster->Length)))
+    {
+        if (!HvpFlushWriteCluster(Cluster))
+            return FALSE;
+    }
+
+    /* Without a buffer, or for big chunks, there is nothing to gain */
+    if (!Cluster->Buffer || Length > HV_WRITE_CLUSTER_SIZE)
+    {
+        return Cluster->RegistryHive->FileWrite(Cluster->RegistryHive, Cluster->FileType,
+                                                &FileOffset, Buffer, Length);
+    }
+
+    if (!Cluster->Length)
+        Cluster->FileOffset = FileOffset;
+
+    RtlCopyMemory(Cluster->Buffer + Cluster->Length, Buffer, Length);
+    Cluster->Length += Length;
+    return TRUE;
+}
+
+/**
+ * @brief
+ * Frees the buffer of a write cluster. Any
+ * data still pending is discarded.
+ *
+ * @param[in] Cluster
+ * A pointer to the cluster to clean up.
+ */
+static
+VOID
+HvpFreeWriteCluster(
+    _In_ PHV_WRITE_CLUSTER Cluster)
+{
+    if (Cluster->Buffer)
+        Cluster->RegistryHive->Free(Cluster->Buffer, 0);
+}
+
 /**
  * @brief
  * Validates the base block header of a primary
@@ -92,6 +236,7 @@ HvpWriteLog(
     PVOID Block;
     UINT32 BitmapSize, BufferSize;
     PUCHAR HeaderBuffer, Ptr;
+    HV_WRITE_CLUSTER Cluster;
 
     /*
      * The hive log we are going to write data into
@@ -193,14 +338,18 @@ HvpWriteLog(
         BlockIndex++;
     }
 
-    /* Now write the hive header and block bitmap into the log */
-    FileOffset = 0;
-    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, HeaderBuffer, BufferSize);
+    /*
+     * Now write the hive header and block bitmap into the log.
+     * The dirty blocks are stored right after it, so all of it
+     * goes through the same cluster and ends up in a few big writes.
+     */
+    HvpInitWriteCluster(&Cluster, RegistryHive, HFILE_TYPE_LOG);
+    Success = HvpWriteToCluster(&Cluster, 0, HeaderBuffer, BufferSize);
     RegistryHive->Free(HeaderBuffer, 0);
     if (!Success)
     {
         DPRINT1("Failed to write the hive header block to log (primary sequence)\n");
+        HvpFreeWriteCluster(&Cluster);
         return FALSE;
     }
 
@@ -221,11 +370,11 @@ HvpWriteLog(
         Block = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
 
         /* Write it to log */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                          &FileOffset, Block, HBLOCK_SIZE);
+        Success = HvpWriteToCluster(&Cluster, FileOffset, Block, HBLOCK_SIZE);
         if (!Success)
         {
             DPRINT1("Failed to write dirty block to log (block 0x%p, block index 0x%x)\n", Block, BlockIndex);
+            HvpFreeWriteCluster(&Cluster);
             return FALSE;
         }
 
@@ -234,6 +383,15 @@ HvpWriteLog(
         FileOffset += HBLOCK_SIZE;
     }
 
+    /* Write what's left */
+    Success = HvpFlushWriteCluster(&Cluster);
+    HvpFreeWriteCluster(&Cluster);
+    if (!Success)
+    {
+        DPRINT1("Failed to write dirty blocks to log\n");
+        return FALSE;
+    }
+
     /*
      * We wrote the header and body of log with dirty,
      * data do a flush immediately.
@@ -318,6 +476,7 @@ HvpWriteHive(
     ULONG BlockIndex;
     ULONG LastIndex;
     PVOID Block;
+    HV_WRITE_CLUSTER Cluster;
 
     ASSERT(!RegistryHive->ReadOnly);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -350,14 +509,17 @@ HvpWriteHive(
     RegistryHive->BaseBlock->Sequence1++;
     RegistryHive->BaseBlock->CheckSum = HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
 
-    /* Write hive block */
-    FileOffset = 0;
-    Success = RegistryHive->FileWrite(RegistryHive, FileType,
-                                      &FileOffset, RegistryHive->BaseBlock,
-                                      sizeof(HBASE_BLOCK));
+    /*
+     * Write hive block. Like the blocks that follow,
+     * it goes through a cluster so that adjacent dirty
+     * blocks are written together.
+     */
+    HvpInitWriteCluster(&Cluster, RegistryHive, FileType);
+    Success = HvpWriteToCluster(&Cluster, 0, RegistryHive->BaseBlock, sizeof(HBASE_BLOCK));
     if (!Success)
     {
         DPRINT1("Failed to write the base block header to primary hive (primary sequence)\n");
+        HvpFreeWriteCluster(&Cluster);
         return FALSE;
     }
 
@@ -388,12 +550,12 @@ HvpWriteHive(
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
         /* Now write this block to primary hive file */
-        Success = RegistryHive->FileWrite(RegistryHive, FileType,
-                                          &FileOffset, Block, HBLOCK_SIZE);
+        Success = HvpWriteToCluster(&Cluster, FileOffset, Block, HBLOCK_SIZE);
         if (!Success)
         {
             DPRINT1("Failed to write hive block to primary hive file (block 0x%p, block index 0x%x)\n",
                     Block, BlockIndex);
+            HvpFreeWriteCluster(&Cluster);
             return FALSE;
         }
 
@@ -401,6 +563,15 @@ HvpWriteHive(
         BlockIndex++;
     }
 
+    /* Write what's left */
+    Success = HvpFlushWriteCluster(&Cluster);
+    HvpFreeWriteCluster(&Cluster);
+    if (!Success)
+    {
+        DPRINT1("Failed to write hive blocks to primary hive file\n");
+        return FALSE;
+    }
+
     /*
      * We wrote all the hive contents to the file, we
      * must flush the changes to disk now.
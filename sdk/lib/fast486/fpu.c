@@ -21,7 +21,9 @@
 
 /* INCLUDES *******************************************************************/
 
+#ifndef FAST486_HOST
 #include <windef.h>
+#endif
 
 // #define NDEBUG
 #include <debug.h>
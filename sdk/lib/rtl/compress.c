@@ -11,6 +11,7 @@
 /* INCLUDES *****************************************************************/
 
 #include <rtl.h>
+#include "xpress.h"
 
 #define NDEBUG
 #include <debug.h>
@@ -20,6 +21,8 @@
 #define COMPRESSION_FORMAT_MASK  0x00FF
 #define COMPRESSION_ENGINE_MASK  0xFF00
 
+#define TAG_COMPRESS             'RTCP'
+
 
 
 
@@ -216,28 +219,203 @@ out:
 }
 
 
+/* LZNT1 compression engine parameters */
+#define LZNT1_CHUNK_SIZE        0x1000
+#define LZNT1_MIN_MATCH         3
+#define LZNT1_HASH_BITS         12
+#define LZNT1_HASH_SIZE         (1 << LZNT1_HASH_BITS)
+#define LZNT1_STANDARD_CHAIN    16
+#define LZNT1_MAXIMUM_CHAIN     LZNT1_CHUNK_SIZE
+
+/* Layout of the compression workspace (see RtlpWorkSpaceSizeLZNT1) */
+typedef struct _LZNT1_WORKSPACE
+{
+    USHORT HashHead[LZNT1_HASH_SIZE];
+    USHORT HashPrev[LZNT1_CHUNK_SIZE];
+} LZNT1_WORKSPACE, *PLZNT1_WORKSPACE;
+
+C_ASSERT(sizeof(LZNT1_WORKSPACE) <= 0x8010);
+
+static __inline ULONG lznt1_hash(const UCHAR *p)
+{
+    return ((((ULONG)p[0] << 16) | ((ULONG)p[1] << 8) | p[2]) * 2654435761U) >> (32 - LZNT1_HASH_BITS);
+}
+
+/* number of displacement bits available at a given position of the chunk,
+ * this has to match the computation done in lznt1_decompress_chunk */
+static __inline ULONG lznt1_displacement_bits(ULONG pos)
+{
+    ULONG displacement_bits;
+
+    for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+        if ((1U << (displacement_bits - 1)) < pos) break;
+
+    return displacement_bits;
+}
+
+/* find the longest match for position pos by walking its hash chain */
+static ULONG lznt1_find_match(const UCHAR *src, ULONG src_size, ULONG pos,
+                              PLZNT1_WORKSPACE ws, ULONG max_chain, ULONG *match_pos)
+{
+    ULONG max_length, best_length = 0, length, candidate;
+
+    max_length = (1U << (16 - lznt1_displacement_bits(pos))) + LZNT1_MIN_MATCH - 1;
+    max_length = min(max_length, src_size - pos);
+    if (max_length < LZNT1_MIN_MATCH)
+        return 0;
+
+    candidate = ws->HashHead[lznt1_hash(src + pos)];
+    while (candidate && max_chain--)
+    {
+        candidate--;
+
+        /* quick reject on the byte that would extend the current best match */
+        if (src[candidate + best_length] == src[pos + best_length] &&
+            src[candidate] == src[pos])
+        {
+            for (length = 1; length < max_length; length++)
+                if (src[candidate + length] != src[pos + length]) break;
+
+            if (length > best_length)
+            {
+                best_length = length;
+                *match_pos  = candidate;
+                if (length == max_length) break;
+            }
+        }
+
+        candidate = ws->HashPrev[candidate];
+    }
+
+    return (best_length >= LZNT1_MIN_MATCH) ? best_length : 0;
+}
+
+static __inline void lznt1_insert_hash(const UCHAR *src, ULONG src_size, ULONG pos,
+                                       PLZNT1_WORKSPACE ws)
+{
+    ULONG hash;
+
+    if (pos + LZNT1_MIN_MATCH > src_size)
+        return;
+
+    hash = lznt1_hash(src + pos);
+    ws->HashPrev[pos]  = ws->HashHead[hash];
+    ws->HashHead[hash] = (USHORT)(pos + 1);
+}
+
+/* compress a single LZNT1 chunk, returns the size of the compressed data or 0
+ * if it does not fit into dst_size bytes */
+static ULONG lznt1_compress_chunk(const UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                  PLZNT1_WORKSPACE ws, BOOLEAN maximum)
+{
+    ULONG max_chain = maximum ? LZNT1_MAXIMUM_CHAIN : LZNT1_STANDARD_CHAIN;
+    ULONG pos = 0, length, next_length, match_pos = 0, next_pos, flag_bit = 8;
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags = NULL;
+    ULONG displacement_bits;
+    WORD code;
+
+    RtlZeroMemory(ws->HashHead, sizeof(ws->HashHead));
+
+    while (pos < src_size)
+    {
+        /* start a new flag group every 8 entities */
+        if (flag_bit == 8)
+        {
+            if (dst_cur >= dst_end) return 0;
+            flags = dst_cur++;
+            *flags = 0;
+            flag_bit = 0;
+        }
+
+        length = lznt1_find_match(src, src_size, pos, ws, max_chain, &match_pos);
+
+        lznt1_insert_hash(src, src_size, pos, ws);
+
+        /* lazy evaluation: prefer a literal if the next position has a better match */
+        if (maximum && length && pos + 1 < src_size)
+        {
+            next_length = lznt1_find_match(src, src_size, pos + 1, ws, max_chain, &next_pos);
+            if (next_length > length)
+                length = 0;
+        }
+
+        if (length)
+        {
+            /* backwards reference */
+            if (dst_cur + sizeof(WORD) > dst_end) return 0;
+
+            displacement_bits = lznt1_displacement_bits(pos);
+            code = (WORD)(((pos - match_pos - 1) << (16 - displacement_bits)) |
+                          (length - LZNT1_MIN_MATCH));
+            *dst_cur++ = (UCHAR)code;
+            *dst_cur++ = (UCHAR)(code >> 8);
+            *flags |= 1 << flag_bit;
+
+            /* update the hash chains for the bytes covered by the match */
+            for (next_pos = pos + 1; next_pos < pos + length; next_pos++)
+                lznt1_insert_hash(src, src_size, next_pos, ws);
+            pos += length;
+        }
+        else
+        {
+            /* uncompressed data */
+            if (dst_cur >= dst_end) return 0;
+            *dst_cur++ = src[pos++];
+        }
+
+        flag_bit++;
+    }
+
+    return dst_cur - dst;
+}
+
 static NTSTATUS
 RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
-                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
+                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace,
+                        USHORT engine)
 {
         UCHAR *src_cur = src, *src_end = src + src_size;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        ULONG block_size, compressed_size, limit;
 
         while (src_cur < src_end)
         {
             /* determine size of current chunk */
-            block_size = min(0x1000, src_end - src_cur);
-            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+            block_size = min(LZNT1_CHUNK_SIZE, src_end - src_cur);
+            if (dst_cur + sizeof(WORD) > dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
-            /* write (uncompressed) chunk header */
-            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-            dst_cur += sizeof(WORD);
+            /* a compressed chunk is only worth it if it is smaller than the input */
+            compressed_size = 0;
+            limit = min(block_size - 1, (ULONG)(dst_end - dst_cur - sizeof(WORD)));
+            if (workspace && limit)
+            {
+                compressed_size = lznt1_compress_chunk(src_cur, block_size,
+                                                       dst_cur + sizeof(WORD), limit,
+                                                       (PLZNT1_WORKSPACE)workspace,
+                                                       engine == COMPRESSION_ENGINE_MAXIMUM);
+            }
+
+            if (compressed_size)
+            {
+                /* write compressed chunk header */
+                *(WORD *)dst_cur = 0xB000 | (compressed_size - 1);
+                dst_cur += sizeof(WORD) + compressed_size;
+            }
+            else
+            {
+                if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                    return STATUS_BUFFER_TOO_SMALL;
+
+                /* write (uncompressed) chunk header */
+                *(WORD *)dst_cur = 0x3000 | (block_size - 1);
+                dst_cur += sizeof(WORD);
+
+                /* write chunk content */
+                memcpy(dst_cur, src_cur, block_size);
+                dst_cur += block_size;
+            }
 
-            /* write chunk content */
-            memcpy(dst_cur, src_cur, block_size);
-            dst_cur += block_size;
             src_cur += block_size;
         }
 
@@ -261,7 +439,8 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
    }
    else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
    {
-      *BufferAndWorkSpaceSize = 0x10;
+      /* The maximum engine uses the same hash chains, it only searches deeper */
+      *BufferAndWorkSpaceSize = 0x8010;
       *FragmentWorkSpaceSize = 0x1000;
       return(STATUS_SUCCESS);
    }
@@ -270,6 +449,53 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
 }
 
 
+/* decompress Xpress data, starting at an uncompressed offset */
+static NTSTATUS
+RtlpDecompressFragmentXpress(USHORT Format, PUCHAR dst, ULONG dst_size, PUCHAR src, ULONG src_size,
+                             ULONG offset, PULONG final_size)
+{
+    PUCHAR buffer;
+    ULONG size;
+    NTSTATUS Status;
+
+    if (!offset)
+    {
+        if (Format == COMPRESSION_FORMAT_XPRESS)
+            Status = RtlpDecompressBufferXpress(dst, dst_size, src, src_size, &size);
+        else
+            Status = RtlpDecompressBufferXpressHuff(dst, dst_size, src, src_size, &size);
+
+        if (NT_SUCCESS(Status) && final_size)
+            *final_size = size;
+        return Status;
+    }
+
+    /* Xpress streams have no chunk boundaries, so the data in front of the
+     * fragment has to be decoded too to provide the match history */
+    if (offset + dst_size < offset)
+        return STATUS_INVALID_PARAMETER;
+    buffer = RtlpAllocateMemory(offset + dst_size, TAG_COMPRESS);
+    if (!buffer)
+        return STATUS_NO_MEMORY;
+
+    if (Format == COMPRESSION_FORMAT_XPRESS)
+        Status = RtlpDecompressBufferXpress(buffer, offset + dst_size, src, src_size, &size);
+    else
+        Status = RtlpDecompressBufferXpressHuff(buffer, offset + dst_size, src, src_size, &size);
+
+    if (NT_SUCCESS(Status))
+    {
+        size = (size > offset) ? size - offset : 0;
+        RtlCopyMemory(dst, buffer + offset, size);
+        if (final_size)
+            *final_size = size;
+    }
+
+    RtlpFreeMemory(buffer, TAG_COMPRESS);
+    return Status;
+}
+
+
 /*
  * @implemented
  */
@@ -284,7 +510,7 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
@@ -297,7 +523,26 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                                      CompressedBufferSize,
                                      UncompressedChunkSize,
                                      FinalCompressedSize,
-                                     WorkSpace));
+                                     WorkSpace,
+                                     Engine));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS)
+      return(RtlpCompressBufferXpress(UncompressedBuffer,
+                                      UncompressedBufferSize,
+                                      CompressedBuffer,
+                                      CompressedBufferSize,
+                                      FinalCompressedSize,
+                                      WorkSpace,
+                                      Engine));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS_HUFF)
+      return(RtlpCompressBufferXpressHuff(UncompressedBuffer,
+                                          UncompressedBufferSize,
+                                          CompressedBuffer,
+                                          CompressedBufferSize,
+                                          FinalCompressedSize,
+                                          WorkSpace,
+                                          Engine));
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
@@ -357,6 +602,12 @@ RtlDecompressFragment(IN USHORT format,
             return lznt1_decompress(uncompressed, uncompressed_size, compressed,
                                     compressed_size, offset, final_size, workspace);
 
+        case COMPRESSION_FORMAT_XPRESS:
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            return RtlpDecompressFragmentXpress(format & COMPRESSION_FORMAT_MASK, uncompressed,
+                                                uncompressed_size, compressed, compressed_size,
+                                                offset, final_size);
+
         case COMPRESSION_FORMAT_NONE:
         case COMPRESSION_FORMAT_DEFAULT:
             return STATUS_INVALID_PARAMETER;
@@ -417,6 +668,16 @@ RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
                                     CompressBufferAndWorkSpaceSize,
                                     CompressFragmentWorkSpaceSize));
 
+   if (Format == COMPRESSION_FORMAT_XPRESS)
+      return(RtlpWorkSpaceSizeXpress(Engine,
+                                     CompressBufferAndWorkSpaceSize,
+                                     CompressFragmentWorkSpaceSize));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS_HUFF)
+      return(RtlpWorkSpaceSizeXpressHuff(Engine,
+                                         CompressBufferAndWorkSpaceSize,
+                                         CompressFragmentWorkSpaceSize));
+
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
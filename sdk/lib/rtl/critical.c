@@ -34,6 +34,79 @@ extern HANDLE LdrpShutdownThreadId;
     (((CriticalSection)->DebugInfo != NULL) && \
      ((CriticalSection)->DebugInfo != LongToPtr(-1)))
 
+/* Spinning always gets at least this many tries, so it can recover after backing off */
+#define CRITSECT_MIN_SPIN 64
+
+/*++
+ * RtlpSpinOnCriticalSection
+ *
+ *     Spins while the critical section is owned by a thread running on
+ *     another processor, trying to acquire it once it is released.
+ *
+ * Params:
+ *     CriticalSection - Critical section to acquire.
+ *
+ * Returns:
+ *     TRUE if the critical section was acquired, FALSE otherwise.
+ *
+ * Remarks:
+ *     Spins at most SpinCount times. Critical sections with debug info
+ *     also remember how long spinning took lately (in SpareWORD) and spin
+ *     up to twice that, backing off when spinning didn't pay off. Giving
+ *     up when other threads already wait keeps the waiters' order.
+ *
+ *--*/
+static
+BOOLEAN
+RtlpSpinOnCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
+{
+    PRTL_CRITICAL_SECTION_DEBUG DebugInfo = NULL;
+    ULONG Spin, MaxSpin;
+    LONG LockCount;
+
+    MaxSpin = (ULONG)(CriticalSection->SpinCount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS);
+
+    if (CRITSECT_HAS_DEBUG_INFO(CriticalSection))
+    {
+        DebugInfo = CriticalSection->DebugInfo;
+        MaxSpin = min(MaxSpin, DebugInfo->SpareWORD * 2 + CRITSECT_MIN_SPIN);
+    }
+
+    for (Spin = 0; Spin < MaxSpin; Spin++)
+    {
+        LockCount = *(volatile LONG *)&CriticalSection->LockCount;
+        if (LockCount == -1)
+        {
+            /* It looks free, try to grab it */
+            if (InterlockedCompareExchange(&CriticalSection->LockCount, 0, -1) == -1)
+            {
+                if (DebugInfo)
+                {
+                    /* Move the estimate an eighth of the way toward this spin */
+                    DebugInfo->SpareWORD = (WORD)((LONG)DebugInfo->SpareWORD +
+                                                  ((LONG)Spin - (LONG)DebugInfo->SpareWORD) / 8);
+                    DebugInfo->ContentionCount++;
+                }
+
+                return TRUE;
+            }
+        }
+        else if (LockCount > 0)
+        {
+            /* Others are waiting already, they'll get it before us */
+            break;
+        }
+
+        YieldProcessor();
+    }
+
+    /* Spinning didn't pay off, spin less next time */
+    if (DebugInfo)
+        DebugInfo->SpareWORD /= 2;
+
+    return FALSE;
+}
+
 /*++
  * RtlpCreateCriticalSectionSem
  *
@@ -479,7 +552,8 @@ RtlSetCriticalSectionSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
  *     STATUS_SUCCESS.
  *
  * Remarks:
- *     Uses a fast-path unless contention happens.
+ *     Uses a fast-path unless contention happens. Spins before waiting
+ *     when the critical section has a spin count.
  *
  *--*/
 NTSTATUS
@@ -488,6 +562,17 @@ RtlEnterCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
     HANDLE Thread = (HANDLE)NtCurrentTeb()->ClientId.UniqueThread;
 
+    /* If somebody else owns it on an MP system, spin for a while first */
+    if (CriticalSection->SpinCount &&
+        CriticalSection->OwningThread != Thread &&
+        CriticalSection->LockCount != -1 &&
+        RtlpSpinOnCriticalSection(CriticalSection))
+    {
+        CriticalSection->OwningThread = Thread;
+        CriticalSection->RecursionCount = 1;
+        return STATUS_SUCCESS;
+    }
+
     /* Try to lock it */
     if (InterlockedIncrement(&CriticalSection->LockCount) != 0)
     {
@@ -639,6 +724,7 @@ RtlInitializeCriticalSectionEx(
         CritcalSectionDebugData->EntryCount = 0;
         CritcalSectionDebugData->CriticalSection = CriticalSection;
         CritcalSectionDebugData->Flags = 0;
+        CritcalSectionDebugData->SpareWORD = 0;
         CriticalSection->DebugInfo = CritcalSectionDebugData;
 
         /*
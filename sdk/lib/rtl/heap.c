@@ -1752,6 +1752,9 @@ RtlDestroyHeap(HANDLE HeapPtr) /* [in] Handle of heap */
     if (RtlpGetMode() == UserMode &&
         HeapPtr == NtCurrentPeb()->ProcessHeap) return HeapPtr;
 
+    /* Tear down the low fragmentation heap, its memory goes away with the segments */
+    if (Heap->FrontEndHeap) RtlpDestroyLowFragHeap(Heap);
+
     /* Free up all big allocations */
     Current = Heap->VirtualAllocdBlocks.Flink;
     while (Current != &Heap->VirtualAllocdBlocks)
@@ -1952,6 +1955,95 @@ RtlpSplitEntry(PHEAP Heap,
     return InUseEntry;
 }
 
+/* Fill in a block which was just taken out of the free lists, outside of the heap lock */
+static
+PVOID
+RtlpInitializeInUseEntry(PHEAP Heap,
+                         ULONG Flags,
+                         PHEAP_ENTRY InUseEntry,
+                         SIZE_T Size)
+{
+    PHEAP_ENTRY_EXTRA Extra;
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(InUseEntry + 1, Size);
+    else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
+    {
+        /* Fill this block with a special pattern */
+        RtlFillMemoryUlong(InUseEntry + 1, Size & ~0x3, ARENA_INUSE_FILLER);
+    }
+
+    /* Fill tail of the block with a special pattern too if requested */
+    if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
+    {
+        RtlFillMemory((PCHAR)(InUseEntry + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
+        InUseEntry->Flags |= HEAP_ENTRY_FILL_PATTERN;
+    }
+
+    /* Prepare extra if it's present */
+    if (InUseEntry->Flags & HEAP_ENTRY_EXTRA_PRESENT)
+    {
+        Extra = RtlpGetExtraStuffPointer(InUseEntry);
+        RtlZeroMemory(Extra, sizeof(HEAP_ENTRY_EXTRA));
+
+        // TODO: Tagging
+    }
+
+    /* User data starts right after the entry's header */
+    return InUseEntry + 1;
+}
+
+/* Find a free block of at least Index entries in the free lists, the heap must be locked */
+static
+PHEAP_FREE_ENTRY
+RtlpFindFreeBlock(PHEAP Heap,
+                  SIZE_T Index)
+{
+    PHEAP_FREE_ENTRY FreeEntry;
+
+    /* First quick check: Anybody here ? */
+    if (IsListEmpty(&Heap->FreeLists))
+        return NULL;
+
+    /* Second quick check: Is there someone for us ? */
+    FreeEntry = CONTAINING_RECORD(Heap->FreeLists.Blink, HEAP_FREE_ENTRY, FreeList);
+    if (FreeEntry->Size < Index)
+    {
+        /* Largest entry in the list doesnt fit. */
+        return NULL;
+    }
+
+    if (Index > Heap->DeCommitFreeBlockThreshold)
+    {
+        /* Find an entry from the non dedicated list */
+        FreeEntry = CONTAINING_RECORD(Heap->FreeHints[0],
+                                      HEAP_FREE_ENTRY,
+                                      FreeList);
+
+        while (FreeEntry->Size < Index)
+        {
+            /* We made sure we had the right size available */
+            ASSERT(FreeEntry->FreeList.Flink != &Heap->FreeLists);
+            FreeEntry = CONTAINING_RECORD(FreeEntry->FreeList.Flink,
+                                          HEAP_FREE_ENTRY,
+                                          FreeList);
+        }
+    }
+    else
+    {
+        /* Get the free entry from the hint */
+        ULONG HintIndex = RtlFindSetBits(&Heap->FreeHintBitmap, 1, (ULONG)Index - 1);
+        ASSERT(HintIndex != 0xFFFFFFFF);
+        ASSERT((HintIndex >= (Index - 1)) || (HintIndex == 0));
+        FreeEntry = CONTAINING_RECORD(Heap->FreeHints[HintIndex],
+                                      HEAP_FREE_ENTRY,
+                                      FreeList);
+    }
+
+    return FreeEntry;
+}
+
 static
 PVOID
 RtlpAllocateNonDedicated(PHEAP Heap,
@@ -1974,7 +2066,6 @@ RtlpAllocateNonDedicated(PHEAP Heap,
     if (FreeBlock)
     {
         PHEAP_ENTRY InUseEntry;
-        PHEAP_ENTRY_EXTRA Extra;
 
         RtlpRemoveFreeBlock(Heap, FreeBlock, TRUE);
 
@@ -1984,33 +2075,8 @@ RtlpAllocateNonDedicated(PHEAP Heap,
         /* Release the lock */
         if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
 
-        /* Zero memory if that was requested */
-        if (Flags & HEAP_ZERO_MEMORY)
-            RtlZeroMemory(InUseEntry + 1, Size);
-        else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
-        {
-            /* Fill this block with a special pattern */
-            RtlFillMemoryUlong(InUseEntry + 1, Size & ~0x3, ARENA_INUSE_FILLER);
-        }
-
-        /* Fill tail of the block with a special pattern too if requested */
-        if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
-        {
-            RtlFillMemory((PCHAR)(InUseEntry + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
-            InUseEntry->Flags |= HEAP_ENTRY_FILL_PATTERN;
-        }
-
-        /* Prepare extra if it's present */
-        if (InUseEntry->Flags & HEAP_ENTRY_EXTRA_PRESENT)
-        {
-            Extra = RtlpGetExtraStuffPointer(InUseEntry);
-            RtlZeroMemory(Extra, sizeof(HEAP_ENTRY_EXTRA));
-
-            // TODO: Tagging
-        }
-
         /* Return pointer to the */
-        return InUseEntry + 1;
+        return RtlpInitializeInUseEntry(Heap, Flags, InUseEntry, Size);
     }
 
     /* Really unfortunate, out of memory condition */
@@ -2056,7 +2122,6 @@ RtlAllocateHeap(IN PVOID HeapPtr,
     UCHAR EntryFlags = HEAP_ENTRY_BUSY;
     BOOLEAN HeapLocked = FALSE;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
-    PHEAP_ENTRY_EXTRA Extra;
     NTSTATUS Status;
 
     /* Force flags */
@@ -2106,6 +2171,15 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks without extra stuff come from the low fragmentation heap, if there is one */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+        Index <= HEAP_LFH_MAX_BLOCK_SIZE &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        PVOID Block = RtlpLowFragHeapAllocate(Heap, Flags, Size, Index, EntryFlags);
+        if (Block) return Block;
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2120,44 +2194,10 @@ RtlAllocateHeap(IN PVOID HeapPtr,
         PHEAP_ENTRY InUseEntry;
         PHEAP_FREE_ENTRY FreeEntry;
 
-        /* First quick check: Anybody here ? */
-        if (IsListEmpty(&Heap->FreeLists))
-            return RtlpAllocateNonDedicated(Heap, Flags, Size, AllocationSize, Index, HeapLocked);
-
-        /* Second quick check: Is there someone for us ? */
-        FreeEntry = CONTAINING_RECORD(Heap->FreeLists.Blink, HEAP_FREE_ENTRY, FreeList);
-        if (FreeEntry->Size < Index)
-        {
-            /* Largest entry in the list doesnt fit. */
+        /* Is there someone for us ? */
+        FreeEntry = RtlpFindFreeBlock(Heap, Index);
+        if (!FreeEntry)
             return RtlpAllocateNonDedicated(Heap, Flags, Size, AllocationSize, Index, HeapLocked);
-        }
-
-        if (Index > Heap->DeCommitFreeBlockThreshold)
-        {
-            /* Find an entry from the non dedicated list */
-            FreeEntry = CONTAINING_RECORD(Heap->FreeHints[0],
-                                      HEAP_FREE_ENTRY,
-                                      FreeList);
-
-            while (FreeEntry->Size < Index)
-            {
-                /* We made sure we had the right size available */
-                ASSERT(FreeEntry->FreeList.Flink != &Heap->FreeLists);
-                FreeEntry = CONTAINING_RECORD(FreeEntry->FreeList.Flink,
-                                              HEAP_FREE_ENTRY,
-                                              FreeList);
-            }
-        }
-        else
-        {
-            /* Get the free entry from the hint */
-            ULONG HintIndex = RtlFindSetBits(&Heap->FreeHintBitmap, 1, Index - 1);
-            ASSERT(HintIndex != 0xFFFFFFFF);
-            ASSERT((HintIndex >= (Index - 1)) || (HintIndex == 0));
-            FreeEntry = CONTAINING_RECORD(Heap->FreeHints[HintIndex],
-                                          HEAP_FREE_ENTRY,
-                                          FreeList);
-        }
 
         /* Remove the free block, split, profit. */
         RtlpRemoveFreeBlock(Heap, FreeEntry, FALSE);
@@ -2166,33 +2206,7 @@ RtlAllocateHeap(IN PVOID HeapPtr,
         /* Release the lock */
         if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
 
-        /* Zero memory if that was requested */
-        if (Flags & HEAP_ZERO_MEMORY)
-            RtlZeroMemory(InUseEntry + 1, Size);
-        else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
-        {
-            /* Fill this block with a special pattern */
-            RtlFillMemoryUlong(InUseEntry + 1, Size & ~0x3, ARENA_INUSE_FILLER);
-        }
-
-        /* Fill tail of the block with a special pattern too if requested */
-        if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
-        {
-            RtlFillMemory((PCHAR)(InUseEntry + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
-            InUseEntry->Flags |= HEAP_ENTRY_FILL_PATTERN;
-        }
-
-        /* Prepare extra if it's present */
-        if (InUseEntry->Flags & HEAP_ENTRY_EXTRA_PRESENT)
-        {
-            Extra = RtlpGetExtraStuffPointer(InUseEntry);
-            RtlZeroMemory(Extra, sizeof(HEAP_ENTRY_EXTRA));
-
-            // TODO: Tagging
-        }
-
-        /* User data starts right after the entry's header */
-        return InUseEntry + 1;
+        return RtlpInitializeInUseEntry(Heap, Flags, InUseEntry, Size);
     }
 
     if (Heap->Flags & HEAP_GROWABLE)
@@ -2256,41 +2270,12 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 }
 
 
-/***********************************************************************
- *           HeapFree   (KERNEL32.338)
- * RETURNS
- * TRUE: Success
- * FALSE: Failure
- *
- * @implemented
- */
-BOOLEAN NTAPI RtlFreeHeap(
-   HANDLE HeapPtr, /* [in] Handle of heap */
-   ULONG Flags,   /* [in] Heap freeing flags */
-   PVOID Ptr     /* [in] Address of memory to free */
-)
+/* Make sure a block given to us for freeing looks like one of ours */
+static
+BOOLEAN
+RtlpCheckFreeEntry(PHEAP_ENTRY HeapEntry)
 {
-    PHEAP Heap;
-    PHEAP_ENTRY HeapEntry;
-    USHORT TagIndex = 0;
-    SIZE_T BlockSize;
-    PHEAP_VIRTUAL_ALLOC_ENTRY VirtualEntry;
-    BOOLEAN Locked = FALSE;
-    NTSTATUS Status;
-
-    /* Freeing NULL pointer is a legal operation */
-    if (!Ptr) return TRUE;
-
-    /* Get pointer to the heap and force flags */
-    Heap = (PHEAP)HeapPtr;
-    Flags |= Heap->ForceFlags;
-
-    /* Call special heap */
-    if (RtlpHeapIsSpecial(Flags))
-        return RtlDebugFreeHeap(Heap, Flags, Ptr);
-
-    /* Get pointer to the heap entry */
-    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    PVOID Ptr = HeapEntry + 1;
 
     /* Protect with SEH in case the pointer is not valid */
     _SEH2_TRY
@@ -2298,7 +2283,7 @@ BOOLEAN NTAPI RtlFreeHeap(
         /* Check this entry, fail if it's invalid */
         if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
             (((ULONG_PTR)Ptr & 0x7) != 0) ||
-            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+            ((HeapEntry->SegmentOffset >= HEAP_SEGMENTS) && !RtlpIsLowFragHeapEntry(HeapEntry)))
         {
             /* This is an invalid block */
             DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -2315,12 +2300,19 @@ BOOLEAN NTAPI RtlFreeHeap(
     }
     _SEH2_END;
 
-    /* Lock if necessary */
-    if (!(Flags & HEAP_NO_SERIALIZE))
-    {
-        RtlEnterHeapLock(Heap->LockVariable, TRUE);
-        Locked = TRUE;
-    }
+    return TRUE;
+}
+
+/* Give a checked block of the back end back to the heap, which must be locked */
+static
+VOID
+RtlpFreeHeapEntry(PHEAP Heap,
+                  PHEAP_ENTRY HeapEntry)
+{
+    USHORT TagIndex = 0;
+    SIZE_T BlockSize;
+    PHEAP_VIRTUAL_ALLOC_ENTRY VirtualEntry;
+    NTSTATUS Status;
 
     if (HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC)
     {
@@ -2341,7 +2333,7 @@ BOOLEAN NTAPI RtlFreeHeap(
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("HEAP: Failed releasing memory with Status 0x%08X. Heap %p, ptr %p, base address %p\n",
-                Status, Heap, Ptr, VirtualEntry);
+                Status, Heap, HeapEntry + 1, VirtualEntry);
             RtlSetLastWin32ErrorAndNtStatusFromNtStatus(Status);
         }
     }
@@ -2381,6 +2373,53 @@ BOOLEAN NTAPI RtlFreeHeap(
             }
         }
     }
+}
+
+/***********************************************************************
+ *           HeapFree   (KERNEL32.338)
+ * RETURNS
+ * TRUE: Success
+ * FALSE: Failure
+ *
+ * @implemented
+ */
+BOOLEAN NTAPI RtlFreeHeap(
+   HANDLE HeapPtr, /* [in] Handle of heap */
+   ULONG Flags,   /* [in] Heap freeing flags */
+   PVOID Ptr     /* [in] Address of memory to free */
+)
+{
+    PHEAP Heap;
+    PHEAP_ENTRY HeapEntry;
+    BOOLEAN Locked = FALSE;
+
+    /* Freeing NULL pointer is a legal operation */
+    if (!Ptr) return TRUE;
+
+    /* Get pointer to the heap and force flags */
+    Heap = (PHEAP)HeapPtr;
+    Flags |= Heap->ForceFlags;
+
+    /* Call special heap */
+    if (RtlpHeapIsSpecial(Flags))
+        return RtlDebugFreeHeap(Heap, Flags, Ptr);
+
+    /* Get pointer to the heap entry */
+    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    if (!RtlpCheckFreeEntry(HeapEntry)) return FALSE;
+
+    /* Blocks of the low fragmentation heap don't need the heap lock */
+    if (RtlpIsLowFragHeapEntry(HeapEntry))
+        return RtlpLowFragHeapFree(Heap, HeapEntry);
+
+    /* Lock if necessary */
+    if (!(Flags & HEAP_NO_SERIALIZE))
+    {
+        RtlEnterHeapLock(Heap->LockVariable, TRUE);
+        Locked = TRUE;
+    }
+
+    RtlpFreeHeapEntry(Heap, HeapEntry);
 
     /* Release the heap lock */
     if (Locked) RtlLeaveHeapLock(Heap->LockVariable);
@@ -2706,6 +2745,10 @@ RtlReAllocateHeap(HANDLE HeapPtr,
         return NULL;
     }
 
+    /* Blocks of the low fragmentation heap are handled by it */
+    if (RtlpIsLowFragHeapEntry((PHEAP_ENTRY)Ptr - 1))
+        return RtlpLowFragHeapReAllocate(Heap, Flags, Ptr, Size);
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -3279,6 +3322,10 @@ RtlpValidateHeapEntry(
     if ((ULONG_PTR)HeapEntry & (HEAP_ENTRY_SIZE - 1)) goto invalid_entry;
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
 
+    /* Blocks of the low fragmentation heap live inside a block of the back end */
+    if (RtlpIsLowFragHeapEntry(HeapEntry))
+        return RtlpLowFragHeapValidateEntry(Heap, HeapEntry);
+
     BigAllocation = HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC;
     Segment = Heap->Segments[HeapEntry->SegmentOffset];
 
@@ -4061,13 +4108,14 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_LOWFRAGHEAP)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        if (!HeapHandle) return STATUS_INVALID_HANDLE;
+
+        return RtlpCreateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -4106,6 +4154,64 @@ RtlQueryHeapInformation(HANDLE HeapHandle,
     return STATUS_UNSUCCESSFUL;
 }
 
+/* Cut Count blocks of Index entries out of a free block taken out of the free lists */
+static
+VOID
+RtlpCarveEntries(PHEAP Heap,
+                 ULONG Flags,
+                 PHEAP_FREE_ENTRY FreeBlock,
+                 SIZE_T AllocationSize,
+                 SIZE_T Index,
+                 SIZE_T Size,
+                 ULONG Count,
+                 PVOID *Array)
+{
+    PHEAP_ENTRY InUseEntry = (PHEAP_ENTRY)FreeBlock;
+    PHEAP_FREE_ENTRY Remainder;
+    UCHAR EntryFlags = HEAP_ENTRY_BUSY;
+    ULONG i;
+
+    ASSERT(Count != 0);
+    ASSERT(FreeBlock->Size >= Count * Index);
+
+    /* Same flags as RtlpSplitEntry gives */
+    if ((Flags & HEAP_EXTRA_FLAGS_MASK) ||
+        Heap->PseudoTagEntries)
+    {
+        EntryFlags |= HEAP_ENTRY_EXTRA_PRESENT;
+    }
+    EntryFlags |= (Flags & HEAP_SETTABLE_USER_FLAGS) >> 4;
+
+    /* All but the last one just follow each other */
+    for (i = 0; i < Count - 1; i++)
+    {
+        /* What's left after this one keeps the flags of the free block */
+        Remainder = (PHEAP_FREE_ENTRY)(InUseEntry + Index);
+        Remainder->Size = (USHORT)(InUseEntry->Size - Index);
+        Remainder->Flags = InUseEntry->Flags;
+        Remainder->SegmentOffset = InUseEntry->SegmentOffset;
+        Remainder->PreviousSize = (USHORT)Index;
+
+        InUseEntry->Size = (USHORT)Index;
+        InUseEntry->Flags = EntryFlags;
+        InUseEntry->SmallTagIndex = 0;
+        InUseEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+        Heap->TotalFreeSize -= Index;
+
+        Array[i] = InUseEntry + 1;
+        InUseEntry = (PHEAP_ENTRY)Remainder;
+    }
+
+    /* The last one takes care of the rest of the free block */
+    InUseEntry = RtlpSplitEntry(Heap, Flags, (PHEAP_FREE_ENTRY)InUseEntry, AllocationSize, Index, Size);
+    Array[i] = InUseEntry + 1;
+
+    /* Without a remainder to split off, RtlpSplitEntry leaves the next entry
+       alone, and its previous size still covers the whole free block */
+    if (!(InUseEntry->Flags & HEAP_ENTRY_LAST_ENTRY))
+        (InUseEntry + InUseEntry->Size)->PreviousSize = InUseEntry->Size;
+}
+
 /* @implemented */
 ULONG
 NTAPI
@@ -4115,31 +4221,106 @@ RtlMultipleAllocateHeap(IN PVOID HeapHandle,
                         IN ULONG Count,
                         OUT PVOID *Array)
 {
-    ULONG Index;
+    PHEAP Heap = (PHEAP)HeapHandle;
+    PHEAP_FREE_ENTRY FreeBlock;
+    SIZE_T AllocationSize = 0, Index = 0;
+    ULONG Allocated = 0, Wanted, Carved, i;
+    BOOLEAN HeapLocked = FALSE, Extra = FALSE;
     EXCEPTION_RECORD ExceptionRecord;
 
-    for (Index = 0; Index < Count; ++Index)
+    /* Force flags */
+    Flags |= Heap->ForceFlags;
+
+    /* Calculate allocation size and index like RtlAllocateHeap does */
+    if (!RtlpHeapIsSpecial(Flags) && Size < 0x80000000)
     {
-        Array[Index] = RtlAllocateHeap(HeapHandle, Flags, Size);
-        if (Array[Index] == NULL)
+        AllocationSize = ((Size ? Size : 1) + Heap->AlignRound) & Heap->AlignMask;
+        if ((Flags & HEAP_EXTRA_FLAGS_MASK) ||
+            Heap->PseudoTagEntries)
         {
-            /* ERROR_NOT_ENOUGH_MEMORY */
-            RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_NO_MEMORY);
+            AllocationSize += sizeof(HEAP_ENTRY_EXTRA);
+            Extra = TRUE;
+        }
+        Index = AllocationSize >> HEAP_ENTRY_SHIFT;
+    }
 
-            if (Flags & HEAP_GENERATE_EXCEPTIONS)
+    /* Special heaps, big blocks and the ones of the front end go one by one */
+    if (!Index ||
+        Index > Heap->VirtualMemoryThreshold ||
+        (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+         Index <= HEAP_LFH_MAX_BLOCK_SIZE &&
+         !Extra))
+    {
+        for (Allocated = 0; Allocated < Count; Allocated++)
+        {
+            Array[Allocated] = RtlAllocateHeap(HeapHandle, Flags, Size);
+            if (Array[Allocated] == NULL)
+                break;
+        }
+    }
+    else
+    {
+        /* Acquire the lock once for all of them */
+        if (!(Flags & HEAP_NO_SERIALIZE))
+        {
+            RtlEnterHeapLock(Heap->LockVariable, TRUE);
+            HeapLocked = TRUE;
+        }
+
+        while (Allocated < Count)
+        {
+            Wanted = (ULONG)min(Count - Allocated, HEAP_MAX_BLOCK_SIZE / Index);
+
+            /* Best is a free block for all of them, else take what the biggest one can give */
+            FreeBlock = RtlpFindFreeBlock(Heap, Wanted * Index);
+            if (!FreeBlock && !IsListEmpty(&Heap->FreeLists))
             {
-                ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
-                ExceptionRecord.ExceptionRecord = NULL;
-                ExceptionRecord.NumberParameters = 0;
-                ExceptionRecord.ExceptionFlags = 0;
+                FreeBlock = CONTAINING_RECORD(Heap->FreeLists.Blink, HEAP_FREE_ENTRY, FreeList);
+                if (FreeBlock->Size < Index) FreeBlock = NULL;
+            }
 
-                RtlRaiseException(&ExceptionRecord);
+            /* Nothing fits, so extend the heap */
+            if (!FreeBlock)
+            {
+                FreeBlock = RtlpExtendHeap(Heap, (Wanted * Index) << HEAP_ENTRY_SHIFT);
+                if (!FreeBlock && Wanted > 1)
+                    FreeBlock = RtlpExtendHeap(Heap, AllocationSize);
+                if (!FreeBlock)
+                    break;
             }
-            break;
+
+            /* Take as many blocks as we can out of it in one go */
+            Carved = (ULONG)min(Wanted, FreeBlock->Size / Index);
+            RtlpRemoveFreeBlock(Heap, FreeBlock, FALSE);
+            RtlpCarveEntries(Heap, Flags, FreeBlock, AllocationSize, Index, Size, Carved, &Array[Allocated]);
+            Allocated += Carved;
         }
+
+        /* Release the lock */
+        if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
+
+        /* Zero or fill them without holding the lock */
+        for (i = 0; i < Allocated; i++)
+            RtlpInitializeInUseEntry(Heap, Flags, (PHEAP_ENTRY)Array[i] - 1, Size);
     }
 
-    return Index;
+    if (Allocated < Count)
+    {
+        /* ERROR_NOT_ENOUGH_MEMORY */
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_NO_MEMORY);
+
+        if (Flags & HEAP_GENERATE_EXCEPTIONS)
+        {
+            ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
+            ExceptionRecord.ExceptionRecord = NULL;
+            ExceptionRecord.NumberParameters = 0;
+            ExceptionRecord.ExceptionFlags = 0;
+
+            RtlRaiseException(&ExceptionRecord);
+        }
+    }
+
+    return Allocated;
 }
 
 /* @implemented */
@@ -4150,29 +4331,99 @@ RtlMultipleFreeHeap(IN PVOID HeapHandle,
                     IN ULONG Count,
                     OUT PVOID *Array)
 {
-    ULONG Index;
+    PHEAP Heap = (PHEAP)HeapHandle;
+    PHEAP_ENTRY Batch[HEAP_MULTIPLE_FREE_BATCH], HeapEntry;
+    ULONG Index, Batched, i, j;
+    BOOLEAN Failed = FALSE;
 
-    for (Index = 0; Index < Count; ++Index)
-    {
-        if (Array[Index] == NULL)
-            continue;
+    /* Force flags */
+    Flags |= Heap->ForceFlags;
 
-        _SEH2_TRY
+    /* Special heaps go one by one */
+    if (RtlpHeapIsSpecial(Flags))
+    {
+        for (Index = 0; Index < Count; ++Index)
         {
-            if (!RtlFreeHeap(HeapHandle, Flags, Array[Index]))
+            if (Array[Index] == NULL)
+                continue;
+
+            _SEH2_TRY
+            {
+                if (!RtlFreeHeap(HeapHandle, Flags, Array[Index]))
+                {
+                    /* ERROR_INVALID_PARAMETER */
+                    RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+                    break;
+                }
+            }
+            _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
             {
                 /* ERROR_INVALID_PARAMETER */
                 RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
                 break;
             }
+            _SEH2_END;
         }
-        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+
+        return Index;
+    }
+
+    Index = 0;
+    while (Index < Count && !Failed)
+    {
+        /* Check a batch of blocks, the ones of the front end are freed right away */
+        for (Batched = 0; Index < Count && Batched < HEAP_MULTIPLE_FREE_BATCH; Index++)
         {
-            /* ERROR_INVALID_PARAMETER */
-            RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
-            break;
+            if (Array[Index] == NULL)
+                continue;
+
+            HeapEntry = (PHEAP_ENTRY)Array[Index] - 1;
+            if (!RtlpCheckFreeEntry(HeapEntry))
+            {
+                Failed = TRUE;
+                break;
+            }
+
+            if (RtlpIsLowFragHeapEntry(HeapEntry))
+            {
+                if (!RtlpLowFragHeapFree(Heap, HeapEntry))
+                {
+                    Failed = TRUE;
+                    break;
+                }
+                continue;
+            }
+
+            /* Keep them in address order, so each one can merge with the one before */
+            for (j = Batched; j > 0 && Batch[j - 1] > HeapEntry; j--)
+                Batch[j] = Batch[j - 1];
+
+            /* Don't free the same block twice */
+            if (j > 0 && Batch[j - 1] == HeapEntry)
+            {
+                RtlMoveMemory(&Batch[j], &Batch[j + 1], (Batched - j) * sizeof(Batch[0]));
+                DPRINT1("HEAP: Trying to free an invalid address %p!\n", Array[Index]);
+                RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+                Failed = TRUE;
+                break;
+            }
+
+            Batch[j] = HeapEntry;
+            Batched++;
         }
-        _SEH2_END;
+
+        if (!Batched)
+            continue;
+
+        /* Free the whole batch with a single round trip on the lock */
+        if (!(Flags & HEAP_NO_SERIALIZE))
+            RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+        for (i = 0; i < Batched; i++)
+            RtlpFreeHeapEntry(Heap, Batch[i]);
+
+        if (!(Flags & HEAP_NO_SERIALIZE))
+            RtlLeaveHeapLock(Heap->LockVariable);
     }
 
     return Index;
@@ -54,6 +54,9 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* How many blocks RtlMultipleFreeHeap sorts and frees under one lock acquisition */
+#define HEAP_MULTIPLE_FREE_BATCH 64
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -313,6 +316,64 @@ typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
     HEAP_ENTRY BusyBlock;
 } HEAP_VIRTUAL_ALLOC_ENTRY, *PHEAP_VIRTUAL_ALLOC_ENTRY;
 
+/* Low fragmentation heap front end */
+#define HEAP_FRONT_LOWFRAGHEAP          2
+#define HEAP_LFH_BUCKETS                80
+#define HEAP_LFH_MAX_BLOCK_SIZE         256      /* In heap entries, header included */
+#define HEAP_LFH_AFFINITY_SLOTS         16
+#define HEAP_LFH_MIN_SUBSEGMENT_SIZE    0x1000
+#define HEAP_LFH_MAX_SUBSEGMENT_SIZE    0x10000
+#define HEAP_LFH_MIN_SUBSEGMENT_BLOCKS  4
+#define HEAP_LFH_SPIN_COUNT             4000
+#define HEAP_LFH_SUBSEGMENT_SIGNATURE   0x5348464C
+
+/* Blocks of the low fragmentation heap have this segment offset, which no segment can have */
+#define HEAP_LFH_SEGMENT_OFFSET         0xFF
+C_ASSERT(HEAP_LFH_SEGMENT_OFFSET >= HEAP_SEGMENTS);
+
+/*
+ * A subsegment is a block of the back end, cut in blocks of a single size
+ * class. The PreviousSize of each of those blocks is its distance in heap
+ * entries from the subsegment, so freeing it doesn't need any lookup.
+ */
+typedef struct _HEAP_LFH_SUBSEGMENT
+{
+    LIST_ENTRY ListEntry;
+    ULONG Signature;
+    struct _HEAP_LFH_AFFINITY_SLOT *AffinitySlot;
+    PHEAP_ENTRY FreeEntries;
+    USHORT BucketIndex;
+    USHORT BlockSize;
+    USHORT BlockCount;
+    USHORT FreeCount;
+} HEAP_LFH_SUBSEGMENT, *PHEAP_LFH_SUBSEGMENT;
+
+typedef struct _HEAP_LFH_BUCKET
+{
+    LIST_ENTRY SubSegments;     /* The ones that have free blocks */
+    ULONG SubSegmentSize;       /* Of the next one, grows as more are needed */
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+/* Threads are spread over the affinity slots, each with its own lock and subsegments */
+typedef struct _HEAP_LFH_AFFINITY_SLOT
+{
+    RTL_CRITICAL_SECTION Lock;
+    HEAP_LFH_BUCKET Buckets[HEAP_LFH_BUCKETS];
+} HEAP_LFH_AFFINITY_SLOT, *PHEAP_LFH_AFFINITY_SLOT;
+
+typedef struct _HEAP_LFH
+{
+    ULONG AffinitySlotCount;
+    HEAP_LFH_AFFINITY_SLOT AffinitySlots[ANYSIZE_ARRAY];
+} HEAP_LFH, *PHEAP_LFH;
+
+FORCEINLINE BOOLEAN
+RtlpIsLowFragHeapEntry(PHEAP_ENTRY HeapEntry)
+{
+    return (HeapEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET) &&
+           !(HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC);
+}
+
 /* Global variables */
 extern RTL_CRITICAL_SECTION RtlpProcessHeapsListLock;
 extern BOOLEAN RtlpPageHeapEnabled;
@@ -393,6 +454,34 @@ RtlDebugSizeHeap(HANDLE HeapPtr,
                  ULONG Flags,
                  PVOID Ptr);
 
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpCreateLowFragHeap(PHEAP Heap);
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap);
+
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapValidateEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry);
+
 /* heappage.c */
 
 HANDLE NTAPI
@@ -0,0 +1,443 @@
+/*
+ * PROJECT:     ReactOS Runtime Library
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Low fragmentation heap front end
+ */
+
+/*
+ * Small blocks are grouped by size class (bucket) in subsegments, which are
+ * themselves allocated from the back end. Each thread works with the
+ * subsegments of one affinity slot, so threads running on different
+ * processors don't fight for the heap lock, nor for the same cache lines.
+ * A block is always given back to the subsegment it came from, whatever
+ * thread frees it.
+ *
+ * The back end lock is never acquired while holding the lock of a slot.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define HEAP_LFH_SUBSEGMENT_HEADER \
+    (ROUND_UP(sizeof(HEAP_LFH_SUBSEGMENT), HEAP_ENTRY_SIZE) >> HEAP_ENTRY_SHIFT)
+
+/* FUNCTIONS *****************************************************************/
+
+/*
+ * Buckets 0 - 31 go by one heap entry, then every 16 buckets the step doubles:
+ * 2 entries up to 64, 4 up to 128 and 8 up to 256 (HEAP_LFH_MAX_BLOCK_SIZE).
+ * The step is kept small enough for the unused bytes to fit in the header.
+ */
+static
+ULONG
+RtlpLowFragHeapBucketIndex(SIZE_T BlockSize)
+{
+    ULONG Shift;
+
+    ASSERT(BlockSize != 0 && BlockSize <= HEAP_LFH_MAX_BLOCK_SIZE);
+
+    if (BlockSize <= 32) return (ULONG)BlockSize - 1;
+
+    for (Shift = 0; BlockSize > ((SIZE_T)64 << Shift); Shift++);
+
+    return 32 + 16 * Shift + (ULONG)((BlockSize - (32 << Shift) - 1) >> (Shift + 1));
+}
+
+static
+USHORT
+RtlpLowFragHeapBlockSize(ULONG BucketIndex)
+{
+    ULONG Shift;
+
+    ASSERT(BucketIndex < HEAP_LFH_BUCKETS);
+
+    if (BucketIndex < 32) return (USHORT)(BucketIndex + 1);
+
+    Shift = (BucketIndex - 32) >> 4;
+    return (USHORT)((32 << Shift) + ((((BucketIndex - 32) & 15) + 1) << (Shift + 1)));
+}
+
+static
+PHEAP_LFH_AFFINITY_SLOT
+RtlpLowFragHeapAffinitySlot(PHEAP_LFH Lfh)
+{
+    ULONG_PTR ThreadId = (ULONG_PTR)NtCurrentTeb()->ClientId.UniqueThread;
+
+    /* Thread IDs are multiples of 4 */
+    return &Lfh->AffinitySlots[(ThreadId >> 2) % Lfh->AffinitySlotCount];
+}
+
+FORCEINLINE
+PHEAP_LFH_SUBSEGMENT
+RtlpLowFragHeapSubSegment(PHEAP_ENTRY HeapEntry)
+{
+    return (PHEAP_LFH_SUBSEGMENT)(HeapEntry - HeapEntry->PreviousSize);
+}
+
+static
+BOOLEAN
+RtlpIsLowFragHeapSubSegmentEntry(PHEAP_LFH_SUBSEGMENT SubSegment,
+                                 PHEAP_ENTRY HeapEntry)
+{
+    ULONG_PTR Offset;
+
+    if (SubSegment->Signature != HEAP_LFH_SUBSEGMENT_SIGNATURE) return FALSE;
+
+    /* It has to be the start of one of its blocks */
+    Offset = HeapEntry->PreviousSize - HEAP_LFH_SUBSEGMENT_HEADER;
+    return (HeapEntry->PreviousSize >= HEAP_LFH_SUBSEGMENT_HEADER) &&
+           (HeapEntry->Size == SubSegment->BlockSize) &&
+           (Offset % SubSegment->BlockSize == 0) &&
+           (Offset / SubSegment->BlockSize < SubSegment->BlockCount);
+}
+
+static
+PHEAP_LFH_SUBSEGMENT
+RtlpCreateLowFragHeapSubSegment(PHEAP Heap,
+                                PHEAP_LFH_AFFINITY_SLOT AffinitySlot,
+                                ULONG BucketIndex,
+                                ULONG SubSegmentSize)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY HeapEntry, NextEntry;
+    USHORT BlockSize;
+    ULONG BlockCount, i;
+
+    BlockSize = RtlpLowFragHeapBlockSize(BucketIndex);
+    BlockCount = max(SubSegmentSize / (BlockSize << HEAP_ENTRY_SHIFT),
+                     HEAP_LFH_MIN_SUBSEGMENT_BLOCKS);
+
+    /* This is always too big to come from the front end again */
+    ASSERT(HEAP_LFH_SUBSEGMENT_HEADER + BlockCount * BlockSize > HEAP_LFH_MAX_BLOCK_SIZE);
+    SubSegment = RtlAllocateHeap(Heap,
+                                 0,
+                                 (HEAP_LFH_SUBSEGMENT_HEADER + BlockCount * BlockSize) << HEAP_ENTRY_SHIFT);
+    if (!SubSegment) return NULL;
+
+    SubSegment->Signature = HEAP_LFH_SUBSEGMENT_SIGNATURE;
+    SubSegment->AffinitySlot = AffinitySlot;
+    SubSegment->BucketIndex = (USHORT)BucketIndex;
+    SubSegment->BlockSize = BlockSize;
+    SubSegment->BlockCount = (USHORT)BlockCount;
+    SubSegment->FreeCount = (USHORT)BlockCount;
+
+    /* Build the free list backwards, so the blocks are handed out in address order */
+    NextEntry = NULL;
+    HeapEntry = (PHEAP_ENTRY)SubSegment + HEAP_LFH_SUBSEGMENT_HEADER + (BlockCount - 1) * BlockSize;
+    for (i = 0; i < BlockCount; i++)
+    {
+        HeapEntry->Size = BlockSize;
+        HeapEntry->Flags = 0;
+        HeapEntry->SmallTagIndex = 0;
+        HeapEntry->PreviousSize = (USHORT)(HeapEntry - (PHEAP_ENTRY)SubSegment);
+        HeapEntry->SegmentOffset = HEAP_LFH_SEGMENT_OFFSET;
+        HeapEntry->UnusedBytes = 0;
+        *(PHEAP_ENTRY *)(HeapEntry + 1) = NextEntry;
+
+        NextEntry = HeapEntry;
+        HeapEntry -= BlockSize;
+    }
+    SubSegment->FreeEntries = NextEntry;
+
+    return SubSegment;
+}
+
+NTSTATUS NTAPI
+RtlpCreateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh;
+    PHEAP_LFH_AFFINITY_SLOT AffinitySlot;
+    ULONG SlotCount, i, j;
+
+    /* Only user mode heaps using the normal back end, with its lock, can have one */
+    if (RtlpGetMode() != UserMode ||
+        (Heap->ForceFlags & HEAP_FLAG_PAGE_ALLOCS) ||
+        RtlpHeapIsSpecial(Heap->Flags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED |
+                        HEAP_CREATE_ALIGN_16)))
+    {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Nothing to do if it's already there */
+    if (Heap->FrontEndHeap) return STATUS_SUCCESS;
+
+    /* One affinity slot per processor */
+    SlotCount = min(max(NtCurrentPeb()->NumberOfProcessors, 1), HEAP_LFH_AFFINITY_SLOTS);
+    Lfh = RtlAllocateHeap(Heap, HEAP_ZERO_MEMORY, FIELD_OFFSET(HEAP_LFH, AffinitySlots[SlotCount]));
+    if (!Lfh) return STATUS_NO_MEMORY;
+
+    Lfh->AffinitySlotCount = SlotCount;
+    for (i = 0; i < SlotCount; i++)
+    {
+        AffinitySlot = &Lfh->AffinitySlots[i];
+        RtlInitializeCriticalSectionEx(&AffinitySlot->Lock,
+                                       HEAP_LFH_SPIN_COUNT,
+                                       RTL_CRITICAL_SECTION_FLAG_NO_DEBUG_INFO);
+
+        for (j = 0; j < HEAP_LFH_BUCKETS; j++)
+        {
+            InitializeListHead(&AffinitySlot->Buckets[j].SubSegments);
+            AffinitySlot->Buckets[j].SubSegmentSize = HEAP_LFH_MIN_SUBSEGMENT_SIZE;
+        }
+    }
+
+    /* Install it, unless someone else was faster */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+    if (!Heap->FrontEndHeap)
+    {
+        /* The pointer has to be visible before the type is */
+        InterlockedExchangePointer(&Heap->FrontEndHeap, Lfh);
+        Heap->FrontEndHeapType = HEAP_FRONT_LOWFRAGHEAP;
+        Lfh = NULL;
+    }
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    if (Lfh)
+    {
+        for (i = 0; i < SlotCount; i++)
+            RtlDeleteCriticalSection(&Lfh->AffinitySlots[i].Lock);
+        RtlFreeHeap(Heap, 0, Lfh);
+    }
+
+    DPRINT("Low fragmentation heap enabled for heap %p\n", Heap);
+    return STATUS_SUCCESS;
+}
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh = Heap->FrontEndHeap;
+    ULONG i;
+
+    /* The subsegments and the front end itself go away with the segments */
+    for (i = 0; i < Lfh->AffinitySlotCount; i++)
+        RtlDeleteCriticalSection(&Lfh->AffinitySlots[i].Lock);
+
+    Heap->FrontEndHeapType = 0;
+    Heap->FrontEndHeap = NULL;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags)
+{
+    PHEAP_LFH_AFFINITY_SLOT AffinitySlot;
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_ENTRY HeapEntry;
+    ULONG BucketIndex, SubSegmentSize;
+
+    BucketIndex = RtlpLowFragHeapBucketIndex(Index);
+    AffinitySlot = RtlpLowFragHeapAffinitySlot(Heap->FrontEndHeap);
+    Bucket = &AffinitySlot->Buckets[BucketIndex];
+
+    RtlEnterCriticalSection(&AffinitySlot->Lock);
+
+    if (IsListEmpty(&Bucket->SubSegments))
+    {
+        /* Get a bigger subsegment each time we run out */
+        SubSegmentSize = Bucket->SubSegmentSize;
+        Bucket->SubSegmentSize = min(SubSegmentSize * 2, HEAP_LFH_MAX_SUBSEGMENT_SIZE);
+
+        /* Don't hold our lock while the back end takes the heap lock */
+        RtlLeaveCriticalSection(&AffinitySlot->Lock);
+        SubSegment = RtlpCreateLowFragHeapSubSegment(Heap, AffinitySlot, BucketIndex, SubSegmentSize);
+
+        /* Let the back end try, it knows how to fail */
+        if (!SubSegment) return NULL;
+
+        RtlEnterCriticalSection(&AffinitySlot->Lock);
+        InsertHeadList(&Bucket->SubSegments, &SubSegment->ListEntry);
+    }
+
+    /* Take the first free block of the first subsegment that has one */
+    SubSegment = CONTAINING_RECORD(Bucket->SubSegments.Flink, HEAP_LFH_SUBSEGMENT, ListEntry);
+    ASSERT(SubSegment->FreeCount != 0);
+    HeapEntry = SubSegment->FreeEntries;
+    SubSegment->FreeEntries = *(PHEAP_ENTRY *)(HeapEntry + 1);
+
+    /* It's not looked at anymore once it's full */
+    if (--SubSegment->FreeCount == 0)
+        RemoveEntryList(&SubSegment->ListEntry);
+
+    ASSERT(!(HeapEntry->Flags & HEAP_ENTRY_BUSY));
+    HeapEntry->Flags = EntryFlags;
+    HeapEntry->UnusedBytes = (UCHAR)((HeapEntry->Size << HEAP_ENTRY_SHIFT) - Size);
+
+    RtlLeaveCriticalSection(&AffinitySlot->Lock);
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(HeapEntry + 1, Size);
+
+    return HeapEntry + 1;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_AFFINITY_SLOT AffinitySlot;
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_LFH_BUCKET Bucket;
+    BOOLEAN Release = FALSE;
+
+    SubSegment = RtlpLowFragHeapSubSegment(HeapEntry);
+
+    /* Make sure this really is one of our blocks */
+    _SEH2_TRY
+    {
+        if (!Heap->FrontEndHeap ||
+            !RtlpIsLowFragHeapSubSegmentEntry(SubSegment, HeapEntry))
+        {
+            DPRINT1("HEAP: Trying to free an invalid address %p!\n", HeapEntry + 1);
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+            _SEH2_YIELD(return FALSE);
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        DPRINT1("HEAP: Trying to free an invalid address %p!\n", HeapEntry + 1);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        _SEH2_YIELD(return FALSE);
+    }
+    _SEH2_END;
+
+    AffinitySlot = SubSegment->AffinitySlot;
+    Bucket = &AffinitySlot->Buckets[SubSegment->BucketIndex];
+
+    RtlEnterCriticalSection(&AffinitySlot->Lock);
+
+    /* Someone else might just have freed it */
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY))
+    {
+        RtlLeaveCriticalSection(&AffinitySlot->Lock);
+        DPRINT1("HEAP: Trying to free an invalid address %p!\n", HeapEntry + 1);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    HeapEntry->Flags = 0;
+    *(PHEAP_ENTRY *)(HeapEntry + 1) = SubSegment->FreeEntries;
+    SubSegment->FreeEntries = HeapEntry;
+
+    if (SubSegment->FreeCount++ == 0)
+    {
+        /* It has room again, so it's worth looking at */
+        InsertTailList(&Bucket->SubSegments, &SubSegment->ListEntry);
+    }
+    else if ((SubSegment->FreeCount == SubSegment->BlockCount) &&
+             (Bucket->SubSegments.Flink != Bucket->SubSegments.Blink))
+    {
+        /* It's empty and not the only one, give it back to the back end */
+        RemoveEntryList(&SubSegment->ListEntry);
+        Release = TRUE;
+    }
+
+    RtlLeaveCriticalSection(&AffinitySlot->Lock);
+
+    if (Release)
+    {
+        SubSegment->Signature = 0;
+        RtlFreeHeap(Heap, 0, SubSegment);
+    }
+
+    return TRUE;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size)
+{
+    PHEAP_ENTRY HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    SIZE_T OldSize, BlockSize;
+    EXCEPTION_RECORD ExceptionRecord;
+    PVOID NewPtr;
+
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return Ptr;
+    }
+
+    BlockSize = HeapEntry->Size << HEAP_ENTRY_SHIFT;
+    OldSize = BlockSize - HeapEntry->UnusedBytes;
+
+    /* Stay in the same block if the new size still belongs to its size class */
+    if (!(Flags & HEAP_EXTRA_FLAGS_MASK) &&
+        (((Size ? Size : 1) + Heap->AlignRound) & Heap->AlignMask) <= BlockSize &&
+        BlockSize - Size <= MAXUCHAR)
+    {
+        HeapEntry->UnusedBytes = (UCHAR)(BlockSize - Size);
+
+        if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY))
+            RtlZeroMemory((PCHAR)Ptr + OldSize, Size - OldSize);
+
+        return Ptr;
+    }
+
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        DPRINT1("Realloc in place failed, but it was the only option\n");
+        NewPtr = NULL;
+    }
+    else
+    {
+        /* Move it to a block that fits, from whichever end */
+        NewPtr = RtlAllocateHeap(Heap, Flags & ~HEAP_ZERO_MEMORY, Size);
+        if (NewPtr)
+        {
+            RtlMoveMemory(NewPtr, Ptr, min(Size, OldSize));
+
+            if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY))
+                RtlZeroMemory((PCHAR)NewPtr + OldSize, Size - OldSize);
+
+            RtlpLowFragHeapFree(Heap, HeapEntry);
+        }
+    }
+
+    if (!NewPtr && (Flags & HEAP_GENERATE_EXCEPTIONS))
+    {
+        ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
+        ExceptionRecord.ExceptionRecord = NULL;
+        ExceptionRecord.NumberParameters = 1;
+        ExceptionRecord.ExceptionFlags = 0;
+        ExceptionRecord.ExceptionInformation[0] = Size;
+
+        RtlRaiseException(&ExceptionRecord);
+    }
+
+    return NewPtr;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapValidateEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment = RtlpLowFragHeapSubSegment(HeapEntry);
+
+    if (!Heap->FrontEndHeap ||
+        !RtlpIsLowFragHeapSubSegmentEntry(SubSegment, HeapEntry))
+    {
+        DPRINT1("HEAP: Invalid heap entry %p in heap %p\n", HeapEntry, Heap);
+        return FALSE;
+    }
+
+    /* The subsegment itself is an ordinary block of the heap */
+    return RtlpValidateHeapEntry(Heap, (PHEAP_ENTRY)SubSegment - 1);
+}
+
+/* EOF */
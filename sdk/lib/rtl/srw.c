@@ -46,6 +46,13 @@
                              RTL_SRWLOCK_SHARED | RTL_SRWLOCK_CONTENTION_LOCK)
 #define RTL_SRWLOCK_BITS    4
 
+/* Wake values of the wait blocks */
+#define RTL_SRWLOCK_WAKE_SIGNALED   1
+#define RTL_SRWLOCK_WAKE_SLEEPING   2
+
+/* How many times a waiter checks its wake value before going to sleep */
+#define RTL_SRWLOCK_SPIN_COUNT  1024
+
 typedef struct _RTLP_SRWLOCK_SHARED_WAKE
 {
     LONG Wake;
@@ -80,6 +87,51 @@ typedef struct _RTLP_SRWLOCK_WAITBLOCK
 } volatile RTLP_SRWLOCK_WAITBLOCK, *PRTLP_SRWLOCK_WAITBLOCK;
 
 
+/* Wait until the releasing thread sets Wake. On MP systems, spin for a while
+   first, as the lock is usually held for a short time. Then block on the
+   keyed event, telling the waker about it through the sleeping bit */
+static VOID
+NTAPI
+RtlpWaitForSRWLockWake(IN OUT volatile LONG *Wake)
+{
+    ULONG Spin;
+
+    if (NtCurrentPeb()->NumberOfProcessors > 1)
+    {
+        for (Spin = 0; Spin < RTL_SRWLOCK_SPIN_COUNT; Spin++)
+        {
+            if (*Wake != 0)
+                return;
+
+            YieldProcessor();
+        }
+    }
+
+    if (InterlockedCompareExchange((PLONG)Wake,
+                                   RTL_SRWLOCK_WAKE_SLEEPING,
+                                   0) == 0)
+    {
+        /* Use the global keyed event (NULL as keyed event handle) */
+        NtWaitForKeyedEvent(NULL, (PVOID)Wake, FALSE, NULL);
+    }
+
+    ASSERT(*Wake & RTL_SRWLOCK_WAKE_SIGNALED);
+}
+
+
+static VOID
+NTAPI
+RtlpSetSRWLockWake(IN OUT volatile LONG *Wake)
+{
+    /* Once Wake is set, the waiter may return and its wait block is gone,
+       unless it was sleeping, in which case it waits for us */
+    if (InterlockedOr((PLONG)Wake, RTL_SRWLOCK_WAKE_SIGNALED) & RTL_SRWLOCK_WAKE_SLEEPING)
+    {
+        NtReleaseKeyedEvent(NULL, (PVOID)Wake, FALSE, NULL);
+    }
+}
+
+
 static VOID
 NTAPI
 RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
@@ -127,8 +179,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
 
     if (FirstWaitBlock->Exclusive)
     {
-        (void)InterlockedOr(&FirstWaitBlock->Wake,
-                            TRUE);
+        RtlpSetSRWLockWake(&FirstWaitBlock->Wake);
     }
     else
     {
@@ -141,8 +192,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
         {
             NextWake = WakeChain->Next;
 
-            (void)InterlockedOr((PLONG)&WakeChain->Wake,
-                                TRUE);
+            RtlpSetSRWLockWake(&WakeChain->Wake);
 
             WakeChain = NextWake;
         } while (WakeChain != NULL);
@@ -180,8 +230,7 @@ RtlpReleaseWaitBlockLockLastShared(IN OUT PRTL_SRWLOCK SRWLock,
 
     (void)InterlockedExchangePointer(&SRWLock->Ptr, (PVOID)NewValue);
 
-    (void)InterlockedOr(&FirstWaitBlock->Wake,
-                        TRUE);
+    RtlpSetSRWLockWake(&FirstWaitBlock->Wake);
 }
 
 
@@ -232,33 +281,10 @@ NTAPI
 RtlpAcquireSRWLockExclusiveWait(IN OUT PRTL_SRWLOCK SRWLock,
                                 IN PRTLP_SRWLOCK_WAITBLOCK WaitBlock)
 {
-    LONG_PTR CurrentValue;
-
-    while (1)
-    {
-        CurrentValue = *(volatile LONG_PTR *)&SRWLock->Ptr;
-        if (!(CurrentValue & RTL_SRWLOCK_SHARED))
-        {
-            if (CurrentValue & RTL_SRWLOCK_CONTENDED)
-            {
-                if (WaitBlock->Wake != 0)
-                {
-                    /* Our wait block became the first one
-                       in the chain, we own the lock now! */
-                    break;
-                }
-            }
-            else
-            {
-                /* The last wait block was removed and/or we're
-                   finally a simple exclusive lock. This means we
-                   don't need to wait anymore, we acquired the lock! */
-                break;
-            }
-        }
-
-        YieldProcessor();
-    }
+    /* Whoever hands the lock over to our wait block sets Wake, even when
+       the lock is turned back into a simple one. Don't look at the lock
+       value, so the wait block stays valid until it is done with it */
+    RtlpWaitForSRWLockWake(&WaitBlock->Wake);
 }
 
 
@@ -268,47 +294,9 @@ RtlpAcquireSRWLockSharedWait(IN OUT PRTL_SRWLOCK SRWLock,
                              IN OUT PRTLP_SRWLOCK_WAITBLOCK FirstWait  OPTIONAL,
                              IN OUT PRTLP_SRWLOCK_SHARED_WAKE WakeChain)
 {
-    if (FirstWait != NULL)
-    {
-        while (WakeChain->Wake == 0)
-        {
-            YieldProcessor();
-        }
-    }
-    else
-    {
-        LONG_PTR CurrentValue;
-
-        while (1)
-        {
-            CurrentValue = *(volatile LONG_PTR *)&SRWLock->Ptr;
-            if (CurrentValue & RTL_SRWLOCK_SHARED)
-            {
-                /* The RTL_SRWLOCK_OWNED bit always needs to be set when
-                   RTL_SRWLOCK_SHARED is set! */
-                ASSERT(CurrentValue & RTL_SRWLOCK_OWNED);
-
-                if (CurrentValue & RTL_SRWLOCK_CONTENDED)
-                {
-                    if (WakeChain->Wake != 0)
-                    {
-                        /* Our wait block became the first one
-                           in the chain, we own the lock now! */
-                        break;
-                    }
-                }
-                else
-                {
-                    /* The last wait block was removed and/or we're
-                       finally a simple shared lock. This means we
-                       don't need to wait anymore, we acquired the lock! */
-                    break;
-                }
-            }
-
-            YieldProcessor();
-        }
-    }
+    /* Every shared waiter of a wait block is in its wake chain, and the
+       whole chain is woken when the wait block gets the lock */
+    RtlpWaitForSRWLockWake(&WakeChain->Wake);
 }
 
 
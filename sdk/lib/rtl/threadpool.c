@@ -0,0 +1,1595 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Thread pool (Tp*) routines
+ *
+ * NOTES:             Every pool owns an I/O completion port. Queued
+ *                    callbacks are kept on per-object queues which are
+ *                    served round-robin, one port packet waking one
+ *                    worker per queued callback. The port also receives
+ *                    the completions of the files bound to the pool.
+ *                    Workers are added while there are more queued
+ *                    callbacks than idle workers, and exit again after
+ *                    staying idle for a while.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+VOID
+NTAPI
+RtlInitializeConditionVariable(OUT PRTL_CONDITION_VARIABLE ConditionVariable);
+
+VOID
+NTAPI
+RtlWakeAllConditionVariable(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable);
+
+NTSTATUS
+NTAPI
+RtlSleepConditionVariableCS(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
+                            IN OUT PRTL_CRITICAL_SECTION CriticalSection,
+                            IN const LARGE_INTEGER * TimeOut OPTIONAL);
+
+/* GLOBALS *******************************************************************/
+
+#define RTLP_TP_DEFAULT_MAX_THREADS 500
+#define RTLP_TP_IDLE_TIMEOUT        (-10000LL * 10000) /* 10 seconds */
+#define RTLP_TP_MAX_WAITS           (MAXIMUM_WAIT_OBJECTS - 1)
+
+typedef enum _RTLP_TP_OBJECT_TYPE
+{
+    TpSimpleObject,
+    TpWorkObject,
+    TpTimerObject,
+    TpWaitObject,
+    TpIoObject
+} RTLP_TP_OBJECT_TYPE;
+
+typedef struct _RTLP_TP_POOL
+{
+    LONG ReferenceCount;
+    BOOLEAN Shutdown;
+    RTL_CRITICAL_SECTION Lock;
+    HANDLE CompletionPort;
+    ULONG MaxThreads;
+    ULONG MinThreads;
+    ULONG Threads;
+    ULONG IdleThreads;
+    ULONG QueuedCallbacks;
+    ULONG PendingIo;
+    LIST_ENTRY Queues[TP_CALLBACK_PRIORITY_COUNT];
+} RTLP_TP_POOL, *PRTLP_TP_POOL;
+
+typedef struct _RTLP_TP_CLEANUP_GROUP
+{
+    LONG ReferenceCount;
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY Members;
+} RTLP_TP_CLEANUP_GROUP, *PRTLP_TP_CLEANUP_GROUP;
+
+struct _RTLP_TP_WAIT_BUCKET;
+
+typedef struct _RTLP_TP_OBJECT
+{
+    /* Must be first, kernel32 keeps the Win32 I/O callback here */
+    PVOID Win32Callback;
+    LONG ReferenceCount;
+    RTLP_TP_OBJECT_TYPE Type;
+    PRTLP_TP_POOL Pool;
+    PRTLP_TP_CLEANUP_GROUP Group;
+    LIST_ENTRY GroupEntry;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK GroupCancelCallback;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PVOID Context;
+    BOOLEAN LongFunction;
+    LONG Released;
+    TP_CALLBACK_PRIORITY Priority;
+    ULONG PendingCallbacks;
+    ULONG RunningCallbacks;
+    LIST_ENTRY QueueEntry;
+    RTL_CONDITION_VARIABLE Finished;
+    union
+    {
+        PTP_SIMPLE_CALLBACK Simple;
+        PTP_WORK_CALLBACK Work;
+        PTP_TIMER_CALLBACK Timer;
+        PTP_WAIT_CALLBACK Wait;
+        PTP_IO_CALLBACK Io;
+    } Callback;
+    union
+    {
+        struct
+        {
+            LIST_ENTRY Entry;
+            ULONGLONG DueTime;
+            ULONG Period;
+            ULONG Window;
+            BOOLEAN Set;
+            BOOLEAN Queued;
+        } Timer;
+        struct
+        {
+            struct _RTLP_TP_WAIT_BUCKET *Bucket;
+            LIST_ENTRY Entry;
+            HANDLE Handle;
+            ULONGLONG Timeout;
+            ULONG Signaled;
+        } Wait;
+        struct
+        {
+            ULONG PendingIo;
+            ULONG Canceling;
+        } Io;
+    } u;
+} RTLP_TP_OBJECT, *PRTLP_TP_OBJECT;
+
+typedef struct _RTLP_TP_CALLBACK_INSTANCE
+{
+    PRTLP_TP_OBJECT Object;
+    BOOLEAN Associated;
+    BOOLEAN MayRunLong;
+    PRTL_CRITICAL_SECTION CriticalSection;
+    HANDLE Mutex;
+    HANDLE Semaphore;
+    ULONG SemaphoreReleaseCount;
+    HANDLE Event;
+    PVOID DllHandle;
+} RTLP_TP_CALLBACK_INSTANCE, *PRTLP_TP_CALLBACK_INSTANCE;
+
+typedef struct _RTLP_TP_WAIT_BUCKET
+{
+    LIST_ENTRY BucketEntry;
+    LIST_ENTRY Waits;
+    ULONG Count;
+    HANDLE UpdateEvent;
+} RTLP_TP_WAIT_BUCKET, *PRTLP_TP_WAIT_BUCKET;
+
+static RTL_RUN_ONCE RtlpTpDefaultPoolOnce = RTL_RUN_ONCE_INIT;
+static PRTLP_TP_POOL RtlpTpDefaultPool;
+
+static RTL_RUN_ONCE RtlpTpTimerOnce = RTL_RUN_ONCE_INIT;
+static RTL_CRITICAL_SECTION RtlpTpTimerLock;
+static LIST_ENTRY RtlpTpTimerList;
+static HANDLE RtlpTpTimerEvent;
+
+static RTL_RUN_ONCE RtlpTpWaitOnce = RTL_RUN_ONCE_INIT;
+static RTL_CRITICAL_SECTION RtlpTpWaitLock;
+static LIST_ENTRY RtlpTpWaitBuckets;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+NTSTATUS
+RtlpTpStartThread(IN PTHREAD_START_ROUTINE StartRoutine,
+                  IN PVOID Parameter)
+{
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+
+    Status = RtlCreateUserThread(NtCurrentProcess(),
+                                 NULL,
+                                 FALSE,
+                                 0,
+                                 0,
+                                 0,
+                                 StartRoutine,
+                                 Parameter,
+                                 &ThreadHandle,
+                                 NULL);
+    if (NT_SUCCESS(Status))
+        NtClose(ThreadHandle);
+
+    return Status;
+}
+
+static
+VOID
+RtlpTpFreePool(IN PRTLP_TP_POOL Pool)
+{
+    NtClose(Pool->CompletionPort);
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static
+VOID
+RtlpTpDereferencePool(IN PRTLP_TP_POOL Pool)
+{
+    ULONG Threads, i;
+
+    if (InterlockedDecrement(&Pool->ReferenceCount))
+        return;
+
+    /* Nothing can queue callbacks anymore, tell the workers to go away */
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->Shutdown = TRUE;
+    Threads = Pool->Threads;
+    for (i = 0; i < Threads; i++)
+        NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* Otherwise the last worker to exit frees the pool */
+    if (!Threads)
+        RtlpTpFreePool(Pool);
+}
+
+static ULONG NTAPI RtlpTpWorkerThread(IN PVOID Parameter);
+
+static
+NTSTATUS
+RtlpTpStartWorkerLocked(IN PRTLP_TP_POOL Pool)
+{
+    NTSTATUS Status;
+
+    Status = RtlpTpStartThread(RtlpTpWorkerThread, Pool);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to start a thread pool worker: 0x%lx\n", Status);
+        return Status;
+    }
+
+    /* The new worker goes straight to the completion port */
+    Pool->Threads++;
+    Pool->IdleThreads++;
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+RtlpTpReferenceObject(IN PRTLP_TP_OBJECT Object)
+{
+    InterlockedIncrement(&Object->ReferenceCount);
+}
+
+static
+VOID
+RtlpTpDereferenceObject(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    if (InterlockedDecrement(&Object->ReferenceCount))
+        return;
+
+    ASSERT(!Object->PendingCallbacks && !Object->RunningCallbacks);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+    RtlpTpDereferencePool(Pool);
+}
+
+static
+VOID
+RtlpTpDereferenceGroup(IN PRTLP_TP_CLEANUP_GROUP Group)
+{
+    if (InterlockedDecrement(&Group->ReferenceCount))
+        return;
+
+    RtlDeleteCriticalSection(&Group->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Group);
+}
+
+static
+ULONG
+NTAPI
+RtlpTpInitDefaultPool(IN OUT PRTL_RUN_ONCE RunOnce,
+                      IN OUT PVOID Parameter OPTIONAL,
+                      IN OUT PVOID *Context OPTIONAL)
+{
+    /* The default pool lives as long as the process */
+    return NT_SUCCESS(TpAllocPool((PTP_POOL*)&RtlpTpDefaultPool, NULL));
+}
+
+static
+NTSTATUS
+RtlpTpAllocObject(OUT PRTLP_TP_OBJECT *ObjectReturn,
+                  IN RTLP_TP_OBJECT_TYPE Type,
+                  IN PVOID Callback,
+                  IN PVOID Context OPTIONAL,
+                  IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    TP_CALLBACK_PRIORITY Priority = TP_CALLBACK_PRIORITY_NORMAL;
+    PRTLP_TP_POOL Pool = NULL;
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    if (CallbackEnviron)
+    {
+        if (CallbackEnviron->Version == 3)
+        {
+            Priority = ((TP_CALLBACK_ENVIRON_V3*)CallbackEnviron)->CallbackPriority;
+            if (Priority < TP_CALLBACK_PRIORITY_HIGH || Priority >= TP_CALLBACK_PRIORITY_COUNT)
+                return STATUS_INVALID_PARAMETER;
+        }
+        else if (CallbackEnviron->Version != 1)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        Pool = (PRTLP_TP_POOL)CallbackEnviron->Pool;
+    }
+
+    if (!Pool)
+    {
+        Status = RtlRunOnceExecuteOnce(&RtlpTpDefaultPoolOnce, RtlpTpInitDefaultPool, NULL, NULL);
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        Pool = RtlpTpDefaultPool;
+    }
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Object));
+    if (!Object)
+        return STATUS_NO_MEMORY;
+
+    /* One reference for the caller, and one on the pool */
+    Object->ReferenceCount = 1;
+    Object->Type = Type;
+    Object->Pool = Pool;
+    Object->Callback.Simple = (PTP_SIMPLE_CALLBACK)Callback;
+    Object->Context = Context;
+    Object->Priority = Priority;
+    InitializeListHead(&Object->GroupEntry);
+    RtlInitializeConditionVariable(&Object->Finished);
+    InterlockedIncrement(&Pool->ReferenceCount);
+
+    if (CallbackEnviron)
+    {
+        /* Linked to the group by RtlpTpInsertObject, once the object is complete */
+        Object->Group = (PRTLP_TP_CLEANUP_GROUP)CallbackEnviron->CleanupGroup;
+        Object->GroupCancelCallback = CallbackEnviron->CleanupGroupCancelCallback;
+        Object->FinalizationCallback = CallbackEnviron->FinalizationCallback;
+        Object->LongFunction = CallbackEnviron->u.s.LongFunction;
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+RtlpTpInsertObject(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_CLEANUP_GROUP Group = Object->Group;
+
+    if (!Group)
+        return;
+
+    /* The group keeps the member alive until it releases it */
+    RtlpTpReferenceObject(Object);
+    InterlockedIncrement(&Group->ReferenceCount);
+
+    RtlEnterCriticalSection(&Group->Lock);
+    InsertTailList(&Group->Members, &Object->GroupEntry);
+    RtlLeaveCriticalSection(&Group->Lock);
+}
+
+static
+VOID
+RtlpTpRemoveObject(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_CLEANUP_GROUP Group = Object->Group;
+
+    if (!Group)
+        return;
+
+    RtlEnterCriticalSection(&Group->Lock);
+    if (Object->Group != Group)
+    {
+        /* TpReleaseCleanupGroupMembers got it first */
+        RtlLeaveCriticalSection(&Group->Lock);
+        return;
+    }
+    RemoveEntryList(&Object->GroupEntry);
+    InitializeListHead(&Object->GroupEntry);
+    Object->Group = NULL;
+    RtlLeaveCriticalSection(&Group->Lock);
+
+    RtlpTpDereferenceObject(Object);
+    RtlpTpDereferenceGroup(Group);
+}
+
+static
+VOID
+RtlpTpQueueCallbackLocked(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    /* Objects sit once in their queue, holding one reference */
+    if (Object->PendingCallbacks++ == 0)
+    {
+        RtlpTpReferenceObject(Object);
+        InsertTailList(&Pool->Queues[Object->Priority], &Object->QueueEntry);
+    }
+
+    Pool->QueuedCallbacks++;
+    NtSetIoCompletion(Pool->CompletionPort, Pool, NULL, STATUS_SUCCESS, 0);
+
+    /* Grow while the idle workers can't take all the queued callbacks */
+    if (Pool->QueuedCallbacks > Pool->IdleThreads && Pool->Threads < Pool->MaxThreads)
+        RtlpTpStartWorkerLocked(Pool);
+}
+
+static
+BOOLEAN
+RtlpTpCancelCallbacksLocked(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    if (!Object->PendingCallbacks)
+        return FALSE;
+
+    /* The extra port packets find an empty queue and are ignored */
+    RemoveEntryList(&Object->QueueEntry);
+    Pool->QueuedCallbacks -= Object->PendingCallbacks;
+    Object->PendingCallbacks = 0;
+    if (Object->Type == TpWaitObject)
+        Object->u.Wait.Signaled = 0;
+
+    if (!Object->RunningCallbacks)
+        RtlWakeAllConditionVariable(&Object->Finished);
+
+    /* The caller drops the queue reference once the lock is released */
+    return TRUE;
+}
+
+static
+VOID
+RtlpTpCallbackDoneLocked(IN PRTLP_TP_OBJECT Object)
+{
+    ASSERT(Object->RunningCallbacks);
+    Object->RunningCallbacks--;
+    if (!Object->PendingCallbacks && !Object->RunningCallbacks)
+        RtlWakeAllConditionVariable(&Object->Finished);
+}
+
+static
+VOID
+RtlpTpWaitForCallbacks(IN PRTLP_TP_OBJECT Object,
+                       IN BOOLEAN CancelPendingCallbacks)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    BOOLEAN Canceled = FALSE;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (CancelPendingCallbacks)
+        Canceled = RtlpTpCancelCallbacksLocked(Object);
+    while (Object->PendingCallbacks ||
+           Object->RunningCallbacks ||
+           (Object->Type == TpIoObject && Object->u.Io.PendingIo))
+    {
+        RtlSleepConditionVariableCS(&Object->Finished, &Pool->Lock, NULL);
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (Canceled)
+    {
+        /* A simple callback that never ran also gives up its own reference */
+        if (Object->Type == TpSimpleObject)
+            RtlpTpDereferenceObject(Object);
+        RtlpTpDereferenceObject(Object);
+    }
+}
+
+static
+PRTLP_TP_OBJECT
+RtlpTpDequeueCallbackLocked(IN PRTLP_TP_POOL Pool,
+                            OUT PULONG WaitResult)
+{
+    PRTLP_TP_OBJECT Object;
+    ULONG Priority;
+
+    for (Priority = TP_CALLBACK_PRIORITY_HIGH; Priority < TP_CALLBACK_PRIORITY_COUNT; Priority++)
+    {
+        if (IsListEmpty(&Pool->Queues[Priority]))
+            continue;
+
+        Object = CONTAINING_RECORD(RemoveHeadList(&Pool->Queues[Priority]),
+                                   RTLP_TP_OBJECT,
+                                   QueueEntry);
+        Pool->QueuedCallbacks--;
+        Object->RunningCallbacks++;
+
+        /* Go to the back of the line, so that busy objects don't starve the others.
+           The queue reference becomes the one of the running callback when the
+           object leaves the queue, otherwise it takes a new one. */
+        if (--Object->PendingCallbacks)
+        {
+            RtlpTpReferenceObject(Object);
+            InsertTailList(&Pool->Queues[Priority], &Object->QueueEntry);
+        }
+
+        *WaitResult = WAIT_TIMEOUT;
+        if (Object->Type == TpWaitObject && Object->u.Wait.Signaled)
+        {
+            Object->u.Wait.Signaled--;
+            *WaitResult = WAIT_OBJECT_0;
+        }
+
+        return Object;
+    }
+
+    return NULL;
+}
+
+static
+VOID
+RtlpTpRunCallback(IN PRTLP_TP_OBJECT Object,
+                  IN ULONG WaitResult,
+                  IN PVOID ApcContext OPTIONAL,
+                  IN PIO_STATUS_BLOCK IoStatusBlock OPTIONAL)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    RTLP_TP_CALLBACK_INSTANCE Instance;
+    PTP_CALLBACK_INSTANCE CallbackInstance = (PTP_CALLBACK_INSTANCE)&Instance;
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    Instance.Associated = TRUE;
+    Instance.MayRunLong = Object->LongFunction;
+
+    switch (Object->Type)
+    {
+        case TpSimpleObject:
+            Object->Callback.Simple(CallbackInstance, Object->Context);
+            break;
+
+        case TpWorkObject:
+            Object->Callback.Work(CallbackInstance, Object->Context, (PTP_WORK)Object);
+            break;
+
+        case TpTimerObject:
+            Object->Callback.Timer(CallbackInstance, Object->Context, (PTP_TIMER)Object);
+            break;
+
+        case TpWaitObject:
+            Object->Callback.Wait(CallbackInstance, Object->Context, (PTP_WAIT)Object, WaitResult);
+            break;
+
+        case TpIoObject:
+            Object->Callback.Io(CallbackInstance, Object->Context, ApcContext, IoStatusBlock, (PTP_IO)Object);
+            break;
+    }
+
+    if (Object->FinalizationCallback)
+        Object->FinalizationCallback(CallbackInstance, Object->Context);
+
+    /* Completion actions requested by the callback */
+    if (Instance.CriticalSection)
+        RtlLeaveCriticalSection(Instance.CriticalSection);
+    if (Instance.Mutex)
+        NtReleaseMutant(Instance.Mutex, NULL);
+    if (Instance.Semaphore)
+        NtReleaseSemaphore(Instance.Semaphore, Instance.SemaphoreReleaseCount, NULL);
+    if (Instance.Event)
+        NtSetEvent(Instance.Event, NULL);
+    if (Instance.DllHandle)
+        LdrUnloadDll(Instance.DllHandle);
+
+    if (Instance.Associated)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+        RtlpTpCallbackDoneLocked(Object);
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+
+    /* Simple callbacks run only once, they are done with the group and their own reference */
+    if (Object->Type == TpSimpleObject)
+    {
+        RtlpTpRemoveObject(Object);
+        RtlpTpDereferenceObject(Object);
+    }
+
+    RtlpTpDereferenceObject(Object);
+}
+
+static
+ULONG
+NTAPI
+RtlpTpWorkerThread(IN PVOID Parameter)
+{
+    PRTLP_TP_POOL Pool = Parameter;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PRTLP_TP_OBJECT Object;
+    LARGE_INTEGER Timeout;
+    PVOID Key, ApcContext;
+    ULONG WaitResult;
+    BOOLEAN Free;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        Timeout.QuadPart = RTLP_TP_IDLE_TIMEOUT;
+        Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                      &Key,
+                                      &ApcContext,
+                                      &IoStatusBlock,
+                                      &Timeout);
+
+        RtlEnterCriticalSection(&Pool->Lock);
+        Pool->IdleThreads--;
+
+        if (Status == STATUS_TIMEOUT && !Pool->Shutdown)
+        {
+            /* Keep the minimum number of workers around, and one for the pending I/O */
+            if (Pool->Threads <= Pool->MinThreads ||
+                (Pool->PendingIo && Pool->Threads == 1))
+            {
+                Pool->IdleThreads++;
+                RtlLeaveCriticalSection(&Pool->Lock);
+                continue;
+            }
+
+            /* A packet posted before we took the lock counted on us being idle,
+               only leave if the port is still empty */
+            Timeout.QuadPart = 0;
+            Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                          &Key,
+                                          &ApcContext,
+                                          &IoStatusBlock,
+                                          &Timeout);
+        }
+
+        if (Status == STATUS_TIMEOUT)
+            break;
+
+        if (!NT_SUCCESS(Status) || !Key)
+            break;
+
+        if (Key == Pool)
+        {
+            /* A queued callback, unless it was canceled in the meantime */
+            Object = RtlpTpDequeueCallbackLocked(Pool, &WaitResult);
+            RtlLeaveCriticalSection(&Pool->Lock);
+
+            if (Object)
+                RtlpTpRunCallback(Object, WaitResult, NULL, NULL);
+        }
+        else
+        {
+            /* A completion for a file bound to the pool, the operation reference is the one of the callback */
+            Object = Key;
+            Object->u.Io.PendingIo--;
+            Pool->PendingIo--;
+
+            if (Object->u.Io.Canceling)
+            {
+                /* Dropped by TpWaitForIoCompletion, don't run the callback */
+                if (!Object->u.Io.PendingIo && !Object->RunningCallbacks)
+                    RtlWakeAllConditionVariable(&Object->Finished);
+                RtlLeaveCriticalSection(&Pool->Lock);
+
+                RtlpTpDereferenceObject(Object);
+            }
+            else
+            {
+                Object->RunningCallbacks++;
+                RtlLeaveCriticalSection(&Pool->Lock);
+
+                RtlpTpRunCallback(Object, 0, ApcContext, &IoStatusBlock);
+            }
+        }
+
+        RtlEnterCriticalSection(&Pool->Lock);
+        Pool->IdleThreads++;
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+
+    Pool->Threads--;
+    Free = Pool->Shutdown && !Pool->Threads;
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (Free)
+        RtlpTpFreePool(Pool);
+
+    RtlExitUserThread(STATUS_SUCCESS);
+    return 0;
+}
+
+static
+ULONGLONG
+RtlpTpGetDueTime(IN PLARGE_INTEGER DueTime,
+                 IN ULONGLONG CurrentTime)
+{
+    /* Negative times are relative, zero means right now */
+    if (DueTime->QuadPart < 0)
+        return CurrentTime - DueTime->QuadPart;
+    if (DueTime->QuadPart == 0)
+        return CurrentTime;
+    return DueTime->QuadPart;
+}
+
+static
+ULONG
+NTAPI
+RtlpTpTimerThread(IN PVOID Parameter)
+{
+    PLIST_ENTRY Entry, NextEntry;
+    PRTLP_TP_OBJECT Timer;
+    LARGE_INTEGER CurrentTime, Timeout;
+    ULONGLONG Deadline;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&RtlpTpTimerLock);
+        NtQuerySystemTime(&CurrentTime);
+        Deadline = MAXULONGLONG;
+
+        for (Entry = RtlpTpTimerList.Flink; Entry != &RtlpTpTimerList; Entry = NextEntry)
+        {
+            NextEntry = Entry->Flink;
+            Timer = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.Entry);
+
+            if (Timer->u.Timer.DueTime <= (ULONGLONG)CurrentTime.QuadPart)
+            {
+                RtlEnterCriticalSection(&Timer->Pool->Lock);
+                RtlpTpQueueCallbackLocked(Timer);
+                RtlLeaveCriticalSection(&Timer->Pool->Lock);
+
+                if (!Timer->u.Timer.Period)
+                {
+                    RemoveEntryList(&Timer->u.Timer.Entry);
+                    Timer->u.Timer.Queued = FALSE;
+                    continue;
+                }
+
+                /* Periodic timers don't try to catch up with missed periods */
+                Timer->u.Timer.DueTime += Timer->u.Timer.Period * 10000ULL;
+                if (Timer->u.Timer.DueTime <= (ULONGLONG)CurrentTime.QuadPart)
+                    Timer->u.Timer.DueTime = CurrentTime.QuadPart + Timer->u.Timer.Period * 10000ULL;
+            }
+
+            /* Sleep as long as the window of the timers allows, to fire them together */
+            Deadline = min(Deadline, Timer->u.Timer.DueTime + Timer->u.Timer.Window * 10000ULL);
+        }
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+
+        if (Deadline == MAXULONGLONG)
+        {
+            NtWaitForSingleObject(RtlpTpTimerEvent, FALSE, NULL);
+        }
+        else
+        {
+            Timeout.QuadPart = Deadline;
+            NtWaitForSingleObject(RtlpTpTimerEvent, FALSE, &Timeout);
+        }
+    }
+
+    return 0;
+}
+
+static
+ULONG
+NTAPI
+RtlpTpInitTimers(IN OUT PRTL_RUN_ONCE RunOnce,
+                 IN OUT PVOID Parameter OPTIONAL,
+                 IN OUT PVOID *Context OPTIONAL)
+{
+    NTSTATUS Status;
+
+    Status = NtCreateEvent(&RtlpTpTimerEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+        return FALSE;
+
+    RtlInitializeCriticalSection(&RtlpTpTimerLock);
+    InitializeListHead(&RtlpTpTimerList);
+
+    Status = RtlpTpStartThread(RtlpTpTimerThread, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to start the thread pool timer thread: 0x%lx\n", Status);
+        RtlDeleteCriticalSection(&RtlpTpTimerLock);
+        NtClose(RtlpTpTimerEvent);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+RtlpTpDisarmWaitLocked(IN PRTLP_TP_OBJECT Wait)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = Wait->u.Wait.Bucket;
+
+    RemoveEntryList(&Wait->u.Wait.Entry);
+    Bucket->Count--;
+    Wait->u.Wait.Bucket = NULL;
+
+    /* The armed reference can't be the last one, the caller or the queue holds another */
+    InterlockedDecrement(&Wait->ReferenceCount);
+}
+
+static
+VOID
+RtlpTpSignalWaitLocked(IN PRTLP_TP_OBJECT Wait,
+                       IN BOOLEAN Signaled)
+{
+    PRTLP_TP_POOL Pool = Wait->Pool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (Signaled)
+        Wait->u.Wait.Signaled++;
+    RtlpTpQueueCallbackLocked(Wait);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlpTpDisarmWaitLocked(Wait);
+}
+
+static
+PRTLP_TP_OBJECT
+RtlpTpFindWaitLocked(IN PRTLP_TP_WAIT_BUCKET Bucket,
+                     IN PRTLP_TP_OBJECT Wait,
+                     IN HANDLE Handle)
+{
+    PLIST_ENTRY Entry;
+
+    /* Only compare the pointer, the wait may have been freed since */
+    for (Entry = Bucket->Waits.Flink; Entry != &Bucket->Waits; Entry = Entry->Flink)
+    {
+        if (CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Wait.Entry) == Wait)
+            return Wait->u.Wait.Handle == Handle ? Wait : NULL;
+    }
+
+    return NULL;
+}
+
+static
+ULONG
+NTAPI
+RtlpTpWaitThread(IN PVOID Parameter)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    PRTLP_TP_OBJECT Waits[MAXIMUM_WAIT_OBJECTS];
+    PLIST_ENTRY Entry, NextEntry;
+    PRTLP_TP_OBJECT Wait;
+    LARGE_INTEGER CurrentTime, Timeout;
+    ULONGLONG Deadline;
+    ULONG Count, i;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+        /* Fire the waits that timed out */
+        NtQuerySystemTime(&CurrentTime);
+        Deadline = MAXULONGLONG;
+        Handles[0] = Bucket->UpdateEvent;
+        Waits[0] = NULL;
+        Count = 1;
+        for (Entry = Bucket->Waits.Flink; Entry != &Bucket->Waits; Entry = NextEntry)
+        {
+            NextEntry = Entry->Flink;
+            Wait = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Wait.Entry);
+
+            if (Wait->u.Wait.Timeout <= (ULONGLONG)CurrentTime.QuadPart)
+            {
+                RtlpTpSignalWaitLocked(Wait, FALSE);
+                continue;
+            }
+
+            Deadline = min(Deadline, Wait->u.Wait.Timeout);
+            Handles[Count] = Wait->u.Wait.Handle;
+            Waits[Count] = Wait;
+            Count++;
+        }
+
+        if (Count == 1)
+        {
+            /* Nothing left to wait for, retire the bucket */
+            RemoveEntryList(&Bucket->BucketEntry);
+            RtlLeaveCriticalSection(&RtlpTpWaitLock);
+            NtClose(Bucket->UpdateEvent);
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+            break;
+        }
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+
+        Timeout.QuadPart = Deadline;
+        Status = NtWaitForMultipleObjects(Count,
+                                          Handles,
+                                          WaitAny,
+                                          FALSE,
+                                          Deadline == MAXULONGLONG ? NULL : &Timeout);
+        if ((Status > STATUS_WAIT_0 && Status < STATUS_WAIT_0 + Count) ||
+            (Status > STATUS_ABANDONED_WAIT_0 && Status < STATUS_ABANDONED_WAIT_0 + Count))
+        {
+            /* An abandoned mutex still counts as signaled */
+            i = (Status & ~STATUS_ABANDONED_WAIT_0) - STATUS_WAIT_0;
+
+            RtlEnterCriticalSection(&RtlpTpWaitLock);
+            Wait = RtlpTpFindWaitLocked(Bucket, Waits[i], Handles[i]);
+            if (Wait)
+                RtlpTpSignalWaitLocked(Wait, TRUE);
+            RtlLeaveCriticalSection(&RtlpTpWaitLock);
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            /* Drop the handles that can't be waited on, instead of spinning on them */
+            Timeout.QuadPart = 0;
+            RtlEnterCriticalSection(&RtlpTpWaitLock);
+            for (i = 1; i < Count; i++)
+            {
+                Wait = RtlpTpFindWaitLocked(Bucket, Waits[i], Handles[i]);
+                if (!Wait)
+                    continue;
+
+                Status = NtWaitForSingleObject(Handles[i], FALSE, &Timeout);
+                if (NT_SUCCESS(Status))
+                    continue;
+
+                DPRINT1("Thread pool wait on handle %p failed: 0x%lx\n", Handles[i], Status);
+                RtlpTpDisarmWaitLocked(Wait);
+            }
+            RtlLeaveCriticalSection(&RtlpTpWaitLock);
+        }
+    }
+
+    RtlExitUserThread(STATUS_SUCCESS);
+    return 0;
+}
+
+static
+ULONG
+NTAPI
+RtlpTpInitWaits(IN OUT PRTL_RUN_ONCE RunOnce,
+                IN OUT PVOID Parameter OPTIONAL,
+                IN OUT PVOID *Context OPTIONAL)
+{
+    RtlInitializeCriticalSection(&RtlpTpWaitLock);
+    InitializeListHead(&RtlpTpWaitBuckets);
+    return TRUE;
+}
+
+static
+PRTLP_TP_WAIT_BUCKET
+RtlpTpGetWaitBucketLocked(VOID)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket;
+    PLIST_ENTRY Entry;
+    NTSTATUS Status;
+
+    for (Entry = RtlpTpWaitBuckets.Flink; Entry != &RtlpTpWaitBuckets; Entry = Entry->Flink)
+    {
+        Bucket = CONTAINING_RECORD(Entry, RTLP_TP_WAIT_BUCKET, BucketEntry);
+        if (Bucket->Count < RTLP_TP_MAX_WAITS)
+            return Bucket;
+    }
+
+    Bucket = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*Bucket));
+    if (!Bucket)
+        return NULL;
+
+    Status = NtCreateEvent(&Bucket->UpdateEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+        return NULL;
+    }
+
+    InitializeListHead(&Bucket->Waits);
+    Bucket->Count = 0;
+
+    Status = RtlpTpStartThread(RtlpTpWaitThread, Bucket);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to start a thread pool wait thread: 0x%lx\n", Status);
+        NtClose(Bucket->UpdateEvent);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+        return NULL;
+    }
+
+    /* The thread can't look at the bucket before we release the lock */
+    InsertTailList(&RtlpTpWaitBuckets, &Bucket->BucketEntry);
+    return Bucket;
+}
+
+static
+VOID
+RtlpTpDisarmObject(IN PRTLP_TP_OBJECT Object)
+{
+    if (Object->Type == TpTimerObject)
+        TpSetTimer((PTP_TIMER)Object, NULL, 0, 0);
+    else if (Object->Type == TpWaitObject)
+        TpSetWait((PTP_WAIT)Object, NULL, NULL);
+}
+
+static
+VOID
+RtlpTpReleaseObject(IN PRTLP_TP_OBJECT Object)
+{
+    RtlpTpDisarmObject(Object);
+
+    /* TpReleaseCleanupGroupMembers may already have released it */
+    if (InterlockedExchange(&Object->Released, TRUE))
+        return;
+
+    RtlpTpRemoveObject(Object);
+    RtlpTpDereferenceObject(Object);
+}
+
+/* FUNCTIONS *****************************************************************/
+
+NTSTATUS
+NTAPI
+TpAllocPool(OUT PTP_POOL *PoolReturn,
+            IN PVOID Reserved)
+{
+    PRTLP_TP_POOL Pool;
+    ULONG i;
+    NTSTATUS Status;
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Pool));
+    if (!Pool)
+        return STATUS_NO_MEMORY;
+
+    Status = NtCreateIoCompletion(&Pool->CompletionPort,
+                                  IO_COMPLETION_ALL_ACCESS,
+                                  NULL,
+                                  0);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    RtlInitializeCriticalSection(&Pool->Lock);
+    Pool->ReferenceCount = 1;
+    Pool->MaxThreads = RTLP_TP_DEFAULT_MAX_THREADS;
+    for (i = 0; i < TP_CALLBACK_PRIORITY_COUNT; i++)
+        InitializeListHead(&Pool->Queues[i]);
+
+    *PoolReturn = (PTP_POOL)Pool;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleasePool(IN OUT PTP_POOL Pool)
+{
+    RtlpTpDereferencePool((PRTLP_TP_POOL)Pool);
+}
+
+VOID
+NTAPI
+TpSetPoolMaxThreads(IN OUT PTP_POOL Pool,
+                    IN ULONG MaxThreads)
+{
+    PRTLP_TP_POOL TpPool = (PRTLP_TP_POOL)Pool;
+
+    RtlEnterCriticalSection(&TpPool->Lock);
+    TpPool->MaxThreads = max(MaxThreads, 1);
+    TpPool->MinThreads = min(TpPool->MinThreads, TpPool->MaxThreads);
+    RtlLeaveCriticalSection(&TpPool->Lock);
+}
+
+NTSTATUS
+NTAPI
+TpSetPoolMinThreads(IN OUT PTP_POOL Pool,
+                    IN ULONG MinThreads)
+{
+    PRTLP_TP_POOL TpPool = (PRTLP_TP_POOL)Pool;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&TpPool->Lock);
+    while (TpPool->Threads < MinThreads)
+    {
+        Status = RtlpTpStartWorkerLocked(TpPool);
+        if (!NT_SUCCESS(Status))
+            break;
+    }
+
+    if (NT_SUCCESS(Status))
+    {
+        TpPool->MinThreads = MinThreads;
+        TpPool->MaxThreads = max(TpPool->MaxThreads, MinThreads);
+    }
+    RtlLeaveCriticalSection(&TpPool->Lock);
+
+    return Status;
+}
+
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PRTLP_TP_CLEANUP_GROUP Group;
+
+    Group = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*Group));
+    if (!Group)
+        return STATUS_NO_MEMORY;
+
+    Group->ReferenceCount = 1;
+    RtlInitializeCriticalSection(&Group->Lock);
+    InitializeListHead(&Group->Members);
+
+    *CleanupGroupReturn = (PTP_CLEANUP_GROUP)Group;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseCleanupGroup(IN OUT PTP_CLEANUP_GROUP CleanupGroup)
+{
+    RtlpTpDereferenceGroup((PRTLP_TP_CLEANUP_GROUP)CleanupGroup);
+}
+
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(IN OUT PTP_CLEANUP_GROUP CleanupGroup,
+                             IN BOOLEAN CancelPendingCallbacks,
+                             IN OUT PVOID CleanupParameter OPTIONAL)
+{
+    PRTLP_TP_CLEANUP_GROUP Group = (PRTLP_TP_CLEANUP_GROUP)CleanupGroup;
+    PRTLP_TP_OBJECT Object;
+    LIST_ENTRY Members;
+
+    /* Take all the members at once, objects created meanwhile stay in the group */
+    InitializeListHead(&Members);
+    RtlEnterCriticalSection(&Group->Lock);
+    while (!IsListEmpty(&Group->Members))
+    {
+        Object = CONTAINING_RECORD(RemoveHeadList(&Group->Members), RTLP_TP_OBJECT, GroupEntry);
+        Object->Group = NULL;
+        InsertTailList(&Members, &Object->GroupEntry);
+    }
+    RtlLeaveCriticalSection(&Group->Lock);
+
+    while (!IsListEmpty(&Members))
+    {
+        Object = CONTAINING_RECORD(RemoveHeadList(&Members), RTLP_TP_OBJECT, GroupEntry);
+        InitializeListHead(&Object->GroupEntry);
+
+        RtlpTpDisarmObject(Object);
+        RtlpTpWaitForCallbacks(Object, CancelPendingCallbacks);
+
+        if (!InterlockedExchange(&Object->Released, TRUE))
+        {
+            if (CancelPendingCallbacks && Object->GroupCancelCallback)
+                Object->GroupCancelCallback(Object->Context, CleanupParameter);
+
+            /* Simple callbacks have no reference of the caller to drop */
+            if (Object->Type != TpSimpleObject)
+                RtlpTpDereferenceObject(Object);
+        }
+
+        /* The reference of the group */
+        RtlpTpDereferenceObject(Object);
+        RtlpTpDereferenceGroup(Group);
+    }
+}
+
+NTSTATUS
+NTAPI
+TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback,
+                IN OUT PVOID Context OPTIONAL,
+                IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(&Object, TpSimpleObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    RtlpTpInsertObject(Object);
+
+    /* The reference of the caller is dropped once the callback ran */
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    RtlpTpQueueCallbackLocked(Object);
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+NTAPI
+TpAllocWork(OUT PTP_WORK *WorkReturn,
+            IN PTP_WORK_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(&Object, TpWorkObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    RtlpTpInsertObject(Object);
+    *WorkReturn = (PTP_WORK)Object;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseWork(IN OUT PTP_WORK Work)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Work);
+}
+
+VOID
+NTAPI
+TpPostWork(IN OUT PTP_WORK Work)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Work;
+
+    RtlEnterCriticalSection(&Object->Pool->Lock);
+    RtlpTpQueueCallbackLocked(Object);
+    RtlLeaveCriticalSection(&Object->Pool->Lock);
+}
+
+VOID
+NTAPI
+TpWaitForWork(IN OUT PTP_WORK Work,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Work, CancelPendingCallbacks);
+}
+
+NTSTATUS
+NTAPI
+TpAllocTimer(OUT PTP_TIMER *Timer,
+             IN PTP_TIMER_CALLBACK Callback,
+             IN OUT PVOID Context OPTIONAL,
+             IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlRunOnceExecuteOnce(&RtlpTpTimerOnce, RtlpTpInitTimers, NULL, NULL);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlpTpAllocObject(&Object, TpTimerObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    InitializeListHead(&Object->u.Timer.Entry);
+    RtlpTpInsertObject(Object);
+    *Timer = (PTP_TIMER)Object;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseTimer(IN OUT PTP_TIMER Timer)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Timer);
+}
+
+VOID
+NTAPI
+TpSetTimer(IN OUT PTP_TIMER Timer,
+           IN PLARGE_INTEGER DueTime OPTIONAL,
+           IN LONG Period,
+           IN LONG WindowLength OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Timer;
+    LARGE_INTEGER CurrentTime;
+
+    RtlEnterCriticalSection(&RtlpTpTimerLock);
+
+    if (Object->u.Timer.Queued)
+    {
+        RemoveEntryList(&Object->u.Timer.Entry);
+        Object->u.Timer.Queued = FALSE;
+    }
+
+    Object->u.Timer.Set = (DueTime != NULL);
+    if (DueTime)
+    {
+        NtQuerySystemTime(&CurrentTime);
+        Object->u.Timer.DueTime = RtlpTpGetDueTime(DueTime, CurrentTime.QuadPart);
+        Object->u.Timer.Period = Period;
+        Object->u.Timer.Window = WindowLength;
+        Object->u.Timer.Queued = TRUE;
+        InsertTailList(&RtlpTpTimerList, &Object->u.Timer.Entry);
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpTimerLock);
+
+    if (DueTime)
+        NtSetEvent(RtlpTpTimerEvent, NULL);
+}
+
+BOOLEAN
+NTAPI
+TpIsTimerSet(IN PTP_TIMER Timer)
+{
+    return ((PRTLP_TP_OBJECT)Timer)->u.Timer.Set;
+}
+
+VOID
+NTAPI
+TpWaitForTimer(IN OUT PTP_TIMER Timer,
+               IN BOOLEAN CancelPendingCallbacks)
+{
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Timer, CancelPendingCallbacks);
+}
+
+NTSTATUS
+NTAPI
+TpAllocWait(OUT PTP_WAIT *WaitReturn,
+            IN PTP_WAIT_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlRunOnceExecuteOnce(&RtlpTpWaitOnce, RtlpTpInitWaits, NULL, NULL);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlpTpAllocObject(&Object, TpWaitObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    InitializeListHead(&Object->u.Wait.Entry);
+    RtlpTpInsertObject(Object);
+    *WaitReturn = (PTP_WAIT)Object;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseWait(IN OUT PTP_WAIT Wait)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Wait);
+}
+
+VOID
+NTAPI
+TpSetWait(IN OUT PTP_WAIT Wait,
+          IN HANDLE Handle OPTIONAL,
+          IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Wait;
+    PRTLP_TP_WAIT_BUCKET Bucket;
+    LARGE_INTEGER CurrentTime;
+
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+    Bucket = Object->u.Wait.Bucket;
+    if (Bucket)
+    {
+        RtlpTpDisarmWaitLocked(Object);
+        NtSetEvent(Bucket->UpdateEvent, NULL);
+    }
+
+    if (Handle)
+    {
+        Bucket = RtlpTpGetWaitBucketLocked();
+        if (!Bucket)
+        {
+            DPRINT1("Failed to arm the thread pool wait on handle %p\n", Handle);
+            RtlLeaveCriticalSection(&RtlpTpWaitLock);
+            return;
+        }
+
+        Object->u.Wait.Handle = Handle;
+        Object->u.Wait.Timeout = MAXULONGLONG;
+        if (Timeout)
+        {
+            NtQuerySystemTime(&CurrentTime);
+            Object->u.Wait.Timeout = RtlpTpGetDueTime(Timeout, CurrentTime.QuadPart);
+        }
+
+        /* An armed wait keeps a reference, the bucket thread only sees it under the lock */
+        RtlpTpReferenceObject(Object);
+        Object->u.Wait.Bucket = Bucket;
+        InsertTailList(&Bucket->Waits, &Object->u.Wait.Entry);
+        Bucket->Count++;
+        NtSetEvent(Bucket->UpdateEvent, NULL);
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+}
+
+VOID
+NTAPI
+TpWaitForWait(IN OUT PTP_WAIT Wait,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Wait, CancelPendingCallbacks);
+}
+
+NTSTATUS
+NTAPI
+TpAllocIoCompletion(OUT PTP_IO *IoReturn,
+                    IN HANDLE File,
+                    IN PTP_IO_CALLBACK Callback,
+                    IN OUT PVOID Context OPTIONAL,
+                    IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    FILE_COMPLETION_INFORMATION CompletionInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(&Object, TpIoObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* Completions of the file go to the pool port, keyed by the object */
+    CompletionInfo.Port = Object->Pool->CompletionPort;
+    CompletionInfo.Key = Object;
+    Status = NtSetInformationFile(File,
+                                  &IoStatusBlock,
+                                  &CompletionInfo,
+                                  sizeof(CompletionInfo),
+                                  FileCompletionInformation);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlpTpDereferenceObject(Object);
+        return Status;
+    }
+
+    RtlpTpInsertObject(Object);
+    *IoReturn = (PTP_IO)Object;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseIoCompletion(IN OUT PTP_IO Io)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Io);
+}
+
+VOID
+NTAPI
+TpStartAsyncIoOperation(IN OUT PTP_IO Io)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Io;
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    /* The operation keeps the object alive until its completion is dispatched */
+    RtlpTpReferenceObject(Object);
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Object->u.Io.PendingIo++;
+    Pool->PendingIo++;
+    if (!Pool->IdleThreads && Pool->Threads < Pool->MaxThreads)
+        RtlpTpStartWorkerLocked(Pool);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+VOID
+NTAPI
+TpCancelAsyncIoOperation(IN OUT PTP_IO Io)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Io;
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    ASSERT(Object->u.Io.PendingIo);
+    Object->u.Io.PendingIo--;
+    Pool->PendingIo--;
+    if (!Object->u.Io.PendingIo && !Object->RunningCallbacks)
+        RtlWakeAllConditionVariable(&Object->Finished);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlpTpDereferenceObject(Object);
+}
+
+VOID
+NTAPI
+TpWaitForIoCompletion(IN OUT PTP_IO Io,
+                      IN BOOLEAN CancelPendingCallbacks)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Io;
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    /* Completions stay on the pool port until a worker takes them, so canceling
+       means dropping the ones that come in while we wait, without their callback */
+    if (CancelPendingCallbacks)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+        Object->u.Io.Canceling++;
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+
+    RtlpTpWaitForCallbacks(Object, FALSE);
+
+    if (CancelPendingCallbacks)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+        Object->u.Io.Canceling--;
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+}
+
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PRTLP_TP_CALLBACK_INSTANCE TpInstance = (PRTLP_TP_CALLBACK_INSTANCE)Instance;
+    PRTLP_TP_POOL Pool = TpInstance->Object->Pool;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (TpInstance->MayRunLong)
+        return STATUS_SUCCESS;
+
+    /* Make sure another worker can take the queued callbacks meanwhile */
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (!Pool->IdleThreads)
+    {
+        if (Pool->Threads < Pool->MaxThreads)
+            Status = RtlpTpStartWorkerLocked(Pool);
+        else
+            Status = STATUS_TOO_MANY_THREADS;
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    TpInstance->MayRunLong = TRUE;
+    return Status;
+}
+
+VOID
+NTAPI
+TpDisassociateCallback(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PRTLP_TP_CALLBACK_INSTANCE TpInstance = (PRTLP_TP_CALLBACK_INSTANCE)Instance;
+    PRTLP_TP_POOL Pool = TpInstance->Object->Pool;
+
+    if (!TpInstance->Associated)
+        return;
+
+    /* Let the waiters for the object go on, the callback runs by itself now */
+    RtlEnterCriticalSection(&Pool->Lock);
+    RtlpTpCallbackDoneLocked(TpInstance->Object);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    TpInstance->Associated = FALSE;
+}
+
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                           IN OUT PRTL_CRITICAL_SECTION CriticalSection)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)Instance)->CriticalSection = CriticalSection;
+}
+
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                   IN HANDLE Mutex)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)Instance)->Mutex = Mutex;
+}
+
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                       IN HANDLE Semaphore,
+                                       IN ULONG ReleaseCount)
+{
+    PRTLP_TP_CALLBACK_INSTANCE TpInstance = (PRTLP_TP_CALLBACK_INSTANCE)Instance;
+
+    TpInstance->Semaphore = Semaphore;
+    TpInstance->SemaphoreReleaseCount = ReleaseCount;
+}
+
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                               IN HANDLE Event)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)Instance)->Event = Event;
+}
+
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                IN PVOID DllHandle)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)Instance)->DllHandle = DllHandle;
+}
+
+/* EOF */
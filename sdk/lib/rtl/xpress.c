@@ -0,0 +1,972 @@
+/*
+ * PROJECT:     ReactOS Runtime Library
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Xpress and Xpress Huffman compression formats [MS-XCA]
+ */
+
+/* INCLUDES *****************************************************************/
+
+#ifdef RTL_XPRESS_HOST
+#include "xpress.h"
+#else
+#include <rtl.h>
+#include "xpress.h"
+
+#define NDEBUG
+#include <debug.h>
+#endif
+
+/* MACROS *******************************************************************/
+
+#define XPRESS_MIN_MATCH            3
+#define XPRESS_HASH_BITS            15
+#define XPRESS_HASH_SIZE            (1 << XPRESS_HASH_BITS)
+#define XPRESS_WINDOW_SIZE          0x10000
+#define XPRESS_WINDOW_MASK          (XPRESS_WINDOW_SIZE - 1)
+
+/* Match finder effort for the standard and maximum engines */
+#define XPRESS_STANDARD_CHAIN       16
+#define XPRESS_MAXIMUM_CHAIN        256
+
+/* Plain LZ77 encodes the offset in 13 bits */
+#define XPRESS_MAX_OFFSET           0x2000
+
+/* Xpress Huffman block layout */
+#define XPRESS_HUFF_MAX_OFFSET      0xFFFF
+#define XPRESS_HUFF_MAX_MATCH       (0x7FFF + XPRESS_MIN_MATCH)
+#define XPRESS_HUFF_BLOCK_SIZE      0x10000
+#define XPRESS_HUFF_SYMBOLS         512
+#define XPRESS_HUFF_END_OF_STREAM   256
+#define XPRESS_HUFF_TABLE_SIZE      (XPRESS_HUFF_SYMBOLS / 2)
+#define XPRESS_HUFF_MAX_CODE_LENGTH 15
+#define XPRESS_HUFF_PRIMARY_BITS    9
+#define XPRESS_HUFF_MATCH_TOKEN     0x80000000
+
+typedef struct _XPRESS_WORKSPACE
+{
+    /* Most recent position + 1 for each hash, 0 if none */
+    ULONG HashHead[XPRESS_HASH_SIZE];
+    /* Distance to the previous position with the same hash, 0 if none */
+    USHORT HashPrev[XPRESS_WINDOW_SIZE];
+} XPRESS_WORKSPACE, *PXPRESS_WORKSPACE;
+
+typedef struct _XPRESS_HUFF_WORKSPACE
+{
+    XPRESS_WORKSPACE Lz;
+    /* Literals and matches of the current block, see XpressHuffCompressBlock */
+    ULONG Tokens[XPRESS_HUFF_BLOCK_SIZE];
+    ULONG Frequencies[XPRESS_HUFF_SYMBOLS];
+    USHORT Codes[XPRESS_HUFF_SYMBOLS];
+    UCHAR Lengths[XPRESS_HUFF_SYMBOLS];
+    /* Scratch space for building the Huffman tree */
+    ULONG Weights[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT Parents[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT Heap[XPRESS_HUFF_SYMBOLS + 1];
+} XPRESS_HUFF_WORKSPACE, *PXPRESS_HUFF_WORKSPACE;
+
+/* FUNCTIONS ****************************************************************/
+
+static __inline ULONG
+XpressRead16(const UCHAR *Buffer)
+{
+    return Buffer[0] | ((ULONG)Buffer[1] << 8);
+}
+
+static __inline ULONG
+XpressRead32(const UCHAR *Buffer)
+{
+    return Buffer[0] | ((ULONG)Buffer[1] << 8) | ((ULONG)Buffer[2] << 16) | ((ULONG)Buffer[3] << 24);
+}
+
+static __inline VOID
+XpressWrite16(PUCHAR Buffer, ULONG Value)
+{
+    Buffer[0] = (UCHAR)Value;
+    Buffer[1] = (UCHAR)(Value >> 8);
+}
+
+static __inline VOID
+XpressWrite32(PUCHAR Buffer, ULONG Value)
+{
+    Buffer[0] = (UCHAR)Value;
+    Buffer[1] = (UCHAR)(Value >> 8);
+    Buffer[2] = (UCHAR)(Value >> 16);
+    Buffer[3] = (UCHAR)(Value >> 24);
+}
+
+/* Index of the highest set bit, Value must not be 0 */
+static __inline ULONG
+XpressHighBit(ULONG Value)
+{
+    ULONG Bit = 0;
+
+    if (Value & 0xFFFF0000) { Value >>= 16; Bit += 16; }
+    if (Value & 0xFF00) { Value >>= 8; Bit += 8; }
+    if (Value & 0xF0) { Value >>= 4; Bit += 4; }
+    if (Value & 0xC) { Value >>= 2; Bit += 2; }
+    if (Value & 0x2) Bit++;
+
+    return Bit;
+}
+
+/*
+ * Copy a match of Length bytes from Offset bytes back. The source and
+ * destination may overlap, so whole words are only moved when the offset
+ * is at least one word, which keeps every read behind the write pointer.
+ */
+static __inline VOID
+XpressCopyMatch(PUCHAR Out, ULONG Offset, ULONG Length)
+{
+    const UCHAR *Source = Out - Offset;
+
+    if (Offset >= sizeof(ULONGLONG))
+    {
+        for (; Length >= sizeof(ULONGLONG); Length -= sizeof(ULONGLONG))
+        {
+            RtlCopyMemory(Out, Source, sizeof(ULONGLONG));
+            Out += sizeof(ULONGLONG);
+            Source += sizeof(ULONGLONG);
+        }
+    }
+    else if (Offset >= sizeof(ULONG))
+    {
+        for (; Length >= sizeof(ULONG); Length -= sizeof(ULONG))
+        {
+            RtlCopyMemory(Out, Source, sizeof(ULONG));
+            Out += sizeof(ULONG);
+            Source += sizeof(ULONG);
+        }
+    }
+
+    while (Length--)
+        *Out++ = *Source++;
+}
+
+static __inline ULONG
+XpressHash(const UCHAR *Data)
+{
+    return ((((ULONG)Data[0] << 16) | ((ULONG)Data[1] << 8) | Data[2]) * 2654435761U) >> (32 - XPRESS_HASH_BITS);
+}
+
+static __inline VOID
+XpressInsertHash(PXPRESS_WORKSPACE WorkSpace, const UCHAR *Source, ULONG SourceSize, ULONG Position)
+{
+    ULONG Hash, Previous, Distance = 0;
+
+    if (Position + XPRESS_MIN_MATCH > SourceSize)
+        return;
+
+    Hash = XpressHash(Source + Position);
+    Previous = WorkSpace->HashHead[Hash];
+    if (Previous && Position - (Previous - 1) < XPRESS_WINDOW_SIZE)
+        Distance = Position - (Previous - 1);
+
+    WorkSpace->HashPrev[Position & XPRESS_WINDOW_MASK] = (USHORT)Distance;
+    WorkSpace->HashHead[Hash] = Position + 1;
+}
+
+/* Find the longest match for Position, returns its length or 0 */
+static ULONG
+XpressFindMatch(PXPRESS_WORKSPACE WorkSpace, const UCHAR *Source, ULONG SourceSize,
+                ULONG Position, ULONG MaxLength, ULONG MaxOffset, ULONG MaxChain,
+                PULONG MatchOffset)
+{
+    ULONG Candidate, Distance, Length, BestLength = 0;
+
+    MaxLength = min(MaxLength, SourceSize - Position);
+    if (MaxLength < XPRESS_MIN_MATCH)
+        return 0;
+
+    Candidate = WorkSpace->HashHead[XpressHash(Source + Position)];
+    while (Candidate && MaxChain--)
+    {
+        Candidate--;
+        if (Position - Candidate > MaxOffset)
+            break;
+
+        /* Quick reject on the byte that would extend the current best match */
+        if (Source[Candidate + BestLength] == Source[Position + BestLength] &&
+            Source[Candidate] == Source[Position])
+        {
+            for (Length = 1; Length < MaxLength; Length++)
+                if (Source[Candidate + Length] != Source[Position + Length]) break;
+
+            if (Length > BestLength)
+            {
+                BestLength = Length;
+                *MatchOffset = Position - Candidate;
+                if (Length == MaxLength) break;
+            }
+        }
+
+        Distance = WorkSpace->HashPrev[Candidate & XPRESS_WINDOW_MASK];
+        if (!Distance || Distance > Candidate)
+            break;
+        Candidate = Candidate - Distance + 1;
+    }
+
+    return (BestLength >= XPRESS_MIN_MATCH) ? BestLength : 0;
+}
+
+/* Find the match to emit at Position and add Position to the hash chains */
+static ULONG
+XpressNextMatch(PXPRESS_WORKSPACE WorkSpace, const UCHAR *Source, ULONG SourceSize,
+                ULONG Position, ULONG MaxLength, ULONG MaxOffset, USHORT Engine,
+                PULONG MatchOffset)
+{
+    ULONG MaxChain = (Engine == COMPRESSION_ENGINE_MAXIMUM) ? XPRESS_MAXIMUM_CHAIN : XPRESS_STANDARD_CHAIN;
+    ULONG Length, NextLength, NextOffset;
+
+    Length = XpressFindMatch(WorkSpace, Source, SourceSize, Position,
+                             MaxLength, MaxOffset, MaxChain, MatchOffset);
+    XpressInsertHash(WorkSpace, Source, SourceSize, Position);
+
+    /* Lazy evaluation: prefer a literal if the next position has a better match */
+    if (Engine == COMPRESSION_ENGINE_MAXIMUM && Length && MaxLength > 1)
+    {
+        NextLength = XpressFindMatch(WorkSpace, Source, SourceSize, Position + 1,
+                                     MaxLength - 1, MaxOffset, MaxChain, &NextOffset);
+        if (NextLength > Length)
+            Length = 0;
+    }
+
+    return Length;
+}
+
+NTSTATUS
+RtlpCompressBufferXpress(
+    _In_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _Out_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalCompressedSize,
+    _In_ PVOID WorkSpace,
+    _In_ USHORT Engine)
+{
+    PXPRESS_WORKSPACE Lz = WorkSpace;
+    PUCHAR Out = CompressedBuffer, OutEnd = CompressedBuffer + CompressedBufferSize;
+    PUCHAR FlagsOut, HalfByte = NULL;
+    ULONG Position = 0, Length, Offset = 0, Flags = 0, FlagCount = 0, i;
+
+    if (!WorkSpace)
+        return STATUS_INVALID_PARAMETER;
+
+    RtlZeroMemory(Lz->HashHead, sizeof(Lz->HashHead));
+
+    if (CompressedBufferSize < sizeof(ULONG))
+        return STATUS_BUFFER_TOO_SMALL;
+    FlagsOut = Out;
+    Out += sizeof(ULONG);
+
+    while (Position < UncompressedBufferSize)
+    {
+        Length = XpressNextMatch(Lz, UncompressedBuffer, UncompressedBufferSize, Position,
+                                 MAXULONG, XPRESS_MAX_OFFSET, Engine, &Offset);
+        if (Length)
+        {
+            /* A match takes at most 2 + 1 + 1 + 2 + 4 bytes */
+            if (OutEnd - Out < 10)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            for (i = Position + 1; i < Position + Length; i++)
+                XpressInsertHash(Lz, UncompressedBuffer, UncompressedBufferSize, i);
+            Position += Length;
+
+            Length -= XPRESS_MIN_MATCH;
+            if (Length < 7)
+            {
+                XpressWrite16(Out, ((Offset - 1) << 3) | Length);
+                Out += 2;
+            }
+            else
+            {
+                XpressWrite16(Out, ((Offset - 1) << 3) | 7);
+                Out += 2;
+                Length -= 7;
+
+                /* Two length nibbles share one byte */
+                if (!HalfByte)
+                {
+                    HalfByte = Out++;
+                    *HalfByte = (UCHAR)min(Length, 15);
+                }
+                else
+                {
+                    *HalfByte |= (UCHAR)(min(Length, 15) << 4);
+                    HalfByte = NULL;
+                }
+
+                if (Length >= 15)
+                {
+                    Length -= 15;
+                    if (Length < 255)
+                    {
+                        *Out++ = (UCHAR)Length;
+                    }
+                    else
+                    {
+                        *Out++ = 255;
+                        Length += 15 + 7;
+                        if (Length < 0x10000)
+                        {
+                            XpressWrite16(Out, Length);
+                            Out += 2;
+                        }
+                        else
+                        {
+                            XpressWrite16(Out, 0);
+                            XpressWrite32(Out + 2, Length);
+                            Out += 6;
+                        }
+                    }
+                }
+            }
+
+            Flags = (Flags << 1) | 1;
+        }
+        else
+        {
+            if (Out >= OutEnd)
+                return STATUS_BUFFER_TOO_SMALL;
+            *Out++ = UncompressedBuffer[Position++];
+            Flags <<= 1;
+        }
+
+        if (++FlagCount == 32)
+        {
+            XpressWrite32(FlagsOut, Flags);
+            if (OutEnd - Out < sizeof(ULONG))
+                return STATUS_BUFFER_TOO_SMALL;
+            FlagsOut = Out;
+            Out += sizeof(ULONG);
+            Flags = FlagCount = 0;
+        }
+    }
+
+    /* Pad the last flags with match bits, the decoder stops at the end of input */
+    Flags = (ULONG)(((ULONGLONG)Flags << (32 - FlagCount)) | ((1ULL << (32 - FlagCount)) - 1));
+    XpressWrite32(FlagsOut, Flags);
+
+    *FinalCompressedSize = (ULONG)(Out - CompressedBuffer);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+RtlpDecompressBufferXpress(
+    _Out_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _In_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalUncompressedSize)
+{
+    const UCHAR *In = CompressedBuffer, *InEnd = CompressedBuffer + CompressedBufferSize;
+    const UCHAR *HalfByte = NULL;
+    PUCHAR Out = UncompressedBuffer, OutEnd = UncompressedBuffer + UncompressedBufferSize;
+    ULONG Flags = 0, FlagCount = 0, Run, Length, Offset;
+
+    while (Out < OutEnd)
+    {
+        if (!FlagCount)
+        {
+            if (InEnd - In < sizeof(ULONG))
+                break;
+            Flags = XpressRead32(In);
+            In += sizeof(ULONG);
+            FlagCount = 32;
+        }
+
+        if (!(Flags & 0x80000000))
+        {
+            /* Copy a whole run of literals at once */
+            Run = Flags ? min(31 - XpressHighBit(Flags), FlagCount) : FlagCount;
+            Run = min(Run, (ULONG)(InEnd - In));
+            Run = min(Run, (ULONG)(OutEnd - Out));
+            if (!Run)
+                break;
+
+            RtlCopyMemory(Out, In, Run);
+            Out += Run;
+            In += Run;
+            Flags = (Run < 32) ? (Flags << Run) : 0;
+            FlagCount -= Run;
+            continue;
+        }
+
+        Flags <<= 1;
+        FlagCount--;
+
+        /* A match flag past the end of the input terminates the stream */
+        if (In == InEnd)
+            break;
+
+        if (InEnd - In < 2)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        Length = XpressRead16(In);
+        In += 2;
+        Offset = (Length >> 3) + 1;
+        Length &= 7;
+
+        if (Length == 7)
+        {
+            if (!HalfByte)
+            {
+                if (In >= InEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                HalfByte = In++;
+                Length = *HalfByte & 15;
+            }
+            else
+            {
+                Length = *HalfByte >> 4;
+                HalfByte = NULL;
+            }
+
+            if (Length == 15)
+            {
+                if (In >= InEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *In++;
+                if (Length == 255)
+                {
+                    if (InEnd - In < 2)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = XpressRead16(In);
+                    In += 2;
+                    if (!Length)
+                    {
+                        if (InEnd - In < 4)
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        Length = XpressRead32(In);
+                        In += 4;
+                    }
+                    if (Length < 15 + 7 || Length > MAXULONG - XPRESS_MIN_MATCH)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15 + 7;
+                }
+                Length += 15;
+            }
+            Length += 7;
+        }
+        Length += XPRESS_MIN_MATCH;
+
+        if (Offset > (ULONG)(Out - UncompressedBuffer))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        /* Partial decompression is no error, like for LZNT1 */
+        Length = min(Length, (ULONG)(OutEnd - Out));
+        XpressCopyMatch(Out, Offset, Length);
+        Out += Length;
+    }
+
+    *FinalUncompressedSize = (ULONG)(Out - UncompressedBuffer);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+RtlpWorkSpaceSizeXpress(
+    _In_ USHORT Engine,
+    _Out_ PULONG BufferAndWorkSpaceSize,
+    _Out_ PULONG FragmentWorkSpaceSize)
+{
+    if (Engine != COMPRESSION_ENGINE_STANDARD && Engine != COMPRESSION_ENGINE_MAXIMUM)
+        return STATUS_NOT_SUPPORTED;
+
+    *BufferAndWorkSpaceSize = sizeof(XPRESS_WORKSPACE);
+    *FragmentWorkSpaceSize = 0;
+    return STATUS_SUCCESS;
+}
+
+static VOID
+XpressHuffHeapDown(PXPRESS_HUFF_WORKSPACE WorkSpace, ULONG HeapSize, ULONG Index)
+{
+    USHORT *Heap = WorkSpace->Heap;
+    ULONG *Weights = WorkSpace->Weights;
+    USHORT Node = Heap[Index];
+    ULONG Child;
+
+    while ((Child = 2 * Index) <= HeapSize)
+    {
+        if (Child < HeapSize && Weights[Heap[Child + 1]] < Weights[Heap[Child]])
+            Child++;
+        if (Weights[Node] <= Weights[Heap[Child]])
+            break;
+        Heap[Index] = Heap[Child];
+        Index = Child;
+    }
+    Heap[Index] = Node;
+}
+
+/* Build code lengths limited to 15 bits, then assign canonical codes */
+static VOID
+XpressHuffBuildCodes(PXPRESS_HUFF_WORKSPACE WorkSpace)
+{
+    ULONG *Weights = WorkSpace->Weights;
+    USHORT *Parents = WorkSpace->Parents, *Heap = WorkSpace->Heap;
+    ULONG Count[XPRESS_HUFF_MAX_CODE_LENGTH + 1], NextCode[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    ULONG Symbol, HeapSize, Node, First, Second, MaxLength, Length, Code;
+    UCHAR Depth[2 * XPRESS_HUFF_SYMBOLS];
+
+    /* A single used symbol still needs a complete code */
+    for (Symbol = 0, Node = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        if (WorkSpace->Frequencies[Symbol]) Node++;
+    if (Node < 2)
+    {
+        WorkSpace->Frequencies[0] |= 1;
+        WorkSpace->Frequencies[1] |= 1;
+    }
+
+    for (;;)
+    {
+        HeapSize = 0;
+        for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        {
+            Weights[Symbol] = WorkSpace->Frequencies[Symbol];
+            if (Weights[Symbol])
+                Heap[++HeapSize] = (USHORT)Symbol;
+        }
+        for (Node = HeapSize / 2; Node > 0; Node--)
+            XpressHuffHeapDown(WorkSpace, HeapSize, Node);
+
+        /* Merge the two lightest nodes until only the root is left */
+        Node = XPRESS_HUFF_SYMBOLS;
+        while (HeapSize > 1)
+        {
+            First = Heap[1];
+            Heap[1] = Heap[HeapSize--];
+            XpressHuffHeapDown(WorkSpace, HeapSize, 1);
+            Second = Heap[1];
+
+            Weights[Node] = Weights[First] + Weights[Second];
+            Parents[First] = Parents[Second] = (USHORT)Node;
+            Heap[1] = (USHORT)Node++;
+            XpressHuffHeapDown(WorkSpace, HeapSize, 1);
+        }
+
+        /* Parents always have a higher index than their children */
+        Depth[Node - 1] = 0;
+        for (First = Node - 1; First-- > XPRESS_HUFF_SYMBOLS;)
+            Depth[First] = Depth[Parents[First]] + 1;
+
+        MaxLength = 0;
+        for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        {
+            Length = WorkSpace->Frequencies[Symbol] ? Depth[Parents[Symbol]] + 1 : 0;
+            WorkSpace->Lengths[Symbol] = (UCHAR)Length;
+            MaxLength = max(MaxLength, Length);
+        }
+
+        if (MaxLength <= XPRESS_HUFF_MAX_CODE_LENGTH)
+            break;
+
+        /* Flatten the distribution and try again */
+        for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+            if (WorkSpace->Frequencies[Symbol])
+                WorkSpace->Frequencies[Symbol] = (WorkSpace->Frequencies[Symbol] >> 1) | 1;
+    }
+
+    /* Canonical codes, ordered by length and then by symbol value */
+    RtlZeroMemory(Count, sizeof(Count));
+    for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        Count[WorkSpace->Lengths[Symbol]]++;
+    Count[0] = 0;
+    for (Code = 0, Length = 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        Code = (Code + Count[Length - 1]) << 1;
+        NextCode[Length] = Code;
+    }
+    for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+    {
+        if (WorkSpace->Lengths[Symbol])
+            WorkSpace->Codes[Symbol] = (USHORT)NextCode[WorkSpace->Lengths[Symbol]]++;
+    }
+}
+
+typedef struct _XPRESS_BIT_WRITER
+{
+    PUCHAR Slot1;
+    PUCHAR Slot2;
+    PUCHAR Out;
+    PUCHAR OutEnd;
+    ULONG Bits;
+    ULONG FreeBits;
+} XPRESS_BIT_WRITER, *PXPRESS_BIT_WRITER;
+
+/*
+ * The decoder always holds 32 bits of look-ahead, so the bit stream is
+ * written in 16-bit words that are reserved two ahead of the raw bytes
+ * used for long match lengths.
+ */
+static __inline BOOLEAN
+XpressWriteBits(PXPRESS_BIT_WRITER Writer, ULONG Count, ULONG Bits)
+{
+    if (Count <= Writer->FreeBits)
+    {
+        Writer->FreeBits -= Count;
+        Writer->Bits = (Writer->Bits << Count) | Bits;
+        return TRUE;
+    }
+
+    if (Writer->OutEnd - Writer->Out < 2)
+        return FALSE;
+
+    Count -= Writer->FreeBits;
+    XpressWrite16(Writer->Slot1, (Writer->Bits << Writer->FreeBits) | (Bits >> Count));
+    Writer->Slot1 = Writer->Slot2;
+    Writer->Slot2 = Writer->Out;
+    Writer->Out += 2;
+    Writer->FreeBits = 16 - Count;
+    Writer->Bits = Bits & ((1 << Count) - 1);
+    return TRUE;
+}
+
+static NTSTATUS
+XpressHuffCompressBlock(PXPRESS_HUFF_WORKSPACE WorkSpace, ULONG TokenCount, BOOLEAN LastBlock, PUCHAR *Out, PUCHAR OutEnd)
+{
+    XPRESS_BIT_WRITER Writer;
+    ULONG i, Token, Symbol, Length, Offset, OffsetBits;
+
+    if (LastBlock)
+        WorkSpace->Frequencies[XPRESS_HUFF_END_OF_STREAM]++;
+    XpressHuffBuildCodes(WorkSpace);
+
+    if (OutEnd - *Out < XPRESS_HUFF_TABLE_SIZE + 4)
+        return STATUS_BUFFER_TOO_SMALL;
+    for (i = 0; i < XPRESS_HUFF_TABLE_SIZE; i++)
+        (*Out)[i] = WorkSpace->Lengths[2 * i] | (WorkSpace->Lengths[2 * i + 1] << 4);
+
+    Writer.Slot1 = *Out + XPRESS_HUFF_TABLE_SIZE;
+    Writer.Slot2 = Writer.Slot1 + 2;
+    Writer.Out = Writer.Slot2 + 2;
+    Writer.OutEnd = OutEnd;
+    Writer.Bits = 0;
+    Writer.FreeBits = 16;
+
+    for (i = 0; i < TokenCount; i++)
+    {
+        Token = WorkSpace->Tokens[i];
+        if (!(Token & XPRESS_HUFF_MATCH_TOKEN))
+        {
+            if (!XpressWriteBits(&Writer, WorkSpace->Lengths[Token], WorkSpace->Codes[Token]))
+                return STATUS_BUFFER_TOO_SMALL;
+            continue;
+        }
+
+        Length = (Token >> 16) & 0x7FFF;
+        Offset = Token & 0xFFFF;
+        OffsetBits = XpressHighBit(Offset);
+        Symbol = XPRESS_HUFF_END_OF_STREAM + (OffsetBits << 4) + min(Length, 15);
+
+        if (!XpressWriteBits(&Writer, WorkSpace->Lengths[Symbol], WorkSpace->Codes[Symbol]))
+            return STATUS_BUFFER_TOO_SMALL;
+
+        if (Length >= 15)
+        {
+            if (Writer.OutEnd - Writer.Out < 3)
+                return STATUS_BUFFER_TOO_SMALL;
+            if (Length - 15 < 255)
+            {
+                *Writer.Out++ = (UCHAR)(Length - 15);
+            }
+            else
+            {
+                *Writer.Out++ = 255;
+                XpressWrite16(Writer.Out, Length);
+                Writer.Out += 2;
+            }
+        }
+
+        if (!XpressWriteBits(&Writer, OffsetBits, Offset - (1 << OffsetBits)))
+            return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    if (LastBlock &&
+        !XpressWriteBits(&Writer,
+                         WorkSpace->Lengths[XPRESS_HUFF_END_OF_STREAM],
+                         WorkSpace->Codes[XPRESS_HUFF_END_OF_STREAM]))
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    XpressWrite16(Writer.Slot1, Writer.Bits << Writer.FreeBits);
+    XpressWrite16(Writer.Slot2, 0);
+    *Out = Writer.Out;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+RtlpCompressBufferXpressHuff(
+    _In_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _Out_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalCompressedSize,
+    _In_ PVOID WorkSpace,
+    _In_ USHORT Engine)
+{
+    PXPRESS_HUFF_WORKSPACE Huff = WorkSpace;
+    PUCHAR Out = CompressedBuffer, OutEnd = CompressedBuffer + CompressedBufferSize;
+    ULONG Position = 0, BlockStart, BlockEnd, TokenCount, Length, Offset = 0, i;
+    NTSTATUS Status;
+
+    if (!WorkSpace)
+        return STATUS_INVALID_PARAMETER;
+
+    RtlZeroMemory(Huff->Lz.HashHead, sizeof(Huff->Lz.HashHead));
+
+    do
+    {
+        BlockStart = Position;
+        BlockEnd = BlockStart + min(UncompressedBufferSize - BlockStart, XPRESS_HUFF_BLOCK_SIZE);
+        RtlZeroMemory(Huff->Frequencies, sizeof(Huff->Frequencies));
+        TokenCount = 0;
+
+        /* Matches never cross a block, the decoder switches tables at block ends */
+        while (Position < BlockEnd)
+        {
+            Length = XpressNextMatch(&Huff->Lz, UncompressedBuffer, BlockEnd, Position,
+                                     XPRESS_HUFF_MAX_MATCH, XPRESS_HUFF_MAX_OFFSET, Engine, &Offset);
+
+            /* Offset 1 with length 3 is the end of stream symbol, spell it out */
+            if (Length == XPRESS_MIN_MATCH && Offset == 1)
+                Length = 0;
+
+            if (Length)
+            {
+                for (i = Position + 1; i < Position + Length; i++)
+                    XpressInsertHash(&Huff->Lz, UncompressedBuffer, BlockEnd, i);
+                Position += Length;
+
+                Length -= XPRESS_MIN_MATCH;
+                Huff->Frequencies[XPRESS_HUFF_END_OF_STREAM + (XpressHighBit(Offset) << 4) + min(Length, 15)]++;
+                Huff->Tokens[TokenCount++] = XPRESS_HUFF_MATCH_TOKEN | (Length << 16) | Offset;
+            }
+            else
+            {
+                Huff->Frequencies[UncompressedBuffer[Position]]++;
+                Huff->Tokens[TokenCount++] = UncompressedBuffer[Position++];
+            }
+        }
+
+        Status = XpressHuffCompressBlock(Huff, TokenCount, BlockEnd == UncompressedBufferSize,
+                                         &Out, OutEnd);
+        if (!NT_SUCCESS(Status))
+            return Status;
+    } while (Position < UncompressedBufferSize);
+
+    *FinalCompressedSize = (ULONG)(Out - CompressedBuffer);
+    return STATUS_SUCCESS;
+}
+
+typedef struct _XPRESS_HUFF_DECODER
+{
+    /* Codes up to XPRESS_HUFF_PRIMARY_BITS long: (Length << 9) | Symbol, 0 for longer codes */
+    USHORT Primary[1 << XPRESS_HUFF_PRIMARY_BITS];
+    /* Longer codes are resolved canonically from the 15-bit left-aligned code space */
+    ULONG First[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    ULONG Limit[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    USHORT Base[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    USHORT Sorted[XPRESS_HUFF_SYMBOLS];
+    UCHAR Lengths[XPRESS_HUFF_SYMBOLS];
+} XPRESS_HUFF_DECODER, *PXPRESS_HUFF_DECODER;
+
+static BOOLEAN
+XpressHuffBuildDecoder(PXPRESS_HUFF_DECODER Decoder, const UCHAR *Table)
+{
+    ULONG Symbol, Length, Cursor = 0, Span, Count = 0, i;
+
+    for (i = 0; i < XPRESS_HUFF_TABLE_SIZE; i++)
+    {
+        Decoder->Lengths[2 * i] = Table[i] & 15;
+        Decoder->Lengths[2 * i + 1] = Table[i] >> 4;
+    }
+
+    RtlZeroMemory(Decoder->Primary, sizeof(Decoder->Primary));
+    for (Length = 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        Decoder->First[Length] = Cursor;
+        Decoder->Base[Length] = (USHORT)Count;
+        Span = 1 << (XPRESS_HUFF_MAX_CODE_LENGTH - Length);
+
+        for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        {
+            if (Decoder->Lengths[Symbol] != Length)
+                continue;
+            if (Cursor + Span > (1 << XPRESS_HUFF_MAX_CODE_LENGTH))
+                return FALSE;
+
+            if (Length <= XPRESS_HUFF_PRIMARY_BITS)
+            {
+                for (i = Cursor >> (XPRESS_HUFF_MAX_CODE_LENGTH - XPRESS_HUFF_PRIMARY_BITS);
+                     i < (Cursor + Span) >> (XPRESS_HUFF_MAX_CODE_LENGTH - XPRESS_HUFF_PRIMARY_BITS);
+                     i++)
+                {
+                    Decoder->Primary[i] = (USHORT)((Length << 9) | Symbol);
+                }
+            }
+
+            Decoder->Sorted[Count++] = (USHORT)Symbol;
+            Cursor += Span;
+        }
+
+        Decoder->Limit[Length] = Cursor;
+    }
+
+    return TRUE;
+}
+
+static __inline ULONG
+XpressHuffDecodeSymbol(PXPRESS_HUFF_DECODER Decoder, ULONG Next15Bits, PULONG SymbolLength)
+{
+    ULONG Entry, Length;
+
+    Entry = Decoder->Primary[Next15Bits >> (XPRESS_HUFF_MAX_CODE_LENGTH - XPRESS_HUFF_PRIMARY_BITS)];
+    if (Entry)
+    {
+        *SymbolLength = Entry >> 9;
+        return Entry & 0x1FF;
+    }
+
+    for (Length = XPRESS_HUFF_PRIMARY_BITS + 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        if (Next15Bits < Decoder->Limit[Length])
+        {
+            if (Next15Bits < Decoder->First[Length])
+                break;
+            *SymbolLength = Length;
+            return Decoder->Sorted[Decoder->Base[Length] +
+                                   ((Next15Bits - Decoder->First[Length]) >> (XPRESS_HUFF_MAX_CODE_LENGTH - Length))];
+        }
+    }
+
+    /* Not a valid code */
+    *SymbolLength = 0;
+    return 0;
+}
+
+NTSTATUS
+RtlpDecompressBufferXpressHuff(
+    _Out_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _In_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalUncompressedSize)
+{
+    const UCHAR *In = CompressedBuffer, *InEnd = CompressedBuffer + CompressedBufferSize;
+    PUCHAR Out = UncompressedBuffer, OutEnd = UncompressedBuffer + UncompressedBufferSize;
+    PUCHAR BlockEnd;
+    XPRESS_HUFF_DECODER Decoder;
+    ULONG NextBits, Symbol, SymbolLength, Length, Offset, OffsetBits;
+    ULONG Padding = 0;
+    LONG ExtraBitCount;
+
+/* Refill the bit buffer, reading zeroes past the end of input. The look-ahead
+   may run over the last 32 bits of the stream, but not further. */
+#define XPRESS_HUFF_REFILL()                                                \
+    if (ExtraBitCount < 0)                                                  \
+    {                                                                       \
+        if (InEnd - In >= 2)                                                \
+        {                                                                   \
+            NextBits |= XpressRead16(In) << (-ExtraBitCount);               \
+            In += 2;                                                        \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            Padding += 2;                                                   \
+            if (Padding > 4)                                                \
+                return STATUS_BAD_COMPRESSION_BUFFER;                       \
+            In = InEnd;                                                     \
+        }                                                                   \
+        ExtraBitCount += 16;                                                \
+    }
+
+    /* A new block needs at least its table and the initial 32 bits */
+    while (Out < OutEnd && InEnd - In >= XPRESS_HUFF_TABLE_SIZE + 4)
+    {
+        if (!XpressHuffBuildDecoder(&Decoder, In))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        In += XPRESS_HUFF_TABLE_SIZE;
+
+        NextBits = (XpressRead16(In) << 16) | XpressRead16(In + 2);
+        In += 4;
+        ExtraBitCount = 16;
+
+        BlockEnd = Out + min(XPRESS_HUFF_BLOCK_SIZE, (ULONG)(OutEnd - Out));
+        while (Out < BlockEnd)
+        {
+            Symbol = XpressHuffDecodeSymbol(&Decoder, NextBits >> (32 - XPRESS_HUFF_MAX_CODE_LENGTH), &SymbolLength);
+            if (!SymbolLength)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            NextBits <<= SymbolLength;
+            ExtraBitCount -= SymbolLength;
+            XPRESS_HUFF_REFILL();
+
+            if (Symbol < 256)
+            {
+                *Out++ = (UCHAR)Symbol;
+                continue;
+            }
+
+            if (Symbol == XPRESS_HUFF_END_OF_STREAM && In >= InEnd)
+                goto Done;
+
+            Symbol -= 256;
+            Length = Symbol & 15;
+            OffsetBits = Symbol >> 4;
+
+            if (Length == 15)
+            {
+                if (In >= InEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *In++;
+                if (Length == 255)
+                {
+                    if (InEnd - In < 2)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = XpressRead16(In);
+                    In += 2;
+                    if (Length < 15)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15;
+                }
+                Length += 15;
+            }
+            Length += XPRESS_MIN_MATCH;
+
+            Offset = OffsetBits ? (NextBits >> (32 - OffsetBits)) : 0;
+            Offset += 1 << OffsetBits;
+            NextBits <<= OffsetBits;
+            ExtraBitCount -= OffsetBits;
+            XPRESS_HUFF_REFILL();
+
+            if (Offset > (ULONG)(Out - UncompressedBuffer))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            /* Partial decompression is no error, like for LZNT1 */
+            Length = min(Length, (ULONG)(OutEnd - Out));
+            XpressCopyMatch(Out, Offset, Length);
+            Out += Length;
+        }
+    }
+
+#undef XPRESS_HUFF_REFILL
+
+Done:
+    *FinalUncompressedSize = (ULONG)(Out - UncompressedBuffer);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+RtlpWorkSpaceSizeXpressHuff(
+    _In_ USHORT Engine,
+    _Out_ PULONG BufferAndWorkSpaceSize,
+    _Out_ PULONG FragmentWorkSpaceSize)
+{
+    if (Engine != COMPRESSION_ENGINE_STANDARD && Engine != COMPRESSION_ENGINE_MAXIMUM)
+        return STATUS_NOT_SUPPORTED;
+
+    *BufferAndWorkSpaceSize = sizeof(XPRESS_HUFF_WORKSPACE);
+    *FragmentWorkSpaceSize = 0;
+    return STATUS_SUCCESS;
+}
+
+/* EOF */
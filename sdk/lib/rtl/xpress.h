@@ -0,0 +1,95 @@
+/*
+ * PROJECT:     ReactOS Runtime Library
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Xpress and Xpress Huffman compression formats [MS-XCA]
+ */
+
+#pragma once
+
+#ifdef RTL_XPRESS_HOST
+    #include <typedefs.h>
+    #include <string.h>
+
+    #if (!defined(_MSC_VER) || (_MSC_VER < 1500))
+    #define _In_
+    #define _Out_
+    #endif
+
+    #ifndef min
+    #define min(a, b)  (((a) < (b)) ? (a) : (b))
+    #endif
+    #ifndef max
+    #define max(a, b)  (((a) > (b)) ? (a) : (b))
+    #endif
+
+    #ifndef STATUS_SUCCESS
+    #define STATUS_SUCCESS                  ((NTSTATUS)0x00000000)
+    #endif
+    #ifndef STATUS_BUFFER_TOO_SMALL
+    #define STATUS_BUFFER_TOO_SMALL         ((NTSTATUS)0xC0000023)
+    #endif
+    #ifndef STATUS_INVALID_PARAMETER
+    #define STATUS_INVALID_PARAMETER        ((NTSTATUS)0xC000000D)
+    #endif
+    #ifndef STATUS_NOT_SUPPORTED
+    #define STATUS_NOT_SUPPORTED            ((NTSTATUS)0xC00000BB)
+    #endif
+    #ifndef STATUS_BAD_COMPRESSION_BUFFER
+    #define STATUS_BAD_COMPRESSION_BUFFER   ((NTSTATUS)0xC0000242)
+    #endif
+
+    #define COMPRESSION_FORMAT_XPRESS       (0x0003)
+    #define COMPRESSION_FORMAT_XPRESS_HUFF  (0x0004)
+    #define COMPRESSION_ENGINE_STANDARD     (0x0000)
+    #define COMPRESSION_ENGINE_MAXIMUM      (0x0100)
+#endif
+
+/* Plain LZ77 (Xpress) compression, [MS-XCA] 2.3 / 2.4 */
+NTSTATUS
+RtlpCompressBufferXpress(
+    _In_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _Out_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalCompressedSize,
+    _In_ PVOID WorkSpace,
+    _In_ USHORT Engine);
+
+NTSTATUS
+RtlpDecompressBufferXpress(
+    _Out_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _In_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalUncompressedSize);
+
+NTSTATUS
+RtlpWorkSpaceSizeXpress(
+    _In_ USHORT Engine,
+    _Out_ PULONG BufferAndWorkSpaceSize,
+    _Out_ PULONG FragmentWorkSpaceSize);
+
+/* LZ77 + Huffman (Xpress Huffman) compression, [MS-XCA] 2.1 / 2.2 */
+NTSTATUS
+RtlpCompressBufferXpressHuff(
+    _In_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _Out_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalCompressedSize,
+    _In_ PVOID WorkSpace,
+    _In_ USHORT Engine);
+
+NTSTATUS
+RtlpDecompressBufferXpressHuff(
+    _Out_ PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _In_ PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalUncompressedSize);
+
+NTSTATUS
+RtlpWorkSpaceSizeXpressHuff(
+    _In_ USHORT Engine,
+    _Out_ PULONG BufferAndWorkSpaceSize,
+    _Out_ PULONG FragmentWorkSpaceSize);
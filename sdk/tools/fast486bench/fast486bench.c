@@ -0,0 +1,208 @@
+/*
+ * PROJECT:     ReactOS Fast486 CPU Emulator
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Host benchmark running a fixed 16-bit and 32-bit instruction mix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fast486.h>
+
+#define MEMORY_SIZE     (4 * 1024 * 1024)
+#define DEFAULT_COUNT   20000000
+
+#define CODE16_SEGMENT  0x0000
+#define CODE16_OFFSET   0x1000
+#define DATA16_SEGMENT  0x2000
+#define STACK16_SEGMENT 0x3000
+
+#define GDT_ADDRESS     0x0800
+#define CODE32_ADDRESS  0x100000
+#define STACK32_ADDRESS 0x200000
+
+static UCHAR Memory[MEMORY_SIZE];
+
+/*
+ * Real mode loop, 11 instructions per iteration:
+ *
+ * start:   mov cx, 1000
+ * top:     add ax, bx
+ *          xor dx, ax
+ *          mov [si], ax
+ *          mov bx, [si+2]
+ *          inc si
+ *          and si, 0FEh
+ *          push ax
+ *          pop bx
+ *          shl ax, 1
+ *          add eax, ebx        (operand size prefix)
+ *          mov di, cs:[1000h]  (segment override prefix)
+ *          loop top
+ *          jmp start
+ */
+static const UCHAR Code16[] =
+{
+    0xB9, 0xE8, 0x03,
+    0x01, 0xD8,
+    0x31, 0xC2,
+    0x89, 0x04,
+    0x8B, 0x5C, 0x02,
+    0x46,
+    0x81, 0xE6, 0xFE, 0x00,
+    0x50,
+    0x5B,
+    0xD1, 0xE0,
+    0x66, 0x01, 0xD8,
+    0x2E, 0x8B, 0x3E, 0x00, 0x10,
+    0xE2, 0xE4,
+    0xEB, 0xDF
+};
+
+/*
+ * Flat 32-bit protected mode loop, 12 instructions per iteration:
+ *
+ * start:   mov ecx, 1000
+ * top:     add eax, ebx
+ *          xor edx, eax
+ *          mov [esi+180000h], eax
+ *          mov ebx, [esi+180004h]
+ *          inc esi
+ *          and esi, 0FCh
+ *          push eax
+ *          pop ebx
+ *          shl eax, 1
+ *          add ax, bx          (operand size prefix)
+ *          lea edi, [esi+esi*2]
+ *          imul eax, ebx
+ *          loop top
+ *          jmp start
+ */
+static const UCHAR Code32[] =
+{
+    0xB9, 0xE8, 0x03, 0x00, 0x00,
+    0x01, 0xD8,
+    0x31, 0xC2,
+    0x89, 0x86, 0x00, 0x00, 0x18, 0x00,
+    0x8B, 0x9E, 0x04, 0x00, 0x18, 0x00,
+    0x46,
+    0x81, 0xE6, 0xFC, 0x00, 0x00, 0x00,
+    0x50,
+    0x5B,
+    0xD1, 0xE0,
+    0x66, 0x01, 0xD8,
+    0x8D, 0x3C, 0x76,
+    0x0F, 0xAF, 0xC3,
+    0xE2, 0xDA,
+    0xEB, 0xD3
+};
+
+/* Null, flat 32-bit code and flat 32-bit data descriptors */
+static const UCHAR Gdt[] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xFF, 0xFF, 0x00, 0x00, 0x00, 0x9A, 0xCF, 0x00,
+    0xFF, 0xFF, 0x00, 0x00, 0x00, 0x92, 0xCF, 0x00
+};
+
+static VOID FASTCALL
+BenchMemRead(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address)
+    {
+        /* Open bus */
+        RtlFillMemory(Buffer, Size, 0xFF);
+        return;
+    }
+
+    RtlCopyMemory(Buffer, &Memory[Address], Size);
+}
+
+static VOID FASTCALL
+BenchMemWrite(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address) return;
+    RtlCopyMemory(&Memory[Address], Buffer, Size);
+}
+
+static VOID
+SetupReal(PFAST486_STATE State)
+{
+    Fast486Reset(State);
+    RtlCopyMemory(&Memory[CODE16_SEGMENT * 16 + CODE16_OFFSET], Code16, sizeof(Code16));
+
+    Fast486SetSegment(State, FAST486_REG_DS, DATA16_SEGMENT);
+    Fast486SetStack(State, STACK16_SEGMENT, 0xFFFE);
+    Fast486ExecuteAt(State, CODE16_SEGMENT, CODE16_OFFSET);
+}
+
+static VOID
+SetupProtected(PFAST486_STATE State)
+{
+    Fast486Reset(State);
+    RtlCopyMemory(&Memory[GDT_ADDRESS], Gdt, sizeof(Gdt));
+    RtlCopyMemory(&Memory[CODE32_ADDRESS], Code32, sizeof(Code32));
+
+    State->Gdtr.Address = GDT_ADDRESS;
+    State->Gdtr.Size = sizeof(Gdt) - 1;
+    State->ControlRegisters[FAST486_REG_CR0] |= FAST486_CR0_PE;
+
+    Fast486SetSegment(State, FAST486_REG_DS, 0x10);
+    Fast486SetSegment(State, FAST486_REG_ES, 0x10);
+    Fast486SetStack(State, 0x10, STACK32_ADDRESS);
+    Fast486ExecuteAt(State, 0x08, CODE32_ADDRESS);
+}
+
+static VOID
+Run(PFAST486_STATE State, const char *Name, ULONG Count)
+{
+    ULONG i;
+    clock_t Start, End;
+    double Seconds;
+
+    /* Give the loop something to chew on */
+    State->GeneralRegs[FAST486_REG_EAX].Long = 0x12345678;
+    State->GeneralRegs[FAST486_REG_EBX].Long = 0x9ABCDEF1;
+
+    Start = clock();
+    for (i = 0; i < Count; i++) Fast486StepInto(State);
+    End = clock();
+
+    Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+    printf("%-9s %lu instructions in %.3f s, %.2f MIPS (EAX=%08lX EBX=%08lX EDX=%08lX EIP=%08lX)\n",
+           Name,
+           (unsigned long)Count,
+           Seconds,
+           Seconds > 0 ? (double)Count / Seconds / 1000000.0 : 0.0,
+           (unsigned long)State->GeneralRegs[FAST486_REG_EAX].Long,
+           (unsigned long)State->GeneralRegs[FAST486_REG_EBX].Long,
+           (unsigned long)State->GeneralRegs[FAST486_REG_EDX].Long,
+           (unsigned long)State->InstPtr.Long);
+}
+
+int main(int argc, char **argv)
+{
+    static FAST486_STATE State;
+    ULONG Count = DEFAULT_COUNT;
+
+    if (argc > 1) Count = strtoul(argv[1], NULL, 0);
+    if (Count == 0)
+    {
+        printf("Usage: %s [instruction count]\n", argv[0]);
+        return 1;
+    }
+
+    Fast486Initialize(&State, BenchMemRead, BenchMemWrite, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    SetupReal(&State);
+    Run(&State, "16-bit:", Count);
+
+    SetupProtected(&State);
+    Run(&State, "32-bit:", Count);
+
+    return 0;
+}
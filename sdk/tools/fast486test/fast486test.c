@@ -0,0 +1,704 @@
+/*
+ * PROJECT:     ReactOS Fast486 CPU Emulator
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Host conformance and speed tests
+ */
+
+/*
+ * Each vector is a short piece of code run from a known state, until the
+ * instruction pointer reaches its end. The resulting registers, flags and
+ * (optionally) one memory dword are compared with what a real 486 gives.
+ * Every vector is then run again a number of times to get the speed of the
+ * emulator for each group of instructions.
+ *
+ * Usage: fast486test [repeat count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fast486.h>
+
+#define MEMORY_SIZE     (4 * 1024 * 1024)
+#define DEFAULT_REPEAT  20000
+#define MAX_STEPS       10000
+
+#define CODE16_SEGMENT  0x0000
+#define CODE16_OFFSET   0x1000
+#define DATA16_SEGMENT  0x2000
+#define STACK16_SEGMENT 0x3000
+#define STACK16_OFFSET  0xFFFE
+
+#define GDT_ADDRESS     0x0800
+#define CODE32_ADDRESS  0x100000
+#define STACK32_ADDRESS 0x200000
+#define PAGE_DIR        0x300000
+#define PAGE_TABLE      0x301000
+
+#define FLAG_CF 0x0001
+#define FLAG_PF 0x0004
+#define FLAG_AF 0x0010
+#define FLAG_ZF 0x0040
+#define FLAG_SF 0x0080
+#define FLAG_DF 0x0400
+#define FLAG_OF 0x0800
+
+#define FLAGS_ARITH (FLAG_CF | FLAG_PF | FLAG_AF | FLAG_ZF | FLAG_SF | FLAG_OF)
+
+/* Vector options */
+#define TEST_REAL_MODE  0x01
+#define TEST_PAGING     0x02
+#define TEST_CHECK_MEM  0x04
+
+typedef struct _TEST_VECTOR
+{
+    const char *Group;
+    const char *Name;
+    ULONG Options;
+    const UCHAR *Code;
+    ULONG CodeSize;
+
+    /* EAX, ECX, EDX, EBX, ESP (0 means the default stack), EBP, ESI, EDI */
+    ULONG Input[FAST486_NUM_GEN_REGS];
+    ULONG Output[FAST486_NUM_GEN_REGS];
+    ULONG Flags;
+    ULONG FlagsMask;
+    ULONG MemAddress;
+    ULONG MemValue;
+} TEST_VECTOR, *PTEST_VECTOR;
+
+typedef struct _TEST_GROUP
+{
+    const char *Name;
+    ULONGLONG Instructions;
+    double Seconds;
+} TEST_GROUP, *PTEST_GROUP;
+
+static UCHAR Memory[MEMORY_SIZE];
+static ULONG Tlb[0x100000]; /* One entry per page, as NUM_TLB_ENTRIES in common.h */
+static FAST486_STATE State;
+
+/* Null, flat 32-bit code and flat 32-bit data descriptors */
+static const UCHAR Gdt[] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xFF, 0xFF, 0x00, 0x00, 0x00, 0x9A, 0xCF, 0x00,
+    0xFF, 0xFF, 0x00, 0x00, 0x00, 0x92, 0xCF, 0x00
+};
+
+/* INTEGER ********************************************************************/
+
+/* add eax, ebx */
+static const UCHAR CodeAdd[] = { 0x01, 0xD8 };
+
+/* sub eax, ebx */
+static const UCHAR CodeSub[] = { 0x29, 0xD8 };
+
+/* add eax, ebx / adc edx, ecx */
+static const UCHAR CodeAdc[] = { 0x01, 0xD8, 0x11, 0xCA };
+
+/* mul ecx */
+static const UCHAR CodeMul[] = { 0xF7, 0xE1 };
+
+/* div ecx */
+static const UCHAR CodeDiv[] = { 0xF7, 0xF1 };
+
+/* rol eax, 1 */
+static const UCHAR CodeRol[] = { 0xD1, 0xC0 };
+
+/* shr eax, 4 */
+static const UCHAR CodeShr[] = { 0xC1, 0xE8, 0x04 };
+
+/* bsf eax, ecx / bswap ecx */
+static const UCHAR CodeBsf[] = { 0x0F, 0xBC, 0xC1, 0x0F, 0xC9 };
+
+/* mov ax, 1234h / xchg al, ah / neg ax (real mode) */
+static const UCHAR CodeNeg16[] = { 0xB8, 0x34, 0x12, 0x86, 0xC4, 0xF7, 0xD8 };
+
+/*
+ *          mov cx, 5       (real mode)
+ *          xor ax, ax
+ * again:   call sum
+ *          loop again
+ *          jmp done
+ * sum:     add ax, cx
+ *          ret
+ * done:
+ */
+static const UCHAR CodeCall16[] =
+{
+    0xB9, 0x05, 0x00,
+    0x31, 0xC0,
+    0xE8, 0x04, 0x00,
+    0xE2, 0xFB,
+    0xEB, 0x03,
+    0x01, 0xC8,
+    0xC3
+};
+
+/*
+ *          mov ecx, 2
+ * again:   inc eax                 (becomes inc ebx)
+ *          mov byte [again], 43h
+ *          loop again
+ */
+static const UCHAR CodeSelfModify[] =
+{
+    0xB9, 0x02, 0x00, 0x00, 0x00,
+    0x40,
+    0xC6, 0x05, 0x05, 0x00, 0x10, 0x00, 0x43,
+    0xE2, 0xF6
+};
+
+/* FLAGS **********************************************************************/
+
+/* cmp eax, ebx / setl cl / setb dl / seta bl */
+static const UCHAR CodeSetcc[] = { 0x39, 0xD8, 0x0F, 0x9C, 0xC1, 0x0F, 0x92, 0xC2, 0x0F, 0x97, 0xC3 };
+
+/* stc / cmc / stc / pushfd / pop eax / and eax, 1 */
+static const UCHAR CodePushf[] = { 0xF9, 0xF5, 0xF9, 0x9C, 0x58, 0x83, 0xE0, 0x01 };
+
+/* stc / inc eax */
+static const UCHAR CodeInc[] = { 0xF9, 0x40 };
+
+/* add al, bl / daa */
+static const UCHAR CodeDaa[] = { 0x00, 0xD8, 0x27 };
+
+/* STRING *********************************************************************/
+
+/*
+ * cld
+ * mov edi, 180000h / mov ecx, 16 / mov eax, 0A5A5A5A5h / rep stosd
+ * mov esi, 180000h / mov edi, 181000h / mov ecx, 64 / rep movsb
+ * mov esi, 180000h / mov edi, 181000h / mov ecx, 64 / repe cmpsb
+ */
+static const UCHAR CodeRepMovs[] =
+{
+    0xFC,
+    0xBF, 0x00, 0x00, 0x18, 0x00,
+    0xB9, 0x10, 0x00, 0x00, 0x00,
+    0xB8, 0xA5, 0xA5, 0xA5, 0xA5,
+    0xF3, 0xAB,
+    0xBE, 0x00, 0x00, 0x18, 0x00,
+    0xBF, 0x00, 0x10, 0x18, 0x00,
+    0xB9, 0x40, 0x00, 0x00, 0x00,
+    0xF3, 0xA4,
+    0xBE, 0x00, 0x00, 0x18, 0x00,
+    0xBF, 0x00, 0x10, 0x18, 0x00,
+    0xB9, 0x40, 0x00, 0x00, 0x00,
+    0xF3, 0xA6
+};
+
+/*
+ * cld
+ * mov edi, 182000h / mov ecx, 32 / mov al, 0 / rep stosb
+ * mov byte [182010h], 42h
+ * mov edi, 182000h / mov ecx, 32 / mov al, 42h / repne scasb
+ */
+static const UCHAR CodeRepScas[] =
+{
+    0xFC,
+    0xBF, 0x00, 0x20, 0x18, 0x00,
+    0xB9, 0x20, 0x00, 0x00, 0x00,
+    0xB0, 0x00,
+    0xF3, 0xAA,
+    0xC6, 0x05, 0x10, 0x20, 0x18, 0x00, 0x42,
+    0xBF, 0x00, 0x20, 0x18, 0x00,
+    0xB9, 0x20, 0x00, 0x00, 0x00,
+    0xB0, 0x42,
+    0xF2, 0xAE
+};
+
+/*
+ * Real mode:
+ * cld / mov di, 100h / mov ax, 1111h / mov cx, 4 / rep stosw
+ * std / mov si, 106h / mov di, 206h / mov cx, 4 / rep movsw
+ * cld
+ */
+static const UCHAR CodeRepMovsBack16[] =
+{
+    0xFC,
+    0xBF, 0x00, 0x01,
+    0xB8, 0x11, 0x11,
+    0xB9, 0x04, 0x00,
+    0xF3, 0xAB,
+    0xFD,
+    0xBE, 0x06, 0x01,
+    0xBF, 0x06, 0x02,
+    0xB9, 0x04, 0x00,
+    0xF3, 0xA5,
+    0xFC
+};
+
+/* PAGING *********************************************************************/
+
+/*
+ * mov eax, PAGE_DIR / mov cr3, eax
+ * mov eax, cr0 / or eax, 80000000h / mov cr0, eax
+ * mov dword [3FF000h], 0CAFEBABEh      (mapped to 180000h)
+ * mov ebx, [180000h]
+ * mov dword [PAGE_TABLE + 3FFh * 4], 181007h
+ * invlpg [3FF000h]
+ * mov dword [3FF000h], 12345678h       (now mapped to 181000h)
+ * mov ecx, [181000h]
+ * mov eax, cr0 / and eax, 7FFFFFFFh / mov cr0, eax
+ */
+static const UCHAR CodePaging[] =
+{
+    0xB8, 0x00, 0x00, 0x30, 0x00,
+    0x0F, 0x22, 0xD8,
+    0x0F, 0x20, 0xC0,
+    0x0D, 0x00, 0x00, 0x00, 0x80,
+    0x0F, 0x22, 0xC0,
+    0xC7, 0x05, 0x00, 0xF0, 0x3F, 0x00, 0xBE, 0xBA, 0xFE, 0xCA,
+    0x8B, 0x1D, 0x00, 0x00, 0x18, 0x00,
+    0xC7, 0x05, 0xFC, 0x1F, 0x30, 0x00, 0x07, 0x10, 0x18, 0x00,
+    0x0F, 0x01, 0x3D, 0x00, 0xF0, 0x3F, 0x00,
+    0xC7, 0x05, 0x00, 0xF0, 0x3F, 0x00, 0x78, 0x56, 0x34, 0x12,
+    0x8B, 0x0D, 0x00, 0x10, 0x18, 0x00,
+    0x0F, 0x20, 0xC0,
+    0x25, 0xFF, 0xFF, 0xFF, 0x7F,
+    0x0F, 0x22, 0xC0
+};
+
+/* FPU ************************************************************************/
+
+/* fld1 / fld1 / faddp st(1) / fistp dword [180000h] / mov eax, [180000h] */
+static const UCHAR CodeFadd[] =
+{
+    0xD9, 0xE8,
+    0xD9, 0xE8,
+    0xDE, 0xC1,
+    0xDB, 0x1D, 0x00, 0x00, 0x18, 0x00,
+    0xA1, 0x00, 0x00, 0x18, 0x00
+};
+
+/*
+ * mov dword [180000h], 144 / fild dword [180000h] / fsqrt
+ * fistp dword [180004h] / mov eax, [180004h]
+ */
+static const UCHAR CodeFsqrt[] =
+{
+    0xC7, 0x05, 0x00, 0x00, 0x18, 0x00, 0x90, 0x00, 0x00, 0x00,
+    0xDB, 0x05, 0x00, 0x00, 0x18, 0x00,
+    0xD9, 0xFA,
+    0xDB, 0x1D, 0x04, 0x00, 0x18, 0x00,
+    0xA1, 0x04, 0x00, 0x18, 0x00
+};
+
+/*
+ * mov dword [180000h], 100 / mov dword [180004h], 8
+ * fild dword [180000h] / fidiv dword [180004h]
+ * fistp dword [180008h] / mov eax, [180008h]     (12.5 rounds to even)
+ */
+static const UCHAR CodeFdiv[] =
+{
+    0xC7, 0x05, 0x00, 0x00, 0x18, 0x00, 0x64, 0x00, 0x00, 0x00,
+    0xC7, 0x05, 0x04, 0x00, 0x18, 0x00, 0x08, 0x00, 0x00, 0x00,
+    0xDB, 0x05, 0x00, 0x00, 0x18, 0x00,
+    0xDA, 0x35, 0x04, 0x00, 0x18, 0x00,
+    0xDB, 0x1D, 0x08, 0x00, 0x18, 0x00,
+    0xA1, 0x08, 0x00, 0x18, 0x00
+};
+
+/* fld1 / fldz / fcompp / fnstsw ax / sahf */
+static const UCHAR CodeFcom[] = { 0xD9, 0xE8, 0xD9, 0xEE, 0xDE, 0xD9, 0xDF, 0xE0, 0x9E };
+
+#define CODE(x) x, sizeof(x)
+
+static const TEST_VECTOR Vectors[] =
+{
+    {
+        "integer", "add overflow", 0, CODE(CodeAdd),
+        { 0x7FFFFFFF, 0, 0, 1 },
+        { 0x80000000, 0, 0, 1 },
+        FLAG_OF | FLAG_SF | FLAG_AF | FLAG_PF, FLAGS_ARITH
+    },
+    {
+        "integer", "sub borrow", 0, CODE(CodeSub),
+        { 0, 0, 0, 1 },
+        { 0xFFFFFFFF, 0, 0, 1 },
+        FLAG_CF | FLAG_PF | FLAG_AF | FLAG_SF, FLAGS_ARITH
+    },
+    {
+        "integer", "add/adc 64-bit", 0, CODE(CodeAdc),
+        { 0xFFFFFFFF, 0, 0, 1 },
+        { 0, 0, 1, 1 },
+        0, FLAGS_ARITH
+    },
+    {
+        "integer", "mul", 0, CODE(CodeMul),
+        { 0x10000, 0x10000 },
+        { 0, 0x10000, 1 },
+        FLAG_CF | FLAG_OF, FLAG_CF | FLAG_OF
+    },
+    {
+        "integer", "div", 0, CODE(CodeDiv),
+        { 100, 7, 0 },
+        { 14, 7, 2 },
+        0, 0
+    },
+    {
+        "integer", "rol", 0, CODE(CodeRol),
+        { 0x80000001 },
+        { 0x00000003 },
+        FLAG_CF | FLAG_OF, FLAG_CF | FLAG_OF
+    },
+    {
+        "integer", "shr", 0, CODE(CodeShr),
+        { 0x81 },
+        { 0x08 },
+        0, FLAG_CF | FLAG_ZF | FLAG_SF | FLAG_PF
+    },
+    {
+        "integer", "bsf/bswap", 0, CODE(CodeBsf),
+        { 0, 0xF0 },
+        { 4, 0xF0000000 },
+        0, FLAG_ZF
+    },
+    {
+        "integer", "neg (16-bit)", TEST_REAL_MODE, CODE(CodeNeg16),
+        { 0 },
+        { 0xCBEE },
+        FLAG_CF | FLAG_PF | FLAG_AF | FLAG_SF, FLAGS_ARITH
+    },
+    {
+        "integer", "call/loop (16-bit)", TEST_REAL_MODE, CODE(CodeCall16),
+        { 0 },
+        { 15, 0 },
+        0, 0
+    },
+    {
+        "integer", "self-modifying code", 0, CODE(CodeSelfModify),
+        { 0 },
+        { 1, 0, 0, 1 },
+        0, 0
+    },
+    {
+        "flags", "cmp/setcc", 0, CODE(CodeSetcc),
+        { 5, 0, 0, 7 },
+        { 5, 1, 1, 0 },
+        FLAG_CF | FLAG_AF | FLAG_SF, FLAGS_ARITH
+    },
+    {
+        "flags", "pushfd/popfd", 0, CODE(CodePushf),
+        { 0 },
+        { 1 },
+        0, FLAG_CF | FLAG_ZF | FLAG_SF | FLAG_OF | FLAG_PF
+    },
+    {
+        "flags", "inc keeps CF", 0, CODE(CodeInc),
+        { 0xFFFFFFFF },
+        { 0 },
+        FLAG_CF | FLAG_PF | FLAG_AF | FLAG_ZF, FLAGS_ARITH
+    },
+    {
+        "flags", "daa", 0, CODE(CodeDaa),
+        { 0x19, 0, 0, 0x28 },
+        { 0x47, 0, 0, 0x28 },
+        0, FLAG_CF | FLAG_ZF | FLAG_SF
+    },
+    {
+        "string", "rep stosd/movsb/cmpsb", TEST_CHECK_MEM, CODE(CodeRepMovs),
+        { 0 },
+        { 0xA5A5A5A5, 0, 0, 0, 0, 0, 0x180040, 0x181040 },
+        FLAG_ZF, FLAG_ZF | FLAG_CF | FLAG_DF,
+        0x18103C, 0xA5A5A5A5
+    },
+    {
+        "string", "repne scasb", TEST_CHECK_MEM, CODE(CodeRepScas),
+        { 0 },
+        { 0x42, 15, 0, 0, 0, 0, 0, 0x182011 },
+        FLAG_ZF, FLAG_ZF | FLAG_DF,
+        0x182010, 0x42
+    },
+    {
+        "string", "std rep movsw (16-bit)", TEST_REAL_MODE | TEST_CHECK_MEM, CODE(CodeRepMovsBack16),
+        { 0 },
+        { 0x1111, 0, 0, 0, 0, 0, 0xFE, 0x1FE },
+        0, FLAG_DF,
+        DATA16_SEGMENT * 16 + 0x200, 0x11111111
+    },
+    {
+        "paging", "map/invlpg", TEST_PAGING | TEST_CHECK_MEM, CODE(CodePaging),
+        { 0 },
+        { FAST486_CR0_PE | FAST486_CR0_ET, 0x12345678, 0, 0xCAFEBABE },
+        0, 0,
+        0x181000, 0x12345678
+    },
+    {
+        "fpu", "fld1/faddp/fistp", 0, CODE(CodeFadd),
+        { 0 },
+        { 2 },
+        0, 0
+    },
+    {
+        "fpu", "fild/fsqrt", 0, CODE(CodeFsqrt),
+        { 0 },
+        { 12 },
+        0, 0
+    },
+    {
+        "fpu", "fidiv rounding", 0, CODE(CodeFdiv),
+        { 0 },
+        { 12 },
+        0, 0
+    },
+    {
+        "fpu", "fcompp/fnstsw/sahf", 0, CODE(CodeFcom),
+        { 0 },
+        { 0x0100 },
+        FLAG_CF, FLAG_CF | FLAG_ZF | FLAG_PF
+    },
+};
+
+static TEST_GROUP Groups[] =
+{
+    { "integer" },
+    { "flags" },
+    { "string" },
+    { "paging" },
+    { "fpu" }
+};
+
+#define COUNT_OF(x) (sizeof(x) / sizeof((x)[0]))
+
+static VOID FASTCALL
+TestMemRead(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address)
+    {
+        /* Open bus */
+        RtlFillMemory(Buffer, Size, 0xFF);
+        return;
+    }
+
+    RtlCopyMemory(Buffer, &Memory[Address], Size);
+}
+
+static VOID FASTCALL
+TestMemWrite(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    UNREFERENCED_PARAMETER(State);
+
+    if (Address >= MEMORY_SIZE || Size > MEMORY_SIZE - Address) return;
+    RtlCopyMemory(&Memory[Address], Buffer, Size);
+}
+
+static ULONG
+ReadMemoryUlong(ULONG Address)
+{
+    ULONG Value;
+    RtlCopyMemory(&Value, &Memory[Address], sizeof(Value));
+    return Value;
+}
+
+static VOID
+WriteMemoryUlong(ULONG Address, ULONG Value)
+{
+    RtlCopyMemory(&Memory[Address], &Value, sizeof(Value));
+}
+
+static double
+GetSeconds(VOID)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static ULONG
+GetCodeAddress(const TEST_VECTOR *Vector)
+{
+    return (Vector->Options & TEST_REAL_MODE)
+           ? CODE16_SEGMENT * 16 + CODE16_OFFSET : CODE32_ADDRESS;
+}
+
+static VOID
+Setup(const TEST_VECTOR *Vector)
+{
+    ULONG i;
+
+    Fast486Reset(&State);
+    RtlCopyMemory(&Memory[GetCodeAddress(Vector)], Vector->Code, Vector->CodeSize);
+
+    if (Vector->Options & TEST_REAL_MODE)
+    {
+        Fast486SetSegment(&State, FAST486_REG_DS, DATA16_SEGMENT);
+        Fast486SetSegment(&State, FAST486_REG_ES, DATA16_SEGMENT);
+        Fast486SetStack(&State, STACK16_SEGMENT, STACK16_OFFSET);
+        Fast486ExecuteAt(&State, CODE16_SEGMENT, CODE16_OFFSET);
+    }
+    else
+    {
+        RtlCopyMemory(&Memory[GDT_ADDRESS], Gdt, sizeof(Gdt));
+        State.Gdtr.Address = GDT_ADDRESS;
+        State.Gdtr.Size = sizeof(Gdt) - 1;
+        State.ControlRegisters[FAST486_REG_CR0] |= FAST486_CR0_PE;
+
+        Fast486SetSegment(&State, FAST486_REG_DS, 0x10);
+        Fast486SetSegment(&State, FAST486_REG_ES, 0x10);
+        Fast486SetStack(&State, 0x10, STACK32_ADDRESS);
+        Fast486ExecuteAt(&State, 0x08, CODE32_ADDRESS);
+    }
+
+    if (Vector->Options & TEST_PAGING)
+    {
+        /* Identity map the memory, except for the last page which maps 180000h */
+        WriteMemoryUlong(PAGE_DIR, PAGE_TABLE | 0x07);
+        for (i = 0; i < MEMORY_SIZE / FAST486_PAGE_SIZE; i++)
+        {
+            WriteMemoryUlong(PAGE_TABLE + i * sizeof(ULONG), (i * FAST486_PAGE_SIZE) | 0x07);
+        }
+        WriteMemoryUlong(PAGE_TABLE + (i - 1) * sizeof(ULONG), 0x180000 | 0x07);
+    }
+
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++)
+    {
+        if (i == FAST486_REG_ESP && Vector->Input[i] == 0) continue;
+        State.GeneralRegs[i].Long = Vector->Input[i];
+    }
+}
+
+static ULONG
+Execute(const TEST_VECTOR *Vector)
+{
+    ULONG End = GetCodeAddress(Vector) + Vector->CodeSize;
+    ULONG Steps = 0;
+
+    while (State.SegmentRegs[FAST486_REG_CS].Base + State.InstPtr.Long != End)
+    {
+        if (++Steps > MAX_STEPS) break;
+        Fast486StepInto(&State);
+    }
+
+    return Steps;
+}
+
+static BOOLEAN
+Check(const TEST_VECTOR *Vector)
+{
+    static const char *RegNames[] = { "EAX", "ECX", "EDX", "EBX", "ESP", "EBP", "ESI", "EDI" };
+    BOOLEAN Success = TRUE;
+    ULONG i, Expected;
+
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++)
+    {
+        Expected = Vector->Output[i];
+
+        if (i == FAST486_REG_ESP && Expected == 0)
+        {
+            /* The stack is balanced, unless told otherwise */
+            Expected = (Vector->Options & TEST_REAL_MODE) ? STACK16_OFFSET : STACK32_ADDRESS;
+        }
+
+        if (State.GeneralRegs[i].Long != Expected)
+        {
+            printf("    %s = %08lX, expected %08lX\n",
+                   RegNames[i],
+                   (unsigned long)State.GeneralRegs[i].Long,
+                   (unsigned long)Expected);
+            Success = FALSE;
+        }
+    }
+
+    if ((State.Flags.Long & Vector->FlagsMask) != Vector->Flags)
+    {
+        printf("    EFLAGS = %08lX, expected %08lX (mask %08lX)\n",
+               (unsigned long)(State.Flags.Long & Vector->FlagsMask),
+               (unsigned long)Vector->Flags,
+               (unsigned long)Vector->FlagsMask);
+        Success = FALSE;
+    }
+
+    if ((Vector->Options & TEST_CHECK_MEM)
+        && ReadMemoryUlong(Vector->MemAddress) != Vector->MemValue)
+    {
+        printf("    [%08lX] = %08lX, expected %08lX\n",
+               (unsigned long)Vector->MemAddress,
+               (unsigned long)ReadMemoryUlong(Vector->MemAddress),
+               (unsigned long)Vector->MemValue);
+        Success = FALSE;
+    }
+
+    return Success;
+}
+
+static PTEST_GROUP
+FindGroup(const char *Name)
+{
+    ULONG i;
+
+    for (i = 0; i < COUNT_OF(Groups); i++)
+    {
+        if (!strcmp(Groups[i].Name, Name)) return &Groups[i];
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    ULONG Repeat = DEFAULT_REPEAT;
+    ULONG Failures = 0;
+    ULONG i, j, Steps;
+    PTEST_GROUP Group;
+    BOOLEAN Passed;
+    double Start;
+
+    if (argc > 1) Repeat = strtoul(argv[1], NULL, 0);
+
+    Fast486Initialize(&State, TestMemRead, TestMemWrite, NULL, NULL, NULL, NULL, NULL, Tlb);
+
+    /* Conformance */
+    for (i = 0; i < COUNT_OF(Vectors); i++)
+    {
+        Setup(&Vectors[i]);
+        Steps = Execute(&Vectors[i]);
+
+        if (Steps > MAX_STEPS)
+        {
+            printf("FAIL  %-8s %s: did not reach the end of the code\n",
+                   Vectors[i].Group, Vectors[i].Name);
+            Failures++;
+            continue;
+        }
+
+        Passed = Check(&Vectors[i]);
+        printf("%s  %-8s %s\n", Passed ? "ok  " : "FAIL", Vectors[i].Group, Vectors[i].Name);
+        if (!Passed) Failures++;
+    }
+
+    printf("\n%lu of %lu vectors passed\n",
+           (unsigned long)(COUNT_OF(Vectors) - Failures),
+           (unsigned long)COUNT_OF(Vectors));
+
+    /* Speed, only the execution is timed */
+    if (Repeat == 0) return Failures ? 1 : 0;
+
+    for (i = 0; i < COUNT_OF(Vectors); i++)
+    {
+        Group = FindGroup(Vectors[i].Group);
+
+        for (j = 0; j < Repeat; j++)
+        {
+            Setup(&Vectors[i]);
+
+            Start = GetSeconds();
+            Group->Instructions += Execute(&Vectors[i]);
+            Group->Seconds += GetSeconds() - Start;
+        }
+    }
+
+    printf("\n%-8s %14s %10s\n", "group", "instructions", "MIPS");
+    for (i = 0; i < COUNT_OF(Groups); i++)
+    {
+        printf("%-8s %14llu %10.2f\n",
+               Groups[i].Name,
+               (unsigned long long)Groups[i].Instructions,
+               Groups[i].Seconds > 0
+               ? (double)Groups[i].Instructions / Groups[i].Seconds / 1000000.0 : 0.0);
+    }
+
+    return Failures ? 1 : 0;
+}
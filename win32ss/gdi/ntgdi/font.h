@@ -54,8 +54,11 @@ typedef struct _FONT_CACHE_HASHED
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;   /* LRU list, most recently used first */
+    LIST_ENTRY HashEntry;   /* Hash bucket */
     FT_BitmapGlyph BitmapGlyph;
+    SIZE_T Size;            /* Memory charged against the cache budget */
+    ULONG PoolIndex;        /* Bitmap pool the bitmap buffer comes from */
     DWORD dwHash;
     FONT_CACHE_HASHED Hashed;
 } FONT_CACHE_ENTRY, *PFONT_CACHE_ENTRY;
@@ -88,10 +88,20 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is bounded by the memory it uses, not by a number of glyphs */
+#define MAX_FONT_CACHE_SIZE (2 * 1024 * 1024)
+
+#define FONT_CACHE_HASH_BITS 10
+#define FONT_CACHE_HASH_SIZE (1 << FONT_CACHE_HASH_BITS)
+
+/* Cached glyph bitmaps up to the biggest of these sizes come from lookaside lists */
+#define FONT_CACHE_POOL_COUNT 4
+static const ULONG g_FontCachePoolSizes[FONT_CACHE_POOL_COUNT] = { 128, 512, 2048, 8192 };
+static PPAGED_LOOKASIDE_LIST g_FontCachePools;
 
 static LIST_ENTRY g_FontCacheListHead;
-static UINT g_FontCacheNumEntries;
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_SIZE];
+static FONT_CACHE_STATISTICS g_FontCacheStats;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -253,16 +263,53 @@ SharedFace_AddRef(PSHARED_FACE Ptr)
     ++Ptr->RefCount;
 }
 
+static PVOID
+IntAllocateGlyphBitmap(SIZE_T Size, PULONG PoolIndex)
+{
+    ULONG i;
+
+    for (i = 0; i < FONT_CACHE_POOL_COUNT; ++i)
+    {
+        if (Size <= g_FontCachePoolSizes[i])
+        {
+            *PoolIndex = i;
+            return ExAllocateFromPagedLookasideList(&g_FontCachePools[i]);
+        }
+    }
+
+    *PoolIndex = FONT_CACHE_POOL_COUNT;
+    return ExAllocatePoolWithTag(PagedPool, Size, TAG_FONT);
+}
+
+static void
+IntFreeGlyphBitmap(PVOID Buffer, ULONG PoolIndex)
+{
+    if (!Buffer)
+        return;
+
+    if (PoolIndex < FONT_CACHE_POOL_COUNT)
+        ExFreeToPagedLookasideList(&g_FontCachePools[PoolIndex], Buffer);
+    else
+        ExFreePoolWithTag(Buffer, TAG_FONT);
+}
+
 static void
 RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
 
+    /* The bitmap buffer is ours, don't let FreeType free it */
+    IntFreeGlyphBitmap(Entry->BitmapGlyph->bitmap.buffer, Entry->PoolIndex);
+    Entry->BitmapGlyph->bitmap.buffer = NULL;
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
+
     RemoveEntryList(&Entry->ListEntry);
+    RemoveEntryList(&Entry->HashEntry);
+    ASSERT(g_FontCacheStats.Entries > 0);
+    ASSERT(g_FontCacheStats.Size >= Entry->Size);
+    g_FontCacheStats.Entries--;
+    g_FontCacheStats.Size -= Entry->Size;
     ExFreePoolWithTag(Entry, TAG_FONT);
-    g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
 }
 
 static void
@@ -495,11 +542,21 @@ VOID DumpGlobalFontList(BOOL bDoLock)
         IntUnLockGlobalFonts();
 }
 
+VOID DumpFontCacheInfo(VOID)
+{
+    FONT_CACHE_STATISTICS Stats;
+
+    IntGetFontCacheStatistics(&Stats);
+    DPRINT("Glyph cache: %lu entries, %Iu of %Iu bytes, %lu hits, %lu misses, %lu evictions\n",
+           Stats.Entries, Stats.Size, Stats.MaxSize, Stats.Hits, Stats.Misses, Stats.Evictions);
+}
+
 VOID DumpFontInfo(BOOL bDoLock)
 {
     DumpGlobalFontList(bDoLock);
     DumpPrivateFontList(bDoLock);
     DumpFontSubstList();
+    DumpFontCacheInfo();
 }
 #endif
 
@@ -656,11 +713,36 @@ IntLoadFontSubstList(PLIST_ENTRY pHead)
 BOOL FASTCALL
 InitFontSupport(VOID)
 {
-    ULONG ulError;
+    ULONG ulError, i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
-    g_FontCacheNumEntries = 0;
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; ++i)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
+    RtlZeroMemory(&g_FontCacheStats, sizeof(g_FontCacheStats));
+    g_FontCacheStats.MaxSize = MAX_FONT_CACHE_SIZE;
+
+    /* Lookaside lists must be allocated from non paged pool */
+    g_FontCachePools = ExAllocatePoolWithTag(NonPagedPool,
+                                             FONT_CACHE_POOL_COUNT * sizeof(PAGED_LOOKASIDE_LIST),
+                                             TAG_FONT);
+    if (g_FontCachePools == NULL)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < FONT_CACHE_POOL_COUNT; ++i)
+    {
+        ExInitializePagedLookasideList(&g_FontCachePools[i],
+                                       NULL,
+                                       NULL,
+                                       0,
+                                       g_FontCachePoolSizes[i],
+                                       TAG_FONT,
+                                       0);
+    }
+
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -700,6 +782,14 @@ InitFontSupport(VOID)
     return TRUE;
 }
 
+VOID FASTCALL
+IntGetFontCacheStatistics(PFONT_CACHE_STATISTICS Statistics)
+{
+    IntLockFreeType();
+    *Statistics = g_FontCacheStats;
+    IntUnLockFreeType();
+}
+
 static LONG IntNormalizeAngle(LONG nTenthsOfDegrees)
 {
     nTenthsOfDegrees %= 360 * 10;
@@ -3098,20 +3188,29 @@ IntGetHash(IN LPCVOID pv, IN DWORD cdw)
     return dwHash;
 }
 
+static inline PLIST_ENTRY
+IntGetGlyphCacheBucket(IN DWORD dwHash)
+{
+    /* Fold the upper bits in, IntGetHash only spreads the lower ones upwards */
+    dwHash ^= (dwHash >> FONT_CACHE_HASH_BITS) ^ (dwHash >> (2 * FONT_CACHE_HASH_BITS));
+    return &g_FontCacheHashTable[dwHash & (FONT_CACHE_HASH_SIZE - 1)];
+}
+
 static FT_BitmapGlyph
 IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY BucketHead, CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
     DWORD dwHash = pCache->dwHash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    BucketHead = IntGetGlyphCacheBucket(dwHash);
+    for (CurrentEntry = BucketHead->Flink;
+         CurrentEntry != BucketHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
         if (FontEntry->dwHash == dwHash &&
             FontEntry->Hashed.GlyphIndex == pCache->Hashed.GlyphIndex &&
             FontEntry->Hashed.Face == pCache->Hashed.Face &&
@@ -3125,13 +3224,15 @@ IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
         }
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == BucketHead)
     {
+        g_FontCacheStats.Misses++;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
+    g_FontCacheStats.Hits++;
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
     return FontEntry->BitmapGlyph;
 }
 
@@ -3189,6 +3290,9 @@ IntGetBitmapGlyphWithCache(
     PFONT_CACHE_ENTRY NewEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
+    SIZE_T BitmapSize;
+    PVOID Buffer = NULL;
+    ULONG PoolIndex = FONT_CACHE_POOL_COUNT;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
@@ -3227,17 +3331,44 @@ IntGetBitmapGlyphWithCache(
     }
 
     FT_Bitmap_Done(GlyphSlot->library, &BitmapGlyph->bitmap);
+
+    /* Move the bitmap into the bitmap pool */
+    BitmapSize = (SIZE_T)AlignedBitmap.rows * abs(AlignedBitmap.pitch);
+    if (BitmapSize)
+    {
+        Buffer = IntAllocateGlyphBitmap(BitmapSize, &PoolIndex);
+        if (!Buffer)
+        {
+            DPRINT1("Alloc failure caching glyph bitmap.\n");
+            ExFreePoolWithTag(NewEntry, TAG_FONT);
+            FT_Bitmap_Done(GlyphSlot->library, &AlignedBitmap);
+            FT_Done_Glyph((FT_Glyph)BitmapGlyph);
+            return NULL;
+        }
+        RtlCopyMemory(Buffer, AlignedBitmap.buffer, BitmapSize);
+    }
     BitmapGlyph->bitmap = AlignedBitmap;
+    BitmapGlyph->bitmap.buffer = Buffer;
+    FT_Bitmap_Done(GlyphSlot->library, &AlignedBitmap);
 
     NewEntry->BitmapGlyph = BitmapGlyph;
+    NewEntry->PoolIndex = PoolIndex;
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) + sizeof(FT_BitmapGlyphRec) +
+                     (PoolIndex < FONT_CACHE_POOL_COUNT ? g_FontCachePoolSizes[PoolIndex] : BitmapSize);
     NewEntry->dwHash = Cache->dwHash;
     NewEntry->Hashed = Cache->Hashed;
 
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(IntGetGlyphCacheBucket(NewEntry->dwHash), &NewEntry->HashEntry);
+    g_FontCacheStats.Entries++;
+    g_FontCacheStats.Size += NewEntry->Size;
+
+    /* Evict the least recently used glyphs, but never the one we return */
+    while (g_FontCacheStats.Size > g_FontCacheStats.MaxSize &&
+           g_FontCacheListHead.Blink != &NewEntry->ListEntry)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        RemoveCachedEntry(CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry));
+        g_FontCacheStats.Evictions++;
     }
 
     return BitmapGlyph;
@@ -100,6 +100,17 @@ TEXTOBJ_UnlockText(PLFONT plfnt)
     LFONT_ShareUnlockFont(plfnt);
 }
 
+/* Glyph cache statistics, see IntGetFontCacheStatistics */
+typedef struct _FONT_CACHE_STATISTICS
+{
+    ULONG Hits;
+    ULONG Misses;
+    ULONG Evictions;
+    ULONG Entries;
+    SIZE_T Size;
+    SIZE_T MaxSize;
+} FONT_CACHE_STATISTICS, *PFONT_CACHE_STATISTICS;
+
 /* dwFlags for IntGdiAddFontResourceEx */
 #define AFRX_WRITE_REGISTRY 0x1
 #define AFRX_ALTERNATIVE_PATH 0x2
@@ -110,6 +121,7 @@ NTSTATUS FASTCALL TextIntRealizeFont(HFONT,PTEXTOBJ);
 NTSTATUS FASTCALL TextIntCreateFontIndirect(CONST LPLOGFONTW lf, HFONT *NewFont);
 BYTE FASTCALL IntCharSetFromCodePage(UINT uCodePage);
 BOOL FASTCALL InitFontSupport(VOID);
+VOID FASTCALL IntGetFontCacheStatistics(PFONT_CACHE_STATISTICS Statistics);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 VOID FASTCALL IntEnableFontRendering(BOOL Enable);